@@ -0,0 +1,224 @@
+#include "ball_tree.hpp"
+#include <algorithm> // For std::nth_element and std::max
+#include <cmath>     // For std::sqrt
+#include <iostream>
+#include <utility>   // For std::pair
+#include <omp.h>     // For OpenMP
+
+namespace
+{
+    // Subtrees with more points than this are built as separate OpenMP tasks
+    constexpr size_t PARALLEL_BUILD_MIN = 2048;
+
+    // Relative slack on the pruning test, so rounding in the center distance never prunes a true neighbor
+    constexpr float PRUNE_SLACK = 1e-4f;
+
+    // Nodes of the tree over count points; the shape depends only on count and leaf_size
+    size_t subtree_nodes(size_t count, size_t leaf_size)
+    {
+        if (count <= leaf_size)
+        {
+            return 1;
+        }
+        return 1 + subtree_nodes(count / 2, leaf_size) + subtree_nodes(count - count / 2, leaf_size);
+    }
+}
+
+ball_tree::ball_tree(const dataset_view& training, distance_metric m, size_t leaf)
+    : feature_count(training.get_normalized_feature_count()), leaf_size(std::max<size_t>(leaf, 1)), metric(m)
+{
+    if (metric == distance_metric::cosine)
+    {
+        std::cerr << "The ball tree needs a true metric; cosine distance is not supported." << std::endl;
+        exit(1);
+    }
+    if (training.get_normalized_precision() != feature_precision::fp32)
+    {
+        std::cerr << "The ball tree needs normalized rows stored at fp32." << std::endl;
+        exit(1);
+    }
+    kernel = get_distance_kernels().get(metric);
+
+    const size_t n = training.size();
+    if (n == 0)
+    {
+        return;
+    }
+    nodes.resize(subtree_nodes(n, leaf_size));
+    centers.resize(nodes.size() * feature_count);
+
+    // Positions into the view, permuted into leaf order while building
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    #pragma omp parallel
+    #pragma omp single
+    build(0, order.data(), 0, n, training);
+
+    points.resize(n * feature_count);
+    point_ids.resize(n);
+    #pragma omp parallel for
+    for (long long i = 0; i < static_cast<long long>(n); ++i)
+    {
+        auto row = training.normalized_row(order[i]);
+        std::copy(row.begin(), row.end(), points.data() + i * feature_count);
+        point_ids[i] = training.index(order[i]);
+    }
+}
+
+float ball_tree::to_metric(float distance) const
+{
+    return metric == distance_metric::squared_l2 ? std::sqrt(distance) : distance;
+}
+
+void ball_tree::build(size_t node_index, uint32_t* order, size_t begin, size_t end, const dataset_view& training)
+{
+    const size_t count = end - begin;
+    float* center = centers.data() + node_index * feature_count;
+
+    // Centroid of the node's points
+    std::vector<double> sum(feature_count, 0.0);
+    for (size_t i = begin; i < end; ++i)
+    {
+        auto row = training.normalized_row(order[i]);
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            sum[j] += row[j];
+        }
+    }
+    for (size_t j = 0; j < feature_count; ++j)
+    {
+        center[j] = static_cast<float>(sum[j] / static_cast<double>(count));
+    }
+
+    // Radius, and the point farthest from the center as the first split pivot
+    float radius = 0.0f;
+    size_t pivot_a = begin;
+    for (size_t i = begin; i < end; ++i)
+    {
+        float distance = kernel(center, training.normalized_row(order[i]).data(), feature_count);
+        if (distance > radius)
+        {
+            radius = distance;
+            pivot_a = i;
+        }
+    }
+
+    node& current = nodes[node_index];
+    current.radius = to_metric(radius);
+    current.begin = static_cast<uint32_t>(begin);
+    current.end = static_cast<uint32_t>(end);
+    current.right = 0;
+    if (count <= leaf_size)
+    {
+        return;
+    }
+
+    // Second pivot: the point farthest from the first
+    const float* a = training.normalized_row(order[pivot_a]).data();
+    float farthest = -1.0f;
+    size_t pivot_b = begin;
+    for (size_t i = begin; i < end; ++i)
+    {
+        float distance = kernel(a, training.normalized_row(order[i]).data(), feature_count);
+        if (distance > farthest)
+        {
+            farthest = distance;
+            pivot_b = i;
+        }
+    }
+
+    // Split at the median of the projections onto the pivot axis
+    const float* b = training.normalized_row(order[pivot_b]).data();
+    std::vector<float> axis(feature_count);
+    for (size_t j = 0; j < feature_count; ++j)
+    {
+        axis[j] = b[j] - a[j];
+    }
+    std::vector<std::pair<float, uint32_t>> projected(count);
+    for (size_t i = begin; i < end; ++i)
+    {
+        auto row = training.normalized_row(order[i]);
+        float dot = 0.0f;
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            dot += row[j] * axis[j];
+        }
+        projected[i - begin] = {dot, order[i]};
+    }
+    const size_t half = count / 2;
+    std::nth_element(projected.begin(), projected.begin() + half, projected.end());
+    for (size_t i = 0; i < count; ++i)
+    {
+        order[begin + i] = projected[i].second;
+    }
+
+    const size_t mid = begin + half;
+    const size_t left = node_index + 1;
+    const size_t right = left + subtree_nodes(half, leaf_size);
+    current.right = static_cast<uint32_t>(right);
+
+    const dataset_view* view = &training;
+    #pragma omp task if(half > PARALLEL_BUILD_MIN)
+    build(left, order, begin, mid, *view);
+    #pragma omp task if(count - half > PARALLEL_BUILD_MIN)
+    build(right, order, mid, end, *view);
+}
+
+void ball_tree::search(span<const float> query, size_t k, top_k& best, search_stats& stats) const
+{
+    if (query.size() != feature_count)
+    {
+        std::cerr << "The ball tree cannot search with a query of " << query.size() << " features." << std::endl;
+        exit(1);
+    }
+    best.reset(k);
+    if (!nodes.empty())
+    {
+        descend(0, query.data(), best, stats);
+    }
+}
+
+void ball_tree::descend(size_t node_index, const float* query, top_k& best, search_stats& stats) const
+{
+    const node& current = nodes[node_index];
+    stats.nodes_visited++;
+
+    if (current.right == 0)
+    {
+        // Leaf: its points are contiguous, so this is a short linear scan
+        for (uint32_t p = current.begin; p < current.end; ++p)
+        {
+            best.push(kernel(query, points.data() + p * feature_count, feature_count), point_ids[p]);
+        }
+        stats.distance_evaluations += current.end - current.begin;
+        return;
+    }
+
+    // Lower bound on the distance to anything in each child's ball; visit the nearer child first
+    size_t children[2] = {node_index + 1, current.right};
+    float bounds[2];
+    for (int c = 0; c < 2; ++c)
+    {
+        float to_center = to_metric(kernel(query, centers.data() + children[c] * feature_count, feature_count));
+        bounds[c] = std::max(0.0f, to_center - nodes[children[c]].radius);
+    }
+    if (bounds[1] < bounds[0])
+    {
+        std::swap(children[0], children[1]);
+        std::swap(bounds[0], bounds[1]);
+    }
+
+    for (int c = 0; c < 2; ++c)
+    {
+        // Branch and bound: the k-th distance only shrinks, so once a ball is out of reach so is the farther one
+        if (bounds[c] > to_metric(best.threshold()) * (1.0f + PRUNE_SLACK))
+        {
+            break;
+        }
+        descend(children[c], query, best, stats);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef __BALL_TREE_HPP
+#define __BALL_TREE_HPP
+
+#include "../../include/dataset.hpp"
+#include "distance.hpp"
+#include "search_index.hpp"
+#include <vector>
+
+// Exact k-nearest-neighbor index: a binary tree of balls (centroid plus radius) over the training
+// rows. Each split projects a node's points onto the line between two far-apart points and cuts at
+// the median, which works in high dimensions where a KD-tree's per-axis splits do not. A subtree is
+// skipped when its ball lies entirely beyond the current k-th distance, so results equal the scan's.
+// Works for true metrics: squared_l2 (bounded through its square root) and l1.
+class ball_tree : public search_index
+{
+    struct node
+    {
+        float radius;   // Largest metric distance from the center to a point below
+        uint32_t begin; // Range of the node's points in leaf order
+        uint32_t end;
+        uint32_t right; // Index of the right child; the left child directly follows its parent. 0 for leaves.
+    };
+
+    size_t feature_count;
+    size_t leaf_size;
+    distance_metric metric;
+    distance_kernel kernel;
+
+    std::vector<node> nodes;           // Preorder
+    aligned_buffer<float> centers;     // One row of feature_count per node
+    aligned_buffer<float> points;      // Training rows, copied in leaf order so every leaf is contiguous
+    std::vector<uint32_t> point_ids;   // Dataset row of each point
+
+    // Convert a kernel value to the metric distance the ball bounds hold for
+    float to_metric(float distance) const;
+
+    void build(size_t node_index, uint32_t* order, size_t begin, size_t end, const dataset_view& training);
+    void descend(size_t node_index, const float* query, top_k& best, search_stats& stats) const;
+
+public:
+    static constexpr size_t DEFAULT_LEAF_SIZE = 32;
+
+    // Build over the normalized rows of training, stored at fp32; subtrees above a few thousand points are built in parallel
+    ball_tree(const dataset_view& training, distance_metric metric, size_t leaf_size = DEFAULT_LEAF_SIZE);
+
+    void search(span<const float> query, size_t k, top_k& best, search_stats& stats) const override;
+
+    size_t size() const { return point_ids.size(); }
+    size_t node_count() const { return nodes.size(); }
+};
+
+#endif // __BALL_TREE_HPP
@@ -0,0 +1,342 @@
+#include "batch_distance.hpp"
+#include "../../include/profiler.hpp"
+#include <algorithm> // For std::min and std::max
+#include <omp.h>     // For OpenMP
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KNN_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr size_t MR = batch_distance_engine::MICRO_ROWS;
+    constexpr size_t NR = batch_distance_engine::MICRO_COLS;
+
+    // c (MR rows of NR values, row stride ldc) = (accumulate ? c : 0) + the MR x NR dot products of kc
+    // features. qp holds MR query values per feature, tp holds NR training values per feature.
+    using micro_kernel = void (*)(const float* qp, const float* tp, size_t kc, float* c, size_t ldc, bool accumulate);
+
+    void micro_kernel_scalar(const float* qp, const float* tp, size_t kc, float* c, size_t ldc, bool accumulate)
+    {
+        float acc[MR][NR];
+        for (size_t r = 0; r < MR; ++r)
+        {
+            for (size_t j = 0; j < NR; ++j)
+            {
+                acc[r][j] = accumulate ? c[r * ldc + j] : 0.0f;
+            }
+        }
+        for (size_t p = 0; p < kc; ++p)
+        {
+            for (size_t r = 0; r < MR; ++r)
+            {
+                float q = qp[p * MR + r];
+                for (size_t j = 0; j < NR; ++j)
+                {
+                    acc[r][j] += q * tp[p * NR + j];
+                }
+            }
+        }
+        for (size_t r = 0; r < MR; ++r)
+        {
+            for (size_t j = 0; j < NR; ++j)
+            {
+                c[r * ldc + j] = acc[r][j];
+            }
+        }
+    }
+
+#ifdef KNN_X86_KERNELS
+    // Two passes of 8 training rows, each keeping an 8 x 8 tile in eight ymm accumulators
+    __attribute__((target("avx2,fma"))) void micro_kernel_avx2(const float* qp, const float* tp, size_t kc, float* c, size_t ldc, bool accumulate)
+    {
+        for (size_t half = 0; half < NR; half += 8)
+        {
+            __m256 c0, c1, c2, c3, c4, c5, c6, c7;
+            if (accumulate)
+            {
+                c0 = _mm256_loadu_ps(c + 0 * ldc + half);
+                c1 = _mm256_loadu_ps(c + 1 * ldc + half);
+                c2 = _mm256_loadu_ps(c + 2 * ldc + half);
+                c3 = _mm256_loadu_ps(c + 3 * ldc + half);
+                c4 = _mm256_loadu_ps(c + 4 * ldc + half);
+                c5 = _mm256_loadu_ps(c + 5 * ldc + half);
+                c6 = _mm256_loadu_ps(c + 6 * ldc + half);
+                c7 = _mm256_loadu_ps(c + 7 * ldc + half);
+            }
+            else
+            {
+                c0 = c1 = c2 = c3 = c4 = c5 = c6 = c7 = _mm256_setzero_ps();
+            }
+            for (size_t p = 0; p < kc; ++p)
+            {
+                __m256 t = _mm256_load_ps(tp + p * NR + half);
+                const float* q = qp + p * MR;
+                c0 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 0), t, c0);
+                c1 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 1), t, c1);
+                c2 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 2), t, c2);
+                c3 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 3), t, c3);
+                c4 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 4), t, c4);
+                c5 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 5), t, c5);
+                c6 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 6), t, c6);
+                c7 = _mm256_fmadd_ps(_mm256_broadcast_ss(q + 7), t, c7);
+            }
+            _mm256_storeu_ps(c + 0 * ldc + half, c0);
+            _mm256_storeu_ps(c + 1 * ldc + half, c1);
+            _mm256_storeu_ps(c + 2 * ldc + half, c2);
+            _mm256_storeu_ps(c + 3 * ldc + half, c3);
+            _mm256_storeu_ps(c + 4 * ldc + half, c4);
+            _mm256_storeu_ps(c + 5 * ldc + half, c5);
+            _mm256_storeu_ps(c + 6 * ldc + half, c6);
+            _mm256_storeu_ps(c + 7 * ldc + half, c7);
+        }
+    }
+
+    // The whole 8 x 16 tile in eight zmm accumulators
+    __attribute__((target("avx512f"))) void micro_kernel_avx512(const float* qp, const float* tp, size_t kc, float* c, size_t ldc, bool accumulate)
+    {
+        __m512 c0, c1, c2, c3, c4, c5, c6, c7;
+        if (accumulate)
+        {
+            c0 = _mm512_loadu_ps(c + 0 * ldc);
+            c1 = _mm512_loadu_ps(c + 1 * ldc);
+            c2 = _mm512_loadu_ps(c + 2 * ldc);
+            c3 = _mm512_loadu_ps(c + 3 * ldc);
+            c4 = _mm512_loadu_ps(c + 4 * ldc);
+            c5 = _mm512_loadu_ps(c + 5 * ldc);
+            c6 = _mm512_loadu_ps(c + 6 * ldc);
+            c7 = _mm512_loadu_ps(c + 7 * ldc);
+        }
+        else
+        {
+            c0 = c1 = c2 = c3 = c4 = c5 = c6 = c7 = _mm512_setzero_ps();
+        }
+        for (size_t p = 0; p < kc; ++p)
+        {
+            __m512 t = _mm512_load_ps(tp + p * NR);
+            const float* q = qp + p * MR;
+            c0 = _mm512_fmadd_ps(_mm512_set1_ps(q[0]), t, c0);
+            c1 = _mm512_fmadd_ps(_mm512_set1_ps(q[1]), t, c1);
+            c2 = _mm512_fmadd_ps(_mm512_set1_ps(q[2]), t, c2);
+            c3 = _mm512_fmadd_ps(_mm512_set1_ps(q[3]), t, c3);
+            c4 = _mm512_fmadd_ps(_mm512_set1_ps(q[4]), t, c4);
+            c5 = _mm512_fmadd_ps(_mm512_set1_ps(q[5]), t, c5);
+            c6 = _mm512_fmadd_ps(_mm512_set1_ps(q[6]), t, c6);
+            c7 = _mm512_fmadd_ps(_mm512_set1_ps(q[7]), t, c7);
+        }
+        _mm512_storeu_ps(c + 0 * ldc, c0);
+        _mm512_storeu_ps(c + 1 * ldc, c1);
+        _mm512_storeu_ps(c + 2 * ldc, c2);
+        _mm512_storeu_ps(c + 3 * ldc, c3);
+        _mm512_storeu_ps(c + 4 * ldc, c4);
+        _mm512_storeu_ps(c + 5 * ldc, c5);
+        _mm512_storeu_ps(c + 6 * ldc, c6);
+        _mm512_storeu_ps(c + 7 * ldc, c7);
+    }
+#endif // KNN_X86_KERNELS
+
+    micro_kernel select_micro_kernel()
+    {
+#ifdef KNN_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            return micro_kernel_avx512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return micro_kernel_avx2;
+        }
+#endif
+        return micro_kernel_scalar;
+    }
+
+    size_t round_up(size_t value, size_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    float same(float value) { return value; }
+
+    // Copy rows [first, first + count) into panels of width rows, each element converted by Widen.
+    // Panel g holds feature p of its rows at out[g * features * width + p * width + lane]; lanes past
+    // count are zero.
+    template <auto Widen = same, typename RowAt>
+    void pack_panels(RowAt row_at, size_t first, size_t count, size_t width, size_t features, float* out)
+    {
+        size_t panels = (count + width - 1) / width;
+        for (size_t g = 0; g < panels; ++g)
+        {
+            float* panel = out + g * features * width;
+            for (size_t lane = 0; lane < width; ++lane)
+            {
+                size_t i = g * width + lane;
+                if (i < count)
+                {
+                    const auto* row = row_at(first + i);
+                    for (size_t p = 0; p < features; ++p)
+                    {
+                        panel[p * width + lane] = Widen(row[p]);
+                    }
+                }
+                else
+                {
+                    for (size_t p = 0; p < features; ++p)
+                    {
+                        panel[p * width + lane] = 0.0f;
+                    }
+                }
+            }
+        }
+    }
+
+    template <auto Widen = same, typename T>
+    float squared_norm(const T* row, size_t features)
+    {
+        float sum = 0.0f;
+        for (size_t p = 0; p < features; ++p)
+        {
+            const float value = Widen(row[p]);
+            sum += value * value;
+        }
+        return sum;
+    }
+}
+
+batch_distance_engine::batch_distance_engine(const dataset_view& training_view)
+    : training(training_view),
+      training_norms(training_view.size()),
+      precision(training_view.get_normalized_precision())
+{
+    const size_t features = training.get_normalized_feature_count();
+    #pragma omp parallel for
+    for (long long j = 0; j < static_cast<long long>(training.size()); ++j)
+    {
+        if (precision == feature_precision::fp32)
+        {
+            training_norms[j] = squared_norm(training.normalized_row(j).data(), features);
+        }
+        else if (precision == feature_precision::bf16)
+        {
+            training_norms[j] = squared_norm<bf16_to_float>(training.half_row(j).data(), features);
+        }
+        else
+        {
+            training_norms[j] = squared_norm<fp16_to_float>(training.half_row(j).data(), features);
+        }
+    }
+}
+
+neighbor_table batch_distance_engine::search(const dataset_view& queries, size_t k, int threads) const
+{
+    const size_t features = queries.get_normalized_feature_count();
+    const bool widen = queries.get_normalized_precision() != feature_precision::fp32;
+    aligned_buffer<float> widened(widen ? queries.size() * features : 0);
+    std::vector<const float*> rows(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        if (widen)
+        {
+            queries.widen_normalized_row(i, widened.data() + i * features);
+        }
+        rows[i] = widen ? widened.data() + i * features : queries.normalized_row(i).data();
+    }
+    return search(rows, k, threads);
+}
+
+neighbor_table batch_distance_engine::search(const std::vector<const float*>& queries, size_t k, int threads) const
+{
+    static const micro_kernel kernel = select_micro_kernel();
+
+    neighbor_table results;
+    results.k = std::min(k, training.size());
+    results.entries.resize(queries.size() * results.k);
+    if (results.k == 0 || queries.empty())
+    {
+        return results;
+    }
+
+    const size_t features = training.get_normalized_feature_count();
+    const auto query_at = [&](size_t i) { return queries[i]; };
+    const auto train_at = [&](size_t j) { return training.normalized_row(j).data(); };
+    const auto half_at = [&](size_t j) { return training.half_row(j).data(); };
+    const long long blocks = static_cast<long long>((queries.size() + QUERY_BLOCK - 1) / QUERY_BLOCK);
+
+    // Query blocks are independent; each thread owns its packing buffers, tile and heaps
+    #pragma omp parallel num_threads(threads > 0 ? threads : omp_get_max_threads())
+    {
+        aligned_buffer<float> query_panels(round_up(QUERY_BLOCK, MR) * features);
+        aligned_buffer<float> train_panels(round_up(TRAIN_BLOCK, NR) * features);
+        aligned_buffer<float> tile(round_up(QUERY_BLOCK, MR) * TRAIN_BLOCK); // q.t products of the current block pair
+        std::vector<float> query_norms(QUERY_BLOCK);
+        std::vector<top_k> best(QUERY_BLOCK);
+
+        #pragma omp for schedule(dynamic)
+        for (long long block = 0; block < blocks; ++block)
+        {
+            PROFILE_PHASE("batch_distance");
+            const size_t q0 = static_cast<size_t>(block) * QUERY_BLOCK;
+            const size_t query_count = std::min(QUERY_BLOCK, queries.size() - q0);
+            const size_t query_groups = (query_count + MR - 1) / MR;
+            pack_panels(query_at, q0, query_count, MR, features, query_panels.data());
+            for (size_t i = 0; i < query_count; ++i)
+            {
+                query_norms[i] = squared_norm(queries[q0 + i], features);
+                best[i].reset(results.k);
+            }
+
+            for (size_t t0 = 0; t0 < training.size(); t0 += TRAIN_BLOCK)
+            {
+                const size_t train_count = std::min(TRAIN_BLOCK, training.size() - t0);
+                const size_t train_groups = (train_count + NR - 1) / NR;
+                if (precision == feature_precision::fp32)
+                {
+                    pack_panels(train_at, t0, train_count, NR, features, train_panels.data());
+                }
+                else if (precision == feature_precision::bf16)
+                {
+                    pack_panels<bf16_to_float>(half_at, t0, train_count, NR, features, train_panels.data());
+                }
+                else
+                {
+                    pack_panels<fp16_to_float>(half_at, t0, train_count, NR, features, train_panels.data());
+                }
+
+                // Feature chunks keep one training micro-panel in L1 while the query panels stream from L2
+                for (size_t p0 = 0; p0 < features; p0 += FEATURE_CHUNK)
+                {
+                    const size_t chunk = std::min(FEATURE_CHUNK, features - p0);
+                    for (size_t g = 0; g < train_groups; ++g)
+                    {
+                        const float* tp = train_panels.data() + g * features * NR + p0 * NR;
+                        for (size_t h = 0; h < query_groups; ++h)
+                        {
+                            const float* qp = query_panels.data() + h * features * MR + p0 * MR;
+                            kernel(qp, tp, chunk, tile.data() + h * MR * TRAIN_BLOCK + g * NR, TRAIN_BLOCK, p0 > 0);
+                        }
+                    }
+                }
+
+                // Fold the finished tile into the heaps; clamp the rounding error of the expansion at zero
+                for (size_t i = 0; i < query_count; ++i)
+                {
+                    const float* products = tile.data() + i * TRAIN_BLOCK;
+                    for (size_t j = 0; j < train_count; ++j)
+                    {
+                        float dist = std::max(0.0f, query_norms[i] - 2.0f * products[j] + training_norms[t0 + j]);
+                        best[i].push(dist, training.index(t0 + j));
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < query_count; ++i)
+            {
+                const auto& nearest = best[i].sorted();
+                std::copy(nearest.begin(), nearest.end(), results.row(q0 + i).begin());
+            }
+        }
+    }
+
+    return results;
+}
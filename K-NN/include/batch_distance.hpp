@@ -0,0 +1,37 @@
+#ifndef __BATCH_DISTANCE_HPP
+#define __BATCH_DISTANCE_HPP
+
+#include "../../include/dataset.hpp"
+#include "distance.hpp"
+#include "top_k.hpp"
+#include <vector>
+
+// Nearest neighbors of many queries at once under squared L2. Distances are expanded as
+// ||q||^2 - 2 q.t + ||t||^2, so the q.t terms of a block of queries against a block of training
+// rows form a small matrix product. That product is computed tile by tile with packed, cache-blocked
+// panels and a register-tiled micro-kernel, and every finished tile is folded into the per-query
+// top-k heaps right away: the full query x training distance matrix never exists.
+class batch_distance_engine
+{
+    dataset_view training;
+    std::vector<float> training_norms; // ||t||^2 per training row of the view
+    feature_precision precision;       // Of the training rows; fp16 and bf16 rows are widened while packing
+
+public:
+    // Tiling parameters: queries and training rows per block, features per packed chunk, micro-tile shape
+    static constexpr size_t QUERY_BLOCK = 256;
+    static constexpr size_t TRAIN_BLOCK = 128;
+    static constexpr size_t FEATURE_CHUNK = 256;
+    static constexpr size_t MICRO_ROWS = 8;  // Queries per micro-tile
+    static constexpr size_t MICRO_COLS = 16; // Training rows per micro-tile
+
+    explicit batch_distance_engine(const dataset_view& training_view);
+
+    // The k nearest training rows of every query, nearest first; reduced-precision query rows are widened. Query blocks are spread over
+    // threads (0 = OpenMP default); the engine itself is never modified, so concurrent calls are safe.
+    neighbor_table search(const dataset_view& queries, size_t k, int threads = 0) const;
+    // Same, for queries given as pointers to rows of the training feature count
+    neighbor_table search(const std::vector<const float*>& queries, size_t k, int threads = 0) const;
+};
+
+#endif // __BATCH_DISTANCE_HPP
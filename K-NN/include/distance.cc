@@ -0,0 +1,1032 @@
+#include "distance.hpp"
+#include <cmath> // For std::sqrt and std::fabs
+#include <cstring> // For std::memcpy
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KNN_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Cosine distance from the accumulated dot product and squared norms
+    inline float cosine_from_sums(float dot, float norm_a, float norm_b)
+    {
+        if (norm_a == 0.0f || norm_b == 0.0f)
+        {
+            return 1.0f;
+        }
+        return 1.0f - dot / std::sqrt(norm_a * norm_b);
+    }
+
+    // Scalar reference kernels
+
+    float squared_l2_scalar(const float* a, const float* b, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    float l1_scalar(const float* a, const float* b, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += std::fabs(a[i] - b[i]);
+        }
+        return sum;
+    }
+
+    float cosine_scalar(const float* a, const float* b, size_t n)
+    {
+        float dot = 0.0f, norm_a = 0.0f, norm_b = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            dot += a[i] * b[i];
+            norm_a += a[i] * a[i];
+            norm_b += b[i] * b[i];
+        }
+        return cosine_from_sums(dot, norm_a, norm_b);
+    }
+
+    uint32_t integer_squared_l2_scalar(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            int diff = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+            sum += static_cast<uint32_t>(diff * diff);
+        }
+        return sum;
+    }
+
+    uint32_t integer_l1_scalar(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        }
+        return sum;
+    }
+
+    float weighted_squared_l2_scalar(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float diff = static_cast<float>(static_cast<int>(a[i]) - static_cast<int>(b[i]));
+            sum += weights[i] * diff * diff;
+        }
+        return sum;
+    }
+
+    float weighted_l1_scalar(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += weights[i] * static_cast<float>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+        }
+        return sum;
+    }
+
+    // Reduced-precision kernels: a float query against an fp16 or bf16 training row, widened to float
+    // on the fly; the arithmetic is that of the float kernels
+
+    template <float (*Widen)(uint16_t)>
+    float half_squared_l2_scalar(const float* a, const uint16_t* b, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float diff = a[i] - Widen(b[i]);
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    template <float (*Widen)(uint16_t)>
+    float half_l1_scalar(const float* a, const uint16_t* b, size_t n)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += std::fabs(a[i] - Widen(b[i]));
+        }
+        return sum;
+    }
+
+    template <float (*Widen)(uint16_t)>
+    float half_cosine_scalar(const float* a, const uint16_t* b, size_t n)
+    {
+        float dot = 0.0f, norm_a = 0.0f, norm_b = 0.0f;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const float bi = Widen(b[i]);
+            dot += a[i] * bi;
+            norm_a += a[i] * a[i];
+            norm_b += bi * bi;
+        }
+        return cosine_from_sums(dot, norm_a, norm_b);
+    }
+
+#ifdef KNN_X86_KERNELS
+    // SSE4.2 kernels: two 4-wide accumulators, scalar tail
+
+    __attribute__((target("sse4.2"))) inline float horizontal_sum(__m128 v)
+    {
+        __m128 shuf = _mm_movehdup_ps(v);
+        __m128 sums = _mm_add_ps(v, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+    }
+
+    __attribute__((target("sse4.2"))) float squared_l2_sse42(const float* a, const float* b, size_t n)
+    {
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+            __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+        }
+        float sum = horizontal_sum(_mm_add_ps(acc0, acc1));
+        for (; i < n; ++i)
+        {
+            float diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    __attribute__((target("sse4.2"))) float l1_sse42(const float* a, const float* b, size_t n)
+    {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+            __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+            acc0 = _mm_add_ps(acc0, _mm_andnot_ps(sign, d0));
+            acc1 = _mm_add_ps(acc1, _mm_andnot_ps(sign, d1));
+        }
+        float sum = horizontal_sum(_mm_add_ps(acc0, acc1));
+        for (; i < n; ++i)
+        {
+            sum += std::fabs(a[i] - b[i]);
+        }
+        return sum;
+    }
+
+    __attribute__((target("sse4.2"))) float cosine_sse42(const float* a, const float* b, size_t n)
+    {
+        __m128 dot = _mm_setzero_ps(), norm_a = _mm_setzero_ps(), norm_b = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 va = _mm_loadu_ps(a + i);
+            __m128 vb = _mm_loadu_ps(b + i);
+            dot = _mm_add_ps(dot, _mm_mul_ps(va, vb));
+            norm_a = _mm_add_ps(norm_a, _mm_mul_ps(va, va));
+            norm_b = _mm_add_ps(norm_b, _mm_mul_ps(vb, vb));
+        }
+        float d = horizontal_sum(dot), na = horizontal_sum(norm_a), nb = horizontal_sum(norm_b);
+        for (; i < n; ++i)
+        {
+            d += a[i] * b[i];
+            na += a[i] * a[i];
+            nb += b[i] * b[i];
+        }
+        return cosine_from_sums(d, na, nb);
+    }
+
+    // The uint8 kernels take |a - b| as saturated a - b OR saturated b - a, which stays in 8 bits.
+    // L1 sums it with psadbw; squared L2 widens it to 16 bits and squares and pairs it with pmaddwd.
+
+    __attribute__((target("sse4.2"))) inline uint32_t horizontal_sum_epi32(__m128i v)
+    {
+        alignas(16) uint32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    __attribute__((target("sse4.2"))) uint32_t integer_squared_l2_sse42(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            __m128i lo = _mm_unpacklo_epi8(diff, zero);
+            __m128i hi = _mm_unpackhi_epi8(diff, zero);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(lo, lo));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(hi, hi));
+        }
+        return horizontal_sum_epi32(_mm_add_epi32(acc0, acc1)) + integer_squared_l2_scalar(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("sse4.2"))) uint32_t integer_l1_sse42(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        __m128i acc = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        }
+        // psadbw leaves one sum per 64-bit half, each well below 2^32
+        return horizontal_sum_epi32(acc) + integer_l1_scalar(a + i, b + i, n - i);
+    }
+
+    // Four uint8 features at p, as 32-bit signed lanes
+    __attribute__((target("sse4.2"))) inline __m128i load4_epu8(const uint8_t* p)
+    {
+        int32_t bytes;
+        std::memcpy(&bytes, p, sizeof(bytes));
+        return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+    }
+
+    __attribute__((target("sse4.2"))) float weighted_squared_l2_sse42(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        __m128 acc = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 diff = _mm_cvtepi32_ps(_mm_sub_epi32(load4_epu8(a + i), load4_epu8(b + i)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(weights + i), _mm_mul_ps(diff, diff)));
+        }
+        return horizontal_sum(acc) + weighted_squared_l2_scalar(a + i, b + i, weights + i, n - i);
+    }
+
+    __attribute__((target("sse4.2"))) float weighted_l1_sse42(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        __m128 acc = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128 diff = _mm_cvtepi32_ps(_mm_abs_epi32(_mm_sub_epi32(load4_epu8(a + i), load4_epu8(b + i))));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(weights + i), diff));
+        }
+        return horizontal_sum(acc) + weighted_l1_scalar(a + i, b + i, weights + i, n - i);
+    }
+
+    // AVX2 kernels: four 8-wide FMA accumulators to hide the FMA latency, scalar tail
+
+    __attribute__((target("avx2,fma"))) inline float horizontal_sum(__m256 v)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        __m128 shuf = _mm_movehdup_ps(sum);
+        sum = _mm_add_ps(sum, shuf);
+        shuf = _mm_movehl_ps(shuf, sum);
+        return _mm_cvtss_f32(_mm_add_ss(sum, shuf));
+    }
+
+    __attribute__((target("avx2,fma"))) float squared_l2_avx2(const float* a, const float* b, size_t n)
+    {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+            __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16));
+            __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24));
+            acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+            acc2 = _mm256_fmadd_ps(d2, d2, acc2);
+            acc3 = _mm256_fmadd_ps(d3, d3, acc3);
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            acc0 = _mm256_fmadd_ps(d, d, acc0);
+        }
+        float sum = horizontal_sum(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+        for (; i < n; ++i)
+        {
+            float diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx2,fma"))) float l1_avx2(const float* a, const float* b, size_t n)
+    {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+            acc1 = _mm256_add_ps(acc1, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8))));
+            acc2 = _mm256_add_ps(acc2, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16))));
+            acc3 = _mm256_add_ps(acc3, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24))));
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i))));
+        }
+        float sum = horizontal_sum(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+        for (; i < n; ++i)
+        {
+            sum += std::fabs(a[i] - b[i]);
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx2,fma"))) float cosine_avx2(const float* a, const float* b, size_t n)
+    {
+        __m256 dot = _mm256_setzero_ps(), norm_a = _mm256_setzero_ps(), norm_b = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 va = _mm256_loadu_ps(a + i);
+            __m256 vb = _mm256_loadu_ps(b + i);
+            dot = _mm256_fmadd_ps(va, vb, dot);
+            norm_a = _mm256_fmadd_ps(va, va, norm_a);
+            norm_b = _mm256_fmadd_ps(vb, vb, norm_b);
+        }
+        float d = horizontal_sum(dot), na = horizontal_sum(norm_a), nb = horizontal_sum(norm_b);
+        for (; i < n; ++i)
+        {
+            d += a[i] * b[i];
+            na += a[i] * a[i];
+            nb += b[i] * b[i];
+        }
+        return cosine_from_sums(d, na, nb);
+    }
+
+    __attribute__((target("avx2,fma"))) inline uint32_t horizontal_sum_epi32(__m256i v)
+    {
+        alignas(32) uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+        uint32_t sum = 0;
+        for (uint32_t lane : lanes)
+        {
+            sum += lane;
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx2,fma"))) uint32_t integer_squared_l2_avx2(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i diff = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+            __m256i lo = _mm256_unpacklo_epi8(diff, zero);
+            __m256i hi = _mm256_unpackhi_epi8(diff, zero);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(lo, lo));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(hi, hi));
+        }
+        return horizontal_sum_epi32(_mm256_add_epi32(acc0, acc1)) + integer_squared_l2_scalar(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma"))) uint32_t integer_l1_avx2(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            __m256i va0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i va1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32));
+            __m256i vb1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32));
+            acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(va0, vb0));
+            acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(va1, vb1));
+        }
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(va, vb));
+        }
+        return horizontal_sum_epi32(_mm256_add_epi64(acc0, acc1)) + integer_l1_scalar(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma"))) float weighted_squared_l2_avx2(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+            __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+            __m256i diff = _mm256_sub_epi16(va, vb);
+            __m256 d0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(diff)));
+            __m256 d1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(diff, 1)));
+            acc0 = _mm256_fmadd_ps(_mm256_mul_ps(d0, d0), _mm256_loadu_ps(weights + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_mul_ps(d1, d1), _mm256_loadu_ps(weights + i + 8), acc1);
+        }
+        return horizontal_sum(_mm256_add_ps(acc0, acc1)) + weighted_squared_l2_scalar(a + i, b + i, weights + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma"))) float weighted_l1_avx2(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+            __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+            __m256i diff = _mm256_abs_epi16(_mm256_sub_epi16(va, vb));
+            __m256 d0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(diff)));
+            __m256 d1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(diff, 1)));
+            acc0 = _mm256_fmadd_ps(d0, _mm256_loadu_ps(weights + i), acc0);
+            acc1 = _mm256_fmadd_ps(d1, _mm256_loadu_ps(weights + i + 8), acc1);
+        }
+        return horizontal_sum(_mm256_add_ps(acc0, acc1)) + weighted_l1_scalar(a + i, b + i, weights + i, n - i);
+    }
+
+    // Reduced-precision AVX2 kernels. F16C widens 8 fp16 values per instruction; a bf16 is the top half
+    // of a float, so zero-extending to 32 bits and shifting left by 16 widens it exactly.
+
+    struct widen_fp16_avx2
+    {
+        __attribute__((target("avx2,fma,f16c"))) static __m256 load(const uint16_t* p)
+        {
+            return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        }
+        static float scalar(uint16_t h) { return fp16_to_float(h); }
+    };
+
+    struct widen_bf16_avx2
+    {
+        __attribute__((target("avx2,fma,f16c"))) static __m256 load(const uint16_t* p)
+        {
+            __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+            return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+        }
+        static float scalar(uint16_t h) { return bf16_to_float(h); }
+    };
+
+    template <typename Widen>
+    __attribute__((target("avx2,fma,f16c"))) float half_squared_l2_avx2(const float* a, const uint16_t* b, size_t n)
+    {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), Widen::load(b + i));
+            __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), Widen::load(b + i + 8));
+            __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 16), Widen::load(b + i + 16));
+            __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 24), Widen::load(b + i + 24));
+            acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+            acc2 = _mm256_fmadd_ps(d2, d2, acc2);
+            acc3 = _mm256_fmadd_ps(d3, d3, acc3);
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), Widen::load(b + i));
+            acc0 = _mm256_fmadd_ps(d, d, acc0);
+        }
+        float sum = horizontal_sum(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+        for (; i < n; ++i)
+        {
+            float diff = a[i] - Widen::scalar(b[i]);
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    template <typename Widen>
+    __attribute__((target("avx2,fma,f16c"))) float half_l1_avx2(const float* a, const uint16_t* b, size_t n)
+    {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i), Widen::load(b + i))));
+            acc1 = _mm256_add_ps(acc1, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), Widen::load(b + i + 8))));
+            acc2 = _mm256_add_ps(acc2, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i + 16), Widen::load(b + i + 16))));
+            acc3 = _mm256_add_ps(acc3, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i + 24), Widen::load(b + i + 24))));
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = _mm256_add_ps(acc0, _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(a + i), Widen::load(b + i))));
+        }
+        float sum = horizontal_sum(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+        for (; i < n; ++i)
+        {
+            sum += std::fabs(a[i] - Widen::scalar(b[i]));
+        }
+        return sum;
+    }
+
+    template <typename Widen>
+    __attribute__((target("avx2,fma,f16c"))) float half_cosine_avx2(const float* a, const uint16_t* b, size_t n)
+    {
+        __m256 dot = _mm256_setzero_ps(), norm_a = _mm256_setzero_ps(), norm_b = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 va = _mm256_loadu_ps(a + i);
+            __m256 vb = Widen::load(b + i);
+            dot = _mm256_fmadd_ps(va, vb, dot);
+            norm_a = _mm256_fmadd_ps(va, va, norm_a);
+            norm_b = _mm256_fmadd_ps(vb, vb, norm_b);
+        }
+        float d = horizontal_sum(dot), na = horizontal_sum(norm_a), nb = horizontal_sum(norm_b);
+        for (; i < n; ++i)
+        {
+            const float bi = Widen::scalar(b[i]);
+            d += a[i] * bi;
+            na += a[i] * a[i];
+            nb += bi * bi;
+        }
+        return cosine_from_sums(d, na, nb);
+    }
+
+    // AVX-512 kernels: four 16-wide accumulators, masked loads for the tail
+
+    __attribute__((target("avx512f"))) inline float horizontal_sum(__m512 v)
+    {
+        // Spill and add pairwise; this runs once per distance, so the extra store is negligible
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, v);
+        for (int width = 8; width > 0; width /= 2)
+        {
+            for (int i = 0; i < width; ++i)
+            {
+                lanes[i] += lanes[i + width];
+            }
+        }
+        return lanes[0];
+    }
+
+    __attribute__((target("avx512f"))) float squared_l2_avx512(const float* a, const float* b, size_t n)
+    {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+            __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+            __m512 d2 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32));
+            __m512 d3 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48));
+            acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+            acc2 = _mm512_fmadd_ps(d2, d2, acc2);
+            acc3 = _mm512_fmadd_ps(d3, d3, acc3);
+        }
+        for (; i < n; i += 16)
+        {
+            __mmask16 mask = n - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (n - i)) - 1);
+            __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+            acc0 = _mm512_fmadd_ps(d, d, acc0);
+        }
+        return horizontal_sum(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+    }
+
+    __attribute__((target("avx512f"))) float l1_avx512(const float* a, const float* b, size_t n)
+    {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))));
+            acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16))));
+            acc2 = _mm512_add_ps(acc2, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32))));
+            acc3 = _mm512_add_ps(acc3, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48))));
+        }
+        for (; i < n; i += 16)
+        {
+            __mmask16 mask = n - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (n - i)) - 1);
+            __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+            acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(d));
+        }
+        return horizontal_sum(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+    }
+
+    __attribute__((target("avx512f"))) float cosine_avx512(const float* a, const float* b, size_t n)
+    {
+        __m512 dot = _mm512_setzero_ps(), norm_a = _mm512_setzero_ps(), norm_b = _mm512_setzero_ps();
+        for (size_t i = 0; i < n; i += 16)
+        {
+            __mmask16 mask = n - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (n - i)) - 1);
+            __m512 va = _mm512_maskz_loadu_ps(mask, a + i);
+            __m512 vb = _mm512_maskz_loadu_ps(mask, b + i);
+            dot = _mm512_fmadd_ps(va, vb, dot);
+            norm_a = _mm512_fmadd_ps(va, va, norm_a);
+            norm_b = _mm512_fmadd_ps(vb, vb, norm_b);
+        }
+        return cosine_from_sums(horizontal_sum(dot), horizontal_sum(norm_a), horizontal_sum(norm_b));
+    }
+
+    // The uint8 kernels need AVX-512BW for byte and word arithmetic; masked loads zero the tail,
+    // and zero bytes add nothing to either distance
+
+    __attribute__((target("avx512f,avx512bw"))) inline uint32_t horizontal_sum_epi32(__m512i v)
+    {
+        alignas(64) uint32_t lanes[16];
+        _mm512_store_si512(lanes, v);
+        uint32_t sum = 0;
+        for (uint32_t lane : lanes)
+        {
+            sum += lane;
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) inline __mmask64 tail_mask_epi8(size_t remaining)
+    {
+        return remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1;
+    }
+
+    // |a - b| of up to 64 bytes, zero past n
+    __attribute__((target("avx512f,avx512bw"))) inline __m512i absolute_difference_epu8(const uint8_t* a, const uint8_t* b, __mmask64 mask)
+    {
+        __m512i va = _mm512_maskz_loadu_epi8(mask, a);
+        __m512i vb = _mm512_maskz_loadu_epi8(mask, b);
+        return _mm512_sub_epi8(_mm512_max_epu8(va, vb), _mm512_min_epu8(va, vb));
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) uint32_t integer_squared_l2_avx512(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        const __m512i zero = _mm512_setzero_si512();
+        __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+        for (size_t i = 0; i < n; i += 64)
+        {
+            __m512i diff = absolute_difference_epu8(a + i, b + i, tail_mask_epi8(n - i));
+            __m512i lo = _mm512_unpacklo_epi8(diff, zero);
+            __m512i hi = _mm512_unpackhi_epi8(diff, zero);
+            acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(lo, lo));
+            acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(hi, hi));
+        }
+        return horizontal_sum_epi32(_mm512_add_epi32(acc0, acc1));
+    }
+
+    // Same with VNNI, which fuses the pmaddwd and the accumulation into one vpdpwssd
+    __attribute__((target("avx512f,avx512bw,avx512vnni"))) uint32_t integer_squared_l2_avx512_vnni(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        const __m512i zero = _mm512_setzero_si512();
+        __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+        for (size_t i = 0; i < n; i += 64)
+        {
+            __m512i diff = absolute_difference_epu8(a + i, b + i, tail_mask_epi8(n - i));
+            __m512i lo = _mm512_unpacklo_epi8(diff, zero);
+            __m512i hi = _mm512_unpackhi_epi8(diff, zero);
+            acc0 = _mm512_dpwssd_epi32(acc0, lo, lo);
+            acc1 = _mm512_dpwssd_epi32(acc1, hi, hi);
+        }
+        return horizontal_sum_epi32(_mm512_add_epi32(acc0, acc1));
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) uint32_t integer_l1_avx512(const uint8_t* a, const uint8_t* b, size_t n)
+    {
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t i = 0; i < n; i += 64)
+        {
+            __mmask64 mask = tail_mask_epi8(n - i);
+            acc = _mm512_add_epi64(acc, _mm512_sad_epu8(_mm512_maskz_loadu_epi8(mask, a + i), _mm512_maskz_loadu_epi8(mask, b + i)));
+        }
+        return horizontal_sum_epi32(acc);
+    }
+
+    // Sixteen uint8 features at p as 32-bit lanes
+    __attribute__((target("avx512f,avx512bw"))) inline __m512i load16_epu8(const uint8_t* p)
+    {
+        // The zero-masking forms avoid GCC 12's -Wmaybe-uninitialized false positives on the plain intrinsics
+        return _mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    // a[i] - b[i] of sixteen uint8 features, as floats
+    __attribute__((target("avx512f,avx512bw"))) inline __m512 difference16_ps(const uint8_t* a, const uint8_t* b)
+    {
+        return _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_sub_epi32(load16_epu8(a), load16_epu8(b)));
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) float weighted_squared_l2_avx512(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m512 d0 = difference16_ps(a + i, b + i);
+            __m512 d1 = difference16_ps(a + i + 16, b + i + 16);
+            acc0 = _mm512_fmadd_ps(_mm512_mul_ps(d0, d0), _mm512_loadu_ps(weights + i), acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_mul_ps(d1, d1), _mm512_loadu_ps(weights + i + 16), acc1);
+        }
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 d = difference16_ps(a + i, b + i);
+            acc0 = _mm512_fmadd_ps(_mm512_mul_ps(d, d), _mm512_loadu_ps(weights + i), acc0);
+        }
+        return horizontal_sum(_mm512_add_ps(acc0, acc1)) + weighted_squared_l2_scalar(a + i, b + i, weights + i, n - i);
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) float weighted_l1_avx512(const uint8_t* a, const uint8_t* b, const float* weights, size_t n)
+    {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m512 d0 = _mm512_abs_ps(difference16_ps(a + i, b + i));
+            __m512 d1 = _mm512_abs_ps(difference16_ps(a + i + 16, b + i + 16));
+            acc0 = _mm512_fmadd_ps(d0, _mm512_loadu_ps(weights + i), acc0);
+            acc1 = _mm512_fmadd_ps(d1, _mm512_loadu_ps(weights + i + 16), acc1);
+        }
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 d = _mm512_abs_ps(difference16_ps(a + i, b + i));
+            acc0 = _mm512_fmadd_ps(d, _mm512_loadu_ps(weights + i), acc0);
+        }
+        return horizontal_sum(_mm512_add_ps(acc0, acc1)) + weighted_l1_scalar(a + i, b + i, weights + i, n - i);
+    }
+
+    // Reduced-precision AVX-512 kernels, widening 16 values per instruction. AVX-512 BF16 only adds
+    // bf16 x bf16 dot products, which would round the query as well; the shift widens bf16 exactly.
+    // The widening uses the zero-masking forms, like load16_epu8.
+
+    struct widen_fp16_avx512
+    {
+        __attribute__((target("avx512f"))) static __m512 load(const uint16_t* p)
+        {
+            return _mm512_maskz_cvtph_ps(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        }
+        static float scalar(uint16_t h) { return fp16_to_float(h); }
+    };
+
+    struct widen_bf16_avx512
+    {
+        __attribute__((target("avx512f"))) static __m512 load(const uint16_t* p)
+        {
+            __m512i wide = _mm512_maskz_cvtepu16_epi32(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+            return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(0xFFFF, wide, 16));
+        }
+        static float scalar(uint16_t h) { return bf16_to_float(h); }
+    };
+
+    template <typename Widen>
+    __attribute__((target("avx512f"))) float half_squared_l2_avx512(const float* a, const uint16_t* b, size_t n)
+    {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), Widen::load(b + i));
+            __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), Widen::load(b + i + 16));
+            __m512 d2 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 32), Widen::load(b + i + 32));
+            __m512 d3 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 48), Widen::load(b + i + 48));
+            acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+            acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+            acc2 = _mm512_fmadd_ps(d2, d2, acc2);
+            acc3 = _mm512_fmadd_ps(d3, d3, acc3);
+        }
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), Widen::load(b + i));
+            acc0 = _mm512_fmadd_ps(d, d, acc0);
+        }
+        float sum = horizontal_sum(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+        for (; i < n; ++i)
+        {
+            float diff = a[i] - Widen::scalar(b[i]);
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    template <typename Widen>
+    __attribute__((target("avx512f"))) float half_l1_avx512(const float* a, const uint16_t* b, size_t n)
+    {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64)
+        {
+            acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), Widen::load(b + i))));
+            acc1 = _mm512_add_ps(acc1, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 16), Widen::load(b + i + 16))));
+            acc2 = _mm512_add_ps(acc2, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 32), Widen::load(b + i + 32))));
+            acc3 = _mm512_add_ps(acc3, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i + 48), Widen::load(b + i + 48))));
+        }
+        for (; i + 16 <= n; i += 16)
+        {
+            acc0 = _mm512_add_ps(acc0, _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(a + i), Widen::load(b + i))));
+        }
+        float sum = horizontal_sum(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+        for (; i < n; ++i)
+        {
+            sum += std::fabs(a[i] - Widen::scalar(b[i]));
+        }
+        return sum;
+    }
+
+    template <typename Widen>
+    __attribute__((target("avx512f"))) float half_cosine_avx512(const float* a, const uint16_t* b, size_t n)
+    {
+        __m512 dot = _mm512_setzero_ps(), norm_a = _mm512_setzero_ps(), norm_b = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512 va = _mm512_loadu_ps(a + i);
+            __m512 vb = Widen::load(b + i);
+            dot = _mm512_fmadd_ps(va, vb, dot);
+            norm_a = _mm512_fmadd_ps(va, va, norm_a);
+            norm_b = _mm512_fmadd_ps(vb, vb, norm_b);
+        }
+        float d = horizontal_sum(dot), na = horizontal_sum(norm_a), nb = horizontal_sum(norm_b);
+        for (; i < n; ++i)
+        {
+            const float bi = Widen::scalar(b[i]);
+            d += a[i] * bi;
+            na += a[i] * a[i];
+            nb += bi * bi;
+        }
+        return cosine_from_sums(d, na, nb);
+    }
+#endif // KNN_X86_KERNELS
+
+    // Features evaluated between checks against the bound when early abandoning
+    constexpr size_t ABANDON_BLOCK = 256;
+
+    // Evaluate Kernel block by block and give up as soon as the partial sum passes bound.
+    // Only valid for kernels whose partial sums never decrease.
+    template <distance_kernel Kernel>
+    float bounded(const float* a, const float* b, size_t n, float bound)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; i += ABANDON_BLOCK)
+        {
+            sum += Kernel(a + i, b + i, n - i < ABANDON_BLOCK ? n - i : ABANDON_BLOCK);
+            if (sum > bound)
+            {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    template <distance_kernel Kernel>
+    float unbounded(const float* a, const float* b, size_t n, float)
+    {
+        return Kernel(a, b, n);
+    }
+
+    const distance_kernels scalar_kernels = {
+        "scalar", squared_l2_scalar, l1_scalar, cosine_scalar,
+        bounded<squared_l2_scalar>, bounded<l1_scalar>, unbounded<cosine_scalar>,
+        integer_squared_l2_scalar, integer_l1_scalar, weighted_squared_l2_scalar, weighted_l1_scalar,
+        half_squared_l2_scalar<fp16_to_float>, half_l1_scalar<fp16_to_float>, half_cosine_scalar<fp16_to_float>,
+        half_squared_l2_scalar<bf16_to_float>, half_l1_scalar<bf16_to_float>, half_cosine_scalar<bf16_to_float>};
+#ifdef KNN_X86_KERNELS
+    const distance_kernels sse42_kernels = {
+        "sse4.2", squared_l2_sse42, l1_sse42, cosine_sse42,
+        bounded<squared_l2_sse42>, bounded<l1_sse42>, unbounded<cosine_sse42>,
+        integer_squared_l2_sse42, integer_l1_sse42, weighted_squared_l2_sse42, weighted_l1_sse42,
+        half_squared_l2_scalar<fp16_to_float>, half_l1_scalar<fp16_to_float>, half_cosine_scalar<fp16_to_float>,
+        half_squared_l2_scalar<bf16_to_float>, half_l1_scalar<bf16_to_float>, half_cosine_scalar<bf16_to_float>};
+    const distance_kernels avx2_kernels = {
+        "avx2", squared_l2_avx2, l1_avx2, cosine_avx2,
+        bounded<squared_l2_avx2>, bounded<l1_avx2>, unbounded<cosine_avx2>,
+        integer_squared_l2_avx2, integer_l1_avx2, weighted_squared_l2_avx2, weighted_l1_avx2,
+        half_squared_l2_avx2<widen_fp16_avx2>, half_l1_avx2<widen_fp16_avx2>, half_cosine_avx2<widen_fp16_avx2>,
+        half_squared_l2_avx2<widen_bf16_avx2>, half_l1_avx2<widen_bf16_avx2>, half_cosine_avx2<widen_bf16_avx2>};
+    const distance_kernels avx512_kernels = {
+        "avx512", squared_l2_avx512, l1_avx512, cosine_avx512,
+        bounded<squared_l2_avx512>, bounded<l1_avx512>, unbounded<cosine_avx512>,
+        integer_squared_l2_avx512, integer_l1_avx512, weighted_squared_l2_avx512, weighted_l1_avx512,
+        half_squared_l2_avx512<widen_fp16_avx512>, half_l1_avx512<widen_fp16_avx512>, half_cosine_avx512<widen_fp16_avx512>,
+        half_squared_l2_avx512<widen_bf16_avx512>, half_l1_avx512<widen_bf16_avx512>, half_cosine_avx512<widen_bf16_avx512>};
+    const distance_kernels avx512_vnni_kernels = {
+        "avx512vnni", squared_l2_avx512, l1_avx512, cosine_avx512,
+        bounded<squared_l2_avx512>, bounded<l1_avx512>, unbounded<cosine_avx512>,
+        integer_squared_l2_avx512_vnni, integer_l1_avx512, weighted_squared_l2_avx512, weighted_l1_avx512,
+        half_squared_l2_avx512<widen_fp16_avx512>, half_l1_avx512<widen_fp16_avx512>, half_cosine_avx512<widen_fp16_avx512>,
+        half_squared_l2_avx512<widen_bf16_avx512>, half_l1_avx512<widen_bf16_avx512>, half_cosine_avx512<widen_bf16_avx512>};
+#endif
+}
+
+distance_kernel distance_kernels::get(distance_metric metric) const
+{
+    switch (metric)
+    {
+    case distance_metric::l1:
+        return l1;
+    case distance_metric::cosine:
+        return cosine;
+    case distance_metric::squared_l2:
+    default:
+        return squared_l2;
+    }
+}
+
+bounded_distance_kernel distance_kernels::get_bounded(distance_metric metric) const
+{
+    switch (metric)
+    {
+    case distance_metric::l1:
+        return bounded_l1;
+    case distance_metric::cosine:
+        return bounded_cosine;
+    case distance_metric::squared_l2:
+    default:
+        return bounded_squared_l2;
+    }
+}
+
+integer_distance_kernel distance_kernels::get_integer(distance_metric metric) const
+{
+    switch (metric)
+    {
+    case distance_metric::squared_l2:
+        return integer_squared_l2;
+    case distance_metric::l1:
+        return integer_l1;
+    default:
+        return nullptr;
+    }
+}
+
+weighted_distance_kernel distance_kernels::get_weighted(distance_metric metric) const
+{
+    switch (metric)
+    {
+    case distance_metric::squared_l2:
+        return weighted_squared_l2;
+    case distance_metric::l1:
+        return weighted_l1;
+    default:
+        return nullptr;
+    }
+}
+
+half_distance_kernel distance_kernels::get_half(distance_metric metric, feature_precision precision) const
+{
+    if (precision == feature_precision::fp32)
+    {
+        return nullptr;
+    }
+    const bool bf16 = precision == feature_precision::bf16;
+    switch (metric)
+    {
+    case distance_metric::l1:
+        return bf16 ? bf16_l1 : fp16_l1;
+    case distance_metric::cosine:
+        return bf16 ? bf16_cosine : fp16_cosine;
+    case distance_metric::squared_l2:
+    default:
+        return bf16 ? bf16_squared_l2 : fp16_squared_l2;
+    }
+}
+
+std::vector<const distance_kernels*> get_available_distance_kernels()
+{
+    std::vector<const distance_kernels*> available;
+#ifdef KNN_X86_KERNELS
+    // __builtin_cpu_supports checks CPUID and that the OS saves the wider registers
+    __builtin_cpu_init();
+    // The AVX-512 sets also use AVX-512BW for their uint8 kernels
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+        if (__builtin_cpu_supports("avx512vnni"))
+        {
+            available.push_back(&avx512_vnni_kernels);
+        }
+        available.push_back(&avx512_kernels);
+    }
+    // F16C, for the fp16 kernels, came with the first AVX CPUs, well before AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+    {
+        available.push_back(&avx2_kernels);
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        available.push_back(&sse42_kernels);
+    }
+#endif
+    available.push_back(&scalar_kernels);
+    return available;
+}
+
+const distance_kernels& get_distance_kernels()
+{
+    static const distance_kernels& selected = *get_available_distance_kernels().front();
+    return selected;
+}
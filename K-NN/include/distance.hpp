@@ -0,0 +1,73 @@
+#ifndef __DISTANCE_HPP
+#define __DISTANCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../../include/half_float.hpp" // For feature_precision and the fp16/bf16 conversions
+
+// Distance measures supported by the KNN kernels
+enum class distance_metric
+{
+    squared_l2, // Squared Euclidean distance; ranks neighbors exactly like Euclidean distance
+    l1,         // Manhattan distance
+    cosine      // 1 - cosine similarity
+};
+
+// Widest uint8 rows whose squared L2, at most 255^2 per feature, fits the integer kernels' uint32_t
+constexpr size_t MAX_INTEGER_FEATURES = 66051;
+
+// Distance between two float rows of length n
+using distance_kernel = float (*)(const float* a, const float* b, size_t n);
+
+// Distance that may stop early once its partial sum exceeds bound; a result above bound is then
+// only a lower bound on the true distance. Results at or below bound are exact.
+using bounded_distance_kernel = float (*)(const float* a, const float* b, size_t n, float bound);
+
+// Distance between two uint8 rows of length n, exact in integers for n up to MAX_INTEGER_FEATURES
+using integer_distance_kernel = uint32_t (*)(const uint8_t* a, const uint8_t* b, size_t n);
+
+// Distance between two uint8 rows with every feature's term scaled by weights[i]: sum of
+// weights[i] * (a[i] - b[i])^2 for squared L2, of weights[i] * |a[i] - b[i]| for L1
+using weighted_distance_kernel = float (*)(const uint8_t* a, const uint8_t* b, const float* weights, size_t n);
+
+// Distance between a float row and a row of n fp16 or bf16 values, widened to float in registers
+using half_distance_kernel = float (*)(const float* a, const uint16_t* b, size_t n);
+
+// One set of kernels compiled for a particular instruction set
+struct distance_kernels
+{
+    const char* isa;
+    distance_kernel squared_l2;
+    distance_kernel l1;
+    distance_kernel cosine;
+    bounded_distance_kernel bounded_squared_l2;
+    bounded_distance_kernel bounded_l1;
+    bounded_distance_kernel bounded_cosine; // Ignores the bound, cosine partial sums are not monotone
+    integer_distance_kernel integer_squared_l2;
+    integer_distance_kernel integer_l1;
+    weighted_distance_kernel weighted_squared_l2;
+    weighted_distance_kernel weighted_l1;
+    half_distance_kernel fp16_squared_l2;
+    half_distance_kernel fp16_l1;
+    half_distance_kernel fp16_cosine;
+    half_distance_kernel bf16_squared_l2;
+    half_distance_kernel bf16_l1;
+    half_distance_kernel bf16_cosine;
+
+    distance_kernel get(distance_metric metric) const;
+    bounded_distance_kernel get_bounded(distance_metric metric) const;
+    // The uint8 kernels exist for squared_l2 and l1 only; nullptr for cosine
+    integer_distance_kernel get_integer(distance_metric metric) const;
+    weighted_distance_kernel get_weighted(distance_metric metric) const;
+    // nullptr for fp32, which uses get()
+    half_distance_kernel get_half(distance_metric metric, feature_precision precision) const;
+};
+
+// Fastest kernels supported by the running CPU, chosen once via CPUID
+const distance_kernels& get_distance_kernels();
+
+// Every kernel set the running CPU supports, fastest first and the scalar reference last
+std::vector<const distance_kernels*> get_available_distance_kernels();
+
+#endif // __DISTANCE_HPP
@@ -0,0 +1,51 @@
+#include "fixed_knn.hpp"
+
+namespace
+{
+    template <size_t Dim, size_t K>
+    std::unique_ptr<search_index> make_for_metric(const dataset_view& training, distance_metric metric)
+    {
+        switch (metric)
+        {
+        case distance_metric::l1:
+            return std::make_unique<fixed_scan_index<Dim, K, distance_metric::l1>>(training);
+        case distance_metric::cosine:
+            return std::make_unique<fixed_scan_index<Dim, K, distance_metric::cosine>>(training);
+        case distance_metric::squared_l2:
+        default:
+            return std::make_unique<fixed_scan_index<Dim, K, distance_metric::squared_l2>>(training);
+        }
+    }
+
+    // The instantiation whose K equals k among Ks, if any
+    template <size_t Dim, size_t... Ks>
+    std::unique_ptr<search_index> make_for_k(const dataset_view& training, size_t k, distance_metric metric)
+    {
+        std::unique_ptr<search_index> index;
+        ((k == Ks && !index ? (index = make_for_metric<Dim, Ks>(training, metric), 0) : 0), ...);
+        return index;
+    }
+
+    template <size_t Dim>
+    std::unique_ptr<search_index> make_for_dimension(const dataset_view& training, size_t k, distance_metric metric)
+    {
+        // Keep in sync with FIXED_KNN_K_VALUES
+        return make_for_k<Dim, 1, 3, 5, 10>(training, k, metric);
+    }
+}
+
+std::unique_ptr<search_index> make_fixed_scan_index(const dataset_view& training, size_t k, distance_metric metric)
+{
+    // Keep in sync with FIXED_KNN_DIMENSIONS
+    switch (training.get_normalized_feature_count())
+    {
+    case 784:
+        return make_for_dimension<784>(training, k, metric);
+    case 100:
+        return make_for_dimension<100>(training, k, metric);
+    case 50:
+        return make_for_dimension<50>(training, k, metric);
+    default:
+        return nullptr;
+    }
+}
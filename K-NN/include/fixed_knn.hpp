@@ -0,0 +1,337 @@
+#ifndef __FIXED_KNN_HPP
+#define __FIXED_KNN_HPP
+
+#include "knn.hpp"
+#include <cmath>  // For std::sqrt and std::fabs
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <omp.h>  // For OpenMP
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIXED_KNN_X86 1
+#endif
+
+// KNN specialized at compile time for a feature count, a k and a metric. The distance loops have a
+// constant trip count and fixed-width accumulators, so the compiler unrolls and vectorizes them; the k
+// nearest are kept in a sorted array of K entries on the stack; the metric is chosen by if constexpr.
+// Each scan is compiled for AVX-512, AVX2 and the baseline target, and the best one the CPU supports
+// is picked once, like the runtime kernels (distance.hpp). make_fixed_scan_index() is the runtime
+// façade: it plugs the specialization matching a KNN's settings in as its search index.
+
+// Sixteen floats that GCC keeps in one AVX-512 register, two AVX2 or four SSE registers, depending on
+// the target of the function they are inlined into
+typedef float fixed_lanes __attribute__((vector_size(64)));
+typedef int32_t fixed_lane_bits __attribute__((vector_size(64)));
+constexpr size_t FIXED_LANES = 16;
+
+__attribute__((always_inline)) inline float sum_lanes(const fixed_lanes& v)
+{
+    float sum = 0.0f;
+    for (size_t j = 0; j < FIXED_LANES; ++j)
+    {
+        sum += v[j];
+    }
+    return sum;
+}
+
+// Add the terms of features [i, i + 16) of metric to the accumulators sums
+template <distance_metric Metric>
+__attribute__((always_inline)) inline void accumulate_lanes(const float* a, const float* b, size_t i, fixed_lanes* sums)
+{
+    fixed_lanes x, y;
+    __builtin_memcpy(&x, a + i, sizeof(x));
+    __builtin_memcpy(&y, b + i, sizeof(y));
+    if constexpr (Metric == distance_metric::squared_l2)
+    {
+        const fixed_lanes diff = x - y;
+        sums[0] += diff * diff;
+    }
+    else if constexpr (Metric == distance_metric::l1)
+    {
+        // Clearing the sign bits is fabs on every lane
+        sums[0] += (fixed_lanes)((fixed_lane_bits)(x - y) & 0x7fffffff);
+    }
+    else
+    {
+        sums[0] += x * y;
+        sums[1] += x * x;
+        sums[2] += y * y;
+    }
+}
+
+// Distance of two rows of Dim features; the same measures as distance.hpp. Every loop has a constant
+// trip count, so the compiler unrolls it and keeps the accumulators in registers.
+template <size_t Dim, distance_metric Metric>
+__attribute__((always_inline)) inline float fixed_distance(const float* __restrict a, const float* __restrict b)
+{
+    constexpr size_t SUMS = Metric == distance_metric::cosine ? 3 : 1;
+    // Two sets of accumulators, so consecutive additions do not wait on each other
+    constexpr size_t STEP = 2 * FIXED_LANES;
+    fixed_lanes even[SUMS] = {}, odd[SUMS] = {};
+    size_t i = 0;
+    #pragma GCC unroll 8
+    for (; i + STEP <= Dim; i += STEP)
+    {
+        accumulate_lanes<Metric>(a, b, i, even);
+        accumulate_lanes<Metric>(a, b, i + FIXED_LANES, odd);
+    }
+    if constexpr (Dim % STEP >= FIXED_LANES)
+    {
+        accumulate_lanes<Metric>(a, b, Dim - Dim % STEP, even);
+        i += FIXED_LANES;
+    }
+    float sums[SUMS];
+    for (size_t s = 0; s < SUMS; ++s)
+    {
+        even[s] += odd[s];
+        sums[s] = sum_lanes(even[s]);
+    }
+    for (; i < Dim; ++i)
+    {
+        if constexpr (Metric == distance_metric::squared_l2)
+        {
+            const float diff = a[i] - b[i];
+            sums[0] += diff * diff;
+        }
+        else if constexpr (Metric == distance_metric::l1)
+        {
+            sums[0] += std::fabs(a[i] - b[i]);
+        }
+        else
+        {
+            sums[0] += a[i] * b[i];
+            sums[1] += a[i] * a[i];
+            sums[2] += b[i] * b[i];
+        }
+    }
+
+    if constexpr (Metric == distance_metric::cosine)
+    {
+        if (sums[1] == 0.0f || sums[2] == 0.0f)
+        {
+            return 1.0f;
+        }
+        return 1.0f - sums[0] / std::sqrt(sums[1] * sums[2]);
+    }
+    else
+    {
+        return sums[0];
+    }
+}
+
+// The K nearest candidates seen so far, sorted nearest first in a fixed array. Insertion shifts at
+// most K entries, which for small K beats a heap, and most candidates fail the first comparison.
+template <size_t K>
+struct fixed_top_k
+{
+    static_assert(K > 0, "fixed_top_k needs room for one neighbor");
+
+    neighbor items[K];
+    size_t count = 0;
+
+    __attribute__((always_inline)) void push(float distance, uint32_t index)
+    {
+        const neighbor candidate{distance, index};
+        if (count == K)
+        {
+            if (!(candidate < items[K - 1]))
+            {
+                return;
+            }
+        }
+        else
+        {
+            ++count;
+        }
+        size_t i = count - 1;
+        // With K = 1 there is nothing to shift, and the loop would index past the array
+        if constexpr (K > 1)
+        {
+            while (i > 0 && candidate < items[i - 1])
+            {
+                items[i] = items[i - 1];
+                --i;
+            }
+        }
+        items[i] = candidate;
+    }
+};
+
+// One query against count packed rows of Dim features, inlined into each instruction-set variant below
+template <size_t Dim, size_t K, distance_metric Metric>
+__attribute__((always_inline)) inline void fixed_scan_rows(const float* rows, const uint32_t* ids, size_t count, const float* query, fixed_top_k<K>& best)
+{
+    best.count = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        best.push(fixed_distance<Dim, Metric>(query, rows + i * Dim), ids[i]);
+    }
+}
+
+template <size_t Dim, size_t K, distance_metric Metric>
+void fixed_scan_baseline(const float* rows, const uint32_t* ids, size_t count, const float* query, fixed_top_k<K>& best)
+{
+    fixed_scan_rows<Dim, K, Metric>(rows, ids, count, query, best);
+}
+
+#ifdef FIXED_KNN_X86
+template <size_t Dim, size_t K, distance_metric Metric>
+__attribute__((target("avx2,fma"))) void fixed_scan_avx2(const float* rows, const uint32_t* ids, size_t count, const float* query, fixed_top_k<K>& best)
+{
+    fixed_scan_rows<Dim, K, Metric>(rows, ids, count, query, best);
+}
+
+template <size_t Dim, size_t K, distance_metric Metric>
+__attribute__((target("avx512f"))) void fixed_scan_avx512(const float* rows, const uint32_t* ids, size_t count, const float* query, fixed_top_k<K>& best)
+{
+    fixed_scan_rows<Dim, K, Metric>(rows, ids, count, query, best);
+}
+#endif
+
+template <size_t Dim, size_t K, distance_metric Metric>
+class fixed_knn
+{
+public:
+    using scan_function = void (*)(const float*, const uint32_t*, size_t, const float*, fixed_top_k<K>&);
+
+    static constexpr size_t dimension = Dim;
+    static constexpr size_t neighbors = K;
+    static constexpr distance_metric metric = Metric;
+
+private:
+    dataset_view training;
+    // Copy of the view's normalized rows in view order, and the dataset row of each: the scan streams
+    // through one array instead of following the view's indices all over the dataset
+    std::vector<float> rows;
+    std::vector<uint32_t> row_ids;
+    scan_function scan;
+    const char* isa;
+
+    int vote(const fixed_top_k<K>& best) const
+    {
+        const dataset* source = training.get_source();
+        return vote_labels(span<const neighbor>(best.items, best.count),
+                           [&](size_t i) { return source->get_enumerated_label(best.items[i].index); },
+                           Metric, vote_weighting::uniform);
+    }
+
+public:
+    // Search the normalized rows of training, which must have Dim features; exits otherwise
+    explicit fixed_knn(const dataset_view& training_view) : training(training_view), scan(&fixed_scan_baseline<Dim, K, Metric>), isa("baseline")
+    {
+        if (!training.empty() && training.get_normalized_feature_count() != Dim)
+        {
+            std::cerr << "fixed_knn<" << Dim << "> cannot search rows of " << training.get_normalized_feature_count() << " features." << std::endl;
+            exit(1);
+        }
+        rows.resize(training.size() * Dim);
+        row_ids.resize(training.size());
+        for (size_t i = 0; i < training.size(); ++i)
+        {
+            // Rows stored at fp16 or bf16 are widened into the copy
+            training.widen_normalized_row(i, rows.data() + i * Dim);
+            row_ids[i] = training.index(i);
+        }
+#ifdef FIXED_KNN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            scan = &fixed_scan_avx512<Dim, K, Metric>;
+            isa = "avx512";
+        }
+        else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            scan = &fixed_scan_avx2<Dim, K, Metric>;
+            isa = "avx2";
+        }
+#endif
+    }
+
+    const dataset_view& get_training_data() const { return training; }
+    const char* get_isa() const { return isa; }
+    // The i-th training row of the view, as copied
+    const float* row(size_t i) const { return rows.data() + i * Dim; }
+
+    // The min(K, training rows) nearest rows of a query of Dim features, in best.items, nearest first
+    void find_neighbors(const float* query, fixed_top_k<K>& best) const { scan(rows.data(), row_ids.data(), row_ids.size(), query, best); }
+
+    // Majority label of the K nearest, ties to the nearer label, like KNN::predict
+    int predict(const float* query) const
+    {
+        fixed_top_k<K> best;
+        find_neighbors(query, best);
+        return vote(best);
+    }
+
+    // Labels and neighbors of queries stored as contiguous rows of Dim features, on threads threads
+    // (0 for the OpenMP default)
+    prediction_batch predict_batch(span<const float> queries, int threads = 0) const
+    {
+        const size_t count = queries.size() / Dim;
+        prediction_batch result;
+        result.labels.resize(count);
+        result.neighbors.k = std::min(K, training.size());
+        result.neighbors.entries.resize(count * result.neighbors.k);
+        #pragma omp parallel for schedule(dynamic, 16) num_threads(threads > 0 ? threads : omp_get_max_threads())
+        for (long long q = 0; q < static_cast<long long>(count); ++q)
+        {
+            fixed_top_k<K> best;
+            find_neighbors(queries.data() + q * Dim, best);
+            std::copy(best.items, best.items + best.count, result.neighbors.row(q).begin());
+            result.labels[q] = vote(best);
+        }
+        return result;
+    }
+};
+
+// A fixed_knn behind the search_index interface, so that KNN's predict, predict_batch and
+// find_neighbors use it. Searches for a count other than K fall back to the runtime kernel; queries
+// must have Dim features.
+template <size_t Dim, size_t K, distance_metric Metric>
+class fixed_scan_index : public search_index
+{
+    fixed_knn<Dim, K, Metric> model;
+
+public:
+    explicit fixed_scan_index(const dataset_view& training) : model(training) {}
+
+    void search(span<const float> query, size_t k, top_k& best, search_stats& stats) const override
+    {
+        if (query.size() != Dim)
+        {
+            std::cerr << "fixed_knn<" << Dim << "> cannot search with a query of " << query.size() << " features." << std::endl;
+            exit(1);
+        }
+        best.reset(k);
+        const dataset_view& training = model.get_training_data();
+        stats.distance_evaluations += training.size();
+        if (k == K)
+        {
+            fixed_top_k<K> nearest;
+            model.find_neighbors(query.data(), nearest);
+            for (size_t i = 0; i < nearest.count; ++i)
+            {
+                best.push(nearest.items[i].distance, nearest.items[i].index);
+            }
+            return;
+        }
+        const distance_kernel kernel = get_distance_kernels().get(Metric);
+        for (size_t i = 0; i < training.size(); ++i)
+        {
+            best.push(kernel(query.data(), model.row(i), Dim), training.index(i));
+        }
+    }
+};
+
+// Specializations compiled in: every combination of these feature counts (MNIST pixels and common PCA
+// widths), k values and the three metrics
+constexpr size_t FIXED_KNN_DIMENSIONS[] = {784, 100, 50};
+constexpr size_t FIXED_KNN_K_VALUES[] = {1, 3, 5, 10};
+
+// Runtime façade: the fixed_scan_index for the training rows' feature count, k and metric, or nullptr
+// if that combination is not compiled in (KNN then keeps its generic scan). Use it as
+// knn.set_search_index(make_fixed_scan_index(training, k, metric)) when it is not null.
+std::unique_ptr<search_index> make_fixed_scan_index(const dataset_view& training, size_t k, distance_metric metric);
+
+#endif // __FIXED_KNN_HPP
@@ -0,0 +1,336 @@
+#include "hnsw_index.hpp"
+#include <algorithm> // For std::push_heap, std::pop_heap and std::sort
+#include <cmath>     // For std::log
+#include <iostream>
+#include <random>
+#include <omp.h>     // For OpenMP
+
+namespace
+{
+    // Nodes seen by the current search, per thread; cleared lazily by bumping the epoch
+    struct visited_set
+    {
+        std::vector<uint32_t> marks;
+        uint32_t epoch = 0;
+
+        void reset(size_t node_count)
+        {
+            if (marks.size() < node_count)
+            {
+                marks.assign(node_count, 0);
+                epoch = 0;
+            }
+            if (++epoch == 0)
+            {
+                std::fill(marks.begin(), marks.end(), 0);
+                epoch = 1;
+            }
+        }
+
+        // Returns whether node was not visited yet
+        bool insert(uint32_t node)
+        {
+            if (marks[node] == epoch)
+            {
+                return false;
+            }
+            marks[node] = epoch;
+            return true;
+        }
+    };
+}
+
+hnsw_index::hnsw_index(const dataset_view& training, distance_metric m, const hnsw_parameters& params)
+    : feature_count(training.get_normalized_feature_count()), metric(m), parameters(params)
+{
+    parameters.m = std::max<size_t>(parameters.m, 2);
+    kernel = get_distance_kernels().get(metric);
+
+    const size_t n = training.size();
+    if (n == 0)
+    {
+        return;
+    }
+
+    points.resize(n * feature_count);
+    point_ids.resize(n);
+    #pragma omp parallel for
+    for (long long i = 0; i < static_cast<long long>(n); ++i)
+    {
+        // Rows stored at fp16 or bf16 are widened into the copy
+        training.widen_normalized_row(i, points.data() + i * feature_count);
+        point_ids[i] = training.index(i);
+    }
+
+    // Level of each node drawn up front from an exponential distribution, so it does not depend on thread timing
+    std::mt19937 rng(parameters.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const double level_scale = 1.0 / std::log(static_cast<double>(parameters.m));
+    levels.resize(n);
+    upper_links.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        levels[i] = static_cast<int>(-std::log(1.0 - uniform(rng)) * level_scale);
+        upper_links[i].resize(levels[i]);
+    }
+    base_links.assign(n * base_stride(), 0);
+    link_locks.reset(new std::mutex[n]);
+
+    // The first node becomes the entry point; the rest are inserted concurrently
+    insert(0);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (long long i = 1; i < static_cast<long long>(n); ++i)
+    {
+        insert(static_cast<uint32_t>(i));
+    }
+}
+
+void hnsw_index::get_links(uint32_t node, int level, std::vector<uint32_t>& links, bool locked) const
+{
+    std::unique_lock<std::mutex> guard;
+    if (locked)
+    {
+        guard = std::unique_lock<std::mutex>(link_locks[node]);
+    }
+    if (level == 0)
+    {
+        const uint32_t* slots = base_links.data() + node * base_stride();
+        links.assign(slots + 1, slots + 1 + slots[0]);
+    }
+    else
+    {
+        links = upper_links[node][level - 1];
+    }
+}
+
+// Callers hold link_locks[node]
+void hnsw_index::set_links(uint32_t node, int level, const std::vector<uint32_t>& links)
+{
+    if (level == 0)
+    {
+        uint32_t* slots = base_links.data() + node * base_stride();
+        slots[0] = static_cast<uint32_t>(links.size());
+        std::copy(links.begin(), links.end(), slots + 1);
+    }
+    else
+    {
+        upper_links[node][level - 1] = links;
+    }
+}
+
+neighbor hnsw_index::greedy_search(const float* query, neighbor entry, int level, search_stats& stats, bool locked) const
+{
+    thread_local std::vector<uint32_t> links;
+    neighbor current = entry;
+    for (bool moved = true; moved;)
+    {
+        moved = false;
+        get_links(current.index, level, links, locked);
+        stats.nodes_visited++;
+        for (uint32_t next : links)
+        {
+            float distance = kernel(query, point(next), feature_count);
+            stats.distance_evaluations++;
+            if (distance < current.distance)
+            {
+                current = {distance, next};
+                moved = true;
+            }
+        }
+    }
+    return current;
+}
+
+void hnsw_index::search_layer(const float* query, neighbor entry, size_t ef, int level, std::vector<neighbor>& found,
+                              search_stats& stats, bool locked) const
+{
+    thread_local visited_set visited;
+    thread_local std::vector<neighbor> candidates; // Min-heap of nodes still to expand
+    thread_local std::vector<uint32_t> links;
+    auto greater = [](const neighbor& a, const neighbor& b) { return b < a; };
+
+    visited.reset(point_ids.size());
+    visited.insert(entry.index);
+    candidates.assign(1, entry);
+    found.assign(1, entry); // Max-heap of the ef nearest so far
+
+    while (!candidates.empty())
+    {
+        neighbor closest = candidates.front();
+        if (found.size() >= ef && found.front() < closest)
+        {
+            break; // Every remaining candidate is farther than the ef-th best
+        }
+        std::pop_heap(candidates.begin(), candidates.end(), greater);
+        candidates.pop_back();
+
+        get_links(closest.index, level, links, locked);
+        stats.nodes_visited++;
+        for (uint32_t next : links)
+        {
+            if (!visited.insert(next))
+            {
+                continue;
+            }
+            neighbor candidate{kernel(query, point(next), feature_count), next};
+            stats.distance_evaluations++;
+            if (found.size() < ef || candidate < found.front())
+            {
+                candidates.push_back(candidate);
+                std::push_heap(candidates.begin(), candidates.end(), greater);
+                found.push_back(candidate);
+                std::push_heap(found.begin(), found.end());
+                if (found.size() > ef)
+                {
+                    std::pop_heap(found.begin(), found.end());
+                    found.pop_back();
+                }
+            }
+        }
+    }
+    std::sort_heap(found.begin(), found.end());
+}
+
+void hnsw_index::select_neighbors(std::vector<neighbor>& candidates, size_t count) const
+{
+    // Keeping only candidates nearer to the base than to every kept one spreads the links over
+    // directions instead of clustering them, which keeps the graph navigable
+    std::vector<neighbor> kept;
+    kept.reserve(count);
+    for (const neighbor& candidate : candidates)
+    {
+        if (kept.size() >= count)
+        {
+            break;
+        }
+        bool diverse = true;
+        for (const neighbor& other : kept)
+        {
+            if (kernel(point(candidate.index), point(other.index), feature_count) < candidate.distance)
+            {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse)
+        {
+            kept.push_back(candidate);
+        }
+    }
+    candidates.swap(kept);
+}
+
+void hnsw_index::insert(uint32_t node)
+{
+    const int level = levels[node];
+    const float* query = point(node);
+    search_stats stats;
+
+    uint32_t entry;
+    int entry_level;
+    {
+        std::lock_guard<std::mutex> guard(entry_lock);
+        if (top_level < 0)
+        {
+            entry_point = node;
+            top_level = level;
+            return;
+        }
+        entry = entry_point;
+        entry_level = top_level;
+    }
+
+    // Descend through the layers above the node's own
+    neighbor current{kernel(query, point(entry), feature_count), entry};
+    for (int l = entry_level; l > level; --l)
+    {
+        current = greedy_search(query, current, l, stats, true);
+    }
+
+    std::vector<neighbor> found;
+    std::vector<uint32_t> links;
+    std::vector<neighbor> relinked;
+    for (int l = std::min(level, entry_level); l >= 0; --l)
+    {
+        search_layer(query, current, parameters.ef_construction, l, found, stats, true);
+        current = found.front();
+
+        std::vector<neighbor> selected = found;
+        select_neighbors(selected, parameters.m);
+        links.clear();
+        for (const neighbor& s : selected)
+        {
+            links.push_back(s.index);
+        }
+        {
+            std::lock_guard<std::mutex> guard(link_locks[node]);
+            set_links(node, l, links);
+        }
+
+        // Link back from every selected node, re-selecting its links when it is full
+        for (const neighbor& s : selected)
+        {
+            std::lock_guard<std::mutex> guard(link_locks[s.index]);
+            get_links(s.index, l, links, false);
+            if (links.size() < max_links(l))
+            {
+                links.push_back(node);
+            }
+            else
+            {
+                relinked.clear();
+                relinked.push_back({s.distance, node});
+                for (uint32_t other : links)
+                {
+                    relinked.push_back({kernel(point(s.index), point(other), feature_count), other});
+                }
+                std::sort(relinked.begin(), relinked.end());
+                select_neighbors(relinked, max_links(l));
+                links.clear();
+                for (const neighbor& r : relinked)
+                {
+                    links.push_back(r.index);
+                }
+            }
+            set_links(s.index, l, links);
+        }
+    }
+
+    if (level > entry_level)
+    {
+        std::lock_guard<std::mutex> guard(entry_lock);
+        if (level > top_level)
+        {
+            top_level = level;
+            entry_point = node;
+        }
+    }
+}
+
+void hnsw_index::search(span<const float> query, size_t k, top_k& best, search_stats& stats) const
+{
+    if (query.size() != feature_count)
+    {
+        std::cerr << "The HNSW index cannot search with a query of " << query.size() << " features." << std::endl;
+        exit(1);
+    }
+    best.reset(k);
+    if (point_ids.empty())
+    {
+        return;
+    }
+
+    neighbor current{kernel(query.data(), point(entry_point), feature_count), entry_point};
+    stats.distance_evaluations++;
+    for (int l = top_level; l > 0; --l)
+    {
+        current = greedy_search(query.data(), current, l, stats, false);
+    }
+
+    thread_local std::vector<neighbor> found;
+    search_layer(query.data(), current, std::max(parameters.ef_search, k), 0, found, stats, false);
+    for (const neighbor& f : found)
+    {
+        best.push(f.distance, point_ids[f.index]);
+    }
+}
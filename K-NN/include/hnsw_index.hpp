@@ -0,0 +1,75 @@
+#ifndef __HNSW_INDEX_HPP
+#define __HNSW_INDEX_HPP
+
+#include "../../include/dataset.hpp"
+#include "distance.hpp"
+#include "search_index.hpp"
+#include <vector>
+#include <memory> // For std::unique_ptr
+#include <mutex>
+
+// Tuning knobs of the HNSW graph
+struct hnsw_parameters
+{
+    size_t m = 16;                // Links per node on the upper layers; layer 0 keeps 2 * m
+    size_t ef_construction = 200; // Candidate list size while inserting; higher builds a better graph, slower
+    size_t ef_search = 64;        // Candidate list size while searching; trades recall for latency
+    unsigned seed = 42;           // Seed for the random node levels
+};
+
+// Approximate k-nearest-neighbor index: a hierarchical navigable small-world graph. Every row is a node on
+// layer 0, and exponentially fewer on each layer above; a query descends greedily through the sparse upper
+// layers and then runs a best-first search of ef_search candidates on layer 0, touching a small fraction of
+// the training set. Results are approximate; recall grows with ef_search. Nodes are inserted in parallel,
+// each node's link lists guarded by its own mutex.
+class hnsw_index : public search_index
+{
+    size_t feature_count;
+    distance_metric metric;
+    distance_kernel kernel;
+    hnsw_parameters parameters;
+
+    aligned_buffer<float> points;                      // Training rows, contiguous in insertion order
+    std::vector<uint32_t> point_ids;                   // Dataset row of each node
+    std::vector<int> levels;                           // Top layer of each node
+    std::vector<uint32_t> base_links;                  // Layer 0: per node a count followed by 2 * m slots
+    std::vector<std::vector<std::vector<uint32_t>>> upper_links; // Layers 1..levels[node] of each node
+    std::unique_ptr<std::mutex[]> link_locks;          // One per node, held while its links change during build
+
+    std::mutex entry_lock;                             // Guards entry_point and top_level during build
+    uint32_t entry_point = 0;
+    int top_level = -1;
+
+    size_t base_stride() const { return 2 * parameters.m + 1; }
+    const float* point(uint32_t node) const { return points.data() + node * feature_count; }
+    size_t max_links(int level) const { return level == 0 ? 2 * parameters.m : parameters.m; }
+
+    // Copy the links of node on level; locked while the graph is still being built
+    void get_links(uint32_t node, int level, std::vector<uint32_t>& links, bool locked) const;
+    void set_links(uint32_t node, int level, const std::vector<uint32_t>& links);
+
+    // Greedy walk to the nearest node on one layer
+    neighbor greedy_search(const float* query, neighbor entry, int level, search_stats& stats, bool locked) const;
+    // Best-first search keeping the ef nearest nodes found, returned nearest first
+    void search_layer(const float* query, neighbor entry, size_t ef, int level, std::vector<neighbor>& found,
+                      search_stats& stats, bool locked) const;
+    // Keep at most count of the candidates (nearest first), skipping any closer to a kept node than to the base
+    void select_neighbors(std::vector<neighbor>& candidates, size_t count) const;
+
+    void insert(uint32_t node);
+
+public:
+    // Build over the normalized rows of training (widened if stored at fp16 or bf16), inserting nodes
+    // on all OpenMP threads
+    hnsw_index(const dataset_view& training, distance_metric metric, const hnsw_parameters& parameters = hnsw_parameters());
+
+    void search(span<const float> query, size_t k, top_k& best, search_stats& stats) const override;
+
+    // Not safe while searches are running
+    void set_ef_search(size_t ef) { parameters.ef_search = ef; }
+
+    size_t size() const { return point_ids.size(); }
+    const hnsw_parameters& get_parameters() const { return parameters; }
+};
+
+#endif // __HNSW_INDEX_HPP
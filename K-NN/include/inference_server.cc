@@ -0,0 +1,265 @@
+#include "inference_server.hpp"
+#include "../../include/profiler.hpp"
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+    using server_clock = std::chrono::steady_clock;
+
+    double seconds_between(server_clock::time_point start, server_clock::time_point end)
+    {
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    void print_stats(const char* title, const server_stats& stats)
+    {
+        std::cout << std::fixed << std::setprecision(1) << "[server] " << title << ": " << stats.requests << " requests in "
+                  << stats.seconds << " s, " << stats.requests_per_second() << " req/s, p50 "
+                  << stats.latency.percentile(0.50) / 1e3 << " us, p99 " << stats.latency.percentile(0.99) / 1e3
+                  << " us, max " << stats.latency.max() / 1e3 << " us, mean batch " << stats.mean_batch() << std::endl;
+    }
+}
+
+inference_server::inference_server(const KNN& knn, const data_handler& data, const server_options& settings)
+    : model(knn), options(settings), projection(nullptr)
+{
+    const dataset& rows = data.get_data_array();
+    raw_feature_count = rows.get_feature_count();
+    feature_count = rows.get_normalized_feature_count();
+    if (feature_count == 0 || knn.get_training_data().get_normalized_feature_count() != feature_count)
+    {
+        std::cerr << "The inference server needs a model trained on the normalized rows of the dataset." << std::endl;
+        exit(1);
+    }
+    data.get_feature_stats().scaling(options.normalization, offset, scale);
+    if (feature_count != raw_feature_count)
+    {
+        projection = &data.get_pca();
+    }
+    class_labels = data.get_class_labels();
+    options.max_batch = std::max<size_t>(options.max_batch, 1);
+    options.max_queued = std::max(options.max_queued, options.max_batch);
+}
+
+inference_server::~inference_server()
+{
+    stop();
+}
+
+void inference_server::run()
+{
+    std::unique_ptr<ipc_listener> listener = listen_ipc(options.address);
+    started = interval_started = server_clock::now();
+    std::cout << "[server] Listening on " << options.address << " (batches of up to " << options.max_batch << ", "
+              << options.max_delay.count() << " us deadline)." << std::endl;
+
+    std::thread batcher(&inference_server::answer_batches, this);
+    while (!stopping)
+    {
+        std::unique_ptr<ipc_channel> stream = listener->accept(100);
+        if (stream)
+        {
+            connections.emplace_back();
+            connection& client = connections.back();
+            client.stream = std::move(stream);
+            client.reader = std::thread(&inference_server::read_requests, this, std::ref(client));
+        }
+        reap_connections();
+
+        const server_clock::time_point now = server_clock::now();
+        if (options.report_seconds > 0.0 && seconds_between(interval_started, now) >= options.report_seconds)
+        {
+            server_stats report;
+            {
+                std::lock_guard<std::mutex> lock(stats_lock);
+                std::swap(report, interval);
+            }
+            report.seconds = seconds_between(interval_started, now);
+            interval_started = now;
+            if (report.requests > 0)
+            {
+                print_stats("last interval", report);
+            }
+        }
+    }
+
+    // Answer what is queued while the connections are still open, then wake the readers
+    queue_filled.notify_all();
+    queue_drained.notify_all();
+    batcher.join();
+    for (connection& client : connections)
+    {
+        client.stream->shutdown();
+    }
+    for (connection& client : connections)
+    {
+        client.reader.join();
+    }
+    connections.clear();
+    print_stats("total", stats());
+}
+
+server_stats inference_server::stats() const
+{
+    std::lock_guard<std::mutex> lock(stats_lock);
+    server_stats result = total;
+    result.seconds = seconds_between(started, server_clock::now());
+    return result;
+}
+
+void inference_server::reap_connections()
+{
+    for (auto c = connections.begin(); c != connections.end();)
+    {
+        if (c->finished && c->in_flight == 0)
+        {
+            c->reader.join();
+            c = connections.erase(c);
+        }
+        else
+        {
+            ++c;
+        }
+    }
+}
+
+void inference_server::read_requests(connection& client)
+{
+    std::vector<uint8_t> raw(raw_feature_count);
+    std::vector<float> normalized(projection ? raw_feature_count : 0);
+    request_header header;
+    while (!stopping && client.stream->receive_all(&header, sizeof(header)))
+    {
+        if (header.magic != INFERENCE_REQUEST_MAGIC)
+        {
+            break;
+        }
+        const request_type type = static_cast<request_type>(header.type);
+        if (type == request_type::shutdown)
+        {
+            stop();
+            break;
+        }
+        const size_t expected = type == request_type::raw_features ? raw_feature_count
+                              : type == request_type::normalized_features ? feature_count : 0;
+        if (expected == 0 || header.feature_count != expected)
+        {
+            const inference_response reply{INFERENCE_RESPONSE_MAGIC, header.id, -1, static_cast<uint32_t>(response_status::bad_request)};
+            std::lock_guard<std::mutex> lock(client.write_lock);
+            client.stream->send_all(&reply, sizeof(reply));
+            break;
+        }
+
+        pending_request request{&client, header.id, {}, std::vector<float>(feature_count)};
+        if (type == request_type::raw_features)
+        {
+            if (!client.stream->receive_all(raw.data(), raw.size()))
+            {
+                break;
+            }
+            // The training rows' preprocessing: scaling, then the projection if there is one
+            float* scaled = projection ? normalized.data() : request.features.data();
+            for (size_t j = 0; j < raw_feature_count; ++j)
+            {
+                scaled[j] = (static_cast<float>(raw[j]) - offset[j]) * scale[j];
+            }
+            if (projection)
+            {
+                projection->project(normalized.data(), request.features.data());
+            }
+        }
+        else if (!client.stream->receive_all(request.features.data(), feature_count * sizeof(float)))
+        {
+            break;
+        }
+        request.arrived = server_clock::now();
+
+        {
+            std::unique_lock<std::mutex> lock(queue_lock);
+            queue_drained.wait(lock, [&] { return stopping || queue.size() < options.max_queued; });
+            if (stopping)
+            {
+                break;
+            }
+            ++client.in_flight;
+            queue.push_back(std::move(request));
+        }
+        queue_filled.notify_one();
+    }
+    client.finished = true;
+}
+
+void inference_server::answer_batches()
+{
+    std::vector<pending_request> batch;
+    std::vector<float> rows;
+    latency_histogram latencies;
+    std::unique_lock<std::mutex> lock(queue_lock);
+    while (true)
+    {
+        if (queue.empty())
+        {
+            if (stopping)
+            {
+                break;
+            }
+            // Woken by a request; the timeout notices a stop() from a signal handler
+            queue_filled.wait_for(lock, std::chrono::milliseconds(100));
+            continue;
+        }
+
+        // Fill the batch until it is full or its oldest request is due
+        const server_clock::time_point deadline = queue.front().arrived + options.max_delay;
+        while (!stopping && queue.size() < options.max_batch && server_clock::now() < deadline)
+        {
+            queue_filled.wait_until(lock, deadline);
+        }
+        const size_t count = std::min(queue.size(), options.max_batch);
+        batch.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        lock.unlock();
+        queue_drained.notify_all();
+
+        PROFILE_PHASE("serve_batch");
+        rows.resize(count * feature_count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::copy(batch[i].features.begin(), batch[i].features.end(), rows.begin() + i * feature_count);
+        }
+        const prediction_batch predictions = model.predict_batch(span<const float>(rows.data(), rows.size()));
+
+        latencies.reset();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const int label = predictions.labels[i];
+            const bool known = label >= 0 && static_cast<size_t>(label) < class_labels.size();
+            const inference_response reply{INFERENCE_RESPONSE_MAGIC, batch[i].id, known ? class_labels[label] : -1,
+                                           static_cast<uint32_t>(response_status::ok)};
+            connection& client = *batch[i].client;
+            {
+                // A client that went away only loses its own responses
+                std::lock_guard<std::mutex> write(client.write_lock);
+                client.stream->send_all(&reply, sizeof(reply));
+            }
+            latencies.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                server_clock::now() - batch[i].arrived).count()));
+            --client.in_flight;
+        }
+
+        {
+            std::lock_guard<std::mutex> stats(stats_lock);
+            for (server_stats* s : {&total, &interval})
+            {
+                s->requests += count;
+                ++s->batches;
+                s->latency.merge(latencies);
+            }
+        }
+        lock.lock();
+    }
+}
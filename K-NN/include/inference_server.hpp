@@ -0,0 +1,150 @@
+#ifndef __INFERENCE_SERVER_HPP
+#define __INFERENCE_SERVER_HPP
+
+#include "knn.hpp"
+#include "../../include/latency_histogram.hpp"
+#include "../../include/ipc_channel.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Wire format of the inference server, native byte order. A request is a header followed by
+// feature_count features: raw uint8 pixels, preprocessed by the server like the training data, or
+// float rows that are already normalized (and projected). Every request gets one response carrying
+// its id; responses to pipelined requests of one connection may arrive out of order.
+constexpr uint32_t INFERENCE_REQUEST_MAGIC = 0x514E4E4B;  // "KNNQ"
+constexpr uint32_t INFERENCE_RESPONSE_MAGIC = 0x524E4E4B; // "KNNR"
+
+enum class request_type : uint32_t
+{
+    raw_features = 0,        // feature_count uint8 values
+    normalized_features = 1, // feature_count float values
+    shutdown = 2             // No payload and no response; the server stops
+};
+
+enum class response_status : uint32_t
+{
+    ok = 0,
+    bad_request = 1 // Unknown type or wrong feature count; the server closes the connection
+};
+
+struct request_header
+{
+    uint32_t magic;
+    uint32_t id;            // Chosen by the client, echoed in the response
+    uint32_t type;          // A request_type
+    uint32_t feature_count;
+};
+
+struct inference_response
+{
+    uint32_t magic;
+    uint32_t id;
+    int32_t label;   // Label as read from the label file, -1 unless ok
+    uint32_t status; // A response_status
+};
+
+struct server_options
+{
+    std::string address = "unix:/tmp/mnist_knn.sock"; // See ipc_channel.hpp
+    size_t max_batch = 64;                             // Requests answered by one predict_batch call
+    std::chrono::microseconds max_delay{1000};         // Longest wait of a request for its batch to fill
+    size_t max_queued = 4096;                          // Readers stop reading while this many requests wait
+    normalization_method normalization = normalization_method::z_score; // Used on raw requests
+    double report_seconds = 10.0;                      // Interval of the statistics line, 0 for none
+};
+
+// Latency and throughput of the requests answered so far. Latency runs from the request being read to
+// its response being written, so it includes the wait for the batch.
+struct server_stats
+{
+    size_t requests = 0;
+    size_t batches = 0;
+    double seconds = 0.0; // Since the server started (or the previous report)
+    latency_histogram latency;
+
+    double requests_per_second() const { return seconds > 0.0 ? requests / seconds : 0.0; }
+    double mean_batch() const { return batches > 0 ? static_cast<double>(requests) / batches : 0.0; }
+};
+
+// Serves predictions of a trained KNN over a local socket, or a shared memory channel for a single
+// client. One thread per connection reads requests and preprocesses them into a shared queue; a
+// batching thread takes up to max_batch requests as soon as that many are waiting or the oldest has
+// waited max_delay, answers them with one predict_batch call and writes the responses. Under load the batches fill up and each training block is reused by
+// the whole batch; a lone request waits at most max_delay.
+class inference_server
+{
+    // One client; the reader thread owns the reading side, the batching thread writes under write_lock
+    struct connection
+    {
+        std::unique_ptr<ipc_channel> stream;
+        std::mutex write_lock;
+        std::thread reader;
+        std::atomic<bool> finished{false};
+        std::atomic<size_t> in_flight{0}; // Queued requests, which keep the connection alive
+    };
+
+    struct pending_request
+    {
+        connection* client;
+        uint32_t id;
+        std::chrono::steady_clock::time_point arrived;
+        std::vector<float> features; // Normalized (and projected) row
+    };
+
+    const KNN& model;
+    server_options options;
+
+    // Preprocessing of raw requests: (x - offset) * scale, then the PCA projection if the training
+    // rows were reduced
+    std::vector<float> offset, scale;
+    const pca* projection;
+    size_t raw_feature_count;
+    size_t feature_count; // Of the rows the model searches
+    std::vector<uint8_t> class_labels;
+
+    std::atomic<bool> stopping{false};
+
+    std::mutex queue_lock;
+    std::condition_variable queue_filled;  // A request arrived, or stopping
+    std::condition_variable queue_drained; // Room for readers
+    std::deque<pending_request> queue;
+
+    std::list<connection> connections; // Touched by the accepting thread only
+
+    mutable std::mutex stats_lock;
+    server_stats total, interval;
+    std::chrono::steady_clock::time_point started, interval_started;
+
+    void read_requests(connection& client);
+    void answer_batches();
+    // Drop the connections whose reader has finished and whose requests are answered
+    void reap_connections();
+
+public:
+    // Serve knn, trained on data's prepared rows; both must outlive the server
+    inference_server(const KNN& knn, const data_handler& data, const server_options& options = server_options());
+    ~inference_server();
+
+    inference_server(const inference_server&) = delete;
+    inference_server& operator=(const inference_server&) = delete;
+
+    // Listen on the configured address and answer requests until stop() or a shutdown request;
+    // queued requests are answered before it returns
+    void run();
+    // Ask run() to return; safe from any thread and from a signal handler
+    void stop() { stopping = true; }
+
+    // Totals since run() started
+    server_stats stats() const;
+};
+
+#endif // __INFERENCE_SERVER_HPP
@@ -0,0 +1,435 @@
+#include "ivf_pq_index.hpp"
+#include "distance.hpp"
+#include <algorithm> // For std::partial_sort, std::shuffle and std::min
+#include <fstream>
+#include <iostream>
+#include <numeric>   // For std::iota
+#include <random>
+#include <omp.h>     // For OpenMP
+
+namespace
+{
+    // Index of the nearest of count centroids of width dim
+    size_t nearest_centroid(const float* row, const float* centroids, size_t count, size_t dim)
+    {
+        const distance_kernel l2 = get_distance_kernels().squared_l2;
+        size_t nearest = 0;
+        float nearest_distance = l2(row, centroids, dim);
+        for (size_t c = 1; c < count; ++c)
+        {
+            float distance = l2(row, centroids + c * dim, dim);
+            if (distance < nearest_distance)
+            {
+                nearest_distance = distance;
+                nearest = c;
+            }
+        }
+        return nearest;
+    }
+
+    // Lloyd's k-means over count contiguous rows of width dim; k x dim centroids seeded with distinct
+    // random rows. Clusters that run empty are re-seeded with a random row.
+    std::vector<float> kmeans(const float* rows, size_t count, size_t dim, size_t k, size_t iterations, std::mt19937& rng)
+    {
+        std::vector<float> centroids(k * dim);
+        std::vector<uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), rng);
+        for (size_t c = 0; c < k; ++c)
+        {
+            std::copy(rows + order[c % count] * dim, rows + (order[c % count] + 1) * dim, centroids.begin() + c * dim);
+        }
+
+        std::vector<uint32_t> assignment(count);
+        std::vector<double> sums(k * dim);
+        std::vector<size_t> sizes(k);
+        for (size_t iteration = 0; iteration < iterations; ++iteration)
+        {
+            #pragma omp parallel for schedule(static)
+            for (long long i = 0; i < static_cast<long long>(count); ++i)
+            {
+                assignment[i] = static_cast<uint32_t>(nearest_centroid(rows + i * dim, centroids.data(), k, dim));
+            }
+
+            std::fill(sums.begin(), sums.end(), 0.0);
+            std::fill(sizes.begin(), sizes.end(), 0);
+            for (size_t i = 0; i < count; ++i)
+            {
+                double* sum = sums.data() + assignment[i] * dim;
+                const float* row = rows + i * dim;
+                for (size_t j = 0; j < dim; ++j)
+                {
+                    sum[j] += row[j];
+                }
+                sizes[assignment[i]]++;
+            }
+            for (size_t c = 0; c < k; ++c)
+            {
+                float* centroid = centroids.data() + c * dim;
+                if (sizes[c] == 0)
+                {
+                    const float* row = rows + (rng() % count) * dim;
+                    std::copy(row, row + dim, centroid);
+                    continue;
+                }
+                for (size_t j = 0; j < dim; ++j)
+                {
+                    centroid[j] = static_cast<float>(sums[c * dim + j] / static_cast<double>(sizes[c]));
+                }
+            }
+        }
+        return centroids;
+    }
+
+    template<typename T>
+    void write_values(std::ofstream& out, const T* values, size_t count)
+    {
+        out.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+
+    template<typename T>
+    void read_values(std::ifstream& in, T* values, size_t count)
+    {
+        in.read(reinterpret_cast<char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+}
+
+ivf_pq_index::ivf_pq_index(const dataset_view& training, const ivf_pq_parameters& params)
+    : parameters(params)
+{
+    if (training.get_normalized_precision() != feature_precision::fp32)
+    {
+        std::cerr << "The IVF-PQ index needs normalized rows stored at fp32." << std::endl;
+        exit(1);
+    }
+    train(training);
+    add(training);
+}
+
+size_t ivf_pq_index::nearest_list(const float* row) const
+{
+    return nearest_centroid(row, coarse_centroids.data(), parameters.lists, feature_count);
+}
+
+void ivf_pq_index::encode(const float* residual, uint8_t* code) const
+{
+    for (size_t s = 0; s + 1 < subspace_begin.size(); ++s)
+    {
+        code[s] = static_cast<uint8_t>(nearest_centroid(residual + subspace_begin[s], codebook(s), CODEBOOK_SIZE, subspace_width(s)));
+    }
+}
+
+void ivf_pq_index::train(const dataset_view& view)
+{
+    feature_count = view.get_normalized_feature_count();
+    const size_t n = view.size();
+    if (n == 0 || feature_count == 0)
+    {
+        std::cerr << "Cannot train an IVF-PQ index on an empty dataset." << std::endl;
+        exit(1);
+    }
+    parameters.subquantizers = std::max<size_t>(1, std::min(parameters.subquantizers, feature_count));
+    parameters.lists = std::max<size_t>(1, std::min(parameters.lists, n));
+
+    // Subspaces of (nearly) equal width covering all features
+    const size_t m = parameters.subquantizers;
+    subspace_begin.resize(m + 1);
+    for (size_t s = 0; s <= m; ++s)
+    {
+        subspace_begin[s] = s * feature_count / m;
+    }
+
+    // Random sample, kept in row order for locality
+    std::mt19937 rng(parameters.seed);
+    std::vector<uint32_t> positions(n);
+    std::iota(positions.begin(), positions.end(), 0);
+    std::shuffle(positions.begin(), positions.end(), rng);
+    const size_t count = std::min(std::max<size_t>(parameters.training_samples, 1), n);
+    positions.resize(count);
+    std::sort(positions.begin(), positions.end());
+    std::vector<float> sample(count * feature_count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto row = view.normalized_row(positions[i]);
+        std::copy(row.begin(), row.end(), sample.begin() + i * feature_count);
+    }
+
+    coarse_centroids = kmeans(sample.data(), count, feature_count, parameters.lists, parameters.iterations, rng);
+
+    // Codebooks are learned on residuals to the coarse centroids, one subspace at a time
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < static_cast<long long>(count); ++i)
+    {
+        float* row = sample.data() + i * feature_count;
+        const float* centroid = coarse_centroids.data() + nearest_list(row) * feature_count;
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            row[j] -= centroid[j];
+        }
+    }
+    codebooks.assign(feature_count * CODEBOOK_SIZE, 0.0f);
+    std::vector<float> subvectors;
+    for (size_t s = 0; s < m; ++s)
+    {
+        const size_t width = subspace_width(s);
+        subvectors.resize(count * width);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float* row = sample.data() + i * feature_count + subspace_begin[s];
+            std::copy(row, row + width, subvectors.begin() + i * width);
+        }
+        std::vector<float> centroids = kmeans(subvectors.data(), count, width, CODEBOOK_SIZE, parameters.iterations, rng);
+        std::copy(centroids.begin(), centroids.end(), codebooks.begin() + subspace_begin[s] * CODEBOOK_SIZE);
+    }
+
+    list_ids.assign(parameters.lists, {});
+    list_codes.assign(parameters.lists, {});
+}
+
+void ivf_pq_index::add(const dataset_view& view)
+{
+    if (coarse_centroids.empty() || view.get_normalized_feature_count() != feature_count)
+    {
+        std::cerr << "The IVF-PQ index must be trained on rows of the same width before adding." << std::endl;
+        exit(1);
+    }
+    source = view.get_source();
+
+    // Encode in parallel, then append to the lists in row order
+    const size_t n = view.size();
+    const size_t m = parameters.subquantizers;
+    std::vector<uint32_t> lists(n);
+    std::vector<uint8_t> codes(n * m);
+    #pragma omp parallel
+    {
+        std::vector<float> residual(feature_count);
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < static_cast<long long>(n); ++i)
+        {
+            const float* row = view.normalized_row(i).data();
+            lists[i] = static_cast<uint32_t>(nearest_list(row));
+            const float* centroid = coarse_centroids.data() + lists[i] * feature_count;
+            for (size_t j = 0; j < feature_count; ++j)
+            {
+                residual[j] = row[j] - centroid[j];
+            }
+            encode(residual.data(), codes.data() + i * m);
+        }
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        list_ids[lists[i]].push_back(view.index(i));
+        list_codes[lists[i]].insert(list_codes[lists[i]].end(), codes.begin() + i * m, codes.begin() + (i + 1) * m);
+    }
+}
+
+void ivf_pq_index::search(span<const float> query, size_t k, top_k& best, search_stats& stats) const
+{
+    best.reset(k);
+    if (coarse_centroids.empty())
+    {
+        return;
+    }
+    if (query.size() != feature_count)
+    {
+        std::cerr << "The IVF-PQ index cannot search with a query of " << query.size() << " features." << std::endl;
+        exit(1);
+    }
+    const distance_kernel l2 = get_distance_kernels().squared_l2;
+    const size_t m = parameters.subquantizers;
+
+    // The probes lists whose centroids are nearest
+    thread_local std::vector<neighbor> lists;
+    lists.resize(parameters.lists);
+    for (size_t c = 0; c < parameters.lists; ++c)
+    {
+        lists[c] = {l2(query.data(), coarse_centroids.data() + c * feature_count, feature_count), static_cast<uint32_t>(c)};
+    }
+    const size_t probes = std::min(std::max<size_t>(parameters.probes, 1), parameters.lists);
+    std::partial_sort(lists.begin(), lists.begin() + probes, lists.end());
+
+    // Rank on codes straight into best, or into a shortlist that is re-ranked below
+    thread_local top_k shortlist;
+    top_k& ranked = parameters.rerank > 0 ? shortlist : best;
+    ranked.reset(parameters.rerank > 0 ? std::max(parameters.rerank, k) : k);
+
+    thread_local std::vector<float> residual;
+    thread_local std::vector<float> table;
+    residual.resize(feature_count);
+    table.resize(m * CODEBOOK_SIZE);
+    for (size_t p = 0; p < probes; ++p)
+    {
+        const size_t list = lists[p].index;
+        stats.nodes_visited++;
+
+        // Distance of the query's residual to every codebook entry, per subspace
+        const float* centroid = coarse_centroids.data() + list * feature_count;
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            residual[j] = query[j] - centroid[j];
+        }
+        for (size_t s = 0; s < m; ++s)
+        {
+            const size_t width = subspace_width(s);
+            for (size_t c = 0; c < CODEBOOK_SIZE; ++c)
+            {
+                table[s * CODEBOOK_SIZE + c] = l2(residual.data() + subspace_begin[s], codebook(s) + c * width, width);
+            }
+        }
+
+        // Asymmetric distance of each vector: one table lookup per code byte
+        const std::vector<uint32_t>& ids = list_ids[list];
+        const uint8_t* codes = list_codes[list].data();
+        for (size_t v = 0; v < ids.size(); ++v)
+        {
+            const uint8_t* code = codes + v * m;
+            float distance = 0.0f;
+            for (size_t s = 0; s < m; ++s)
+            {
+                distance += table[s * CODEBOOK_SIZE + code[s]];
+            }
+            ranked.push(distance, ids[v]);
+        }
+        stats.distance_evaluations += ids.size();
+    }
+
+    if (parameters.rerank > 0)
+    {
+        if (!source || !source->is_normalized())
+        {
+            std::cerr << "Re-ranking needs the normalized dataset the index was built from." << std::endl;
+            exit(1);
+        }
+        for (const neighbor& candidate : shortlist.sorted())
+        {
+            best.push(l2(query.data(), source->normalized_row(candidate.index).data(), feature_count), candidate.index);
+        }
+        stats.distance_evaluations += shortlist.size();
+    }
+}
+
+size_t ivf_pq_index::size() const
+{
+    size_t total = 0;
+    for (const auto& ids : list_ids)
+    {
+        total += ids.size();
+    }
+    return total;
+}
+
+void ivf_pq_index::save(const std::string& path) const
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Could not open " << path << " for writing." << std::endl;
+        exit(1);
+    }
+
+    const uint64_t header[] = {FILE_MAGIC, FILE_VERSION, feature_count, parameters.lists, parameters.subquantizers,
+                               parameters.probes, parameters.rerank};
+    write_values(out, header, sizeof(header) / sizeof(header[0]));
+    write_values(out, coarse_centroids.data(), coarse_centroids.size());
+    write_values(out, codebooks.data(), codebooks.size());
+    for (size_t list = 0; list < parameters.lists; ++list)
+    {
+        const uint64_t count = list_ids[list].size();
+        write_values(out, &count, 1);
+        write_values(out, list_ids[list].data(), list_ids[list].size());
+        write_values(out, list_codes[list].data(), list_codes[list].size());
+    }
+    if (!out)
+    {
+        std::cerr << "Failed writing the IVF-PQ index to " << path << "." << std::endl;
+        exit(1);
+    }
+}
+
+std::unique_ptr<ivf_pq_index> ivf_pq_index::load(const std::string& path, const dataset* source)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        std::cerr << "Could not open IVF-PQ index file: " << path << std::endl;
+        exit(1);
+    }
+    const std::streamoff file_size = in.tellg();
+    in.seekg(0);
+
+    uint64_t header[7];
+    read_values(in, header, 7);
+    if (!in || header[0] != FILE_MAGIC || header[1] != FILE_VERSION)
+    {
+        std::cerr << "Invalid IVF-PQ index file: " << path << std::endl;
+        exit(1);
+    }
+
+    std::unique_ptr<ivf_pq_index> index(new ivf_pq_index());
+    index->source = source;
+    index->feature_count = header[2];
+    index->parameters.lists = header[3];
+    index->parameters.subquantizers = header[4];
+    index->parameters.probes = header[5];
+    index->parameters.rerank = header[6];
+
+    const size_t m = index->parameters.subquantizers;
+    const uint64_t quantizer_bytes = (index->parameters.lists + CODEBOOK_SIZE) * index->feature_count * sizeof(float);
+    if (index->feature_count == 0 || index->feature_count > static_cast<uint64_t>(file_size) || m == 0 || m > index->feature_count || index->parameters.lists == 0
+        || index->parameters.lists > static_cast<uint64_t>(file_size) || quantizer_bytes > static_cast<uint64_t>(file_size))
+    {
+        std::cerr << "Invalid IVF-PQ index file: " << path << std::endl;
+        exit(1);
+    }
+    index->subspace_begin.resize(m + 1);
+    for (size_t s = 0; s <= m; ++s)
+    {
+        index->subspace_begin[s] = s * index->feature_count / m;
+    }
+
+    index->coarse_centroids.resize(index->parameters.lists * index->feature_count);
+    index->codebooks.resize(index->feature_count * CODEBOOK_SIZE);
+    read_values(in, index->coarse_centroids.data(), index->coarse_centroids.size());
+    read_values(in, index->codebooks.data(), index->codebooks.size());
+    index->list_ids.resize(index->parameters.lists);
+    index->list_codes.resize(index->parameters.lists);
+    for (size_t list = 0; list < index->parameters.lists && in; ++list)
+    {
+        uint64_t count = 0;
+        read_values(in, &count, 1);
+        // A list cannot hold more vectors than the rest of the file has bytes for
+        if (!in || count > static_cast<uint64_t>(file_size - in.tellg()) / (sizeof(uint32_t) + m))
+        {
+            in.setstate(std::ios::failbit);
+            break;
+        }
+        index->list_ids[list].resize(count);
+        index->list_codes[list].resize(count * m);
+        read_values(in, index->list_ids[list].data(), count);
+        read_values(in, index->list_codes[list].data(), count * m);
+    }
+    if (!in)
+    {
+        std::cerr << "Truncated IVF-PQ index file: " << path << std::endl;
+        exit(1);
+    }
+    // Re-ranking reads the source's rows by the stored ids, so they must be rows of it, of the same width
+    if (source)
+    {
+        bool valid = !source->is_normalized() || (source->get_normalized_feature_count() == index->feature_count &&
+                                                  source->get_normalized_precision() == feature_precision::fp32);
+        for (size_t list = 0; list < index->parameters.lists && valid; ++list)
+        {
+            for (uint32_t id : index->list_ids[list])
+            {
+                valid = valid && id < source->size();
+            }
+        }
+        if (!valid)
+        {
+            std::cerr << "Invalid IVF-PQ index file: " << path << std::endl;
+            exit(1);
+        }
+    }
+    return index;
+}
@@ -0,0 +1,78 @@
+#ifndef __IVF_PQ_INDEX_HPP
+#define __IVF_PQ_INDEX_HPP
+
+#include "../../include/dataset.hpp"
+#include "search_index.hpp"
+#include <vector>
+#include <memory> // For std::unique_ptr
+#include <string>
+
+// Tuning knobs of the IVF-PQ index
+struct ivf_pq_parameters
+{
+    size_t lists = 64;               // Coarse k-means centroids, one inverted list each
+    size_t subquantizers = 16;       // Code bytes per vector (8 to 32 are typical)
+    size_t probes = 8;               // Lists scanned per query
+    size_t rerank = 0;               // Shortlist re-ranked with exact distances from the dataset; 0 to rank on codes only
+    size_t training_samples = 10000; // Rows sampled to train the quantizers
+    size_t iterations = 15;          // k-means iterations
+    unsigned seed = 42;
+};
+
+// Compressed approximate k-nearest-neighbor index for squared L2. Rows are assigned to the nearest of
+// `lists` coarse centroids, and the residual to that centroid is product-quantized: split into
+// `subquantizers` subvectors, each replaced by the byte index of the nearest of 256 centroids. A vector
+// costs `subquantizers` bytes plus its id instead of 4 bytes per feature. A query scans the `probes`
+// nearest lists, scoring every code with a per-list table of subvector distances (asymmetric distance),
+// and optionally recomputes exact distances for the best `rerank` candidates.
+class ivf_pq_index : public search_index
+{
+    static constexpr size_t CODEBOOK_SIZE = 256;
+    static constexpr uint32_t FILE_MAGIC = 0x49565051; // "IVFQ"
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    size_t feature_count = 0;
+    ivf_pq_parameters parameters;
+    const dataset* source = nullptr;          // Normalized rows for re-ranking; not owned
+
+    std::vector<float> coarse_centroids;      // lists x feature_count
+    std::vector<size_t> subspace_begin;       // First feature of each subspace, plus feature_count at the end
+    std::vector<float> codebooks;             // Per subspace 256 centroids of its width, subspace after subspace
+    std::vector<std::vector<uint32_t>> list_ids;   // Dataset row of each vector, per list
+    std::vector<std::vector<uint8_t>> list_codes;  // subquantizers bytes per vector, per list
+
+    ivf_pq_index() = default;
+
+    size_t subspace_width(size_t s) const { return subspace_begin[s + 1] - subspace_begin[s]; }
+    const float* codebook(size_t s) const { return codebooks.data() + subspace_begin[s] * CODEBOOK_SIZE; }
+    size_t nearest_list(const float* row) const;
+    void encode(const float* residual, uint8_t* code) const;
+
+public:
+    // Train the quantizers on a sample of training and add all of its rows, which must be stored at fp32
+    ivf_pq_index(const dataset_view& training, const ivf_pq_parameters& parameters = ivf_pq_parameters());
+
+    // Learn the coarse centroids and the codebooks from (a sample of) the normalized rows of view
+    void train(const dataset_view& view);
+    // Encode the normalized rows of view into the lists; the quantizers must be trained
+    void add(const dataset_view& view);
+
+    void search(span<const float> query, size_t k, top_k& best, search_stats& stats) const override;
+
+    // Not safe while searches are running
+    void set_probes(size_t probes) { parameters.probes = probes; }
+    void set_rerank(size_t rerank) { parameters.rerank = rerank; }
+
+    // Write the quantizers and lists to path; exits on I/O errors
+    void save(const std::string& path) const;
+    // Read an index written by save(); source supplies the rows for re-ranking and may be null without it.
+    // Exits unless every stored id is a row of source and its normalized rows are fp32 of the index's width.
+    static std::unique_ptr<ivf_pq_index> load(const std::string& path, const dataset* source = nullptr);
+
+    size_t size() const;
+    // Bytes of code and id stored per vector
+    size_t bytes_per_vector() const { return parameters.subquantizers + sizeof(uint32_t); }
+    const ivf_pq_parameters& get_parameters() const { return parameters; }
+};
+
+#endif // __IVF_PQ_INDEX_HPP
@@ -0,0 +1,138 @@
+#include "k_sweep.hpp"
+#include "../../include/profiler.hpp"
+#include <algorithm>
+#include <iostream>
+#include <omp.h> // For OpenMP
+
+double k_sweep_result::accuracy(size_t k, vote_weighting weighting) const
+{
+    if (k == 0 || k > k_max() || queries == 0)
+    {
+        return 0.0;
+    }
+    const std::vector<size_t>& counts = weighting == vote_weighting::uniform ? correct : weighted_correct;
+    return static_cast<double>(counts[k - 1]) / queries;
+}
+
+size_t k_sweep_result::best_k(vote_weighting weighting) const
+{
+    const std::vector<size_t>& counts = weighting == vote_weighting::uniform ? correct : weighted_correct;
+    if (counts.empty())
+    {
+        return 0;
+    }
+    return static_cast<size_t>(std::max_element(counts.begin(), counts.end()) - counts.begin()) + 1;
+}
+
+void k_sweep_result::merge(const k_sweep_result& other)
+{
+    if (correct.empty())
+    {
+        *this = other;
+        return;
+    }
+    if (other.k_max() != k_max())
+    {
+        std::cerr << "Cannot merge sweeps up to k = " << k_max() << " and k = " << other.k_max() << "." << std::endl;
+        exit(1);
+    }
+    queries += other.queries;
+    for (size_t i = 0; i < k_max(); ++i)
+    {
+        correct[i] += other.correct[i];
+        weighted_correct[i] += other.weighted_correct[i];
+    }
+}
+
+namespace
+{
+    // Running vote of one weighting: the score of every label seen, the rank of its nearest neighbor,
+    // and the current winner
+    struct running_vote
+    {
+        float score[256];
+        size_t first_rank[256];
+        int leader = -1;
+
+        // Count the neighbor at the given rank; only its label can overtake the leader
+        void add(int label, size_t rank, float weight)
+        {
+            if (score[label] == 0.0f)
+            {
+                first_rank[label] = rank;
+            }
+            score[label] += weight;
+            if (leader < 0 || score[label] > score[leader] ||
+                (score[label] == score[leader] && first_rank[label] < first_rank[leader]))
+            {
+                leader = label;
+            }
+        }
+    };
+}
+
+k_sweep_result sweep_k(const KNN& knn, const dataset_view& queries, size_t k_max)
+{
+    PROFILE_PHASE("sweep_k");
+    k_sweep_result result;
+    const neighbor_table neighbors = knn.find_neighbors(queries, k_max);
+    k_max = neighbors.k; // At most the training set size
+    result.queries = queries.size();
+    result.correct.assign(k_max, 0);
+    result.weighted_correct.assign(k_max, 0);
+    if (k_max == 0)
+    {
+        return result;
+    }
+
+    const dataset* source = knn.get_training_data().get_source();
+    const distance_metric metric = knn.get_metric();
+    #pragma omp parallel
+    {
+        std::vector<size_t> correct(k_max, 0);
+        std::vector<size_t> weighted_correct(k_max, 0);
+        running_vote uniform, weighted;
+
+        #pragma omp for schedule(static)
+        for (long long q = 0; q < static_cast<long long>(queries.size()); ++q)
+        {
+            const int truth = queries.get_enumerated_label(q);
+            span<const neighbor> nearest = neighbors.row(q);
+            std::fill(std::begin(uniform.score), std::end(uniform.score), 0.0f);
+            std::fill(std::begin(weighted.score), std::end(weighted.score), 0.0f);
+            uniform.leader = weighted.leader = -1;
+            for (size_t r = 0; r < k_max; ++r)
+            {
+                const int label = source->get_enumerated_label(nearest[r].index);
+                // Enumerated labels come from uint8 labels, so they always fit the score arrays
+                if (label >= 0 && label < 256)
+                {
+                    uniform.add(label, r, 1.0f);
+                    weighted.add(label, r, neighbor_weight(nearest[r].distance, metric, vote_weighting::inverse_distance));
+                }
+                correct[r] += uniform.leader == truth;
+                weighted_correct[r] += weighted.leader == truth;
+            }
+        }
+
+        #pragma omp critical
+        for (size_t i = 0; i < k_max; ++i)
+        {
+            result.correct[i] += correct[i];
+            result.weighted_correct[i] += weighted_correct[i];
+        }
+    }
+    return result;
+}
+
+k_sweep_result cross_validate_k(KNN& knn, const dataset& data, const kfold_splitter& folds, size_t k_max)
+{
+    k_sweep_result total;
+    for (size_t f = 0; f < folds.size(); ++f)
+    {
+        split_indices split = folds.fold(f);
+        knn.set_training_data(dataset_view(&data, std::move(split.training)));
+        total.merge(sweep_k(knn, dataset_view(&data, std::move(split.test)), k_max));
+    }
+    return total;
+}
@@ -0,0 +1,34 @@
+#ifndef __K_SWEEP_HPP
+#define __K_SWEEP_HPP
+
+#include "knn.hpp"
+#include "../../include/dataset_split.hpp"
+#include <vector>
+
+// Accuracy of every k from 1 to k_max under both vote weightings
+struct k_sweep_result
+{
+    size_t queries = 0;
+    std::vector<size_t> correct;          // correct[k - 1]: correct uniform-vote predictions with k neighbors
+    std::vector<size_t> weighted_correct; // correct[k - 1] with inverse-distance votes
+
+    size_t k_max() const { return correct.size(); }
+    double accuracy(size_t k, vote_weighting weighting = vote_weighting::uniform) const;
+    // Smallest k with the highest accuracy
+    size_t best_k(vote_weighting weighting = vote_weighting::uniform) const;
+    // Add the counts of another sweep with the same k_max, e.g. of another fold
+    void merge(const k_sweep_result& other);
+};
+
+// Score every k up to k_max on the queries with one neighbor search. The k_max nearest training rows of
+// each query are found once, in parallel, by knn (scan, batch engine or index as configured), and one
+// walk down each sorted list updates the running votes, so the prediction of every k, uniform and
+// distance-weighted, costs O(1) on top of the previous one. Predictions match set_k(k) with the same
+// tie rule: the label whose nearest neighbor ranks first.
+k_sweep_result sweep_k(const KNN& knn, const dataset_view& queries, size_t k_max);
+
+// k-fold cross validation of every k up to k_max: each fold's training rows become knn's training data
+// and its test rows are swept; the counts add up over the folds. knn's training data is left on the last fold.
+k_sweep_result cross_validate_k(KNN& knn, const dataset& data, const kfold_splitter& folds, size_t k_max);
+
+#endif // __K_SWEEP_HPP
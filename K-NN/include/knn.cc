@@ -1,151 +1,351 @@
-#include "knn.hpp"
-#include <algorithm> // For std::sort
-#include <cmath>     // For std::sqrt
-#include <unordered_map> // For voting mechanism
-
-// Constructor with k parameter
-KNN::KNN(int k_val) : k(k_val) {}
-
-// Default Constructor
-KNN::KNN() : k(3) {} // Default k=3
-
-// Destructor
-KNN::~KNN() {}
-
-// Setter for k
-void KNN::set_k(int val) {
-    k = val;
-}
-
-// Setter for training data
-void KNN::set_training_data(const std::vector<std::unique_ptr<data>>& vect) {
-    trainingData.clear();
-    trainingData.reserve(vect.size());
-    for(const auto& data_ptr : vect) {
-        trainingData.push_back(data_ptr.get());
-    }
-}
-
-// Setter for test data
-void KNN::set_test_data(const std::vector<std::unique_ptr<data>>& vect) {
-    testDataSet.clear();
-    testDataSet.reserve(vect.size());
-    for(const auto& data_ptr : vect) {
-        testDataSet.push_back(data_ptr.get());
-    }
-}
-
-// Setter for validation data
-void KNN::set_validation_data(const std::vector<std::unique_ptr<data>>& vect) {
-    validationDataSet.clear();
-    validationDataSet.reserve(vect.size());
-    for(const auto& data_ptr : vect) {
-        validationDataSet.push_back(data_ptr.get());
-    }
-}
-
-// Calculate Euclidean distance between two data points
-double KNN::calculate_distance(const data* query_point, const data* input) {
-    double sum = 0.0;
-    const auto& query_features = query_point->get_normalized_feature_vector();
-    const auto& input_features = input->get_normalized_feature_vector();
-    size_t size = query_features.size();
-    for(size_t i = 0; i < size; ++i) {
-        double diff = static_cast<double>(query_features[i]) - static_cast<double>(input_features[i]);
-        sum += diff * diff;
-    }
-    return std::sqrt(sum);
-}
-
-// Find k nearest neighbors for a given query point
-void KNN::find_k_nearest_neighbors(const data* query_point) {
-    neighbors.clear();
-    // Vector to hold pairs of (distance, data*)
-    std::vector<std::pair<double, data*>> distance_vector;
-    distance_vector.reserve(trainingData.size());
-
-    // Calculate distance from query_point to each training data point
-    for(auto train_ptr : trainingData) {
-        double dist = calculate_distance(query_point, train_ptr);
-        distance_vector.emplace_back(dist, train_ptr);
-    }
-
-    // Sort the distance_vector based on distance
-    std::sort(distance_vector.begin(), distance_vector.end(),
-              [](const std::pair<double, data*>& a, const std::pair<double, data*>& b) {
-                  return a.first < b.first;
-              });
-
-    // Select the top k nearest neighbors
-    for(int i = 0; i < k && i < static_cast<int>(distance_vector.size()); ++i) {
-        neighbors.push_back(distance_vector[i].second);
-    }
-}
-
-// Predict the label for a given query point
-int KNN::predict(const data* query_point) {
-    find_k_nearest_neighbors(query_point);
-
-    // Voting mechanism using unordered_map
-    std::unordered_map<int, int> vote_map;
-    for(auto neighbor_ptr : neighbors) {
-        vote_map[neighbor_ptr->get_enumerated_label()]++;
-    }
-
-    // Find the label with the maximum votes
-    int predicted_label = -1;
-    int max_votes = -1;
-    for(const auto& pair : vote_map) {
-        if(pair.second > max_votes) {
-            max_votes = pair.second;
-            predicted_label = pair.first;
-        }
-    }
-
-    return predicted_label;
-}
-
-// Validate the KNN model using the validation dataset
-double KNN::validate() {
-    if(validationDataSet.empty()) {
-        std::cerr << "Validation dataset is empty." << std::endl;
-        return 0.0;
-    }
-
-    int correct = 0;
-    for(const auto& query_ptr : validationDataSet) {
-        int prediction = predict(query_ptr);
-        if(prediction == query_ptr->get_enumerated_label()) {
-            correct++;
-        }
-    }
-
-    double accuracy = static_cast<double>(correct) / validationDataSet.size();
-    std::cout << "Validation Accuracy: " << accuracy * 100.0 << "%" << std::endl;
-    return accuracy;
-}
-
-// Test the KNN model using the test dataset
-double KNN::test() {
-    if(testDataSet.empty()) {
-        std::cerr << "Test dataset is empty." << std::endl;
-        return 0.0;
-    }
-
-    int correct = 0;
-    for(const auto& query_ptr : testDataSet) {
-        int prediction = predict(query_ptr);
-        if(prediction == query_ptr->get_enumerated_label()) {
-            correct++;
-        }
-    }
-
-    double accuracy = static_cast<double>(correct) / testDataSet.size();
-    std::cout << "Test Accuracy: " << accuracy * 100.0 << "%" << std::endl;
-    return accuracy;
-}
-
-// Optional: Getter for neighbors
-const std::vector<data*>& KNN::get_neighbors() const {
-    return neighbors;
-}
+#include "knn.hpp"
+#include "../../include/profiler.hpp"
+#include <algorithm>     // For std::max
+#include <iostream>
+#include <omp.h>         // For OpenMP
+#include <type_traits>   // For std::is_same
+
+// Constructor with k parameter
+KNN::KNN(int k_val) : k(k_val), early_abandon(false), integer_distances(false), precision(feature_precision::fp32), thread_count(0), weighting(vote_weighting::uniform) {
+    set_metric(distance_metric::squared_l2);
+}
+
+// Default Constructor
+KNN::KNN() : KNN(3) {} // Default k=3
+
+// Destructor
+KNN::~KNN() {}
+
+// Setter for k
+void KNN::set_k(int val) {
+    k = val;
+}
+
+// Setter for the distance metric
+void KNN::set_metric(distance_metric m) {
+    metric = m;
+    kernel = get_distance_kernels().get(m);
+    bounded_kernel = get_distance_kernels().get_bounded(m);
+    integer_kernel = get_distance_kernels().get_integer(m);
+    weighted_kernel = get_distance_kernels().get_weighted(m);
+    half_kernel = get_distance_kernels().get_half(m, precision);
+    if(integer_distances && !integer_kernel) {
+        std::cerr << "Integer distances support squared_l2 and l1 only." << std::endl;
+        exit(1);
+    }
+}
+
+// Setter for early abandoning of candidate distances
+void KNN::set_early_abandon(bool enabled) {
+    early_abandon = enabled;
+}
+
+// Setter for the number of threads used by predict_batch (0 = OpenMP default)
+void KNN::set_thread_count(int threads) {
+    thread_count = threads;
+}
+
+// Setter for how neighbors' labels are combined
+void KNN::set_vote_weighting(vote_weighting w) {
+    weighting = w;
+}
+
+// Enable distances on the raw uint8 rows
+void KNN::set_integer_distances(bool enabled) {
+    integer_distances = enabled;
+    set_metric(metric);
+}
+
+// Setter for the per-feature weights of the integer distances
+void KNN::set_feature_weights(std::vector<float> weights) {
+    feature_weights = std::move(weights);
+}
+
+std::vector<float> z_score_weights(const feature_stats& stats, distance_metric metric) {
+    std::vector<float> weights(stats.get_feature_count());
+    for(size_t i = 0; i < weights.size(); ++i) {
+        // Zero deviations are scaled by 1, as normalize() does
+        double std_dev = stats.std_dev(i) == 0.0 ? 1.0 : stats.std_dev(i);
+        weights[i] = static_cast<float>(metric == distance_metric::l1 ? 1.0 / std_dev : 1.0 / (std_dev * std_dev));
+    }
+    return weights;
+}
+
+// Setter for the search index replacing the scan
+void KNN::set_search_index(std::unique_ptr<search_index> search) {
+    index = std::move(search);
+}
+
+// Setter for training data
+void KNN::set_training_data(const dataset_view& view) {
+    trainingData = view;
+    precision = view.get_normalized_precision();
+    half_kernel = get_distance_kernels().get_half(metric, precision);
+    // The batch engine works on normalized rows; raw-only datasets are served by the integer scan
+    if(!view.get_source() || !view.get_source()->is_normalized()) {
+        batch_engine.reset();
+        return;
+    }
+    batch_engine = std::make_unique<batch_distance_engine>(trainingData);
+}
+
+// Setter for test data
+void KNN::set_test_data(const dataset_view& view) {
+    testDataSet = view;
+}
+
+// Setter for validation data
+void KNN::set_validation_data(const dataset_view& view) {
+    validationDataSet = view;
+}
+
+// Calculate the distance between two data points with the dispatched SIMD kernel
+float KNN::calculate_distance(span<const float> query_features, span<const float> input_features) const {
+    return kernel(query_features.data(), input_features.data(), query_features.size());
+}
+
+// Find k nearest neighbors for a given query point
+void KNN::find_k_nearest_neighbors(span<const float> query_point, top_k& best) const {
+    scan(query_point, k > 0 ? static_cast<size_t>(k) : 0, best);
+}
+
+void KNN::scan(span<const float> query_point, size_t count, top_k& best) const {
+    if(index) {
+        PROFILE_PHASE("index_search");
+        search_stats stats;
+        index->search(query_point, count, best, stats);
+        return;
+    }
+    PROFILE_PHASE("knn_scan");
+    best.reset(count);
+
+    // Scan the training rows in order; with early abandoning a candidate's distance evaluation
+    // stops as soon as its partial sum passes the current k-th best distance
+    const size_t feature_count = query_point.size();
+    if(precision != feature_precision::fp32) {
+        for(size_t i = 0; i < trainingData.size(); ++i) {
+            best.push(half_kernel(query_point.data(), trainingData.half_row(i).data(), feature_count), trainingData.index(i));
+        }
+    } else if(early_abandon) {
+        for(size_t i = 0; i < trainingData.size(); ++i) {
+            float dist = bounded_kernel(query_point.data(), trainingData.normalized_row(i).data(), feature_count, best.threshold());
+            best.push(dist, trainingData.index(i));
+        }
+    } else {
+        for(size_t i = 0; i < trainingData.size(); ++i) {
+            best.push(calculate_distance(query_point, trainingData.normalized_row(i)), trainingData.index(i));
+        }
+    }
+}
+
+void KNN::find_k_nearest_neighbors(span<const float> query_point) {
+    top_k best;
+    find_k_nearest_neighbors(query_point, best);
+    const auto& nearest = best.sorted();
+    neighbors.assign(nearest.begin(), nearest.end());
+}
+
+void KNN::find_k_nearest_neighbors(span<const uint8_t> query_point, top_k& best) const {
+    scan(query_point, k > 0 ? static_cast<size_t>(k) : 0, best);
+}
+
+void KNN::scan(span<const uint8_t> query_point, size_t count, top_k& best) const {
+    PROFILE_PHASE("knn_scan_integer");
+    best.reset(count);
+
+    const size_t feature_count = query_point.size();
+    if(!feature_weights.empty()) {
+        if(feature_weights.size() != feature_count) {
+            std::cerr << "Expected " << feature_count << " feature weights, got " << feature_weights.size() << "." << std::endl;
+            exit(1);
+        }
+        for(size_t i = 0; i < trainingData.size(); ++i) {
+            best.push(weighted_kernel(query_point.data(), trainingData.raw_row(i).data(), feature_weights.data(), feature_count), trainingData.index(i));
+        }
+    } else {
+        if(feature_count > MAX_INTEGER_FEATURES) {
+            std::cerr << "Integer distances support rows of at most " << MAX_INTEGER_FEATURES << " features, got " << feature_count << "." << std::endl;
+            exit(1);
+        }
+        // Exact up to 2^24, far beyond the distance of any plausible nearest neighbor
+        for(size_t i = 0; i < trainingData.size(); ++i) {
+            best.push(static_cast<float>(integer_kernel(query_point.data(), trainingData.raw_row(i).data(), feature_count)), trainingData.index(i));
+        }
+    }
+}
+
+int KNN::predict(span<const uint8_t> query_point) const {
+    thread_local top_k best;
+    find_k_nearest_neighbors(query_point, best);
+    const auto& nearest = best.sorted();
+    return vote({nearest.data(), nearest.size()});
+}
+
+// Predict the label for a given query point
+int KNN::predict(span<const float> query_point) const {
+    // Bounded max-heap of the best candidates, reused by every query on this thread
+    thread_local top_k best;
+    find_k_nearest_neighbors(query_point, best);
+    const auto& nearest = best.sorted();
+    return vote({nearest.data(), nearest.size()});
+}
+
+// Vote over the labels of the given neighbors, which are sorted nearest first
+int KNN::vote(span<const neighbor> nearest) const {
+    const dataset* source = trainingData.get_source();
+    return vote_labels(nearest, [&](size_t i) { return source->get_enumerated_label(nearest[i].index); }, metric, weighting);
+}
+
+// Row pointers of a view's queries, raw or normalized
+static std::vector<const uint8_t*> raw_rows(const dataset_view& queries) {
+    std::vector<const uint8_t*> rows(queries.size());
+    for(size_t i = 0; i < queries.size(); ++i) {
+        rows[i] = queries.raw_row(i).data();
+    }
+    return rows;
+}
+
+// Reduced-precision rows are widened into widened, which must outlive the pointers
+static std::vector<const float*> normalized_rows(const dataset_view& queries, aligned_buffer<float>& widened) {
+    std::vector<const float*> rows(queries.size());
+    if(queries.get_normalized_precision() == feature_precision::fp32) {
+        for(size_t i = 0; i < queries.size(); ++i) {
+            rows[i] = queries.normalized_row(i).data();
+        }
+        return rows;
+    }
+    const size_t width = queries.get_normalized_feature_count();
+    widened.resize(queries.size() * width);
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < static_cast<long long>(queries.size()); ++i) {
+        queries.widen_normalized_row(i, widened.data() + i * width);
+    }
+    for(size_t i = 0; i < queries.size(); ++i) {
+        rows[i] = widened.data() + i * width;
+    }
+    return rows;
+}
+
+prediction_batch KNN::predict_batch(const dataset_view& queries) const {
+    if(integer_distances) {
+        return predict_rows(raw_rows(queries));
+    }
+    aligned_buffer<float> widened;
+    return predict_rows(normalized_rows(queries, widened));
+}
+
+neighbor_table KNN::find_neighbors(const dataset_view& queries, size_t count) const {
+    if(integer_distances) {
+        return search_rows(raw_rows(queries), count);
+    }
+    aligned_buffer<float> widened;
+    return search_rows(normalized_rows(queries, widened), count);
+}
+
+// Split contiguous query rows into row pointers
+template<typename T>
+static std::vector<const T*> split_rows(span<const T> queries, size_t feature_count) {
+    const size_t count = feature_count ? queries.size() / feature_count : 0;
+    std::vector<const T*> rows(count);
+    for(size_t i = 0; i < count; ++i) {
+        rows[i] = queries.data() + i * feature_count;
+    }
+    return rows;
+}
+
+prediction_batch KNN::predict_batch(span<const float> queries) const {
+    return predict_rows(split_rows(queries, trainingData.get_normalized_feature_count()));
+}
+
+prediction_batch KNN::predict_batch(span<const uint8_t> queries) const {
+    return predict_rows(split_rows(queries, trainingData.get_feature_count()));
+}
+
+neighbor_table KNN::find_neighbors(span<const float> queries, size_t count) const {
+    return search_rows(split_rows(queries, trainingData.get_normalized_feature_count()), count);
+}
+
+template<typename T>
+neighbor_table KNN::search_rows(const std::vector<const T*>& rows, size_t count) const {
+    const int threads = thread_count > 0 ? thread_count : omp_get_max_threads();
+    // Float queries match the normalized rows, uint8 queries the raw ones
+    const size_t feature_count = std::is_same<T, float>::value ? trainingData.get_normalized_feature_count() : trainingData.get_feature_count();
+
+    if constexpr(std::is_same<T, float>::value) {
+        if(metric == distance_metric::squared_l2 && batch_engine && !index && rows.size() >= MIN_BATCH_QUERIES) {
+            // Evaluate all queries at once so each training block is reused by many queries
+            return batch_engine->search(rows, count, threads);
+        }
+    }
+    neighbor_table neighbors;
+    neighbors.k = std::min(count, trainingData.size());
+    neighbors.entries.resize(rows.size() * neighbors.k);
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(threads)
+    for(long long i = 0; i < static_cast<long long>(rows.size()); ++i) {
+        thread_local top_k best;
+        scan(span<const T>(rows[i], feature_count), count, best);
+        const auto& nearest = best.sorted();
+        std::copy(nearest.begin(), nearest.end(), neighbors.row(i).begin());
+    }
+    return neighbors;
+}
+
+template<typename T>
+prediction_batch KNN::predict_rows(const std::vector<const T*>& rows) const {
+    PROFILE_PHASE("knn_predict_batch");
+    prediction_batch result;
+    result.neighbors = search_rows(rows, static_cast<size_t>(std::max(k, 0)));
+
+    const int threads = thread_count > 0 ? thread_count : omp_get_max_threads();
+    result.labels.resize(rows.size());
+    #pragma omp parallel for num_threads(threads)
+    for(long long i = 0; i < static_cast<long long>(rows.size()); ++i) {
+        result.labels[i] = vote(result.neighbors.row(i));
+    }
+    return result;
+}
+
+// Count correct predictions over a query set
+int KNN::count_correct(const dataset_view& queries) const {
+    prediction_batch predictions = predict_batch(queries);
+    int correct = 0;
+    for(size_t i = 0; i < queries.size(); ++i) {
+        if(predictions.labels[i] == queries.get_enumerated_label(i)) {
+            correct++;
+        }
+    }
+    return correct;
+}
+
+// Validate the KNN model using the validation dataset
+double KNN::validate() {
+    if(validationDataSet.empty()) {
+        std::cerr << "Validation dataset is empty." << std::endl;
+        return 0.0;
+    }
+
+    int correct = count_correct(validationDataSet);
+
+    double accuracy = static_cast<double>(correct) / validationDataSet.size();
+    std::cout << "Validation Accuracy: " << accuracy * 100.0 << "%" << std::endl;
+    return accuracy;
+}
+
+// Test the KNN model using the test dataset
+double KNN::test() {
+    if(testDataSet.empty()) {
+        std::cerr << "Test dataset is empty." << std::endl;
+        return 0.0;
+    }
+
+    int correct = count_correct(testDataSet);
+
+    double accuracy = static_cast<double>(correct) / testDataSet.size();
+    std::cout << "Test Accuracy: " << accuracy * 100.0 << "%" << std::endl;
+    return accuracy;
+}
+
+// Optional: Getter for neighbors
+const std::vector<neighbor>& KNN::get_neighbors() const {
+    return neighbors;
+}
@@ -1,45 +1,202 @@
-#ifndef __KNN_HPP
-#define __KNN_HPP
-
-#include <vector>
-#include <memory>
-#include "../../include/data_handler.hpp" // Adjust the path as per your project structure
-
-class KNN 
-{
-private:
-    // Number of neighbors to consider
-    int k;
-
-    // Data sets as raw pointers (non-owning references)
-    std::vector<data*> neighbors;
-    std::vector<data*> trainingData;
-    std::vector<data*> testDataSet;
-    std::vector<data*> validationDataSet;
-
-public:
-    // Constructors and Destructor
-    KNN(int k_val);
-    KNN();
-    ~KNN();
-
-    // Core KNN functionality
-    void find_k_nearest_neighbors(const data* query_point);
-    int predict(const data* query_point);
-    double calculate_distance(const data* query_point, const data* input);
-
-    // Data setters
-    void set_training_data(const std::vector<std::unique_ptr<data>>& vect);
-    void set_test_data(const std::vector<std::unique_ptr<data>>& vect);
-    void set_validation_data(const std::vector<std::unique_ptr<data>>& vect);
-    void set_k(int val);
-
-    // Evaluation
-    double validate();
-    double test();
-
-    // Optional: Getter for neighbors
-    const std::vector<data*>& get_neighbors() const;
-};
-
-#endif // __KNN_HPP
+#ifndef __KNN_HPP
+#define __KNN_HPP
+
+#include <vector>
+#include <memory>
+#include <cmath>  // For std::sqrt
+#include "../../include/data_handler.hpp" // Adjust the path as per your project structure
+#include "distance.hpp"
+#include "top_k.hpp"
+#include "batch_distance.hpp"
+#include "search_index.hpp"
+
+// Labels predicted for a batch of queries, with the neighbors each prediction was based on
+struct prediction_batch
+{
+    std::vector<int> labels;
+    neighbor_table neighbors;
+};
+
+// How the neighbors' labels are combined into a prediction
+enum class vote_weighting
+{
+    uniform,         // One vote per neighbor
+    inverse_distance // Each neighbor votes with 1 / (distance + 1e-6); Euclidean distance for squared_l2
+};
+
+// Vote of a neighbor at the given ranking distance under the given weighting
+inline float neighbor_weight(float distance, distance_metric metric, vote_weighting weighting)
+{
+    if(weighting == vote_weighting::uniform) {
+        return 1.0f;
+    }
+    // Ranking distances of squared_l2 are squared; weigh by the distance itself
+    const float d = metric == distance_metric::squared_l2 ? std::sqrt(distance) : distance;
+    return 1.0f / (d + 1e-6f);
+}
+
+// Label with the most votes among neighbors sorted nearest first, label_of(i) giving the label of
+// nearest[i]; ties go to the label whose nearest neighbor ranks first
+template<typename LabelOf>
+int vote_labels(span<const neighbor> nearest, LabelOf label_of, distance_metric metric, vote_weighting weighting)
+{
+    int predicted_label = -1;
+    float max_votes = 0.0f;
+    for(size_t i = 0; i < nearest.size(); ++i) {
+        const int label = label_of(i);
+
+        // Count each label once, at its nearest occurrence
+        bool counted = false;
+        for(size_t j = 0; j < i && !counted; ++j) {
+            counted = label_of(j) == label;
+        }
+        if(counted) {
+            continue;
+        }
+
+        float votes = 0.0f;
+        for(size_t j = i; j < nearest.size(); ++j) {
+            if(label_of(j) == label) {
+                votes += neighbor_weight(nearest[j].distance, metric, weighting);
+            }
+        }
+        // Strictly more votes needed, so a tie keeps the label seen first, i.e. the nearer one
+        if(votes > max_votes) {
+            max_votes = votes;
+            predicted_label = label;
+        }
+    }
+    return predicted_label;
+}
+
+// Per-feature weights that make the weighted uint8 distances on raw rows rank neighbors like the
+// float distances on z-score normalized rows: 1/std^2 for squared_l2, 1/std for l1
+std::vector<float> z_score_weights(const feature_stats& stats, distance_metric metric);
+
+class KNN 
+{
+private:
+    // Number of neighbors to consider
+    int k;
+
+    // Distance measure and the kernel evaluating it, picked for the running CPU
+    distance_metric metric;
+    distance_kernel kernel;
+    bounded_distance_kernel bounded_kernel; // Same distance, abandoned once past the current k-th best
+    bool early_abandon;
+
+    // Distances on the raw uint8 rows, a quarter of the bytes of the normalized rows per candidate
+    bool integer_distances;
+    integer_distance_kernel integer_kernel;   // Exact distance, used without feature weights
+    weighted_distance_kernel weighted_kernel; // Used with feature weights
+    std::vector<float> feature_weights;       // Empty for unweighted integer distances
+
+    // Precision the training rows' dataset stores its normalized rows at; fp16 and bf16 rows are
+    // scanned in place with kernels that widen them in registers, half the bytes per candidate
+    feature_precision precision;
+    half_distance_kernel half_kernel;
+
+    // Threads used by predict_batch, 0 for the OpenMP default
+    int thread_count;
+
+    vote_weighting weighting;
+
+    // The k nearest training samples of the last find_k_nearest_neighbors(query) call, nearest first
+    std::vector<neighbor> neighbors;
+
+    // Data sets as index views into the contiguous dataset (non-owning)
+    dataset_view trainingData;
+    dataset_view testDataSet;
+    dataset_view validationDataSet;
+
+    // Blocked all-queries-at-once search over trainingData, used by test() and validate()
+    std::unique_ptr<batch_distance_engine> batch_engine;
+
+    // Optional index answering float queries instead of the linear scan
+    std::unique_ptr<search_index> index;
+
+    // Label with the most votes among the given neighbors; ties go to the label whose nearest neighbor ranks first
+    int vote(span<const neighbor> nearest) const;
+    // The count nearest training rows of one query, scanned (or searched with the index) into best
+    void scan(span<const float> query_point, size_t count, top_k& best) const;
+    void scan(span<const uint8_t> query_point, size_t count, top_k& best) const;
+    // The count nearest training rows of queries given as row pointers, float or uint8
+    template<typename T>
+    neighbor_table search_rows(const std::vector<const T*>& rows, size_t count) const;
+    // Predictions for queries given as row pointers
+    template<typename T>
+    prediction_batch predict_rows(const std::vector<const T*>& rows) const;
+    // Number of queries whose prediction matches their label
+    int count_correct(const dataset_view& queries) const;
+
+public:
+    // Fewer float queries than this are scanned one by one: the batch engine packs the whole training
+    // set per call, which only pays off once several queries share it (e.g. small server batches)
+    static constexpr size_t MIN_BATCH_QUERIES = 8;
+
+    // Constructors and Destructor
+    KNN(int k_val);
+    KNN();
+    ~KNN();
+
+    // Core KNN functionality. Everything const is reentrant: one instance can serve concurrent queries.
+    // Scan the training data, keeping the nearest candidates in best
+    void find_k_nearest_neighbors(span<const float> query_point, top_k& best) const;
+    // Same, storing the result for get_neighbors(); not safe for concurrent use
+    void find_k_nearest_neighbors(span<const float> query_point);
+    int predict(span<const float> query_point) const;
+    // Same on raw uint8 features, with the integer distances
+    void find_k_nearest_neighbors(span<const uint8_t> query_point, top_k& best) const;
+    int predict(span<const uint8_t> query_point) const;
+    // Predict every query of the view, spreading the queries over thread_count threads.
+    // Uses the raw rows when integer distances are enabled and the normalized rows otherwise.
+    prediction_batch predict_batch(const dataset_view& queries) const;
+    // Same, for queries stored as contiguous rows of the training feature count
+    prediction_batch predict_batch(span<const float> queries) const;
+    prediction_batch predict_batch(span<const uint8_t> queries) const;
+    // The count nearest training rows of every query of the view, nearest first, searched like
+    // predict_batch; a larger count than k lets one search serve several k (see sweep_k)
+    neighbor_table find_neighbors(const dataset_view& queries, size_t count) const;
+    // Same, for float queries stored as contiguous rows of the normalized feature count
+    neighbor_table find_neighbors(span<const float> queries, size_t count) const;
+    // Distance used for ranking; for squared_l2 the square root is skipped as it does not change the order
+    float calculate_distance(span<const float> query_point, span<const float> input) const;
+
+    // Data setters
+    // Scans the rows at the precision their dataset stores them (data_handler::set_feature_precision);
+    // call again after changing it. Queries taken from a view of reduced-precision rows are widened
+    // to floats first. Early abandoning applies to fp32 rows only.
+    void set_training_data(const dataset_view& view);
+    void set_test_data(const dataset_view& view);
+    void set_validation_data(const dataset_view& view);
+    void set_k(int val);
+    void set_metric(distance_metric m);
+    // Stop evaluating a candidate once its partial distance passes the current k-th best.
+    // Pays off when the leading features carry most of the distance (e.g. PCA components).
+    void set_early_abandon(bool enabled);
+    void set_thread_count(int threads);
+    void set_vote_weighting(vote_weighting w);
+    // Rank on the raw uint8 rows with integer SIMD kernels (squared_l2 and l1 only). Without
+    // normalization the training data needs no float matrix at all; z_score_weights() restores
+    // the ranking of z-score normalized features if plain pixel distances lose accuracy.
+    void set_integer_distances(bool enabled);
+    // Per-feature factors applied to each term of the integer distances; empty for none
+    void set_feature_weights(std::vector<float> weights);
+    // Answer float queries with an index built over the training data (e.g. ball_tree) instead of
+    // scanning; it must use the same metric. nullptr returns to the scan.
+    void set_search_index(std::unique_ptr<search_index> search);
+
+    // Evaluation
+    double validate();
+    double test();
+
+    // Optional: Getter for neighbors
+    const std::vector<neighbor>& get_neighbors() const;
+    int get_k() const { return k; }
+    distance_metric get_metric() const { return metric; }
+    feature_precision get_feature_precision() const { return precision; }
+    vote_weighting get_vote_weighting() const { return weighting; }
+    const dataset_view& get_training_data() const { return trainingData; }
+};
+
+#endif // __KNN_HPP
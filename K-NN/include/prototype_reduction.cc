@@ -0,0 +1,324 @@
+#include "prototype_reduction.hpp"
+#include "../../include/profiler.hpp"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <numeric> // For std::iota
+#include <omp.h>   // For OpenMP
+
+namespace
+{
+    // splitmix64, as in dataset_split.cc, so a seed gives the same reduction on every platform
+    struct reduction_rng
+    {
+        uint64_t state;
+
+        uint64_t next()
+        {
+            uint64_t x = (state += 0x9E3779B97F4A7C15ULL);
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            return x ^ (x >> 31);
+        }
+
+        // Uniform in [0, n) for n below 2^32
+        uint32_t below(uint32_t n) { return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+    };
+
+    int thread_count(const reduction_options& options)
+    {
+        return options.threads > 0 ? options.threads : omp_get_max_threads();
+    }
+
+    void check_normalized(const dataset_view& training)
+    {
+        if (!training.empty() && (!training.get_source()->is_normalized() || training.get_normalized_precision() != feature_precision::fp32))
+        {
+            std::cerr << "Prototype reduction needs normalized training rows stored at fp32." << std::endl;
+            exit(1);
+        }
+    }
+
+    // View of the rows at the given positions of training, in ascending dataset order
+    dataset_view keep_positions(const dataset_view& training, const std::vector<size_t>& positions)
+    {
+        std::vector<uint32_t> rows(positions.size());
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            rows[i] = training.index(positions[i]);
+        }
+        std::sort(rows.begin(), rows.end());
+        return dataset_view(training.get_source(), std::move(rows));
+    }
+}
+
+dataset_view edit_training_set(const dataset_view& training, const reduction_options& options)
+{
+    PROFILE_PHASE("edit_training_set");
+    check_normalized(training);
+    if (training.size() <= options.edit_k)
+    {
+        return training;
+    }
+    KNN knn(static_cast<int>(options.edit_k));
+    knn.set_metric(options.metric);
+    knn.set_thread_count(options.threads);
+    knn.set_training_data(training);
+    // One neighbor more than the votes, since every row finds itself
+    const neighbor_table neighbors = knn.find_neighbors(training, options.edit_k + 1);
+
+    const dataset* source = training.get_source();
+    std::vector<char> keep(training.size());
+    #pragma omp parallel for schedule(static) num_threads(thread_count(options))
+    for (long long i = 0; i < static_cast<long long>(training.size()); ++i)
+    {
+        thread_local std::vector<neighbor> others;
+        others.clear();
+        for (const neighbor& n : neighbors.row(i))
+        {
+            if (n.index != training.index(i) && others.size() < options.edit_k)
+            {
+                others.push_back(n);
+            }
+        }
+        const int label = vote_labels(span<const neighbor>(others.data(), others.size()),
+                                      [&](size_t j) { return source->get_enumerated_label(others[j].index); },
+                                      options.metric, vote_weighting::uniform);
+        keep[i] = label == training.get_enumerated_label(i);
+    }
+
+    std::vector<size_t> kept;
+    for (size_t i = 0; i < keep.size(); ++i)
+    {
+        if (keep[i])
+        {
+            kept.push_back(i);
+        }
+    }
+    std::cout << "Edited " << training.size() << " training rows to " << kept.size() << "." << std::endl;
+    return keep_positions(training, kept);
+}
+
+dataset_view condense_training_set(const dataset_view& training, const reduction_options& options)
+{
+    PROFILE_PHASE("condense_training_set");
+    check_normalized(training);
+    const size_t n = training.size();
+    if (n == 0)
+    {
+        return training;
+    }
+    const size_t width = training.get_normalized_feature_count();
+    const distance_kernel kernel = get_distance_kernels().get(options.metric);
+    const int threads = thread_count(options);
+
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), size_t(0));
+    reduction_rng rng{options.seed};
+    for (size_t i = n - 1; i > 0; --i)
+    {
+        std::swap(order[i], order[rng.below(static_cast<uint32_t>(i + 1))]);
+    }
+
+    // The kept rows packed one after another, so the 1-NN scans stream through them
+    std::vector<float> kept_rows;
+    std::vector<int> kept_labels;
+    std::vector<size_t> kept;
+    std::vector<char> is_kept(n);
+    auto keep = [&](size_t position) {
+        const span<const float> row = training.normalized_row(position);
+        kept_rows.insert(kept_rows.end(), row.begin(), row.end());
+        kept_labels.push_back(training.get_enumerated_label(position));
+        kept.push_back(position);
+        is_kept[position] = 1;
+    };
+    keep(order[0]);
+
+    // Blocks grow with the kept set: while it is small every new row changes it most, and testing
+    // one block against a fixed set keeps more rows than visiting them one by one would
+    constexpr size_t MAX_BLOCK = 256;
+    std::vector<char> wrong(MAX_BLOCK);
+    size_t passes = 0;
+    while (passes < options.max_passes)
+    {
+        ++passes;
+        size_t added = 0;
+        for (size_t start = 0; start < n;)
+        {
+            const size_t end = std::min(n, start + std::min(MAX_BLOCK, kept.size()));
+            const size_t stored = kept.size();
+            #pragma omp parallel for schedule(dynamic, 8) num_threads(threads)
+            for (long long j = static_cast<long long>(start); j < static_cast<long long>(end); ++j)
+            {
+                const size_t position = order[j];
+                wrong[j - start] = 0;
+                if (is_kept[position])
+                {
+                    continue;
+                }
+                const float* row = training.normalized_row(position).data();
+                float best = std::numeric_limits<float>::infinity();
+                int label = -1;
+                for (size_t s = 0; s < stored; ++s)
+                {
+                    const float distance = kernel(row, kept_rows.data() + s * width, width);
+                    if (distance < best)
+                    {
+                        best = distance;
+                        label = kept_labels[s];
+                    }
+                }
+                wrong[j - start] = label != training.get_enumerated_label(position);
+            }
+            for (size_t j = start; j < end; ++j)
+            {
+                if (wrong[j - start])
+                {
+                    keep(order[j]);
+                    ++added;
+                }
+            }
+            start = end;
+        }
+        if (added == 0)
+        {
+            break;
+        }
+    }
+    std::cout << "Condensed " << n << " training rows to " << kept.size() << " in " << passes << " passes." << std::endl;
+    return keep_positions(training, kept);
+}
+
+dataset_view kmeans_prototypes(const dataset_view& training, const reduction_options& options)
+{
+    PROFILE_PHASE("kmeans_prototypes");
+    check_normalized(training);
+    const size_t width = training.get_normalized_feature_count();
+    const distance_kernel kernel = get_distance_kernels().squared_l2;
+    const int threads = thread_count(options);
+
+    // Positions of the rows of every class
+    std::vector<std::vector<size_t>> members;
+    for (size_t i = 0; i < training.size(); ++i)
+    {
+        const size_t label = static_cast<size_t>(training.get_enumerated_label(i));
+        if (label >= members.size())
+        {
+            members.resize(label + 1);
+        }
+        members[label].push_back(i);
+    }
+
+    reduction_rng rng{options.seed};
+    std::vector<size_t> kept;
+    for (const std::vector<size_t>& rows : members)
+    {
+        if (rows.empty())
+        {
+            continue;
+        }
+        const size_t clusters = std::min(options.prototypes_per_class, rows.size());
+
+        // Start from distinct member rows, the head of a partial shuffle
+        std::vector<size_t> picks(rows);
+        std::vector<float> centroids(clusters * width);
+        for (size_t c = 0; c < clusters; ++c)
+        {
+            std::swap(picks[c], picks[c + rng.below(static_cast<uint32_t>(picks.size() - c))]);
+            const span<const float> row = training.normalized_row(picks[c]);
+            std::copy(row.begin(), row.end(), centroids.begin() + c * width);
+        }
+
+        std::vector<uint32_t> assignment(rows.size());
+        std::vector<float> distances(rows.size());
+        std::vector<float> sums;
+        std::vector<size_t> counts;
+        for (size_t iteration = 0;; ++iteration)
+        {
+            #pragma omp parallel for schedule(static) num_threads(threads)
+            for (long long r = 0; r < static_cast<long long>(rows.size()); ++r)
+            {
+                const float* row = training.normalized_row(rows[r]).data();
+                float best = std::numeric_limits<float>::infinity();
+                uint32_t nearest = 0;
+                for (size_t c = 0; c < clusters; ++c)
+                {
+                    const float distance = kernel(row, centroids.data() + c * width, width);
+                    if (distance < best)
+                    {
+                        best = distance;
+                        nearest = static_cast<uint32_t>(c);
+                    }
+                }
+                assignment[r] = nearest;
+                distances[r] = best;
+            }
+            if (iteration == options.kmeans_iterations)
+            {
+                break;
+            }
+            // Move every centroid to the mean of its rows; an empty cluster keeps its centroid
+            sums.assign(clusters * width, 0.0f);
+            counts.assign(clusters, 0);
+            for (size_t r = 0; r < rows.size(); ++r)
+            {
+                const span<const float> row = training.normalized_row(rows[r]);
+                float* sum = sums.data() + assignment[r] * width;
+                for (size_t f = 0; f < width; ++f)
+                {
+                    sum[f] += row[f];
+                }
+                ++counts[assignment[r]];
+            }
+            for (size_t c = 0; c < clusters; ++c)
+            {
+                if (counts[c] == 0)
+                {
+                    continue;
+                }
+                const float scale = 1.0f / static_cast<float>(counts[c]);
+                for (size_t f = 0; f < width; ++f)
+                {
+                    centroids[c * width + f] = sums[c * width + f] * scale;
+                }
+            }
+        }
+
+        // The member of every cluster nearest to its centroid; clusters left empty are dropped
+        std::vector<size_t> representative(clusters, rows.size());
+        for (size_t r = 0; r < rows.size(); ++r)
+        {
+            size_t& current = representative[assignment[r]];
+            if (current == rows.size() || distances[r] < distances[current])
+            {
+                current = r;
+            }
+        }
+        for (size_t r : representative)
+        {
+            if (r < rows.size())
+            {
+                kept.push_back(rows[r]);
+            }
+        }
+    }
+    std::cout << "Reduced " << training.size() << " training rows to " << kept.size() << " k-means prototypes ("
+              << options.prototypes_per_class << " per class, " << options.kmeans_iterations << " iterations)." << std::endl;
+    return keep_positions(training, kept);
+}
+
+dataset_view reduce_training_set(const dataset_view& training, const reduction_options& options)
+{
+    switch (options.method)
+    {
+    case reduction_method::edited:
+        return edit_training_set(training, options);
+    case reduction_method::condensed:
+        return condense_training_set(training, options);
+    case reduction_method::kmeans:
+        return kmeans_prototypes(training, options);
+    case reduction_method::edited_condensed:
+    default:
+        return condense_training_set(edit_training_set(training, options), options);
+    }
+}
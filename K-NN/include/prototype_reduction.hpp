@@ -0,0 +1,48 @@
+#ifndef __PROTOTYPE_REDUCTION_HPP
+#define __PROTOTYPE_REDUCTION_HPP
+
+#include "knn.hpp"
+#include <cstdint>
+
+// Training-set reduction: a subset of the training rows that classifies nearly as well as all of them,
+// so every query scans a fraction of the rows. The result is a view of kept rows in ascending dataset
+// order, so it serves as training data anywhere a training view does (KNN, the indexes, fixed_knn, the
+// server) and keeps the raw rows for integer distances.
+enum class reduction_method
+{
+    edited,           // Wilson editing: drop rows their own k nearest neighbors misclassify (noise, overlap)
+    condensed,        // Hart's condensed NN: keep only the rows 1-NN over the kept rows would get wrong
+    edited_condensed, // Editing, then condensing what is left: the smoothed boundary needs fewer rows
+    kmeans            // Per class k-means; every centroid is represented by its nearest member row
+};
+
+struct reduction_options
+{
+    reduction_method method = reduction_method::edited_condensed;
+    distance_metric metric = distance_metric::squared_l2; // Of the neighbor searches; k-means clusters under squared L2
+    size_t edit_k = 3;                   // Neighbors voting on each row in editing
+    size_t max_passes = 10;              // Condensing passes over the rows; it stops early once a pass adds none
+    size_t prototypes_per_class = 100;   // k-means clusters per class
+    size_t kmeans_iterations = 10;
+    uint64_t seed = 42;                  // Order of the condensing passes and the initial k-means centroids
+    int threads = 0;                     // 0 for the OpenMP default
+};
+
+// The rows of training whose edit_k nearest other rows vote for their own label
+dataset_view edit_training_set(const dataset_view& training, const reduction_options& options = {});
+
+// Hart's condensed nearest neighbor: starting from one row, the rows are visited in a seeded shuffle and
+// every row the kept rows misclassify under 1-NN is kept, pass after pass until a pass keeps none, so
+// 1-NN over the result classifies every training row correctly (unless max_passes ends it first). The
+// rows are tested in parallel blocks against the kept rows as of the block's start; that may keep a few
+// rows a strictly sequential pass would not, but never changes the guarantee.
+dataset_view condense_training_set(const dataset_view& training, const reduction_options& options = {});
+
+// Up to prototypes_per_class rows per class: Lloyd's k-means from seeded random member rows, with each
+// centroid then replaced by the member row nearest to it
+dataset_view kmeans_prototypes(const dataset_view& training, const reduction_options& options = {});
+
+// The reduction chosen by options.method; the training rows must be normalized, at fp32
+dataset_view reduce_training_set(const dataset_view& training, const reduction_options& options = {});
+
+#endif // __PROTOTYPE_REDUCTION_HPP
@@ -0,0 +1,25 @@
+#ifndef __SEARCH_INDEX_HPP
+#define __SEARCH_INDEX_HPP
+
+#include "../../include/buffer.hpp" // For span
+#include "top_k.hpp"
+
+// Work done by one query, for judging how much of the training set an index skipped
+struct search_stats
+{
+    size_t distance_evaluations = 0; // Query-to-training-row distances computed
+    size_t nodes_visited = 0;        // Index nodes (tree nodes, graph vertices, lists) examined
+};
+
+// A search structure built over KNN's training rows, replacing the linear scan in
+// KNN::find_k_nearest_neighbors. Distances and row indices follow the scan's conventions.
+class search_index
+{
+public:
+    virtual ~search_index() = default;
+
+    // Fill best (reset by the index) with the k nearest training rows of query. Must be safe to call concurrently.
+    virtual void search(span<const float> query, size_t k, top_k& best, search_stats& stats) const = 0;
+};
+
+#endif // __SEARCH_INDEX_HPP
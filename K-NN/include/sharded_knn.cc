@@ -0,0 +1,361 @@
+#include "sharded_knn.hpp"
+#include "../../include/profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring> // For std::strerror
+#include <iostream>
+#include <omp.h> // For OpenMP
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+namespace
+{
+    // Messages between the coordinator and a worker, native byte order
+    constexpr uint32_t SHARD_MAGIC = 0x534E4E4B; // "KNNS"
+
+    // Sent by a worker once its slice is loaded
+    struct shard_hello
+    {
+        uint32_t magic;
+        uint32_t shard;
+        uint64_t rows;          // Training rows of the slice
+        uint64_t feature_count; // Normalized features per row
+    };
+
+    // A batch of query_count rows of feature_count floats follows; the reply has the count nearest
+    struct shard_request
+    {
+        uint32_t magic;
+        uint32_t query_count;
+        uint64_t count;
+    };
+
+    // query_count x k neighbors follow, then query_count x k int32 enumerated labels
+    struct shard_reply
+    {
+        uint32_t magic;
+        uint32_t query_count;
+        uint64_t k;
+    };
+
+    std::string shard_address(shard_transport transport, size_t shard)
+    {
+#ifdef _WIN32
+        const long long pid = 0;
+#else
+        const long long pid = getpid();
+#endif
+        const std::string name = "mnist_shard." + std::to_string(pid) + "." + std::to_string(shard);
+        return transport == shard_transport::shared_memory ? "shm:/" + name : "unix:/tmp/" + name + ".sock";
+    }
+}
+
+sharded_knn::sharded_knn(int k_val, const shard_options& settings)
+    : options(settings), k(k_val), weighting(vote_weighting::uniform)
+{
+#ifdef _WIN32
+    std::cerr << "Sharded KNN needs worker processes, which are not supported on Windows." << std::endl;
+    exit(1);
+#else
+    if (options.shards == 0 || options.worker_command.empty())
+    {
+        std::cerr << "Sharded KNN needs at least one shard and a worker command." << std::endl;
+        exit(1);
+    }
+    options.batch_queries = std::max<size_t>(options.batch_queries, 1);
+
+    // Listen first so that the workers find the endpoints, then start them all before waiting for any
+    std::vector<std::unique_ptr<ipc_listener>> listeners;
+    workers.resize(options.shards);
+    for (size_t s = 0; s < options.shards; ++s)
+    {
+        const std::string address = shard_address(options.transport, s);
+        listeners.push_back(listen_ipc(address));
+
+        std::vector<std::string> arguments = options.worker_command;
+        const std::vector<std::string> worker_arguments = {
+            "--address", address, "--images", options.images, "--labels", options.labels, "--cache", options.cache,
+            "--shard", std::to_string(s), "--shards", std::to_string(options.shards),
+            "--metric", std::to_string(static_cast<int>(options.metric)), "--threads", std::to_string(options.threads_per_shard)};
+        arguments.insert(arguments.end(), worker_arguments.begin(), worker_arguments.end());
+        std::vector<char*> argv;
+        for (std::string& argument : arguments)
+        {
+            argv.push_back(&argument[0]);
+        }
+        argv.push_back(nullptr);
+
+        // The workers' progress messages would repeat the coordinator's; errors still show
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        pid_t pid;
+        const int error = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (error != 0)
+        {
+            std::cerr << "Cannot start shard worker " << arguments[0] << ": " << std::strerror(error) << "." << std::endl;
+            stop_workers();
+            exit(1);
+        }
+        workers[s].pid = pid;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(options.startup_seconds);
+    for (size_t s = 0; s < options.shards; ++s)
+    {
+        shard& worker = workers[s];
+        while (!worker.channel)
+        {
+            const bool exited = waitpid(worker.pid, nullptr, WNOHANG) == worker.pid;
+            if (exited || std::chrono::steady_clock::now() >= deadline)
+            {
+                if (exited)
+                {
+                    worker.pid = -1; // Already reaped
+                }
+                std::cerr << "Shard worker " << s << " did not start." << std::endl;
+                stop_workers();
+                exit(1);
+            }
+            worker.channel = listeners[s]->accept(100);
+        }
+        shard_hello hello;
+        if (!worker.channel->receive_all(&hello, sizeof(hello)) || hello.magic != SHARD_MAGIC || hello.shard != s ||
+            (feature_count != 0 && hello.feature_count != feature_count))
+        {
+            std::cerr << "Shard worker " << s << " sent an invalid greeting." << std::endl;
+            stop_workers();
+            exit(1);
+        }
+        worker.rows = hello.rows;
+        feature_count = hello.feature_count;
+        training_rows += hello.rows;
+    }
+#endif
+}
+
+sharded_knn::~sharded_knn()
+{
+    stop_workers();
+}
+
+void sharded_knn::stop_workers()
+{
+#ifndef _WIN32
+    // A closed channel ends the worker's loop
+    for (shard& worker : workers)
+    {
+        if (worker.channel)
+        {
+            worker.channel->shutdown();
+            worker.channel.reset();
+        }
+        else if (worker.pid > 0)
+        {
+            kill(worker.pid, SIGTERM);
+        }
+    }
+    for (shard& worker : workers)
+    {
+        if (worker.pid > 0)
+        {
+            waitpid(worker.pid, nullptr, 0);
+            worker.pid = -1;
+        }
+    }
+#endif
+}
+
+neighbor_table sharded_knn::find_neighbors(span<const float> queries, size_t count, std::vector<int>& labels) const
+{
+    PROFILE_PHASE("sharded_search");
+    const size_t query_count = feature_count ? queries.size() / feature_count : 0;
+    neighbor_table result;
+    result.k = std::min(count, training_rows);
+    result.entries.resize(query_count * result.k);
+    labels.assign(query_count * result.k, -1);
+
+    std::vector<shard_reply> replies(workers.size());
+    std::vector<std::vector<neighbor>> shard_neighbors(workers.size());
+    std::vector<std::vector<int32_t>> shard_labels(workers.size());
+    for (size_t first = 0; first < query_count; first += options.batch_queries)
+    {
+        const size_t batch = std::min(options.batch_queries, query_count - first);
+
+        // Every worker gets the batch before any reply is read, so they all search at once
+        const shard_request request{SHARD_MAGIC, static_cast<uint32_t>(batch), count};
+        for (const shard& worker : workers)
+        {
+            if (!worker.channel->send_all(&request, sizeof(request)) ||
+                !worker.channel->send_all(queries.data() + first * feature_count, batch * feature_count * sizeof(float)))
+            {
+                std::cerr << "Lost the connection to a shard worker." << std::endl;
+                exit(1);
+            }
+        }
+        for (size_t s = 0; s < workers.size(); ++s)
+        {
+            shard_reply& reply = replies[s];
+            bool received = workers[s].channel->receive_all(&reply, sizeof(reply)) && reply.magic == SHARD_MAGIC &&
+                            reply.query_count == batch && reply.k <= count;
+            if (received)
+            {
+                shard_neighbors[s].resize(batch * reply.k);
+                shard_labels[s].resize(batch * reply.k);
+                received = workers[s].channel->receive_all(shard_neighbors[s].data(), shard_neighbors[s].size() * sizeof(neighbor)) &&
+                           workers[s].channel->receive_all(shard_labels[s].data(), shard_labels[s].size() * sizeof(int32_t));
+            }
+            if (!received)
+            {
+                std::cerr << "Shard worker " << s << " sent an invalid reply." << std::endl;
+                exit(1);
+            }
+        }
+
+        // k-way merge of the sorted lists of each query: a min-heap holds the next candidate of every shard
+        PROFILE_PHASE("shard_merge");
+        #pragma omp parallel for schedule(static)
+        for (long long q = 0; q < static_cast<long long>(batch); ++q)
+        {
+            struct cursor
+            {
+                neighbor candidate;
+                size_t shard;
+                size_t position;
+            };
+            const auto later = [](const cursor& a, const cursor& b) { return b.candidate < a.candidate; };
+            std::vector<cursor> heap;
+            heap.reserve(workers.size());
+            for (size_t s = 0; s < workers.size(); ++s)
+            {
+                if (replies[s].k > 0)
+                {
+                    heap.push_back({shard_neighbors[s][q * replies[s].k], s, 0});
+                }
+            }
+            std::make_heap(heap.begin(), heap.end(), later);
+
+            span<neighbor> merged = result.row(first + q);
+            int* merged_labels = labels.data() + (first + q) * result.k;
+            for (size_t r = 0; r < result.k && !heap.empty(); ++r)
+            {
+                std::pop_heap(heap.begin(), heap.end(), later);
+                cursor& next = heap.back();
+                merged[r] = next.candidate;
+                merged_labels[r] = shard_labels[next.shard][q * replies[next.shard].k + next.position];
+                if (++next.position < replies[next.shard].k)
+                {
+                    next.candidate = shard_neighbors[next.shard][q * replies[next.shard].k + next.position];
+                    std::push_heap(heap.begin(), heap.end(), later);
+                }
+                else
+                {
+                    heap.pop_back();
+                }
+            }
+        }
+    }
+    return result;
+}
+
+prediction_batch sharded_knn::predict_batch(span<const float> queries) const
+{
+    prediction_batch result;
+    std::vector<int> labels;
+    result.neighbors = find_neighbors(queries, static_cast<size_t>(std::max(k, 0)), labels);
+    const size_t query_count = result.neighbors.size();
+    result.labels.resize(query_count);
+    #pragma omp parallel for schedule(static)
+    for (long long q = 0; q < static_cast<long long>(query_count); ++q)
+    {
+        const int* row_labels = labels.data() + q * result.neighbors.k;
+        result.labels[q] = vote_labels(result.neighbors.row(q), [&](size_t i) { return row_labels[i]; }, options.metric, weighting);
+    }
+    return result;
+}
+
+bool parse_shard_worker_arguments(int argc, char** argv, int first, shard_worker_options& options)
+{
+    for (int i = first; i + 1 < argc; i += 2)
+    {
+        const std::string flag = argv[i];
+        const std::string value = argv[i + 1];
+        if (flag == "--address") options.address = value;
+        else if (flag == "--images") options.images = value;
+        else if (flag == "--labels") options.labels = value;
+        else if (flag == "--cache") options.cache = value;
+        else if (flag == "--shard") options.shard = std::stoul(value);
+        else if (flag == "--shards") options.shards = std::stoul(value);
+        else if (flag == "--metric") options.metric = static_cast<distance_metric>(std::stoi(value));
+        else if (flag == "--threads") options.threads = std::stoi(value);
+        else return false;
+    }
+    return !options.address.empty() && options.shard < options.shards;
+}
+
+int run_shard_worker(const shard_worker_options& options)
+{
+    data_handler dh;
+    dh.load_or_prepare(options.images, options.labels, options.cache);
+
+    // Contiguous slice of the training rows, which are ascending, so the slice is one region of the matrix
+    const std::vector<uint32_t>& training = dh.get_training_data().get_indices();
+    const size_t begin = training.size() * options.shard / options.shards;
+    const size_t end = training.size() * (options.shard + 1) / options.shards;
+    const dataset& data = dh.get_data_array();
+    KNN knn;
+    knn.set_metric(options.metric);
+    knn.set_thread_count(options.threads);
+    knn.set_training_data(dataset_view(&data, std::vector<uint32_t>(training.begin() + begin, training.begin() + end)));
+
+    std::unique_ptr<ipc_channel> channel = connect_ipc(options.address);
+    if (!channel)
+    {
+        return 1;
+    }
+    const size_t feature_count = data.get_normalized_feature_count();
+    const shard_hello hello{SHARD_MAGIC, static_cast<uint32_t>(options.shard), end - begin, feature_count};
+    if (!channel->send_all(&hello, sizeof(hello)))
+    {
+        return 1;
+    }
+
+    std::vector<float> queries;
+    std::vector<int32_t> labels;
+    shard_request request;
+    while (channel->receive_all(&request, sizeof(request)))
+    {
+        if (request.magic != SHARD_MAGIC)
+        {
+            std::cerr << "Shard worker " << options.shard << " received an invalid request." << std::endl;
+            return 1;
+        }
+        queries.resize(request.query_count * feature_count);
+        if (!channel->receive_all(queries.data(), queries.size() * sizeof(float)))
+        {
+            break;
+        }
+        const neighbor_table nearest = knn.find_neighbors(span<const float>(queries.data(), queries.size()), request.count);
+        labels.resize(nearest.entries.size());
+        for (size_t i = 0; i < labels.size(); ++i)
+        {
+            labels[i] = data.get_enumerated_label(nearest.entries[i].index);
+        }
+        const shard_reply reply{SHARD_MAGIC, request.query_count, nearest.k};
+        if (!channel->send_all(&reply, sizeof(reply)) ||
+            !channel->send_all(nearest.entries.data(), nearest.entries.size() * sizeof(neighbor)) ||
+            !channel->send_all(labels.data(), labels.size() * sizeof(int32_t)))
+        {
+            break;
+        }
+    }
+    return 0;
+}
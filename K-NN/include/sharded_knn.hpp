@@ -0,0 +1,95 @@
+#ifndef __SHARDED_KNN_HPP
+#define __SHARDED_KNN_HPP
+
+#include "knn.hpp"
+#include "../../include/ipc_channel.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+// KNN over a training set partitioned across worker processes. Each worker maps the prepared dataset
+// cache, takes a contiguous slice of the training rows (so it touches only its share of the matrix) and
+// answers batches of queries with the local nearest rows of its slice; the coordinator sends every
+// batch to all workers, and a k-way merge of their sorted lists yields the global nearest rows, the
+// same ones a single KNN over the whole training set finds. The workers run on one machine here, but
+// only talk to the coordinator through an ipc_channel.
+enum class shard_transport
+{
+    unix_socket,
+    shared_memory
+};
+
+struct shard_options
+{
+    size_t shards = 2;
+    shard_transport transport = shard_transport::unix_socket;
+    // Program, and its leading arguments, that hands the arguments after them to run_shard_worker
+    std::vector<std::string> worker_command;
+    // Files of the dataset every worker loads; the cache must already be prepared by load_or_prepare
+    // with the default normalization and split options, e.g. by the coordinator
+    std::string images, labels, cache;
+    distance_metric metric = distance_metric::squared_l2;
+    int threads_per_shard = 1;   // OpenMP threads of each worker, 0 for the default
+    size_t batch_queries = 1024; // Queries sent to the workers per round trip
+    int startup_seconds = 120;   // How long a worker may take to load its slice
+};
+
+class sharded_knn
+{
+    struct shard
+    {
+        int pid = -1;
+        std::unique_ptr<ipc_channel> channel;
+        size_t rows = 0;
+    };
+
+    std::vector<shard> workers;
+    shard_options options;
+    int k;
+    vote_weighting weighting;
+    size_t feature_count = 0; // Of the normalized rows every query must have
+    size_t training_rows = 0;
+
+    void stop_workers();
+
+public:
+    // Start options.shards workers and wait until each has loaded its slice; exits if one fails
+    sharded_knn(int k, const shard_options& options);
+    ~sharded_knn();
+
+    sharded_knn(const sharded_knn&) = delete;
+    sharded_knn& operator=(const sharded_knn&) = delete;
+
+    // The count nearest training rows of every query, stored as contiguous normalized rows, nearest
+    // first; labels receives the enumerated label of every entry in the same layout
+    neighbor_table find_neighbors(span<const float> queries, size_t count, std::vector<int>& labels) const;
+    // Labels and neighbors of every query, voted like KNN::predict_batch
+    prediction_batch predict_batch(span<const float> queries) const;
+
+    void set_k(int val) { k = val; }
+    void set_vote_weighting(vote_weighting w) { weighting = w; }
+    size_t shard_count() const { return workers.size(); }
+    size_t get_training_rows() const { return training_rows; }
+    size_t get_feature_count() const { return feature_count; }
+};
+
+// Settings of one worker, passed on its command line
+struct shard_worker_options
+{
+    std::string address; // Where the coordinator listens
+    std::string images, labels, cache;
+    size_t shard = 0;
+    size_t shards = 1;
+    distance_metric metric = distance_metric::squared_l2;
+    int threads = 1;
+};
+
+// Read the worker arguments that sharded_knn appends to worker_command, from argv[first] on; false if
+// they are missing or malformed
+bool parse_shard_worker_arguments(int argc, char** argv, int first, shard_worker_options& options);
+
+// Load the slice of the training rows, connect to the coordinator and answer its batches until it
+// closes the channel; returns the exit code for the worker process
+int run_shard_worker(const shard_worker_options& options);
+
+#endif // __SHARDED_KNN_HPP
@@ -0,0 +1,96 @@
+#ifndef __TOP_K_HPP
+#define __TOP_K_HPP
+
+#include "../../include/buffer.hpp" // For span
+#include <vector>
+#include <algorithm> // For std::push_heap and std::pop_heap
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+
+// A candidate neighbor: its distance to the query and its row in the dataset
+struct neighbor
+{
+    float distance;
+    uint32_t index;
+};
+
+// Nearer first; equal distances are ordered by row so results are deterministic
+inline bool operator<(const neighbor& a, const neighbor& b)
+{
+    return a.distance < b.distance || (a.distance == b.distance && a.index < b.index);
+}
+
+// The k nearest neighbors of each query of a batch, nearest first, stored as one row of k entries per query
+struct neighbor_table
+{
+    size_t k = 0;
+    std::vector<neighbor> entries;
+
+    size_t size() const { return k ? entries.size() / k : 0; }
+    span<const neighbor> row(size_t query) const { return {entries.data() + query * k, k}; }
+    span<neighbor> row(size_t query) { return {entries.data() + query * k, k}; }
+};
+
+// Keeps the k nearest candidates seen so far in a fixed-capacity max-heap, so a scan over N
+// points costs O(N log k) instead of sorting all N distances. The storage is reused across
+// reset() calls, so one instance per thread serves any number of queries without allocating.
+class top_k
+{
+    std::vector<neighbor> heap; // Max-heap on (distance, index); heap.front() is the current k-th best
+    size_t capacity = 0;
+
+public:
+    top_k() = default;
+    explicit top_k(size_t k) { reset(k); }
+
+    // Empty the buffer and set its capacity
+    void reset(size_t k)
+    {
+        heap.clear();
+        heap.reserve(k);
+        capacity = k;
+    }
+
+    size_t size() const { return heap.size(); }
+    bool full() const { return heap.size() == capacity; }
+
+    // Distance a candidate has to beat to enter; infinite until k candidates were seen
+    float threshold() const
+    {
+        return full() && capacity > 0 ? heap.front().distance : std::numeric_limits<float>::infinity();
+    }
+
+    // Offer a candidate; returns whether it was kept
+    bool push(float distance, uint32_t index)
+    {
+        if (capacity == 0)
+        {
+            return false;
+        }
+        neighbor candidate{distance, index};
+        if (!full())
+        {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end());
+            return true;
+        }
+        if (!(candidate < heap.front()))
+        {
+            return false;
+        }
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end());
+        return true;
+    }
+
+    // Sort the kept candidates nearest first; reset() must be called before pushing again
+    const std::vector<neighbor>& sorted()
+    {
+        std::sort_heap(heap.begin(), heap.end());
+        return heap;
+    }
+};
+
+#endif // __TOP_K_HPP
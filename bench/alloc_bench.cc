@@ -0,0 +1,222 @@
+// Heap allocations of a full dataset load: the original one-object-per-sample layout, where every image
+// owned its own feature, normalized and one-hot class vectors, against the arena-backed dataset with data
+// views. Global operator new is counted here, aligned_allocate by the library.
+// Usage: alloc_bench [images labels] [--repetitions R]; without files a synthetic MNIST-sized set is used
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../include/feature_stats.hpp"
+#include "../include/idx_file.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::atomic<size_t> new_calls{0};
+    std::atomic<size_t> new_bytes{0};
+
+    void* counted_allocate(size_t bytes, size_t alignment)
+    {
+        new_calls.fetch_add(1, std::memory_order_relaxed);
+        new_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        void* ptr = nullptr;
+        if (alignment <= alignof(std::max_align_t))
+        {
+            ptr = std::malloc(bytes ? bytes : 1);
+        }
+        else
+        {
+            ptr = std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+        }
+        if (!ptr)
+        {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+}
+
+void* operator new(size_t bytes) { return counted_allocate(bytes, 0); }
+void* operator new[](size_t bytes) { return counted_allocate(bytes, 0); }
+void* operator new(size_t bytes, std::align_val_t alignment) { return counted_allocate(bytes, static_cast<size_t>(alignment)); }
+void* operator new[](size_t bytes, std::align_val_t alignment) { return counted_allocate(bytes, static_cast<size_t>(alignment)); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+namespace
+{
+    // The sample class as it was before the dataset owned its storage: three vectors per image
+    struct legacy_sample
+    {
+        std::unique_ptr<std::vector<uint8_t>> feature_vector = std::make_unique<std::vector<uint8_t>>();
+        std::unique_ptr<std::vector<float>> normalized_feature_vector;
+        std::unique_ptr<std::vector<int>> class_vector;
+        uint8_t label = 0;
+        int enum_label = 0;
+    };
+
+    // The original combine_data, count_classes and normalize over per-sample objects
+    size_t load_legacy(const std::string& images, const std::string& labels)
+    {
+        idx_file image_file(images, idx_file::IMAGE_MAGIC);
+        idx_file label_file(labels, idx_file::LABEL_MAGIC);
+        const size_t n = image_file.get_count();
+        const size_t f = image_file.get_record_size();
+
+        std::vector<std::unique_ptr<legacy_sample>> samples;
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto sample = std::make_unique<legacy_sample>();
+            const uint8_t* row = image_file.data() + i * f;
+            sample->feature_vector->insert(sample->feature_vector->end(), row, row + f);
+            sample->label = label_file.data()[i];
+            samples.push_back(std::move(sample));
+        }
+
+        std::map<uint8_t, int> class_from_int;
+        for (auto& sample : samples)
+        {
+            sample->enum_label = class_from_int.try_emplace(sample->label, static_cast<int>(class_from_int.size())).first->second;
+        }
+        for (auto& sample : samples)
+        {
+            sample->class_vector = std::make_unique<std::vector<int>>(class_from_int.size(), 0);
+            sample->class_vector->at(sample->enum_label) = 1;
+        }
+
+        feature_stats statistics = compute_feature_stats({image_file.data(), n * f}, f);
+        std::vector<float> offset, scale;
+        statistics.scaling(normalization_method::z_score, offset, scale);
+        for (auto& sample : samples)
+        {
+            auto normalized = std::make_unique<std::vector<float>>(f);
+            for (size_t j = 0; j < f; ++j)
+            {
+                (*normalized)[j] = ((*sample->feature_vector)[j] - offset[j]) * scale[j];
+            }
+            sample->normalized_feature_vector = std::move(normalized);
+        }
+        return samples.size();
+    }
+
+    // The current path, touching every sample through its data view
+    size_t load_dataset(const std::string& images, const std::string& labels)
+    {
+        data_handler dh;
+        dh.read_feature_vector(images);
+        dh.read_feature_labels(labels);
+        dh.combine_data();
+        dh.count_classes();
+        dh.normalize();
+        dh.split_data();
+        const dataset& all = dh.get_data_array();
+        int hot = 0;
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            data sample = all.sample(i);
+            hot += sample.get_class_vector()[sample.get_enumerated_label()];
+        }
+        return static_cast<size_t>(hot);
+    }
+
+    struct null_buffer : std::streambuf
+    {
+        int overflow(int c) override { return c; }
+    };
+
+    struct load_result
+    {
+        size_t allocations = 0;
+        double megabytes = 0.0; // Requested through operator new; aligned_allocate is counted but not sized
+        double milliseconds = 0.0;
+        size_t samples = 0;
+    };
+
+    template <typename Load>
+    load_result measure(Load load, const std::string& images, const std::string& labels, size_t repetitions)
+    {
+        load_result best;
+        null_buffer sink;
+        for (size_t r = 0; r < repetitions; ++r)
+        {
+            std::streambuf* console = std::cout.rdbuf(&sink);
+            std::streambuf* errors = std::cerr.rdbuf(&sink);
+            const size_t calls = new_calls.load() + aligned_allocation_count();
+            const size_t bytes = new_bytes.load();
+            auto start = std::chrono::steady_clock::now();
+            size_t samples = load(images, labels);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout.rdbuf(console);
+            std::cerr.rdbuf(errors);
+            if (r == 0 || ms < best.milliseconds)
+            {
+                best.milliseconds = ms;
+            }
+            best.allocations = new_calls.load() + aligned_allocation_count() - calls;
+            best.megabytes = (new_bytes.load() - bytes) / double(1 << 20);
+            best.samples = samples;
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string images, labels;
+    size_t repetitions = 3;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--repetitions" && i + 1 < argc)
+        {
+            repetitions = std::stoul(argv[++i]);
+        }
+        else if (images.empty())
+        {
+            images = arg;
+        }
+        else
+        {
+            labels = arg;
+        }
+    }
+    if (labels.empty())
+    {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_alloc_bench";
+        std::filesystem::create_directories(dir);
+        images = (dir / "images.idx3-ubyte").string();
+        labels = (dir / "labels.idx1-ubyte").string();
+        if (!write_synthetic_idx(images, labels, 60000))
+        {
+            return 1;
+        }
+    }
+
+    const load_result legacy = measure(load_legacy, images, labels, repetitions);
+    const load_result current = measure(load_dataset, images, labels, repetitions);
+
+    std::cout << "Full load of " << legacy.samples << " samples, fastest of " << repetitions << " runs\n\n";
+    std::cout << std::left << std::setw(28) << "layout" << std::right << std::setw(16) << "allocations"
+              << std::setw(16) << "new MiB" << std::setw(12) << "ms" << "\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(28) << "per-sample objects" << std::right << std::setw(16) << legacy.allocations
+              << std::setw(16) << legacy.megabytes << std::setw(12) << legacy.milliseconds << "\n";
+    std::cout << std::left << std::setw(28) << "arena dataset + views" << std::right << std::setw(16) << current.allocations
+              << std::setw(16) << current.megabytes << std::setw(12) << current.milliseconds << "\n";
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Ball tree against the linear scan: build time, query latency, pruning ratio and exactness.
+// Usage: ball_tree_bench [images] [labels] [leaf_size] [k]
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/ball_tree.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::string images = argc > 1 ? argv[1] : "./data/train-images.idx3-ubyte";
+    const std::string labels = argc > 2 ? argv[2] : "./data/train-labels.idx1-ubyte";
+    const size_t leaf_size = argc > 3 ? std::stoul(argv[3]) : ball_tree::DEFAULT_LEAF_SIZE;
+    const size_t k = argc > 4 ? std::stoul(argv[4]) : 3;
+
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.count_classes();
+    dh.normalize();
+    dh.split_data();
+    const dataset_view& training = dh.get_training_data();
+    const dataset_view& queries = dh.get_test_data();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "metric      leaf  build_s  scan_us  tree_us  speedup  evaluated  pruned  nodes  mismatches\n";
+    for (distance_metric metric : {distance_metric::squared_l2, distance_metric::l1})
+    {
+        auto start = std::chrono::steady_clock::now();
+        ball_tree tree(training, metric, leaf_size);
+        double build_seconds = seconds_since(start);
+
+        KNN scan(static_cast<int>(k));
+        scan.set_metric(metric);
+        scan.set_training_data(training);
+
+        top_k expected, found;
+        search_stats stats;
+        double scan_seconds = 0.0, tree_seconds = 0.0;
+        size_t mismatches = 0;
+        for (size_t q = 0; q < queries.size(); ++q)
+        {
+            auto query = queries.normalized_row(q);
+
+            start = std::chrono::steady_clock::now();
+            scan.find_k_nearest_neighbors(query, expected);
+            scan_seconds += seconds_since(start);
+
+            start = std::chrono::steady_clock::now();
+            tree.search(query, k, found, stats);
+            tree_seconds += seconds_since(start);
+
+            const auto& a = expected.sorted();
+            const auto& b = found.sorted();
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                mismatches += i >= b.size() || a[i].index != b[i].index;
+            }
+        }
+
+        const double n = static_cast<double>(queries.size());
+        const double evaluated = static_cast<double>(stats.distance_evaluations) / n;
+        std::cout << std::left << std::setw(10) << (metric == distance_metric::l1 ? "l1" : "squared_l2") << std::right
+                  << std::setw(6) << leaf_size
+                  << std::setw(9) << build_seconds
+                  << std::setw(9) << scan_seconds / n * 1e6
+                  << std::setw(9) << tree_seconds / n * 1e6
+                  << std::setw(9) << scan_seconds / tree_seconds
+                  << std::setw(11) << std::setprecision(0) << evaluated << std::setprecision(3)
+                  << std::setw(8) << 1.0 - evaluated / static_cast<double>(training.size())
+                  << std::setw(7) << std::setprecision(0) << static_cast<double>(stats.nodes_visited) / n << std::setprecision(3)
+                  << std::setw(12) << mismatches << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+// The batch distance engine (KNN::predict_batch under squared L2) against the per-query scan
+// (KNN::find_k_nearest_neighbors) it replaces, for rows normalized at fp32, fp16 and bf16 and several k:
+// the time of each over the test set and a check of every neighbor list. Both lists are ordered by
+// (distance, row). The engine expands ||q - t||^2 as ||q||^2 - 2 q.t + ||t||^2, so its distances
+// differ from the scan's in the last bits; lists whose rows differ only among distances that are equal
+// within the tolerance (judged in double precision on the stored rows, widened) count as ties, anything
+// else as a mismatch. Exits with 1 on any mismatch.
+// Usage: batch_distance_bench [images] [labels] [queries] [tolerance]; without files a synthetic set is used
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const char* precision_name(feature_precision precision)
+    {
+        switch (precision)
+        {
+        case feature_precision::fp16:
+            return "fp16";
+        case feature_precision::bf16:
+            return "bf16";
+        default:
+            return "fp32";
+        }
+    }
+
+    // Squared L2 between the query and a training row as stored, widened to float, in double
+    double exact_distance(span<const float> query, const dataset& source, uint32_t row)
+    {
+        std::vector<float> stored(query.size());
+        source.widen_normalized_row(row, stored.data());
+        double sum = 0.0;
+        for (size_t f = 0; f < query.size(); ++f)
+        {
+            const double diff = static_cast<double>(query[f]) - stored[f];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    bool within(double a, double b, double tolerance)
+    {
+        return std::fabs(a - b) <= tolerance * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+    }
+
+    enum class comparison
+    {
+        equal,
+        tied,
+        mismatch
+    };
+
+    // Compares two neighbor lists of one query. Every reported distance must match the exact one; lists
+    // with different rows must agree position by position on the exact distances once both are ordered
+    // by (exact distance, row)
+    comparison compare(span<const neighbor> batch, span<const neighbor> scan, span<const float> query,
+                       const dataset& source, double tolerance)
+    {
+        if (batch.size() != scan.size())
+        {
+            return comparison::mismatch;
+        }
+        struct ranked
+        {
+            double exact;
+            uint32_t index;
+            bool operator<(const ranked& other) const
+            {
+                return exact < other.exact || (exact == other.exact && index < other.index);
+            }
+        };
+        std::vector<ranked> batch_ranked, scan_ranked;
+        bool same_rows = true;
+        for (size_t j = 0; j < batch.size(); ++j)
+        {
+            const double batch_exact = exact_distance(query, source, batch[j].index);
+            const double scan_exact = exact_distance(query, source, scan[j].index);
+            if (!within(batch[j].distance, batch_exact, tolerance) || !within(scan[j].distance, scan_exact, tolerance))
+            {
+                return comparison::mismatch;
+            }
+            batch_ranked.push_back({batch_exact, batch[j].index});
+            scan_ranked.push_back({scan_exact, scan[j].index});
+            same_rows = same_rows && batch[j].index == scan[j].index;
+        }
+        if (same_rows)
+        {
+            return comparison::equal;
+        }
+        std::sort(batch_ranked.begin(), batch_ranked.end());
+        std::sort(scan_ranked.begin(), scan_ranked.end());
+        for (size_t j = 0; j < batch_ranked.size(); ++j)
+        {
+            if (!within(batch_ranked[j].exact, scan_ranked[j].exact, tolerance))
+            {
+                return comparison::mismatch;
+            }
+        }
+        return comparison::tied;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string images = argc > 2 ? argv[1] : "";
+    std::string labels = argc > 2 ? argv[2] : "";
+    const size_t query_limit = argc > 3 ? std::stoul(argv[3]) : 1000;
+    const double tolerance = argc > 4 ? std::stod(argv[4]) : 1e-4;
+    if (images.empty())
+    {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_batch_distance_bench";
+        std::filesystem::create_directories(dir);
+        images = (dir / "images.idx3-ubyte").string();
+        labels = (dir / "labels.idx1-ubyte").string();
+        if (!write_synthetic_idx(images, labels, 12000))
+        {
+            return 1;
+        }
+    }
+
+    std::cout << std::fixed;
+    size_t total_mismatches = 0;
+    for (feature_precision precision : {feature_precision::fp32, feature_precision::fp16, feature_precision::bf16})
+    {
+        // Normalized at the precision, so the test rows used as queries are rounded like the training rows
+        data_handler dh;
+        dh.set_feature_precision(precision);
+        dh.read_feature_vector(images);
+        dh.read_feature_labels(labels);
+        dh.combine_data();
+        dh.count_classes();
+        dh.split_data();
+        dh.normalize();
+        const dataset_view& training = dh.get_training_data();
+        const dataset_view& all_test = dh.get_test_data();
+        std::vector<uint32_t> rows;
+        for (size_t q = 0; q < std::min(query_limit, all_test.size()); ++q)
+        {
+            rows.push_back(all_test.index(q));
+        }
+        const dataset_view test(all_test.get_source(), std::move(rows));
+        const dataset& source = *training.get_source();
+        const size_t width = training.get_normalized_feature_count();
+        std::vector<float> queries(test.size() * width);
+        for (size_t q = 0; q < test.size(); ++q)
+        {
+            test.widen_normalized_row(q, queries.data() + q * width);
+        }
+
+        std::cout << "\n" << test.size() << " queries against " << training.size() << " " << precision_name(precision)
+                  << " training rows, squared L2, kernels " << get_distance_kernels().isa << ", tolerance "
+                  << std::defaultfloat << tolerance << std::fixed << "\n";
+        std::cout << "precision   k  scan_s  batch_s  speedup   equal  tied  mismatches\n";
+        for (size_t k : {size_t(1), size_t(5), size_t(10)})
+        {
+            KNN knn(static_cast<int>(k));
+            knn.set_training_data(training);
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::vector<neighbor>> scanned(test.size());
+            top_k best;
+            for (size_t q = 0; q < test.size(); ++q)
+            {
+                knn.find_k_nearest_neighbors(span<const float>(queries.data() + q * width, width), best);
+                const std::vector<neighbor>& nearest = best.sorted();
+                scanned[q].assign(nearest.begin(), nearest.end());
+            }
+            const double scan_seconds = seconds_since(start);
+            start = std::chrono::steady_clock::now();
+            const prediction_batch batch = knn.predict_batch(test);
+            const double batch_seconds = seconds_since(start);
+
+            size_t counts[3] = {0, 0, 0};
+            for (size_t q = 0; q < test.size(); ++q)
+            {
+                const span<const neighbor> scan_row(scanned[q].data(), scanned[q].size());
+                const span<const float> query(queries.data() + q * width, width);
+                ++counts[static_cast<int>(compare(batch.neighbors.row(q), scan_row, query, source, tolerance))];
+            }
+            total_mismatches += counts[static_cast<int>(comparison::mismatch)];
+            std::cout << std::left << std::setw(9) << precision_name(precision) << std::right << std::setw(4) << k
+                      << std::setprecision(3) << std::setw(8) << scan_seconds << std::setw(9) << batch_seconds
+                      << std::setprecision(2) << std::setw(9) << scan_seconds / batch_seconds << std::setw(8)
+                      << counts[static_cast<int>(comparison::equal)] << std::setw(6) << counts[static_cast<int>(comparison::tied)]
+                      << std::setw(12) << counts[static_cast<int>(comparison::mismatch)] << "\n";
+        }
+    }
+    return total_mismatches == 0 ? 0 : 1;
+}
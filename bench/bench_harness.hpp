@@ -0,0 +1,165 @@
+#ifndef __BENCH_HARNESS_HPP
+#define __BENCH_HARNESS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Minimal harness for the micro benchmarks. An operation is timed over several samples of enough
+// iterations to last a minimum time each, after one untimed warm-up call; results are printed as a
+// table and can be written as CSV so runs can be diffed.
+struct bench_options
+{
+    size_t samples = 10;                // Timed samples per benchmark
+    double min_sample_seconds = 0.05;   // Iterations per sample are chosen to last at least this long
+};
+
+struct bench_result
+{
+    std::string name;
+    size_t iterations = 0;   // Operations per sample
+    size_t samples = 0;
+    double mean_ns = 0.0;    // Per operation, averaged over the samples
+    double stddev_ns = 0.0;  // Between samples
+    double min_ns = 0.0;
+    double bytes_per_op = 0.0;
+
+    double bytes_per_second() const { return mean_ns > 0.0 ? bytes_per_op / (mean_ns * 1e-9) : 0.0; }
+};
+
+// Keeps the compiler from discarding a computed value
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+class bench_suite
+{
+    bench_options options;
+    std::vector<bench_result> results;
+
+    // Swallows the progress messages the library prints to std::cout while an operation is timed
+    struct null_buffer : std::streambuf
+    {
+        int overflow(int c) override { return c; }
+    };
+
+    using clock = std::chrono::steady_clock;
+
+public:
+    explicit bench_suite(bench_options opts = {}) : options(opts) {}
+
+    // Time body. Without setup, the iterations of a sample are timed as one batch; with setup, setup runs
+    // untimed before every call of body and each call is timed on its own.
+    const bench_result& run(const std::string& name, double bytes_per_op, const std::function<void()>& body,
+                            const std::function<void()>& setup = nullptr)
+    {
+        null_buffer sink;
+        std::streambuf* console = std::cout.rdbuf(&sink);
+
+        // One timed call of body, or of n calls of body
+        auto timed = [&](size_t n) {
+            double seconds = 0.0;
+            if (setup)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    setup();
+                    auto start = clock::now();
+                    body();
+                    seconds += std::chrono::duration<double>(clock::now() - start).count();
+                }
+                return seconds;
+            }
+            auto start = clock::now();
+            for (size_t i = 0; i < n; ++i)
+            {
+                body();
+            }
+            return std::chrono::duration<double>(clock::now() - start).count();
+        };
+
+        // The warm-up call also calibrates the iterations per sample
+        const double once = std::max(timed(1), 1e-9);
+        bench_result result;
+        result.name = name;
+        result.bytes_per_op = bytes_per_op;
+        result.samples = options.samples;
+        result.iterations = std::max<size_t>(1, static_cast<size_t>(options.min_sample_seconds / once));
+
+        std::vector<double> per_op(options.samples);
+        for (double& ns : per_op)
+        {
+            ns = timed(result.iterations) * 1e9 / static_cast<double>(result.iterations);
+        }
+        std::cout.rdbuf(console);
+
+        double sum = 0.0;
+        for (double ns : per_op)
+        {
+            sum += ns;
+        }
+        result.mean_ns = sum / per_op.size();
+        double squares = 0.0;
+        for (double ns : per_op)
+        {
+            squares += (ns - result.mean_ns) * (ns - result.mean_ns);
+        }
+        result.stddev_ns = per_op.size() > 1 ? std::sqrt(squares / (per_op.size() - 1)) : 0.0;
+        result.min_ns = *std::min_element(per_op.begin(), per_op.end());
+        results.push_back(result);
+        return results.back();
+    }
+
+    void print(std::ostream& out) const
+    {
+        out << std::left << std::setw(30) << "benchmark" << std::right << std::setw(10) << "iters"
+            << std::setw(16) << "ns/op" << std::setw(10) << "+/- %" << std::setw(16) << "min ns/op" << std::setw(12) << "MB/s" << "\n";
+        for (const bench_result& r : results)
+        {
+            out << std::left << std::setw(30) << r.name << std::right << std::setw(10) << r.iterations
+                << std::fixed << std::setprecision(1)
+                << std::setw(16) << r.mean_ns
+                << std::setw(10) << (r.mean_ns > 0.0 ? 100.0 * r.stddev_ns / r.mean_ns : 0.0)
+                << std::setw(16) << r.min_ns;
+            if (r.bytes_per_op > 0.0)
+            {
+                out << std::setw(12) << r.bytes_per_second() / 1e6;
+            }
+            else
+            {
+                out << std::setw(12) << "-";
+            }
+            out << std::defaultfloat << "\n";
+        }
+    }
+
+    // One row per benchmark: name,iterations,samples,mean_ns,stddev_ns,min_ns,bytes_per_op,bytes_per_second
+    bool write_csv(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cerr << "Could not write benchmark results: " << path << std::endl;
+            return false;
+        }
+        out << "name,iterations,samples,mean_ns,stddev_ns,min_ns,bytes_per_op,bytes_per_second\n";
+        out << std::setprecision(10);
+        for (const bench_result& r : results)
+        {
+            out << r.name << "," << r.iterations << "," << r.samples << "," << r.mean_ns << "," << r.stddev_ns << ","
+                << r.min_ns << "," << r.bytes_per_op << "," << r.bytes_per_second() << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+};
+
+#endif // __BENCH_HARNESS_HPP
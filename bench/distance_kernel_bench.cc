@@ -0,0 +1,254 @@
+// Distance kernels of every instruction set the CPU supports, checked and timed. Every set's float
+// squared-L2, L1 and cosine kernels, plain and bounded, are compared with a double-precision reference
+// (for squared L2 the sum KNN::calculate_distance used to take the root of) on random rows of every
+// length up to max_length, so each vector body and tail is covered. Over the same lengths, from aligned
+// and unaligned starts, the integer kernels on uint8 rows must equal a 64-bit reference exactly (also
+// for the widest rows they support, at the largest difference) and the weighted ones stay within the
+// tolerance. Then the time per 784-feature distance of every float kernel. Exits with 1 on any failure.
+// Usage: distance_kernel_bench [max_length] [tolerance]
+#include "../K-NN/include/distance.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const distance_metric METRICS[] = {distance_metric::squared_l2, distance_metric::l1, distance_metric::cosine};
+
+    const char* metric_name(distance_metric metric)
+    {
+        switch (metric)
+        {
+        case distance_metric::l1:
+            return "l1";
+        case distance_metric::cosine:
+            return "cosine";
+        default:
+            return "squared_l2";
+        }
+    }
+
+    double reference_distance(const float* a, const float* b, size_t n, distance_metric metric)
+    {
+        double sum = 0.0, dot = 0.0, norm_a = 0.0, norm_b = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double diff = static_cast<double>(a[i]) - static_cast<double>(b[i]);
+            sum += metric == distance_metric::l1 ? std::fabs(diff) : diff * diff;
+            dot += static_cast<double>(a[i]) * b[i];
+            norm_a += static_cast<double>(a[i]) * a[i];
+            norm_b += static_cast<double>(b[i]) * b[i];
+        }
+        if (metric != distance_metric::cosine)
+        {
+            return sum;
+        }
+        // As the kernels do, a zero row is at distance 1 from everything
+        return norm_a == 0.0 || norm_b == 0.0 ? 1.0 : 1.0 - dot / std::sqrt(norm_a * norm_b);
+    }
+
+    // Sums of non-negative terms are compared relative to their size; the cosine distance, which
+    // lies in [0, 2], absolutely
+    bool close(double actual, double expected, distance_metric metric, double tolerance)
+    {
+        const double scale = metric == distance_metric::cosine ? 1.0 : std::max(1.0, std::fabs(expected));
+        return std::fabs(actual - expected) <= tolerance * scale;
+    }
+
+    // A bounded result must be exact when the distance is within the bound; above it, the kernel
+    // may stop early with any partial sum past the bound that does not exceed the distance.
+    // Bounded cosine ignores the bound and is always exact.
+    bool bounded_ok(double actual, double expected, double bound, distance_metric metric, double tolerance)
+    {
+        if (close(actual, expected, metric, tolerance))
+        {
+            return true;
+        }
+        return metric != distance_metric::cosine && expected > bound && actual > bound &&
+               actual <= expected + tolerance * std::max(1.0, expected);
+    }
+
+    // Integer and weighted distances of uint8 rows, summed exactly in 64 bits and in double
+    uint64_t reference_integer(const uint8_t* a, const uint8_t* b, size_t n, distance_metric metric)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const int64_t diff = static_cast<int64_t>(a[i]) - b[i];
+            sum += static_cast<uint64_t>(metric == distance_metric::l1 ? std::abs(diff) : diff * diff);
+        }
+        return sum;
+    }
+
+    double reference_weighted(const uint8_t* a, const uint8_t* b, const float* weights, size_t n, distance_metric metric)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const double diff = static_cast<double>(a[i]) - b[i];
+            sum += weights[i] * (metric == distance_metric::l1 ? std::fabs(diff) : diff * diff);
+        }
+        return sum;
+    }
+
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t max_length = argc > 1 ? std::stoul(argv[1]) : 2000;
+    const double tolerance = argc > 2 ? std::stod(argv[2]) : 1e-5;
+    const std::vector<const distance_kernels*> sets = get_available_distance_kernels();
+
+    std::mt19937 rng(3);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> a(max_length), b(max_length);
+    std::vector<size_t> failures(sets.size());
+    std::vector<double> worst(sets.size());
+    for (size_t n = 0; n <= max_length; ++n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            a[i] = normal(rng);
+            b[i] = normal(rng);
+        }
+        for (distance_metric metric : METRICS)
+        {
+            const double expected = reference_distance(a.data(), b.data(), n, metric);
+            // No bound, one the distance is well within and one it passes halfway
+            const float bounds[] = {std::numeric_limits<float>::infinity(), static_cast<float>(expected * 2.0 + 1.0),
+                                    static_cast<float>(expected * 0.5)};
+            for (size_t s = 0; s < sets.size(); ++s)
+            {
+                const double actual = sets[s]->get(metric)(a.data(), b.data(), n);
+                const double scale = metric == distance_metric::cosine ? 1.0 : std::max(1.0, std::fabs(expected));
+                worst[s] = std::max(worst[s], std::fabs(actual - expected) / scale);
+                bool ok = close(actual, expected, metric, tolerance);
+                for (float bound : bounds)
+                {
+                    ok = ok && bounded_ok(sets[s]->get_bounded(metric)(a.data(), b.data(), n, bound), expected, bound, metric, tolerance);
+                }
+                if (!ok && failures[s]++ < 5)
+                {
+                    std::cout << sets[s]->isa << " " << metric_name(metric) << " n = " << n << ": " << actual
+                              << " instead of " << expected << "\n";
+                }
+            }
+        }
+    }
+
+    // Integer and weighted kernels: uint8 rows at offset 0 and at offsets that walk every alignment
+    const size_t SLACK = 64;
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_real_distribution<float> weight(0.0f, 2.0f);
+    std::vector<uint8_t> ia(max_length + SLACK), ib(max_length + SLACK);
+    std::vector<float> weights(max_length + SLACK);
+    std::vector<double> worst_weighted(sets.size());
+    for (size_t n = 0; n <= max_length; ++n)
+    {
+        for (size_t i = 0; i < n + SLACK; ++i)
+        {
+            ia[i] = static_cast<uint8_t>(byte(rng));
+            ib[i] = static_cast<uint8_t>(byte(rng));
+            weights[i] = weight(rng);
+        }
+        const size_t offsets[][2] = {{0, 0}, {n % SLACK, (n * 7 + 1) % SLACK}};
+        for (const auto& offset : offsets)
+        {
+            const uint8_t* a_row = ia.data() + offset[0];
+            const uint8_t* b_row = ib.data() + offset[1];
+            const float* w = weights.data() + offset[1];
+            for (distance_metric metric : {distance_metric::squared_l2, distance_metric::l1})
+            {
+                const uint64_t expected = reference_integer(a_row, b_row, n, metric);
+                const double expected_weighted = reference_weighted(a_row, b_row, w, n, metric);
+                for (size_t s = 0; s < sets.size(); ++s)
+                {
+                    const uint64_t actual = sets[s]->get_integer(metric)(a_row, b_row, n);
+                    const double actual_weighted = sets[s]->get_weighted(metric)(a_row, b_row, w, n);
+                    worst_weighted[s] = std::max(worst_weighted[s], std::fabs(actual_weighted - expected_weighted) / std::max(1.0, expected_weighted));
+                    const bool ok = actual == expected && close(actual_weighted, expected_weighted, metric, tolerance);
+                    if (!ok && failures[s]++ < 5)
+                    {
+                        std::cout << sets[s]->isa << " integer " << metric_name(metric) << " n = " << n << " at offsets "
+                                  << offset[0] << ", " << offset[1] << ": " << actual << " and " << actual_weighted
+                                  << " instead of " << expected << " and " << expected_weighted << "\n";
+                    }
+                }
+            }
+        }
+    }
+    // The widest rows at the largest difference: squared L2 comes within 1021 of the uint32_t range
+    const std::vector<uint8_t> zeros(MAX_INTEGER_FEATURES, 0), full(MAX_INTEGER_FEATURES, 255);
+    for (distance_metric metric : {distance_metric::squared_l2, distance_metric::l1})
+    {
+        const uint64_t expected = reference_integer(zeros.data(), full.data(), MAX_INTEGER_FEATURES, metric);
+        for (size_t s = 0; s < sets.size(); ++s)
+        {
+            const uint64_t actual = sets[s]->get_integer(metric)(zeros.data(), full.data(), MAX_INTEGER_FEATURES);
+            if (actual != expected && failures[s]++ < 5)
+            {
+                std::cout << sets[s]->isa << " integer " << metric_name(metric) << " n = " << MAX_INTEGER_FEATURES << ": "
+                          << actual << " instead of " << expected << "\n";
+            }
+        }
+    }
+
+    // Time per distance: one query against a block of rows, so the loads come from cache
+    const size_t width = 784, rows = 512, repeats = 200;
+    std::vector<float> query(width), block(rows * width);
+    for (float& x : query)
+    {
+        x = normal(rng);
+    }
+    for (float& x : block)
+    {
+        x = normal(rng);
+    }
+
+    std::cout << "lengths 0 to " << max_length << ", tolerance " << tolerance << "; ns per distance at " << width << " features\n";
+    std::cout << "isa          max_error  weighted_error  failures  squared_l2      l1  cosine\n";
+    std::cout << std::fixed;
+    size_t total_failures = 0;
+    for (size_t s = 0; s < sets.size(); ++s)
+    {
+        total_failures += failures[s];
+        std::cout << std::left << std::setw(11) << sets[s]->isa << std::right << std::scientific << std::setprecision(2)
+                  << std::setw(11) << worst[s] << std::setw(16) << worst_weighted[s] << std::fixed << std::setw(10) << failures[s];
+        for (distance_metric metric : METRICS)
+        {
+            const distance_kernel kernel = sets[s]->get(metric);
+            double best = 0.0;
+            for (int run = 0; run < 3; ++run)
+            {
+                float sink = 0.0f;
+                const auto start = std::chrono::steady_clock::now();
+                for (size_t r = 0; r < repeats; ++r)
+                {
+                    for (size_t row = 0; row < rows; ++row)
+                    {
+                        sink += kernel(query.data(), block.data() + row * width, width);
+                    }
+                }
+                const double seconds = seconds_since(start);
+                // Keep the sum alive so the calls are not dropped
+                asm volatile("" : : "g"(sink) : "memory");
+                best = run == 0 ? seconds : std::min(best, seconds);
+            }
+            std::cout << std::setprecision(1) << std::setw(metric == distance_metric::squared_l2 ? 12 : 8)
+                      << best * 1e9 / (repeats * rows);
+        }
+        std::cout << "\n";
+    }
+    return total_failures == 0 ? 0 : 1;
+}
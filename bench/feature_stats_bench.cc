@@ -0,0 +1,182 @@
+// The normalization statistics pass (compute_feature_stats) checked and timed. For row counts around the
+// chunk size and feature counts with odd tails, random uint8 rows give per-feature mean, M2, minimum and
+// maximum that must be bit-identical on one thread and on several, and when fed in batches to
+// accumulate_feature_stats; they must also match a serial two-pass double-precision reference within the
+// tolerance. Last, data_handler::normalize(min_max) on a synthetic set must map every feature into [0, 1]
+// with its minimum at 0 and its maximum at 1 (to one float rounding). Exits with 1 on any failure.
+// Usage: feature_stats_bench [threads] [tolerance]
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../include/feature_stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <omp.h> // For OpenMP
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool same_bits(const std::vector<double>& a, const std::vector<double>& b)
+    {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+    }
+
+    bool identical(const feature_stats& a, const feature_stats& b)
+    {
+        return a.count == b.count && same_bits(a.mean, b.mean) && same_bits(a.m2, b.m2) && a.minimum == b.minimum &&
+               a.maximum == b.maximum;
+    }
+
+    feature_stats timed_stats(const std::vector<uint8_t>& rows, size_t feature_count, int threads, double& seconds)
+    {
+        omp_set_num_threads(threads);
+        const auto start = std::chrono::steady_clock::now();
+        feature_stats stats = compute_feature_stats({rows.data(), rows.size()}, feature_count);
+        seconds = seconds_since(start);
+        return stats;
+    }
+
+    // Largest error of the statistics against a serial two-pass reference: the mean from the exact sum,
+    // then M2 as the sum of squared deviations from it, relative to max(1, |reference|). Minimum and
+    // maximum must be equal; a difference there counts as an infinite error.
+    double reference_error(const std::vector<uint8_t>& rows, size_t feature_count, const feature_stats& stats)
+    {
+        const size_t row_count = rows.size() / feature_count;
+        double worst = stats.count == row_count ? 0.0 : INFINITY;
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            double sum = 0.0;
+            uint8_t minimum = UINT8_MAX, maximum = 0;
+            for (size_t r = 0; r < row_count; ++r)
+            {
+                const uint8_t x = rows[r * feature_count + j];
+                sum += x;
+                minimum = std::min(minimum, x);
+                maximum = std::max(maximum, x);
+            }
+            const double mean = sum / row_count;
+            double m2 = 0.0;
+            for (size_t r = 0; r < row_count; ++r)
+            {
+                const double diff = rows[r * feature_count + j] - mean;
+                m2 += diff * diff;
+            }
+            worst = std::max(worst, std::fabs(stats.mean[j] - mean) / std::max(1.0, std::fabs(mean)));
+            worst = std::max(worst, std::fabs(stats.m2[j] - m2) / std::max(1.0, m2));
+            if (stats.minimum[j] != minimum || stats.maximum[j] != maximum)
+            {
+                worst = INFINITY;
+            }
+        }
+        return worst;
+    }
+
+    // Failed features of a min-max normalized dataset: any value outside [0, 1], a minimum other than 0,
+    // or, for a feature with a spread, a maximum more than one rounding of (max - min) / spread below 1
+    size_t check_min_max(const dataset& data)
+    {
+        const size_t feature_count = data.get_normalized_feature_count();
+        std::vector<float> lowest(feature_count, INFINITY), highest(feature_count, -INFINITY);
+        std::vector<uint8_t> spread(feature_count, 0);
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            const span<const float> row = data.normalized_row(i);
+            const span<const uint8_t> raw = data.raw_row(i);
+            for (size_t j = 0; j < feature_count; ++j)
+            {
+                lowest[j] = std::min(lowest[j], row[j]);
+                highest[j] = std::max(highest[j], row[j]);
+                spread[j] |= raw[j] != data.raw_row(0)[j];
+            }
+        }
+        size_t failures = 0;
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            const float top = spread[j] ? 1.0f - std::ldexp(1.0f, -24) : 0.0f;
+            failures += lowest[j] != 0.0f || highest[j] > 1.0f || highest[j] < top;
+        }
+        return failures;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int threads = argc > 1 ? std::stoi(argv[1]) : std::max(4, omp_get_max_threads());
+    const double tolerance = argc > 2 ? std::stod(argv[2]) : 1e-12;
+
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::cout << "1 against " << threads << " threads, chunks of " << FEATURE_STATS_CHUNK << " rows, tolerance " << tolerance << "\n";
+    std::cout << "   rows  features  serial_ms  parallel_ms  identical  batched  max_error\n";
+    std::cout << std::fixed;
+    size_t failures = 0;
+    const size_t ROW_COUNTS[] = {1, FEATURE_STATS_CHUNK - 1, FEATURE_STATS_CHUNK + 1, 3 * FEATURE_STATS_CHUNK + 7, 60000};
+    for (size_t row_count : ROW_COUNTS)
+    {
+        for (size_t feature_count : {size_t(3), size_t(784)})
+        {
+            // Each feature draws from its own range, so means and spreads differ between features
+            std::vector<uint8_t> rows(row_count * feature_count);
+            for (size_t r = 0; r < row_count; ++r)
+            {
+                for (size_t j = 0; j < feature_count; ++j)
+                {
+                    rows[r * feature_count + j] = static_cast<uint8_t>(byte(rng) % (j % 255 + 2));
+                }
+            }
+
+            double serial_seconds = 0.0, parallel_seconds = 0.0;
+            const feature_stats serial = timed_stats(rows, feature_count, 1, serial_seconds);
+            const feature_stats parallel = timed_stats(rows, feature_count, threads, parallel_seconds);
+            const bool same = identical(serial, parallel);
+
+            // Batches of two chunks, as a streaming reader would feed them
+            feature_stats batched;
+            batched.reset(feature_count);
+            const size_t batch_bytes = 2 * FEATURE_STATS_CHUNK * feature_count;
+            for (size_t offset = 0; offset < rows.size(); offset += batch_bytes)
+            {
+                accumulate_feature_stats(batched, {rows.data() + offset, std::min(batch_bytes, rows.size() - offset)}, feature_count);
+            }
+            const bool batch_same = identical(serial, batched);
+
+            const double error = reference_error(rows, feature_count, serial);
+            failures += !same + !batch_same + !(error <= tolerance);
+            std::cout << std::setw(7) << row_count << std::setw(10) << feature_count << std::setprecision(2)
+                      << std::setw(11) << serial_seconds * 1e3 << std::setw(13) << parallel_seconds * 1e3
+                      << std::setw(11) << (same ? "yes" : "NO") << std::setw(9) << (batch_same ? "yes" : "NO")
+                      << std::scientific << std::setw(11) << error << std::fixed << "\n";
+        }
+    }
+    omp_set_num_threads(threads);
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_feature_stats_bench";
+    std::filesystem::create_directories(dir);
+    const std::string images = (dir / "images.idx3-ubyte").string();
+    const std::string labels = (dir / "labels.idx1-ubyte").string();
+    if (!write_synthetic_idx(images, labels, 6000))
+    {
+        return 1;
+    }
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.normalize(normalization_method::min_max);
+    const size_t min_max_failures = check_min_max(dh.get_data_array());
+    failures += min_max_failures;
+    std::cout << "min-max normalization into [0, 1]: " << (min_max_failures == 0 ? "ok" : "FAILED") << " ("
+              << min_max_failures << " features out of range)\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// Per-query latency of the compile-time specialized KNN (fixed_knn.hpp) against the generic runtime
+// path, for every metric and k = 1, 5 and 10, on the 784 normalized pixels and on 50 principal
+// components: KNN::predict scanning with the runtime kernels, the same KNN with the index returned by
+// make_fixed_scan_index(), and fixed_knn called directly. Both specialized paths are checked against
+// the generic predictions, and fixed_knn::predict_batch against KNN::predict_batch.
+// Usage: fixed_knn_bench [images] [labels] [queries]; without files a synthetic set is used
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/fixed_knn.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const char* metric_name(distance_metric metric)
+    {
+        switch (metric)
+        {
+        case distance_metric::l1:
+            return "l1";
+        case distance_metric::cosine:
+            return "cosine";
+        default:
+            return "squared_l2";
+        }
+    }
+
+    // Labels of the queries from fixed_knn<Dim, K, Metric>::predict, one query at a time
+    template <size_t Dim, size_t K, distance_metric Metric>
+    std::vector<int> predict_fixed(const dataset_view& training, span<const float> queries)
+    {
+        const fixed_knn<Dim, K, Metric> model(training);
+        std::vector<int> labels(queries.size() / Dim);
+        for (size_t q = 0; q < labels.size(); ++q)
+        {
+            labels[q] = model.predict(queries.data() + q * Dim);
+        }
+        return labels;
+    }
+
+    template <size_t Dim, size_t K>
+    std::vector<int> predict_fixed(const dataset_view& training, span<const float> queries, distance_metric metric)
+    {
+        switch (metric)
+        {
+        case distance_metric::l1:
+            return predict_fixed<Dim, K, distance_metric::l1>(training, queries);
+        case distance_metric::cosine:
+            return predict_fixed<Dim, K, distance_metric::cosine>(training, queries);
+        default:
+            return predict_fixed<Dim, K, distance_metric::squared_l2>(training, queries);
+        }
+    }
+
+    template <size_t Dim>
+    std::vector<int> predict_fixed(const dataset_view& training, span<const float> queries, size_t k, distance_metric metric)
+    {
+        switch (k)
+        {
+        case 1:
+            return predict_fixed<Dim, 1>(training, queries, metric);
+        case 5:
+            return predict_fixed<Dim, 5>(training, queries, metric);
+        default:
+            return predict_fixed<Dim, 10>(training, queries, metric);
+        }
+    }
+
+    // Fastest of runs calls of run, in seconds, to keep the noise of a shared machine out of the table
+    template <typename Run>
+    double best_seconds(int runs, Run run)
+    {
+        double best = 0.0;
+        for (int r = 0; r < runs; ++r)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            run();
+            const double seconds = seconds_since(start);
+            best = r == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    }
+
+    size_t count_mismatches(const std::vector<int>& expected, const std::vector<int>& actual)
+    {
+        size_t mismatches = 0;
+        for (size_t q = 0; q < expected.size(); ++q)
+        {
+            mismatches += expected[q] != actual[q];
+        }
+        return mismatches;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string images = argc > 2 ? argv[1] : "";
+    std::string labels = argc > 2 ? argv[2] : "";
+    const size_t query_limit = argc > 3 ? std::stoul(argv[3]) : 200;
+    const int RUNS = 3;
+    if (images.empty())
+    {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_fixed_knn_bench";
+        std::filesystem::create_directories(dir);
+        images = (dir / "images.idx3-ubyte").string();
+        labels = (dir / "labels.idx1-ubyte").string();
+        if (!write_synthetic_idx(images, labels, 10000))
+        {
+            return 1;
+        }
+    }
+
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.count_classes();
+    dh.split_data();
+    const dataset_view& training = dh.get_training_data();
+    const dataset_view& test = dh.get_test_data();
+    const size_t query_count = std::min(query_limit, test.size());
+
+    std::cout << "\n" << query_count << " queries against " << training.size() << " training rows, one thread\n";
+    std::cout << std::fixed;
+    size_t total_mismatches = 0;
+    for (size_t dims : {size_t(784), size_t(50)})
+    {
+        dh.normalize();
+        if (dims < dh.get_data_array().get_normalized_feature_count())
+        {
+            dh.reduce_dimensions(dims);
+        }
+        if (training.get_normalized_feature_count() != dims)
+        {
+            continue;
+        }
+        std::vector<float> queries;
+        queries.reserve(query_count * dims);
+        for (size_t q = 0; q < query_count; ++q)
+        {
+            const span<const float> row = test.normalized_row(q);
+            queries.insert(queries.end(), row.begin(), row.end());
+        }
+        const span<const float> query_rows(queries.data(), queries.size());
+
+        std::cout << "\n" << dims << " features\n";
+        std::cout << "metric       k  generic_us  facade_us  speedup  direct_us  batch_generic_s  batch_fixed_s  mismatches\n";
+        for (distance_metric metric : {distance_metric::squared_l2, distance_metric::l1, distance_metric::cosine})
+        {
+            for (size_t k : {size_t(1), size_t(5), size_t(10)})
+            {
+                KNN knn(static_cast<int>(k));
+                knn.set_metric(metric);
+                knn.set_thread_count(1);
+                knn.set_training_data(training);
+
+                std::vector<int> generic(query_count), facade(query_count), direct;
+                prediction_batch generic_batch, fixed_batch;
+                const double generic_seconds = best_seconds(RUNS, [&] {
+                    for (size_t q = 0; q < query_count; ++q)
+                    {
+                        generic[q] = knn.predict(span<const float>(queries.data() + q * dims, dims));
+                    }
+                });
+                const double generic_batch_seconds = best_seconds(RUNS, [&] { generic_batch = knn.predict_batch(query_rows); });
+
+                knn.set_search_index(make_fixed_scan_index(training, k, metric));
+                const double facade_seconds = best_seconds(RUNS, [&] {
+                    for (size_t q = 0; q < query_count; ++q)
+                    {
+                        facade[q] = knn.predict(span<const float>(queries.data() + q * dims, dims));
+                    }
+                });
+                // With the index set, predict_batch runs every query through the specialized scan
+                const double fixed_batch_seconds = best_seconds(RUNS, [&] { fixed_batch = knn.predict_batch(query_rows); });
+
+                // Includes packing the training rows, as fixed_knn is built from the view each time
+                const double direct_seconds = best_seconds(RUNS, [&] {
+                    direct = dims == 784 ? predict_fixed<784>(training, query_rows, k, metric)
+                                         : predict_fixed<50>(training, query_rows, k, metric);
+                });
+
+                const size_t mismatches = count_mismatches(generic, facade) + count_mismatches(generic, direct) +
+                                          count_mismatches(generic_batch.labels, fixed_batch.labels);
+                total_mismatches += mismatches;
+                std::cout << std::left << std::setw(11) << metric_name(metric) << std::right << std::setw(3) << k
+                          << std::setprecision(1) << std::setw(12) << generic_seconds * 1e6 / query_count
+                          << std::setw(11) << facade_seconds * 1e6 / query_count << std::setprecision(2)
+                          << std::setw(9) << generic_seconds / facade_seconds << std::setprecision(1) << std::setw(11)
+                          << direct_seconds * 1e6 / query_count << std::setprecision(3) << std::setw(17)
+                          << generic_batch_seconds << std::setw(15) << fixed_batch_seconds << std::setw(12)
+                          << mismatches << "\n";
+            }
+        }
+    }
+    return total_mismatches == 0 ? 0 : 1;
+}
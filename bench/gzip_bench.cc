@@ -0,0 +1,68 @@
+// Loading gzip-compressed IDX files against uncompressed memory-mapped ones: time to a ready idx_file with
+// every byte touched, and a full streaming ingestion pass from each.
+// Usage: gzip_bench images labels images.gz labels.gz
+#include "../include/idx_file.hpp"
+#include "../include/stream_ingest.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Open an image file and read every byte, so a mapping pays for its page faults too
+    double load_seconds(const std::string& path, uint64_t& sum)
+    {
+        auto start = std::chrono::steady_clock::now();
+        idx_file file(path, idx_file::IMAGE_MAGIC);
+        const size_t bytes = file.get_count() * file.get_record_size();
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            sum += file.data()[i];
+        }
+        return seconds_since(start);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 5)
+    {
+        std::cerr << "Usage: gzip_bench images labels images.gz labels.gz" << std::endl;
+        return 1;
+    }
+    const std::string files[2][2] = {{argv[1], argv[2]}, {argv[3], argv[4]}};
+    const double megabytes = std::filesystem::file_size(files[0][0]) / 1e6;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "source        file_mb  load_ms  load_mb_s  ingest_ms  ingest_mb_s\n";
+    for (int compressed = 0; compressed < 2; ++compressed)
+    {
+        uint64_t sum = 0;
+        const double load = load_seconds(files[compressed][0], sum);
+
+        ingest_options options;
+        const std::string prefix = files[compressed][0] + ".bench";
+        ingest_report report = stream_ingest(files[compressed][0], files[compressed][1], prefix, options);
+        const double ingest = report.statistics_seconds + report.shard_seconds;
+        for (size_t shard = 0; shard < report.shards; ++shard)
+        {
+            std::filesystem::remove(shard_path(prefix, shard));
+        }
+
+        std::cout << std::left << std::setw(12) << (compressed ? "gzip" : "uncompressed") << std::right
+                  << std::setw(9) << std::filesystem::file_size(files[compressed][0]) / 1e6
+                  << std::setw(9) << load * 1e3
+                  << std::setw(11) << megabytes / load
+                  << std::setw(11) << ingest * 1e3
+                  << std::setw(13) << megabytes / ingest
+                  << (sum == 0 ? " (empty)" : "") << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+// HNSW against the exact scan: build time, then recall@k, latency and accuracy for a range of ef_search.
+// Usage: hnsw_bench [images] [labels] [m] [ef_construction] [k]
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/hnsw_index.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <omp.h>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double accuracy(const KNN& knn, const dataset_view& queries)
+    {
+        prediction_batch predictions = knn.predict_batch(queries);
+        size_t correct = 0;
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            correct += predictions.labels[i] == queries.get_enumerated_label(i);
+        }
+        return static_cast<double>(correct) / static_cast<double>(queries.size());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::string images = argc > 1 ? argv[1] : "./data/train-images.idx3-ubyte";
+    const std::string labels = argc > 2 ? argv[2] : "./data/train-labels.idx1-ubyte";
+    hnsw_parameters parameters;
+    parameters.m = argc > 3 ? std::stoul(argv[3]) : parameters.m;
+    parameters.ef_construction = argc > 4 ? std::stoul(argv[4]) : parameters.ef_construction;
+    const size_t k = argc > 5 ? std::stoul(argv[5]) : 3;
+
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.count_classes();
+    dh.normalize();
+    dh.split_data();
+    const dataset_view& training = dh.get_training_data();
+    const dataset_view& queries = dh.get_test_data();
+
+    // Exact neighbors and their cost
+    KNN knn(static_cast<int>(k));
+    knn.set_training_data(training);
+    std::vector<std::vector<neighbor>> exact(queries.size());
+    top_k best;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t q = 0; q < queries.size(); ++q)
+    {
+        knn.find_k_nearest_neighbors(queries.normalized_row(q), best);
+        exact[q] = best.sorted();
+    }
+    const double scan_us = seconds_since(start) / static_cast<double>(queries.size()) * 1e6;
+    const double exact_accuracy = accuracy(knn, queries);
+
+    start = std::chrono::steady_clock::now();
+    auto index = std::make_unique<hnsw_index>(training, distance_metric::squared_l2, parameters);
+    const double build_seconds = seconds_since(start);
+    hnsw_index* hnsw = index.get();
+    knn.set_search_index(std::move(index));
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "m=" << parameters.m << " ef_construction=" << parameters.ef_construction << " k=" << k
+              << " threads=" << omp_get_max_threads() << " build_s=" << build_seconds
+              << " scan_us=" << scan_us << " exact_accuracy=" << exact_accuracy << "\n";
+    std::cout << "ef_search  recall  mean_us   p99_us  speedup  evaluated  accuracy\n";
+    for (size_t ef : {10, 20, 40, 80, 160, 320})
+    {
+        hnsw->set_ef_search(ef);
+        std::vector<double> latencies(queries.size());
+        search_stats stats;
+        size_t hits = 0;
+        for (size_t q = 0; q < queries.size(); ++q)
+        {
+            start = std::chrono::steady_clock::now();
+            hnsw->search(queries.normalized_row(q), k, best, stats);
+            latencies[q] = seconds_since(start) * 1e6;
+
+            const auto& found = best.sorted();
+            for (const neighbor& f : found)
+            {
+                hits += std::any_of(exact[q].begin(), exact[q].end(), [&](const neighbor& e) { return e.index == f.index; });
+            }
+        }
+        const double n = static_cast<double>(queries.size());
+        double mean_us = 0.0;
+        for (double latency : latencies)
+        {
+            mean_us += latency / n;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        const double p99_us = latencies[std::min(latencies.size() - 1, static_cast<size_t>(0.99 * n))];
+
+        std::cout << std::setw(9) << ef
+                  << std::setw(8) << static_cast<double>(hits) / (n * static_cast<double>(k))
+                  << std::setw(9) << mean_us
+                  << std::setw(9) << p99_us
+                  << std::setw(9) << scan_us / mean_us
+                  << std::setw(11) << std::setprecision(0) << static_cast<double>(stats.distance_evaluations) / n << std::setprecision(3)
+                  << std::setw(10) << accuracy(knn, queries) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+// IVF-PQ against the exact scan: training time, memory per vector, then recall@k, latency and accuracy
+// over probes and re-rank depth. Also checks that a saved and reloaded index answers identically.
+// Usage: ivf_pq_bench [images] [labels] [lists] [subquantizers] [k]
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/ivf_pq_index.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>   // For std::remove
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::string images = argc > 1 ? argv[1] : "./data/train-images.idx3-ubyte";
+    const std::string labels = argc > 2 ? argv[2] : "./data/train-labels.idx1-ubyte";
+    ivf_pq_parameters parameters;
+    parameters.lists = argc > 3 ? std::stoul(argv[3]) : parameters.lists;
+    parameters.subquantizers = argc > 4 ? std::stoul(argv[4]) : parameters.subquantizers;
+    const size_t k = argc > 5 ? std::stoul(argv[5]) : 3;
+
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.count_classes();
+    dh.normalize();
+    dh.split_data();
+    const dataset_view& training = dh.get_training_data();
+    const dataset_view& queries = dh.get_test_data();
+
+    // Exact neighbors and their cost
+    KNN knn(static_cast<int>(k));
+    knn.set_training_data(training);
+    std::vector<std::vector<neighbor>> exact(queries.size());
+    top_k best;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t q = 0; q < queries.size(); ++q)
+    {
+        knn.find_k_nearest_neighbors(queries.normalized_row(q), best);
+        exact[q] = best.sorted();
+    }
+    const double scan_us = seconds_since(start) / static_cast<double>(queries.size()) * 1e6;
+
+    start = std::chrono::steady_clock::now();
+    ivf_pq_index index(training, parameters);
+    const double build_seconds = seconds_since(start);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "lists=" << index.get_parameters().lists << " subquantizers=" << index.get_parameters().subquantizers
+              << " k=" << k << " build_s=" << build_seconds << " bytes_per_vector=" << index.bytes_per_vector()
+              << " float_bytes_per_vector=" << training.get_normalized_feature_count() * sizeof(float) << " scan_us=" << scan_us << "\n";
+    std::cout << "probes  rerank  recall  mean_us  speedup  evaluated  accuracy\n";
+    for (size_t probes : {1, 4, 16})
+    {
+        for (size_t rerank : {0, 50, 200})
+        {
+            index.set_probes(probes);
+            index.set_rerank(rerank);
+            search_stats stats;
+            size_t hits = 0, correct = 0;
+            double seconds = 0.0;
+            for (size_t q = 0; q < queries.size(); ++q)
+            {
+                start = std::chrono::steady_clock::now();
+                index.search(queries.normalized_row(q), k, best, stats);
+                seconds += seconds_since(start);
+
+                const auto& found = best.sorted();
+                for (const neighbor& f : found)
+                {
+                    hits += std::any_of(exact[q].begin(), exact[q].end(), [&](const neighbor& e) { return e.index == f.index; });
+                }
+                // Majority label, ties to the nearest
+                const dataset& source = *training.get_source();
+                int label = -1, votes = 0;
+                for (const neighbor& f : found)
+                {
+                    int count = 0;
+                    for (const neighbor& g : found)
+                    {
+                        count += source.get_enumerated_label(g.index) == source.get_enumerated_label(f.index);
+                    }
+                    if (count > votes)
+                    {
+                        votes = count;
+                        label = source.get_enumerated_label(f.index);
+                    }
+                }
+                correct += label == queries.get_enumerated_label(q);
+            }
+            const double n = static_cast<double>(queries.size());
+            std::cout << std::setw(6) << probes << std::setw(8) << rerank
+                      << std::setw(8) << static_cast<double>(hits) / (n * static_cast<double>(k))
+                      << std::setw(9) << seconds / n * 1e6
+                      << std::setw(9) << scan_us / (seconds / n * 1e6)
+                      << std::setw(11) << std::setprecision(0) << static_cast<double>(stats.distance_evaluations) / n << std::setprecision(3)
+                      << std::setw(10) << static_cast<double>(correct) / n << "\n";
+        }
+    }
+
+    // Round trip through a file
+    const std::string path = "ivf_pq_bench.index";
+    index.set_probes(8);
+    index.set_rerank(0);
+    index.save(path);
+    std::unique_ptr<ivf_pq_index> loaded = ivf_pq_index::load(path, training.get_source());
+    std::remove(path.c_str());
+    size_t differences = 0;
+    top_k reloaded;
+    for (size_t q = 0; q < queries.size(); ++q)
+    {
+        search_stats stats;
+        index.search(queries.normalized_row(q), k, best, stats);
+        loaded->search(queries.normalized_row(q), k, reloaded, stats);
+        const auto& a = best.sorted();
+        const auto& b = reloaded.sorted();
+        differences += a.size() != b.size() || !std::equal(a.begin(), a.end(), b.begin(), [](const neighbor& x, const neighbor& y) {
+            return x.index == y.index && x.distance == y.distance;
+        });
+    }
+    std::cout << "reloaded index: " << loaded->size() << " vectors, " << differences << " queries answered differently\n";
+    return 0;
+}
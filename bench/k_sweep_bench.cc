@@ -0,0 +1,115 @@
+// Tuning k: one sweep_k call against set_k + predict_batch for every k, with the accuracy of every k under
+// uniform and distance-weighted votes on the test set and under k-fold cross validation. Every sweep count
+// is checked against the per-k predictions.
+// Usage: k_sweep_bench [images] [labels] [k_max] [folds]; without files a noisy synthetic set is used
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../include/dataset_split.hpp"
+#include "../K-NN/include/k_sweep.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t count_correct(const prediction_batch& predictions, const dataset_view& queries)
+    {
+        size_t correct = 0;
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            correct += predictions.labels[i] == queries.get_enumerated_label(i);
+        }
+        return correct;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string images = argc > 2 ? argv[1] : "";
+    std::string labels = argc > 2 ? argv[2] : "";
+    const size_t k_max = argc > 3 ? std::stoul(argv[3]) : 15;
+    const size_t fold_count = argc > 4 ? std::stoul(argv[4]) : 5;
+    if (images.empty())
+    {
+        // Heavy noise so that the accuracy actually depends on k
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_k_sweep_bench";
+        std::filesystem::create_directories(dir);
+        images = (dir / "images.idx3-ubyte").string();
+        labels = (dir / "labels.idx1-ubyte").string();
+        if (!write_synthetic_idx(images, labels, 20000, 28, 10, 1, 450.0))
+        {
+            return 1;
+        }
+    }
+
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.count_classes();
+    dh.normalize();
+    dh.split_data();
+    const dataset_view& test = dh.get_test_data();
+
+    KNN knn(static_cast<int>(k_max));
+    knn.set_training_data(dh.get_training_data());
+
+    // One prediction at k_max, the cost of a single evaluation
+    auto start = std::chrono::steady_clock::now();
+    knn.predict_batch(test);
+    const double single_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    const k_sweep_result sweep = sweep_k(knn, test, k_max);
+    const double sweep_seconds = seconds_since(start);
+
+    // The per-k loop the sweep replaces; the weighted pass only checks the sweep and is not timed
+    double per_k_seconds = 0.0;
+    size_t mismatches = 0;
+    for (size_t k = 1; k <= sweep.k_max(); ++k)
+    {
+        knn.set_k(static_cast<int>(k));
+        knn.set_vote_weighting(vote_weighting::uniform);
+        start = std::chrono::steady_clock::now();
+        mismatches += count_correct(knn.predict_batch(test), test) != sweep.correct[k - 1];
+        per_k_seconds += seconds_since(start);
+        knn.set_vote_weighting(vote_weighting::inverse_distance);
+        mismatches += count_correct(knn.predict_batch(test), test) != sweep.weighted_correct[k - 1];
+    }
+
+    const kfold_splitter folds(dh.get_data_array(), fold_count);
+    start = std::chrono::steady_clock::now();
+    const k_sweep_result validated = cross_validate_k(knn, dh.get_data_array(), folds, k_max);
+    const double cross_seconds = seconds_since(start);
+
+    std::cout << "\n" << test.size() << " test queries against " << dh.get_training_data().size() << " training rows\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "single evaluation at k = " << k_max << ": " << single_seconds << " s\n";
+    std::cout << "set_k + predict_batch for k = 1.." << sweep.k_max() << ": " << per_k_seconds << " s\n";
+    std::cout << "sweep_k up to " << sweep.k_max() << ": " << sweep_seconds << " s ("
+              << std::setprecision(1) << per_k_seconds / sweep_seconds << "x faster)\n";
+    std::cout << std::setprecision(3) << fold_count << "-fold cross validation up to " << validated.k_max() << ": "
+              << cross_seconds << " s\n";
+    std::cout << "sweep counts differing from per-k predictions: " << mismatches << "\n\n";
+
+    std::cout << "   k   test_uniform  test_weighted    cv_uniform   cv_weighted\n";
+    std::cout << std::setprecision(4);
+    for (size_t k = 1; k <= sweep.k_max(); ++k)
+    {
+        std::cout << std::setw(4) << k << std::setw(15) << sweep.accuracy(k) << std::setw(15)
+                  << sweep.accuracy(k, vote_weighting::inverse_distance) << std::setw(14) << validated.accuracy(k)
+                  << std::setw(14) << validated.accuracy(k, vote_weighting::inverse_distance) << "\n";
+    }
+    std::cout << "best k: test " << sweep.best_k() << " / " << sweep.best_k(vote_weighting::inverse_distance)
+              << " weighted, cross validation " << validated.best_k() << " / "
+              << validated.best_k(vote_weighting::inverse_distance) << " weighted\n";
+    return mismatches == 0 ? 0 : 1;
+}
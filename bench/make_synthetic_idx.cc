@@ -0,0 +1,24 @@
+// Write a synthetic MNIST-like image and label file pair for running the benchmarks offline.
+// Usage: make_synthetic_idx images labels [samples] [side] [classes] [seed]
+#include "synthetic_idx.hpp"
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: make_synthetic_idx images labels [samples] [side] [classes] [seed]" << std::endl;
+        return 1;
+    }
+    const size_t samples = argc > 3 ? std::stoul(argv[3]) : 60000;
+    const size_t side = argc > 4 ? std::stoul(argv[4]) : 28;
+    const size_t classes = argc > 5 ? std::stoul(argv[5]) : 10;
+    const uint32_t seed = argc > 6 ? static_cast<uint32_t>(std::stoul(argv[6])) : 1;
+    if (!write_synthetic_idx(argv[1], argv[2], samples, side, classes, seed))
+    {
+        return 1;
+    }
+    std::cout << "Wrote " << samples << " images of " << side << "x" << side << " pixels in " << classes << " classes." << std::endl;
+    return 0;
+}
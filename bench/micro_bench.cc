@@ -0,0 +1,121 @@
+// Micro benchmarks of the hot paths on synthetic IDX files: the IDX readers, combine_data, count_classes,
+// normalize, split_data, k-fold splitting, KNN::calculate_distance, find_k_nearest_neighbors and a full test().
+// Usage: micro_bench [--samples N] [--side S] [--k K] [--repetitions R] [--min-time SECONDS] [--csv PATH] [--dir DIR]
+#include "bench_harness.hpp"
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../include/idx_file.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    size_t samples = 10000;
+    size_t side = 28;
+    int k = 3;
+    bench_options options;
+    std::string csv_path;
+    std::string dir = (std::filesystem::temp_directory_path() / "mnist_micro_bench").string();
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string flag = argv[i];
+        const std::string value = argv[i + 1];
+        if (flag == "--samples") samples = std::stoul(value);
+        else if (flag == "--side") side = std::stoul(value);
+        else if (flag == "--k") k = std::stoi(value);
+        else if (flag == "--repetitions") options.samples = std::stoul(value);
+        else if (flag == "--min-time") options.min_sample_seconds = std::stod(value);
+        else if (flag == "--csv") csv_path = value;
+        else if (flag == "--dir") dir = value;
+        else
+        {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    std::filesystem::create_directories(dir);
+    const std::string images = dir + "/images.idx3-ubyte";
+    const std::string labels = dir + "/labels.idx1-ubyte";
+    if (!write_synthetic_idx(images, labels, samples, side))
+    {
+        return 1;
+    }
+    const size_t features = side * side;
+    const double image_bytes = static_cast<double>(samples * features);
+    std::cout << "Synthetic dataset: " << samples << " samples of " << features << " features in " << dir << "\n\n";
+
+    bench_suite suite(options);
+
+    // IDX readers
+    suite.run("idx_file/map+scan", image_bytes, [&] {
+        idx_file file(images, idx_file::IMAGE_MAGIC);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < samples * features; ++i)
+        {
+            sum += file.data()[i];
+        }
+        do_not_optimize(sum);
+    });
+    std::vector<uint8_t> batch(4096 * features);
+    suite.run("idx_stream/read", image_bytes, [&] {
+        idx_stream stream(images, idx_file::IMAGE_MAGIC);
+        while (stream.read(batch.data(), 4096) > 0)
+        {
+        }
+    });
+    suite.run("read_feature_vector+labels", 0.0, [&] {
+        data_handler dh;
+        dh.read_feature_vector(images);
+        dh.read_feature_labels(labels);
+    });
+
+    // Data preparation steps, each on a handler prepared up to the step before it
+    std::unique_ptr<data_handler> dh;
+    suite.run("combine_data", 0.0, [&] { dh->combine_data(); }, [&] {
+        dh = std::make_unique<data_handler>();
+        dh->read_feature_vector(images);
+        dh->read_feature_labels(labels);
+    });
+    suite.run("count_classes", static_cast<double>(samples), [&] { dh->count_classes(); });
+    suite.run("normalize", image_bytes * (1 + sizeof(float)), [&] { dh->normalize(); });
+    suite.run("split_data", 0.0, [&] { dh->split_data(); });
+    suite.run("kfold_splitter/5 folds", 0.0, [&] {
+        kfold_splitter folds(dh->get_data_array(), 5);
+        for (size_t f = 0; f < folds.size(); ++f)
+        {
+            do_not_optimize(folds.fold(f).test.size());
+        }
+    });
+
+    // KNN
+    const dataset_view& training = dh->get_training_data();
+    const dataset_view& test = dh->get_test_data();
+    KNN knn(k);
+    knn.set_training_data(training);
+    knn.set_test_data(test);
+
+    size_t next = 0;
+    float distance_sink = 0.0f;
+    suite.run("calculate_distance", 2.0 * features * sizeof(float), [&] {
+        distance_sink += knn.calculate_distance(test.normalized_row(next % test.size()), training.normalized_row(next % training.size()));
+        ++next;
+    });
+    do_not_optimize(distance_sink);
+
+    top_k best;
+    suite.run("find_k_nearest_neighbors", static_cast<double>(training.size() * features * sizeof(float)), [&] {
+        knn.find_k_nearest_neighbors(test.normalized_row(next++ % test.size()), best);
+    });
+    suite.run("test", 0.0, [&] { knn.test(); });
+
+    suite.print(std::cout);
+    if (!csv_path.empty() && suite.write_csv(csv_path))
+    {
+        std::cout << "\nWrote " << csv_path << "\n";
+    }
+    return 0;
+}
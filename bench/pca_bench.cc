@@ -0,0 +1,87 @@
+// Accuracy and search cost against the number of principal components kept: fit time, retained
+// variance, test accuracy and throughput of the batched scan, and the ball tree's query latency and pruning.
+// Usage: pca_bench [images] [labels] [k]
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/ball_tree.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::string images = argc > 1 ? argv[1] : "./data/train-images.idx3-ubyte";
+    const std::string labels = argc > 2 ? argv[2] : "./data/train-labels.idx1-ubyte";
+    const size_t k = argc > 3 ? std::stoul(argv[3]) : 3;
+
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.count_classes();
+    dh.split_data();
+    const dataset_view& training = dh.get_training_data();
+    const dataset_view& queries = dh.get_test_data();
+    const size_t feature_count = dh.get_data_array().get_feature_count();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  dims  fit_s  variance  accuracy  scan_qps  tree_us  pruned\n";
+    for (size_t components : {size_t(0), size_t(200), size_t(100), size_t(50), size_t(30), size_t(20), size_t(10)})
+    {
+        if (components >= feature_count)
+        {
+            continue;
+        }
+        // Start every row of the table from the full normalized matrix; 0 keeps it unreduced
+        dh.normalize();
+        double fit_seconds = 0.0, variance = 1.0;
+        if (components > 0)
+        {
+            auto start = std::chrono::steady_clock::now();
+            dh.reduce_dimensions(components);
+            fit_seconds = seconds_since(start);
+            variance = dh.get_pca().explained_variance_ratio();
+        }
+
+        KNN knn(static_cast<int>(k));
+        knn.set_training_data(training);
+        auto start = std::chrono::steady_clock::now();
+        prediction_batch predictions = knn.predict_batch(queries);
+        const double scan_seconds = seconds_since(start);
+        size_t correct = 0;
+        for (size_t q = 0; q < queries.size(); ++q)
+        {
+            correct += predictions.labels[q] == queries.get_enumerated_label(q);
+        }
+
+        ball_tree tree(training, distance_metric::squared_l2);
+        top_k found;
+        search_stats stats;
+        start = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < queries.size(); ++q)
+        {
+            tree.search(queries.normalized_row(q), k, found, stats);
+        }
+        const double tree_seconds = seconds_since(start);
+
+        const double n = static_cast<double>(queries.size());
+        std::cout << std::setw(6) << dh.get_data_array().get_normalized_feature_count()
+                  << std::setw(7) << fit_seconds
+                  << std::setw(10) << variance
+                  << std::setw(10) << static_cast<double>(correct) / n
+                  << std::setw(10) << std::setprecision(0) << n / scan_seconds << std::setprecision(3)
+                  << std::setw(9) << tree_seconds / n * 1e6
+                  << std::setw(8) << 1.0 - static_cast<double>(stats.distance_evaluations) / n / static_cast<double>(training.size())
+                  << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+// Reduced-precision normalized rows (data_handler::set_feature_precision): first the conversions and kernels
+// are checked (every fp16 and bf16 value survives a round trip, rounding stays within half a unit in the
+// last place, and every kernel set the CPU supports agrees with the scalar reference), then a dataset is
+// normalized at each precision and, for every metric, compared on the memory of the dataset, the bytes
+// scanned per query, per-query and batch latency on one thread, test accuracy and agreement with the fp32
+// predictions. Test rows are stored at the same precision, so the queries are rounded too. Exits with 1
+// if a check fails or the accuracy of fp16 or bf16 moves more than the tolerance away from fp32's.
+// Usage: precision_bench [images] [labels] [k] [tolerance]; without files a synthetic set is used
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const distance_metric METRICS[] = {distance_metric::squared_l2, distance_metric::l1, distance_metric::cosine};
+
+    const char* metric_name(distance_metric metric)
+    {
+        switch (metric)
+        {
+        case distance_metric::l1:
+            return "l1";
+        case distance_metric::cosine:
+            return "cosine";
+        default:
+            return "squared_l2";
+        }
+    }
+
+    const char* precision_name(feature_precision precision)
+    {
+        switch (precision)
+        {
+        case feature_precision::fp16:
+            return "fp16";
+        case feature_precision::bf16:
+            return "bf16";
+        default:
+            return "fp32";
+        }
+    }
+
+    uint16_t narrow(float value, feature_precision precision)
+    {
+        return precision == feature_precision::bf16 ? float_to_bf16(value) : float_to_fp16(value);
+    }
+
+    float widen(uint16_t value, feature_precision precision)
+    {
+        return precision == feature_precision::bf16 ? bf16_to_float(value) : fp16_to_float(value);
+    }
+
+    // Failed checks of the conversions: round trips of every bit pattern, and the rounding error of
+    // random floats against half a unit in the last place (2^-11 for fp16, 2^-8 for bf16, relative;
+    // for fp16 subnormals, below 2^-14, half the fixed step of 2^-24)
+    size_t check_conversions()
+    {
+        size_t failures = 0;
+        for (feature_precision precision : {feature_precision::fp16, feature_precision::bf16})
+        {
+            for (uint32_t bits = 0; bits <= 0xFFFF; ++bits)
+            {
+                const float value = widen(static_cast<uint16_t>(bits), precision);
+                failures += !std::isnan(value) && narrow(value, precision) != bits;
+            }
+            const double half_ulp = precision == feature_precision::bf16 ? 1.0 / 256 : 1.0 / 2048;
+            const double subnormal_half_step = precision == feature_precision::bf16 ? 0.0 : std::ldexp(1.0, -25);
+            std::mt19937 rng(7);
+            std::uniform_real_distribution<float> magnitude(-10.0f, 10.0f);
+            for (int i = 0; i < 100000; ++i)
+            {
+                const float value = std::ldexp(magnitude(rng) / 10.0f, static_cast<int>(rng() % 28) - 13);
+                const double error = std::fabs(static_cast<double>(widen(narrow(value, precision), precision)) - value);
+                failures += error > std::max(half_ulp * std::fabs(value) * 1.0000001, subnormal_half_step);
+            }
+        }
+        return failures;
+    }
+
+    // Failed comparisons of every supported kernel set's reduced-precision kernels with the scalar ones,
+    // over lengths that exercise the vector bodies and every tail
+    size_t check_kernels()
+    {
+        const std::vector<const distance_kernels*> sets = get_available_distance_kernels();
+        const distance_kernels& reference = *sets.back();
+        std::mt19937 rng(11);
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        size_t failures = 0;
+        for (size_t n : {size_t(1), size_t(7), size_t(15), size_t(16), size_t(33), size_t(63), size_t(64), size_t(100), size_t(784)})
+        {
+            std::vector<float> a(n), b(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                a[i] = normal(rng);
+                b[i] = normal(rng);
+            }
+            for (feature_precision precision : {feature_precision::fp16, feature_precision::bf16})
+            {
+                std::vector<uint16_t> h(n);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    h[i] = narrow(b[i], precision);
+                }
+                for (distance_metric metric : {distance_metric::squared_l2, distance_metric::l1, distance_metric::cosine})
+                {
+                    const float expected = reference.get_half(metric, precision)(a.data(), h.data(), n);
+                    for (const distance_kernels* set : sets)
+                    {
+                        const float actual = set->get_half(metric, precision)(a.data(), h.data(), n);
+                        if (std::fabs(actual - expected) > 1e-4f * std::max(1.0f, std::fabs(expected)))
+                        {
+                            std::cout << set->isa << " " << precision_name(precision) << " " << metric_name(metric)
+                                      << " n = " << n << ": " << actual << " instead of " << expected << "\n";
+                            ++failures;
+                        }
+                    }
+                }
+            }
+        }
+        return failures;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string images = argc > 2 ? argv[1] : "";
+    std::string labels = argc > 2 ? argv[2] : "";
+    const int k = argc > 3 ? std::stoi(argv[3]) : 3;
+    const double tolerance = argc > 4 ? std::stod(argv[4]) : 0.002;
+
+    const size_t conversion_failures = check_conversions();
+    const size_t kernel_failures = check_kernels();
+    std::cout << "conversion checks: " << (conversion_failures == 0 ? "ok" : "FAILED") << ", kernel checks on "
+              << get_available_distance_kernels().size() << " kernel sets: " << (kernel_failures == 0 ? "ok" : "FAILED") << "\n";
+
+    if (images.empty())
+    {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_precision_bench";
+        std::filesystem::create_directories(dir);
+        images = (dir / "images.idx3-ubyte").string();
+        labels = (dir / "labels.idx1-ubyte").string();
+        // Noisy enough that some test rows sit near a class boundary, where rounding could flip them
+        if (!write_synthetic_idx(images, labels, 20000, 28, 10, 1, 250.0))
+        {
+            return 1;
+        }
+    }
+
+    // A dataset per precision, normalized straight into it, so each holds only its own matrix
+    std::ostringstream table;
+    table << std::fixed;
+    std::vector<int> reference[3];
+    double reference_accuracy[3] = {}, reference_query_seconds[3] = {};
+    size_t parity_failures = 0;
+    size_t training_rows = 0, test_rows = 0;
+    for (feature_precision precision : {feature_precision::fp32, feature_precision::fp16, feature_precision::bf16})
+    {
+        data_handler dh;
+        dh.set_feature_precision(precision);
+        dh.read_feature_vector(images);
+        dh.read_feature_labels(labels);
+        dh.combine_data();
+        dh.count_classes();
+        dh.split_data();
+        dh.normalize();
+        const dataset_view& training = dh.get_training_data();
+        const dataset_view& test = dh.get_test_data();
+        training_rows = training.size();
+        test_rows = test.size();
+        const size_t width = training.get_normalized_feature_count();
+        const double dataset_mb = dh.get_data_array().get_storage().bytes_allocated() / 1e6;
+        const double scanned_mb = static_cast<double>(training.size()) * width * precision_bytes(precision) / 1e6;
+
+        // Latency queries widened up front, as a client would send them
+        const size_t latency_queries = std::min<size_t>(200, test.size());
+        std::vector<float> queries(latency_queries * width);
+        for (size_t q = 0; q < latency_queries; ++q)
+        {
+            test.widen_normalized_row(q, queries.data() + q * width);
+        }
+
+        for (size_t m = 0; m < 3; ++m)
+        {
+            const distance_metric metric = METRICS[m];
+            KNN knn(k);
+            knn.set_metric(metric);
+            knn.set_thread_count(1);
+            knn.set_training_data(training);
+
+            auto start = std::chrono::steady_clock::now();
+            const prediction_batch predictions = knn.predict_batch(test);
+            const double batch_seconds = seconds_since(start);
+            start = std::chrono::steady_clock::now();
+            for (size_t q = 0; q < latency_queries; ++q)
+            {
+                knn.predict(span<const float>(queries.data() + q * width, width));
+            }
+            const double query_seconds = seconds_since(start) / latency_queries;
+
+            size_t correct = 0, agreeing = 0;
+            for (size_t q = 0; q < test.size(); ++q)
+            {
+                correct += predictions.labels[q] == test.get_enumerated_label(q);
+                agreeing += reference[m].empty() || predictions.labels[q] == reference[m][q];
+            }
+            const double accuracy = static_cast<double>(correct) / test.size();
+            if (precision == feature_precision::fp32)
+            {
+                reference[m] = predictions.labels;
+                reference_accuracy[m] = accuracy;
+                reference_query_seconds[m] = query_seconds;
+            }
+            const bool parity = std::fabs(accuracy - reference_accuracy[m]) <= tolerance;
+            parity_failures += !parity;
+
+            table << std::left << std::setw(12) << metric_name(metric) << std::setw(9) << precision_name(precision)
+                  << std::right << std::setprecision(1) << std::setw(12) << dataset_mb << std::setw(12) << scanned_mb
+                  << std::setw(10) << query_seconds * 1e6 << std::setprecision(2) << std::setw(9)
+                  << reference_query_seconds[m] / query_seconds << std::setprecision(3) << std::setw(9) << batch_seconds
+                  << std::setprecision(4) << std::setw(10) << accuracy << std::setw(11)
+                  << static_cast<double>(agreeing) / test.size() << std::setw(8) << (parity ? "ok" : "FAIL") << "\n";
+        }
+    }
+
+    std::cout << "\n" << training_rows << " training rows, " << test_rows << " test queries, k = " << k
+              << ", kernels " << get_distance_kernels().isa << ", one thread\n";
+    std::cout << "metric      precision  dataset_MB  scanned_MB  query_us  speedup  batch_s  accuracy  agreement  parity\n";
+    std::cout << table.str();
+    return conversion_failures == 0 && kernel_failures == 0 && parity_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// Accuracy retained against speedup gained by training-set reduction: for the full training set and every
+// reduction method, the rows kept, the reduction time, test accuracy and its ratio to the full set's, and
+// the per-query scan latency and batch throughput of KNN on one thread with the speedup over the full set.
+// Usage: prototype_bench [images] [labels] [k] [prototypes_per_class]; without files a synthetic set is used
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/prototype_reduction.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct reduction_row
+    {
+        const char* name;
+        bool reduce;
+        reduction_method method;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    std::string images = argc > 2 ? argv[1] : "";
+    std::string labels = argc > 2 ? argv[2] : "";
+    const int k = argc > 3 ? std::stoi(argv[3]) : 3;
+    const size_t prototypes_per_class = argc > 4 ? std::stoul(argv[4]) : 100;
+    if (images.empty())
+    {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_prototype_bench";
+        std::filesystem::create_directories(dir);
+        images = (dir / "images.idx3-ubyte").string();
+        labels = (dir / "labels.idx1-ubyte").string();
+        // Noisy enough that the classes overlap and the full set does not classify perfectly
+        if (!write_synthetic_idx(images, labels, 20000, 28, 10, 1, 250.0))
+        {
+            return 1;
+        }
+    }
+
+    data_handler dh;
+    dh.read_feature_vector(images);
+    dh.read_feature_labels(labels);
+    dh.combine_data();
+    dh.count_classes();
+    dh.split_data();
+    dh.normalize();
+    const dataset_view& training = dh.get_training_data();
+    const dataset_view& test = dh.get_test_data();
+    // The per-query latency is measured on a prefix of the test rows, the accuracy on all of them
+    const size_t latency_queries = std::min<size_t>(200, test.size());
+
+    const reduction_row rows[] = {
+        {"none", false, reduction_method::edited},
+        {"edited", true, reduction_method::edited},
+        {"condensed", true, reduction_method::condensed},
+        {"edited_condensed", true, reduction_method::edited_condensed},
+        {"kmeans", true, reduction_method::kmeans},
+    };
+    double full_accuracy = 0.0, full_query_seconds = 0.0;
+    std::ostringstream table;
+    table << std::fixed;
+    for (const reduction_row& row : rows)
+    {
+        reduction_options options;
+        options.method = row.method;
+        options.prototypes_per_class = prototypes_per_class;
+        auto start = std::chrono::steady_clock::now();
+        const dataset_view reduced = row.reduce ? reduce_training_set(training, options) : training;
+        const double reduce_seconds = seconds_since(start);
+
+        KNN knn(k);
+        knn.set_thread_count(1);
+        knn.set_training_data(reduced);
+        start = std::chrono::steady_clock::now();
+        const prediction_batch predictions = knn.predict_batch(test);
+        const double batch_seconds = seconds_since(start);
+        size_t correct = 0;
+        for (size_t q = 0; q < test.size(); ++q)
+        {
+            correct += predictions.labels[q] == test.get_enumerated_label(q);
+        }
+        const double accuracy = static_cast<double>(correct) / test.size();
+
+        start = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < latency_queries; ++q)
+        {
+            knn.predict(test.normalized_row(q));
+        }
+        const double query_seconds = seconds_since(start) / latency_queries;
+        if (!row.reduce)
+        {
+            full_accuracy = accuracy;
+            full_query_seconds = query_seconds;
+        }
+
+        table << std::left << std::setw(17) << row.name << std::right << std::setw(8) << reduced.size()
+              << std::setprecision(1) << std::setw(8) << 100.0 * reduced.size() / training.size()
+              << std::setprecision(2) << std::setw(10) << reduce_seconds << std::setprecision(4) << std::setw(10)
+              << accuracy << std::setprecision(3) << std::setw(10) << accuracy / full_accuracy
+              << std::setprecision(1) << std::setw(10) << query_seconds * 1e6 << std::setprecision(2)
+              << std::setw(9) << full_query_seconds / query_seconds << std::setprecision(0) << std::setw(12)
+              << test.size() / batch_seconds << "\n";
+    }
+
+    std::cout << "\n" << training.size() << " training rows, " << test.size() << " test queries, k = " << k
+              << ", one thread\n";
+    std::cout << "method               rows  kept_%  reduce_s  accuracy  retained  query_us  speedup  batch_qps\n";
+    std::cout << table.str();
+    return 0;
+}
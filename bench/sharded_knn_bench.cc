@@ -0,0 +1,134 @@
+// Throughput of sharded KNN over 1 to max_shards worker processes, one thread each, on Unix sockets and
+// on shared memory, against a single-threaded in-process KNN over the same training set. Every sharded
+// prediction and neighbor list is checked against the in-process one. The workers are this program,
+// started again with --shard-worker.
+// Usage: sharded_knn_bench [images] [labels] [max_shards] [queries]; without files a synthetic set is used
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/knn.hpp"
+#include "../K-NN/include/sharded_knn.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Queries whose label or neighbors differ
+    size_t count_mismatches(const prediction_batch& expected, const prediction_batch& actual)
+    {
+        size_t mismatches = 0;
+        for (size_t q = 0; q < expected.labels.size(); ++q)
+        {
+            bool same = actual.labels[q] == expected.labels[q] && actual.neighbors.k == expected.neighbors.k;
+            for (size_t r = 0; same && r < expected.neighbors.k; ++r)
+            {
+                same = actual.neighbors.row(q)[r].index == expected.neighbors.row(q)[r].index;
+            }
+            mismatches += !same;
+        }
+        return mismatches;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "--shard-worker")
+    {
+        shard_worker_options worker;
+        if (!parse_shard_worker_arguments(argc, argv, 2, worker))
+        {
+            std::cerr << "Invalid shard worker arguments." << std::endl;
+            return 1;
+        }
+        return run_shard_worker(worker);
+    }
+
+    std::string images = argc > 2 ? argv[1] : "";
+    std::string labels = argc > 2 ? argv[2] : "";
+    const size_t max_shards = argc > 3 ? std::stoul(argv[3]) : 4;
+    const size_t query_limit = argc > 4 ? std::stoul(argv[4]) : 2000;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_sharded_knn_bench";
+    std::filesystem::create_directories(dir);
+    if (images.empty())
+    {
+        images = (dir / "images.idx3-ubyte").string();
+        labels = (dir / "labels.idx1-ubyte").string();
+        if (!write_synthetic_idx(images, labels, 40000))
+        {
+            return 1;
+        }
+    }
+    // The workers load the same prepared dataset from this cache
+    const std::string cache = (dir / "prepared.cache").string();
+
+    data_handler dh;
+    dh.load_or_prepare(images, labels, cache);
+    const dataset_view& test = dh.get_test_data();
+    const size_t features = test.get_normalized_feature_count();
+    const size_t query_count = std::min(query_limit, test.size());
+    std::vector<float> queries;
+    queries.reserve(query_count * features);
+    for (size_t q = 0; q < query_count; ++q)
+    {
+        const span<const float> row = test.normalized_row(q);
+        queries.insert(queries.end(), row.begin(), row.end());
+    }
+    const span<const float> query_rows(queries.data(), queries.size());
+
+    const int k = 5;
+    KNN knn(k);
+    knn.set_thread_count(1);
+    knn.set_training_data(dh.get_training_data());
+    auto start = std::chrono::steady_clock::now();
+    const prediction_batch expected = knn.predict_batch(query_rows);
+    const double local_seconds = seconds_since(start);
+
+    std::cout << "\n" << query_count << " queries against " << dh.get_training_data().size() << " training rows, k = " << k
+              << ", " << std::thread::hardware_concurrency() << " hardware threads\n";
+    std::cout << std::fixed << std::setprecision(3) << "in-process KNN, 1 thread: " << local_seconds << " s, "
+              << std::setprecision(0) << query_count / local_seconds << " queries/s\n\n";
+    std::cout << "transport       shards     seconds   queries/s   speedup  mismatches\n";
+
+    size_t total_mismatches = 0;
+    for (shard_transport transport : {shard_transport::unix_socket, shard_transport::shared_memory})
+    {
+        double single_shard_seconds = 0.0;
+        for (size_t shards = 1; shards <= max_shards; shards *= 2)
+        {
+            shard_options options;
+            options.shards = shards;
+            options.transport = transport;
+            options.worker_command = {argv[0], "--shard-worker"};
+            options.images = images;
+            options.labels = labels;
+            options.cache = cache;
+            sharded_knn sharded(k, options);
+
+            // One small batch first, so the workers' pages are mapped before timing
+            sharded.predict_batch(span<const float>(queries.data(), std::min<size_t>(query_count, 16) * features));
+            start = std::chrono::steady_clock::now();
+            const prediction_batch actual = sharded.predict_batch(query_rows);
+            const double seconds = seconds_since(start);
+            if (shards == 1)
+            {
+                single_shard_seconds = seconds;
+            }
+            const size_t mismatches = count_mismatches(expected, actual);
+            total_mismatches += mismatches;
+
+            std::cout << std::left << std::setw(14) << (transport == shard_transport::unix_socket ? "unix_socket" : "shared_memory")
+                      << std::right << std::setw(8) << shards << std::setprecision(3) << std::setw(12) << seconds
+                      << std::setprecision(0) << std::setw(12) << query_count / seconds << std::setprecision(2)
+                      << std::setw(10) << single_shard_seconds / seconds << std::setw(12) << mismatches << "\n";
+        }
+    }
+    return total_mismatches == 0 ? 0 : 1;
+}
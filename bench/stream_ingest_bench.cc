@@ -0,0 +1,57 @@
+// Streaming ingestion over a range of memory limits: batch size, buffer memory, throughput of both passes
+// and peak resident set size.
+// Usage: stream_ingest_bench [images] [labels] [shard_prefix]
+#include "../include/stream_ingest.hpp"
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#ifndef _WIN32
+#include <sys/resource.h> // For getrusage
+#endif
+
+namespace
+{
+    // Peak resident set size of this process so far in MiB, 0 where unavailable
+    double peak_rss_mib()
+    {
+#ifndef _WIN32
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.0;
+#else
+        return 0.0;
+#endif
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::string images = argc > 1 ? argv[1] : "./data/train-images.idx3-ubyte";
+    const std::string labels = argc > 2 ? argv[2] : "./data/train-labels.idx1-ubyte";
+    const std::string prefix = argc > 3 ? argv[3] : "./data/stream_bench";
+    const double megabytes = std::filesystem::file_size(images) / 1e6;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "limit_mib  batch  shards  buffers_mib  stats_mb_s  shard_mb_s  peak_rss_mib\n";
+    // Smallest limit first, so each row's peak RSS is its own
+    for (size_t limit_mib : {40, 64, 128, 256})
+    {
+        ingest_options options;
+        options.memory_limit = limit_mib << 20;
+        options.shard_rows = 65536;
+        ingest_report report = stream_ingest(images, labels, prefix, options);
+        std::cout << std::setw(9) << limit_mib
+                  << std::setw(7) << report.batch_rows
+                  << std::setw(8) << report.shards
+                  << std::setw(13) << report.buffer_bytes / double(1 << 20)
+                  << std::setw(12) << megabytes / report.statistics_seconds
+                  << std::setw(12) << megabytes / report.shard_seconds
+                  << std::setw(14) << peak_rss_mib() << "\n";
+        for (size_t shard = 0; shard < report.shards; ++shard)
+        {
+            std::filesystem::remove(shard_path(prefix, shard));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef __SYNTHETIC_IDX_HPP
+#define __SYNTHETIC_IDX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Write an MNIST-like pair of IDX files, so the benchmarks run without the real dataset: samples images of
+// side x side pixels spread over classes. Every class has a random prototype image and every sample is
+// its class's prototype plus Gaussian noise, clamped to 0..255; the same seed gives the same files.
+inline bool write_synthetic_idx(const std::string& images_path, const std::string& labels_path, size_t samples,
+                                size_t side = 28, size_t classes = 10, uint32_t seed = 1, double noise = 60.0)
+{
+    std::mt19937 rng(seed);
+    const size_t pixels = side * side;
+    std::vector<float> prototypes(classes * pixels);
+    std::uniform_real_distribution<float> intensity(0.0f, 255.0f);
+    for (float& p : prototypes)
+    {
+        p = intensity(rng);
+    }
+
+    auto put_uint32 = [](std::ofstream& out, uint32_t value) {
+        const char bytes[4] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+                               static_cast<char>(value >> 8), static_cast<char>(value)};
+        out.write(bytes, 4);
+    };
+
+    std::ofstream images(images_path, std::ios::binary);
+    std::ofstream labels(labels_path, std::ios::binary);
+    if (!images || !labels)
+    {
+        std::cerr << "Could not create synthetic IDX files: " << images_path << ", " << labels_path << std::endl;
+        return false;
+    }
+    put_uint32(images, 0x00000803);
+    put_uint32(images, static_cast<uint32_t>(samples));
+    put_uint32(images, static_cast<uint32_t>(side));
+    put_uint32(images, static_cast<uint32_t>(side));
+    put_uint32(labels, 0x00000801);
+    put_uint32(labels, static_cast<uint32_t>(samples));
+
+    std::uniform_int_distribution<size_t> pick(0, classes - 1);
+    std::normal_distribution<float> jitter(0.0f, static_cast<float>(noise));
+    std::vector<char> image(pixels);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        const size_t label = pick(rng);
+        const float* prototype = prototypes.data() + label * pixels;
+        for (size_t j = 0; j < pixels; ++j)
+        {
+            image[j] = static_cast<char>(static_cast<uint8_t>(std::clamp(prototype[j] + jitter(rng), 0.0f, 255.0f)));
+        }
+        images.write(image.data(), image.size());
+        const char byte = static_cast<char>(label);
+        labels.write(&byte, 1);
+    }
+    return static_cast<bool>(images) && static_cast<bool>(labels);
+}
+
+#endif // __SYNTHETIC_IDX_HPP
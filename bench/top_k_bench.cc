@@ -0,0 +1,119 @@
+// Neighbor selection with the bounded top-k heap (KNN::find_k_nearest_neighbors) against the full sort
+// it replaced: one (distance, row) pair per training row, sorted by (distance, row) and cut at k. Both
+// use the same distance kernel, so the difference is the selection. For k from 1 to 50 on a training set
+// that fits in cache and one that does not, the milliseconds per query of each, checking that both
+// return the same neighbors for every query and k. Exits with 1 on any difference.
+// Usage: top_k_bench [queries]
+#include "synthetic_idx.hpp"
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/knn.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The former selection: every training row's distance, fully sorted
+    void sort_neighbors(const KNN& knn, const dataset_view& training, span<const float> query, size_t k, std::vector<neighbor>& out)
+    {
+        std::vector<neighbor> all(training.size());
+        for (size_t i = 0; i < training.size(); ++i)
+        {
+            all[i] = {knn.calculate_distance(query, training.normalized_row(i)), training.index(i)};
+        }
+        std::sort(all.begin(), all.end());
+        out.assign(all.begin(), all.begin() + std::min(k, all.size()));
+    }
+
+    // Fastest of runs calls of run, in seconds
+    template <typename Run>
+    double best_seconds(int runs, Run run)
+    {
+        double best = 0.0;
+        for (int r = 0; r < runs; ++r)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            run();
+            const double seconds = seconds_since(start);
+            best = r == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t query_limit = argc > 1 ? std::stoul(argv[1]) : 200;
+    const int RUNS = 3;
+    const size_t K_VALUES[] = {1, 2, 3, 5, 10, 20, 30, 40, 50};
+
+    std::cout << std::fixed;
+    size_t total_mismatches = 0;
+    // About 4.5k training rows (14 MB, mostly cache resident) and 18k (56 MB, streamed from DRAM)
+    for (size_t samples : {size_t(6000), size_t(24000)})
+    {
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "mnist_top_k_bench";
+        std::filesystem::create_directories(dir);
+        const std::string images = (dir / ("images_" + std::to_string(samples) + ".idx3-ubyte")).string();
+        const std::string labels = (dir / ("labels_" + std::to_string(samples) + ".idx1-ubyte")).string();
+        if (!write_synthetic_idx(images, labels, samples))
+        {
+            return 1;
+        }
+        data_handler dh;
+        dh.read_feature_vector(images);
+        dh.read_feature_labels(labels);
+        dh.combine_data();
+        dh.count_classes();
+        dh.split_data();
+        dh.normalize();
+        const dataset_view& training = dh.get_training_data();
+        const dataset_view& test = dh.get_test_data();
+        const size_t query_count = std::min(query_limit, test.size());
+
+        std::cout << "\n" << query_count << " queries against " << training.size() << " training rows, squared L2, one thread\n";
+        std::cout << "  k  sort_ms  heap_ms  speedup  mismatches\n";
+        for (size_t k : K_VALUES)
+        {
+            KNN knn(static_cast<int>(k));
+            knn.set_training_data(training);
+
+            std::vector<std::vector<neighbor>> sorted(query_count), heaped(query_count);
+            const double sort_seconds = best_seconds(RUNS, [&] {
+                for (size_t q = 0; q < query_count; ++q)
+                {
+                    sort_neighbors(knn, training, test.normalized_row(q), k, sorted[q]);
+                }
+            });
+            const double heap_seconds = best_seconds(RUNS, [&] {
+                top_k best;
+                for (size_t q = 0; q < query_count; ++q)
+                {
+                    knn.find_k_nearest_neighbors(test.normalized_row(q), best);
+                    const std::vector<neighbor>& nearest = best.sorted();
+                    heaped[q].assign(nearest.begin(), nearest.end());
+                }
+            });
+
+            size_t mismatches = 0;
+            for (size_t q = 0; q < query_count; ++q)
+            {
+                mismatches += !std::equal(sorted[q].begin(), sorted[q].end(), heaped[q].begin(), heaped[q].end(),
+                                          [](const neighbor& a, const neighbor& b) { return a.distance == b.distance && a.index == b.index; });
+            }
+            total_mismatches += mismatches;
+            std::cout << std::setw(3) << k << std::setprecision(3) << std::setw(9) << sort_seconds * 1e3 / query_count
+                      << std::setw(9) << heap_seconds * 1e3 / query_count << std::setprecision(2) << std::setw(9)
+                      << sort_seconds / heap_seconds << std::setw(12) << mismatches << "\n";
+        }
+    }
+    return total_mismatches == 0 ? 0 : 1;
+}
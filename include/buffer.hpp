@@ -0,0 +1,129 @@
+#ifndef __BUFFER_HPP
+#define __BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Non-owning view over a contiguous run of elements (a minimal C++17 stand-in for std::span)
+template <typename T>
+class span
+{
+    T* ptr;
+    size_t count;
+
+public:
+    constexpr span() : ptr(nullptr), count(0) {}
+    constexpr span(T* p, size_t n) : ptr(p), count(n) {}
+
+    // Allow span<T> -> span<const T>
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U (*)[], T (*)[]>::value>>
+    constexpr span(const span<U>& other) : ptr(other.data()), count(other.size()) {}
+
+    constexpr T* data() const { return ptr; }
+    constexpr size_t size() const { return count; }
+    constexpr bool empty() const { return count == 0; }
+    constexpr T& operator[](size_t i) const { return ptr[i]; }
+    constexpr T* begin() const { return ptr; }
+    constexpr T* end() const { return ptr + count; }
+};
+
+// Allocate / release memory aligned to a cache line
+void* aligned_allocate(size_t bytes);
+void aligned_release(void* ptr);
+// Number of aligned_allocate calls so far, for counting allocations in benchmarks
+size_t aligned_allocation_count();
+
+// Owning, cache-line aligned, zero-initialized array of trivially copyable elements
+template <typename T>
+class aligned_buffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "aligned_buffer holds trivially copyable types only");
+
+    T* ptr = nullptr;
+    size_t count = 0;
+
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    aligned_buffer() = default;
+    explicit aligned_buffer(size_t n) { resize(n); }
+    ~aligned_buffer() { aligned_release(ptr); }
+
+    aligned_buffer(const aligned_buffer&) = delete;
+    aligned_buffer& operator=(const aligned_buffer&) = delete;
+
+    aligned_buffer(aligned_buffer&& other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), count(std::exchange(other.count, 0)) {}
+
+    aligned_buffer& operator=(aligned_buffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            aligned_release(ptr);
+            ptr = std::exchange(other.ptr, nullptr);
+            count = std::exchange(other.count, 0);
+        }
+        return *this;
+    }
+
+    // Discards the current contents
+    void resize(size_t n)
+    {
+        aligned_release(ptr);
+        ptr = n ? static_cast<T*>(aligned_allocate(n * sizeof(T))) : nullptr;
+        count = n;
+    }
+
+    void clear() { resize(0); }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) { return ptr[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+};
+
+// Monotonic allocator: hands out cache-line aligned, zeroed pieces of a few large blocks and releases
+// them all at once, in reset() or on destruction. Nothing is freed individually, so a dataset's
+// per-sample storage costs a handful of heap allocations however many samples it holds.
+class arena
+{
+    std::vector<aligned_buffer<uint8_t>> blocks;
+    size_t used = 0;                // Bytes taken from the last block
+    size_t first_block_size;        // Size of the first block, restored by reset()
+    size_t next_block_size;         // Size of the next block that serves small requests
+    size_t allocated = 0;           // Bytes handed out, including alignment padding
+
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = size_t(1) << 20;
+    static constexpr size_t MAX_BLOCK_SIZE = size_t(64) << 20; // Blocks stop doubling here
+
+    explicit arena(size_t first_block = DEFAULT_BLOCK_SIZE) : first_block_size(first_block), next_block_size(first_block) {}
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+    arena(arena&&) = default;
+    arena& operator=(arena&&) = default;
+
+    // Zeroed, 64-byte aligned storage for count elements, valid until reset()
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "arena holds trivially copyable types only");
+        return static_cast<T*>(allocate_bytes(count * sizeof(T)));
+    }
+    void* allocate_bytes(size_t bytes);
+
+    // Release every block and start doubling from the first block size again; all pointers handed
+    // out become invalid
+    void reset();
+
+    size_t bytes_allocated() const { return allocated; }
+    size_t block_count() const { return blocks.size(); }
+};
+
+#endif
@@ -1,51 +1,46 @@
-#ifndef __DATA_HPP
-#define __DATA_HPP
-
-#include <vector>
-#include <memory> // for std::unique_ptr
-#include <iostream>
-#include "stdint.h"
-#include "stdio.h"
-
-class data
-{
-
-  std::unique_ptr<std::vector<uint8_t>> feature_vector; // Smart pointer to the feature vector
-  std::unique_ptr<std::vector<float>> normalized_feature_vector; // Smart pointer to the normalized feature vector
-  std::unique_ptr<std::vector<int>> class_vector;       // Smart pointer to the class vector
-  uint8_t label;                                        // Label of the data, actual class
-  int enum_label;                                       // Label of the data, enumerated class
-  double distance;                                      // Distance from query point
-
-public:
-  data();
-  ~data();
-
-  // Setters (Mutators)
-  void set_feature_vector(const std::vector<uint8_t> &);
-  void set_normalized_feature_vector(std::unique_ptr<std::vector<float>> vect);
-
-
-  void append_to_feature_vector(const uint8_t *elements, size_t size);
-  void append_to_feature_vector(const double *elements, size_t size);
-
-  void print_vector();
-  void print_normalized_vector();
-
-
-  void set_label(uint8_t);
-  void set_enumerated_label(int);
-  void set_class_vector(int); // Declare the function
-
-  // Getters (Accessors)
-  int get_feature_vector_size();
-  uint8_t get_label();
-  uint8_t get_enumerated_label();
-  double get_distance() const;
-
-  const std::vector<uint8_t>& get_feature_vector() const;
-  const std::vector<int>& get_class_vector() const;
-  const std::vector<float>& get_normalized_feature_vector() const;
-};
-
-#endif
+#ifndef __DATA_HPP
+#define __DATA_HPP
+
+#include "buffer.hpp" // For span
+#include <type_traits>
+#include "stdint.h"
+
+// One sample of a dataset: pointers into the storage its dataset owns, plus the sample's labels.
+// Trivially copyable and free of allocations; valid until the dataset is cleared or re-attached.
+class data
+{
+    const uint8_t* feature_vector = nullptr;          // Raw features
+    const float* normalized_feature_vector = nullptr; // Normalized features; nullptr before normalization
+    const int* class_vector = nullptr;                // One-hot class vector; nullptr before the classes are counted
+    uint32_t feature_count = 0;
+    uint32_t normalized_feature_count = 0;
+    uint32_t class_count = 0;
+    uint8_t label = 0;                                // Label of the data, actual class
+    int enum_label = 0;                               // Label of the data, enumerated class
+
+public:
+    data() = default;
+    data(span<const uint8_t> features, span<const float> normalized, span<const int> classes, uint8_t lbl, int enumerated)
+        : feature_vector(features.data()), normalized_feature_vector(normalized.data()), class_vector(classes.data()),
+          feature_count(static_cast<uint32_t>(features.size())),
+          normalized_feature_count(static_cast<uint32_t>(normalized.size())),
+          class_count(static_cast<uint32_t>(classes.size())), label(lbl), enum_label(enumerated)
+    {
+    }
+
+    void print_vector() const;
+    void print_normalized_vector() const;
+
+    // Getters (Accessors)
+    int get_feature_vector_size() const { return static_cast<int>(feature_count); }
+    uint8_t get_label() const { return label; }
+    int get_enumerated_label() const { return enum_label; }
+
+    span<const uint8_t> get_feature_vector() const { return {feature_vector, feature_count}; }
+    span<const float> get_normalized_feature_vector() const { return {normalized_feature_vector, normalized_feature_count}; }
+    span<const int> get_class_vector() const { return {class_vector, class_count}; }
+};
+
+static_assert(std::is_trivially_copyable<data>::value, "data must stay a trivially copyable view");
+
+#endif
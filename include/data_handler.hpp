@@ -1,70 +1,101 @@
-#ifndef __DATA_HANDLER_HPP
-#define __DATA_HANDLER_HPP
-
-#include "data.hpp"    // Include the full definition of 'data'
-#include <fstream>
-#include <string>
-#include <map>
-#include <future>      // For threading
-#include <cstdint>     // For uint8_t
-
-
-class data_handler
-{
-    // Using unique_ptr to manage the vectors
-    std::unique_ptr<std::vector<std::unique_ptr<data>>> data_array;          // Vector to store all data pre-split
-    std::unique_ptr<std::vector<std::unique_ptr<data>>> training_data;       // Vector to store training data for training the model
-    std::unique_ptr<std::vector<std::unique_ptr<data>>> test_data;           // Vector to store testing data for final evaluation
-    std::unique_ptr<std::vector<std::unique_ptr<data>>> validation_data;     // Vector to store validation data for intermediate evaluation
-
-    int class_counts;
-    int feature_vector_size;
-
-    std::map<uint8_t, int> classFromInt;
-    std::map<std::string, int> classFromString; // String key
-
-    // Temporary storage for images and labels
-    std::vector<std::vector<uint8_t>> temp_image_data;
-    std::vector<uint8_t> temp_label_data;
-
-public:
-    const double TRAIN_SET_PERCENT = 0.75;
-    const double TEST_SET_PERCENT = 0.20;
-    const double VALIDATION_SET_PERCENT = 0.05;
-
-    // Constructor
-    data_handler();
-    // Destructor
-    ~data_handler();
-
-    // Load data from file
-    void read_feature_vector(const std::string& path);
-    // Read labels from file
-    void read_feature_labels(const std::string& path);
-    // Combine images and labels into data_array
-    void combine_data();
-    // Split data into training, test, and validation sets according to the percentages
-    void split_data();
-    void count_classes();
-    void normalize();
-    void print();
-
-    int get_class_counts();
-    int get_data_array_size();
-    int get_training_data_size();
-    int get_test_data_size();
-    int get_validation_size();
-
-    // Helper function to read big-endian uint32_t
-    uint32_t read_uint32(std::ifstream& file);
-
-    // Getters (Accessors)
-    // Returning raw pointers to the vectors for compatibility
-    // Alternatively, you can return references or smart pointers if possible
-    std::vector<std::unique_ptr<data>>* get_training_data();
-    std::vector<std::unique_ptr<data>>* get_test_data();
-    std::vector<std::unique_ptr<data>>* get_validation_data();
-};
-
-#endif
-
+#ifndef __DATA_HANDLER_HPP
+#define __DATA_HANDLER_HPP
+
+#include "dataset.hpp" // Contiguous dataset storage and index views
+#include "idx_file.hpp" // Memory-mapped IDX files
+#include "feature_stats.hpp" // Per-feature statistics
+#include "pca.hpp"      // Principal component projection
+#include "dataset_split.hpp" // Seeded, stratified splits
+#include <string>
+#include <memory>      // For std::unique_ptr
+#include <map>
+#include <future>      // For threading
+#include <cstdint>     // For uint8_t
+
+class data_handler
+{
+    std::unique_ptr<dataset> data_array;   // All samples, stored contiguously
+    dataset_view training_data;            // Indices of the training data for training the model
+    dataset_view test_data;                // Indices of the testing data for final evaluation
+    dataset_view validation_data;          // Indices of the validation data for intermediate evaluation
+
+    int class_counts;
+    int feature_vector_size;
+    feature_stats statistics;   // Per-feature statistics of all samples, computed by normalize
+    pca projection;             // Fitted by reduce_dimensions
+    split_options split_settings; // Used by split_data
+    feature_precision precision = feature_precision::fp32; // Of the normalized rows, see set_feature_precision
+
+    std::map<uint8_t, int> classFromInt;
+    std::map<std::string, int> classFromString; // String key
+
+    // Mapped image and label files, handed over to data_array by combine_data
+    std::shared_ptr<idx_file> temp_image_data;
+    std::shared_ptr<idx_file> temp_label_data;
+
+public:
+    const double TRAIN_SET_PERCENT = 0.75;
+    const double TEST_SET_PERCENT = 0.20;
+    const double VALIDATION_SET_PERCENT = 0.05;
+
+    // Constructor
+    data_handler();
+    // Destructor
+    ~data_handler();
+
+    // Load data from file
+    void read_feature_vector(const std::string& path);
+    // Read labels from file
+    void read_feature_labels(const std::string& path);
+    // Combine images and labels into data_array
+    void combine_data();
+    // Split data into training, test, and validation sets according to the split options; the same
+    // seed gives the same split
+    void split_data();
+    // Use the given rows as the training, test and validation sets, e.g. a fold of a kfold_splitter
+    void apply_split(split_indices split);
+    // Seed, stratification and fractions of split_data; they default to the percentages above
+    void set_split_options(const split_options& options);
+    const split_options& get_split_options() const;
+    void count_classes();
+    void normalize(normalization_method method = normalization_method::z_score);
+    // Store the normalized rows as fp16 or bf16 instead of floats: half the memory, and half the bytes
+    // a KNN scan reads per candidate, at the cost of rounding every value. Normalized rows are
+    // converted now; normalize() and a cache load afterwards write or map them at this precision
+    // directly. The search indexes and prototype reduction need fp32 rows.
+    void set_feature_precision(feature_precision p);
+    feature_precision get_feature_precision() const { return precision; }
+    // Project the normalized rows onto their leading principal components, fitted on the training
+    // set (all rows before split_data); call normalize() again to undo. Reduced-precision rows are
+    // widened for the fit and the projection is stored back at their precision.
+    void reduce_dimensions(size_t components);
+    void print();
+
+    // Read, combine, count classes, normalize and split in one call. With a cache_path the prepared dataset
+    // is loaded from that cache when it was built from the same files with the same parameters, and the
+    // cache is (re)written otherwise. Returns whether the cache was used.
+    bool load_or_prepare(const std::string& images, const std::string& labels, const std::string& cache_path,
+                         normalization_method method = normalization_method::z_score);
+    // Write the prepared dataset (both matrices, labels, class map, statistics and split) to a cache file
+    bool save_cache(const std::string& path, uint64_t key) const;
+    // Replace the dataset with a cached one; false if the cache is missing, out of date or damaged
+    bool load_cache(const std::string& path, uint64_t key);
+
+    int get_class_counts();
+    int get_data_array_size();
+    int get_training_data_size();
+    int get_test_data_size();
+    int get_validation_size();
+
+    // Getters (Accessors)
+    const dataset& get_data_array() const;
+    // The label read from the file for every enumerated label
+    std::vector<uint8_t> get_class_labels() const;
+    const feature_stats& get_feature_stats() const;
+    const pca& get_pca() const;
+    const dataset_view& get_training_data() const;
+    const dataset_view& get_test_data() const;
+    const dataset_view& get_validation_data() const;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef __DATASET_HPP
+#define __DATASET_HPP
+
+#include "buffer.hpp" // For span, aligned_buffer and arena
+#include "data.hpp"   // Per-sample views
+#include "half_float.hpp" // For feature_precision and the fp16/bf16 conversions
+#include <vector>
+#include <memory>     // For std::shared_ptr
+#include <cstdint>
+
+class idx_file;
+class mapped_file;
+
+// Structure-of-arrays storage for a whole dataset: one row-major matrix per feature
+// representation plus flat label arrays, instead of one heap object per sample. Everything the
+// dataset owns lives in one arena, released together by clear() or the next attach.
+class dataset
+{
+    size_t sample_count = 0;
+    size_t feature_count = 0;                    // Width of the raw rows
+    size_t normalized_feature_count = 0;         // Width of the normalized rows; smaller once projected (PCA)
+
+    std::shared_ptr<const idx_file> image_file;  // Mapped image file backing raw_features
+    std::shared_ptr<const idx_file> label_file;  // Mapped label file backing labels
+    std::shared_ptr<mapped_file> cache_file;     // Mapped cache file backing all three matrices instead
+    const uint8_t* raw_features = nullptr;       // sample_count x feature_count, served from image_file
+    const uint8_t* labels = nullptr;             // Label of each sample, actual class, served from label_file
+
+    arena storage;                               // Owns the enumerated labels, class vectors and normalized matrix
+    void* normalized_features = nullptr;         // sample_count x normalized_feature_count, filled by normalize
+    feature_precision normalized_precision = feature_precision::fp32; // Format of every normalized value
+    size_t normalized_capacity = 0;              // Bytes of normalized_features owned by storage; 0 when mapped
+    int* enumerated_labels = nullptr;            // Label of each sample, enumerated class
+    int* class_vectors = nullptr;                // class_count x class_count identity: row c is class c one-hot
+    size_t class_count = 0;
+    size_t class_capacity = 0;                   // Ints of class_vectors owned by storage
+
+public:
+    dataset() = default;
+
+    // Serve raw features and labels directly from the given IDX files; exits if their counts differ
+    void attach(std::shared_ptr<const idx_file> images, std::shared_ptr<const idx_file> sample_labels);
+    // Serve raw features, labels and normalized features (stored at precision) from a mapped dataset
+    // cache; the pointers point into file. Enumerated labels are owned as usual and set by the caller.
+    void attach_cache(std::shared_ptr<mapped_file> file, size_t count, size_t features, size_t normalized_width,
+                      const uint8_t* raw, const uint8_t* sample_labels, void* normalized, feature_precision precision);
+    // Allocate storage for the normalized matrix, as wide as the raw rows, with values at precision. A
+    // matrix already in the arena that is large enough is reused without clearing it, so the arena does
+    // not grow.
+    void allocate_normalized(feature_precision precision = feature_precision::fp32);
+    // Convert the normalized matrix to precision. A matrix owned by the arena that is large enough is
+    // converted in place; a mapped one, or one too small to hold wider values, is replaced by a new
+    // matrix in the arena. Narrowing rounds to nearest even; widening is exact.
+    void set_normalized_precision(feature_precision precision);
+    // Replace the normalized matrix with another float representation of the same samples, e.g. its
+    // projection onto principal components; features must hold sample_count rows of the given width.
+    // The rows are copied over the current matrix when they fit, so the arena does not grow, and are
+    // stored at fp32.
+    void replace_normalized(const aligned_buffer<float>& features, size_t width);
+    // Build the one-hot class vectors for classes enumerated classes, over the current table when it fits
+    void set_class_count(size_t classes);
+    void clear();
+
+    size_t size() const { return sample_count; }
+    size_t get_feature_count() const { return feature_count; }
+    size_t get_normalized_feature_count() const { return normalized_feature_count; }
+    bool is_normalized() const { return normalized_features != nullptr; }
+    feature_precision get_normalized_precision() const { return normalized_precision; }
+
+    // Raw rows live in the mapped file and carry no alignment guarantee
+    span<const uint8_t> raw_row(size_t i) const { return {raw_features + i * feature_count, feature_count}; }
+    // Normalized rows of a matrix stored at fp32
+    span<float> normalized_row(size_t i) { return {static_cast<float*>(normalized_features) + i * normalized_feature_count, normalized_feature_count}; }
+    span<const float> normalized_row(size_t i) const { return {static_cast<const float*>(normalized_features) + i * normalized_feature_count, normalized_feature_count}; }
+    // Normalized rows of a matrix stored at fp16 or bf16
+    span<uint16_t> half_row(size_t i) { return {static_cast<uint16_t*>(normalized_features) + i * normalized_feature_count, normalized_feature_count}; }
+    span<const uint16_t> half_row(size_t i) const { return {static_cast<const uint16_t*>(normalized_features) + i * normalized_feature_count, normalized_feature_count}; }
+    // Normalized row i as floats into out, whatever the precision it is stored at
+    void widen_normalized_row(size_t i, float* out) const;
+
+    uint8_t get_label(size_t i) const { return labels[i]; }
+    int get_enumerated_label(size_t i) const { return enumerated_labels[i]; }
+    void set_enumerated_label(size_t i, int lbl) { enumerated_labels[i] = lbl; }
+
+    // View of sample i; its class vector is empty until set_class_count, its normalized features
+    // unless they are stored at fp32
+    data sample(size_t i) const
+    {
+        span<const int> classes;
+        if (class_vectors && static_cast<size_t>(enumerated_labels[i]) < class_count)
+        {
+            classes = {class_vectors + enumerated_labels[i] * class_count, class_count};
+        }
+        const bool floats = is_normalized() && normalized_precision == feature_precision::fp32;
+        return data(raw_row(i), floats ? normalized_row(i) : span<const float>(), classes, labels[i], enumerated_labels[i]);
+    }
+    // Storage owned by the dataset, for allocation accounting
+    const arena& get_storage() const { return storage; }
+};
+
+// Lightweight subset of a dataset (training, test, validation) expressed as row indices
+class dataset_view
+{
+    const dataset* source = nullptr;
+    std::vector<uint32_t> indices;
+
+public:
+    dataset_view() = default;
+    dataset_view(const dataset* src, std::vector<uint32_t> rows) : source(src), indices(std::move(rows)) {}
+
+    size_t size() const { return indices.size(); }
+    bool empty() const { return indices.empty(); }
+    size_t get_feature_count() const { return source ? source->get_feature_count() : 0; }
+    size_t get_normalized_feature_count() const { return source ? source->get_normalized_feature_count() : 0; }
+    feature_precision get_normalized_precision() const { return source ? source->get_normalized_precision() : feature_precision::fp32; }
+
+    // Row of the i-th sample of the view in the underlying dataset
+    uint32_t index(size_t i) const { return indices[i]; }
+
+    span<const uint8_t> raw_row(size_t i) const { return source->raw_row(indices[i]); }
+    span<const float> normalized_row(size_t i) const { return source->normalized_row(indices[i]); }
+    span<const uint16_t> half_row(size_t i) const { return source->half_row(indices[i]); }
+    void widen_normalized_row(size_t i, float* out) const { source->widen_normalized_row(indices[i], out); }
+    uint8_t get_label(size_t i) const { return source->get_label(indices[i]); }
+    int get_enumerated_label(size_t i) const { return source->get_enumerated_label(indices[i]); }
+    data sample(size_t i) const { return source->sample(indices[i]); }
+
+    const dataset* get_source() const { return source; }
+    const std::vector<uint32_t>& get_indices() const { return indices; }
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef __DATASET_CACHE_HPP
+#define __DATASET_CACHE_HPP
+
+#include "mapped_file.hpp"
+#include <memory>  // For std::shared_ptr
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// On-disk cache of a prepared dataset: one fixed header followed by 64-byte aligned sections, all in the
+// byte order of the machine that wrote it. The header names the source files and parameters the cache
+// was built from (as a key), and checksums cover both the header and every section.
+constexpr uint32_t CACHE_MAGIC = 0x48434E4D; // "MNCH" read as a little-endian uint32_t
+constexpr uint32_t CACHE_VERSION = 1;
+constexpr size_t CACHE_ALIGNMENT = 64;
+
+// Sections, in file order
+enum cache_section : uint32_t
+{
+    CACHE_RAW_FEATURES,        // sample_count x feature_count uint8
+    CACHE_LABELS,              // sample_count uint8
+    CACHE_ENUMERATED_LABELS,   // sample_count int32
+    CACHE_CLASS_LABELS,        // class_count uint8, the label of each enumerated class
+    CACHE_STATS_MEAN,          // feature_count double
+    CACHE_STATS_M2,            // feature_count double
+    CACHE_STATS_MINIMUM,       // feature_count uint8
+    CACHE_STATS_MAXIMUM,       // feature_count uint8
+    CACHE_NORMALIZED_FEATURES, // sample_count x normalized_feature_count float, or fp16/bf16 if the key names one
+    CACHE_SPLIT_INDICES,       // training, then test, then validation rows, uint32
+    CACHE_SECTION_COUNT
+};
+
+struct cache_section_entry
+{
+    uint64_t offset; // From the start of the file, a multiple of CACHE_ALIGNMENT
+    uint64_t bytes;
+};
+
+struct cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;                        // cache_key of the sources and parameters
+    uint64_t sample_count;
+    uint64_t feature_count;
+    uint64_t normalized_feature_count;
+    uint64_t class_count;
+    uint64_t stats_count;                // Rows the statistics were computed over
+    uint64_t training_count;
+    uint64_t test_count;
+    uint64_t validation_count;
+    cache_section_entry sections[CACHE_SECTION_COUNT];
+    uint64_t payload_checksum;           // Over the sections, in order
+    uint64_t header_checksum;            // Over every byte of the header before this field
+};
+
+static_assert(sizeof(cache_header) % CACHE_ALIGNMENT == 0, "sections must start aligned");
+
+// Bytes of one section to write
+struct cache_section_data
+{
+    const void* data;
+    size_t bytes;
+};
+
+// Bytes per independently hashed chunk of a checksum
+constexpr size_t CHECKSUM_CHUNK = size_t(1) << 20;
+
+// 64-bit checksum of a byte range; chunks are hashed in parallel and combined in order, so the value
+// does not depend on the number of threads
+uint64_t checksum(const void* data, size_t bytes);
+
+// The same checksum computed over data that arrives in pieces; at most one chunk is buffered
+class checksum_stream
+{
+    std::vector<uint8_t> pending;  // Start of the current, incomplete chunk
+    std::vector<uint64_t> chunks;  // Hash of every complete chunk
+    size_t total = 0;
+
+public:
+    void update(const void* data, size_t bytes);
+    // Checksum of everything passed to update, equal to checksum() over the concatenation
+    uint64_t finish() const;
+};
+
+// Key identifying what a cache was built from: the path, size and modification time of every source
+// file, and a string describing the preparation parameters
+uint64_t cache_key(const std::vector<std::string>& sources, const std::string& parameters);
+
+// Place the sections one after another behind the header, each aligned to CACHE_ALIGNMENT, and set
+// the magic number and version
+void layout_cache(cache_header& header, const size_t (&section_bytes)[CACHE_SECTION_COUNT]);
+
+// Fill in the payload checksum from the checksums of the sections, then the header checksum
+void seal_cache(cache_header& header, const uint64_t (&section_checksums)[CACHE_SECTION_COUNT]);
+
+// Write header and sections to path, through a temporary file renamed into place; the section table and
+// checksums of header are filled in here. Returns false (with a message) if the file cannot be written.
+bool write_cache(const std::string& path, cache_header header, const cache_section_data (&sections)[CACHE_SECTION_COUNT]);
+
+// Map the cache at path and validate it against key: magic, version, checksums and section bounds. Returns
+// nullptr, after printing why, if the file is missing, stale or damaged; the mapping is copy-on-write.
+std::shared_ptr<mapped_file> open_cache(const std::string& path, uint64_t key);
+
+#endif // __DATASET_CACHE_HPP
@@ -0,0 +1,63 @@
+#ifndef __DATASET_SPLIT_HPP
+#define __DATASET_SPLIT_HPP
+
+#include "dataset.hpp"
+#include <vector>
+#include <cstdint>
+
+// Splits of a dataset into training, test and validation rows. A split is only row indices over the
+// immutable dataset, so making one is O(N) integer work: rows are bucketed by label, shuffled with a
+// seeded generator and dealt out, and every subset comes out in ascending row order without sorting.
+// The generator is part of this file, so a seed gives the same split on every platform and compiler.
+
+// Row indices of one split, each subset in ascending order
+struct split_indices
+{
+    std::vector<uint32_t> training;
+    std::vector<uint32_t> test;
+    std::vector<uint32_t> validation;
+};
+
+struct split_options
+{
+    uint64_t seed = 42;
+    bool stratified = true;          // Split every label in the same proportions
+    double training_fraction = 0.75;
+    double test_fraction = 0.20;     // The rest is validation
+};
+
+// One training / test / validation split. Stratified splits round the subset sizes per label, so the
+// totals may differ from the fractions by up to one row per label.
+split_indices holdout_split(const dataset& data, const split_options& options = {});
+
+// k-fold cross validation: every row is dealt to one of k folds once, round-robin over the shuffled
+// rows (grouped by label when stratified), so fold sizes differ by at most one and every fold holds
+// each label in nearly the same proportion
+class kfold_splitter
+{
+    std::vector<uint32_t> fold_of; // Fold of every row
+    size_t folds = 0;
+
+public:
+    kfold_splitter(const dataset& data, size_t fold_count, uint64_t seed = 42, bool stratified = true);
+
+    size_t size() const { return folds; }
+    // Fold f as the test rows and all other folds as the training rows; validation is empty
+    split_indices fold(size_t f) const;
+};
+
+// Repeated random holdout: split r is a holdout_split with a seed derived from the base seed and r
+class repeated_holdout
+{
+    const dataset* source;
+    split_options options;
+    size_t repeats;
+
+public:
+    repeated_holdout(const dataset& data, const split_options& base, size_t repetitions);
+
+    size_t size() const { return repeats; }
+    split_indices split(size_t repetition) const;
+};
+
+#endif // __DATASET_SPLIT_HPP
@@ -0,0 +1,50 @@
+#ifndef __FEATURE_STATS_HPP
+#define __FEATURE_STATS_HPP
+
+#include "buffer.hpp" // For span
+#include <vector>
+#include <cstdint>
+
+// Feature scaling applied by data_handler::normalize()
+enum class normalization_method
+{
+    z_score, // (x - mean) / standard deviation
+    min_max  // (x - min) / (max - min), into [0, 1]
+};
+
+// Per-feature count, mean, sum of squared deviations from the mean (M2), minimum and maximum of a set of rows
+struct feature_stats
+{
+    size_t count = 0;
+    std::vector<double> mean;
+    std::vector<double> m2;
+    std::vector<uint8_t> minimum;
+    std::vector<uint8_t> maximum;
+
+    void reset(size_t feature_count);
+    size_t get_feature_count() const { return mean.size(); }
+
+    // Fold in the statistics of another set of rows with Chan's pairwise update
+    void merge(const feature_stats& other);
+
+    // Sample variance and standard deviation; 0 for fewer than two rows
+    double variance(size_t feature) const;
+    double std_dev(size_t feature) const;
+
+    // Both scalings are (x - offset) * scale; fill in offset and scale per feature. A feature with zero
+    // spread gets scale 1 and a warning on std::cerr.
+    void scaling(normalization_method method, std::vector<float>& offset, std::vector<float>& scale) const;
+};
+
+// Rows per chunk of the statistics pass; also keeps the 32-bit per-chunk sums of squares exact
+constexpr size_t FEATURE_STATS_CHUNK = 4096;
+
+// Statistics of row-major uint8 rows. Every fixed-size chunk of rows is summed exactly in integers, across
+// features, and the chunks are merged in order, so the result does not depend on the number of threads.
+feature_stats compute_feature_stats(span<const uint8_t> rows, size_t feature_count);
+
+// Fold the chunks of rows into total, in order. Feeding consecutive batches whose sizes are multiples of
+// FEATURE_STATS_CHUNK gives exactly the statistics of one compute_feature_stats call over all of them.
+void accumulate_feature_stats(feature_stats& total, span<const uint8_t> rows, size_t feature_count);
+
+#endif // __FEATURE_STATS_HPP
@@ -0,0 +1,53 @@
+#ifndef __GZIP_READER_HPP
+#define __GZIP_READER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <memory>  // For std::unique_ptr
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// Sequential reader of a gzip file. A producer thread reads and inflates the file into fixed-size blocks
+// and hands them over through a bounded queue, so decompression runs ahead of the consumer while at most
+// QUEUE_DEPTH blocks are waiting. Concatenated gzip members are read as one stream.
+class gzip_reader
+{
+public:
+    static constexpr size_t BLOCK_SIZE = size_t(1) << 20; // Decompressed bytes per block
+    static constexpr size_t QUEUE_DEPTH = 4;              // Blocks the producer may run ahead
+
+    // Open the file at path and start inflating; exits if it cannot be opened
+    explicit gzip_reader(const std::string& path);
+    ~gzip_reader();
+
+    gzip_reader(const gzip_reader&) = delete;
+    gzip_reader& operator=(const gzip_reader&) = delete;
+
+    // Copy up to bytes decompressed bytes into out; returns the number copied, less than bytes only at the
+    // end of the stream. Exits if the file is not valid gzip data.
+    size_t read(uint8_t* out, size_t bytes);
+
+    // Whether the file starts with the gzip magic bytes 0x1f 0x8b
+    static bool is_gzip(const std::string& path);
+
+private:
+    std::string path;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> queue; // Full blocks, oldest first; the last block of the stream may be shorter
+    bool finished = false;                  // The producer has queued its last block
+    bool stopping = false;                  // The consumer is gone; the producer should stop
+    std::string error;                      // Set by the producer on invalid data
+
+    std::vector<uint8_t> current;           // Block being consumed
+    size_t current_offset = 0;
+
+    std::thread producer;
+    void produce();
+};
+
+#endif // __GZIP_READER_HPP
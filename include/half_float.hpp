@@ -0,0 +1,99 @@
+#ifndef __HALF_FLOAT_HPP
+#define __HALF_FLOAT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring> // For std::memcpy
+
+// Storage format of a dataset's normalized rows
+enum class feature_precision
+{
+    fp32, // Floats
+    fp16, // IEEE half precision: 11 significant bits, finite up to 65504
+    bf16  // bfloat16: the top half of a float, 8 significant bits and the full float range
+};
+
+// Round to the nearest fp16, ties to even; overflow becomes infinity and NaN stays NaN
+inline uint16_t float_to_fp16(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000)
+    {
+        return sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00);
+    }
+    if (magnitude >= 0x477FF000) // Rounds to 65520 or more
+    {
+        return sign | 0x7C00;
+    }
+    if (magnitude < 0x38800000) // Below the smallest normal fp16, 2^-14: a subnormal or zero
+    {
+        float scaled;
+        const uint32_t absolute = magnitude;
+        std::memcpy(&scaled, &absolute, sizeof(scaled));
+        // Units of 2^-24, rounded to nearest even by the float addition
+        scaled += 0.5f;
+        uint32_t rounded;
+        std::memcpy(&rounded, &scaled, sizeof(rounded));
+        return sign | static_cast<uint16_t>(rounded - 0x3F000000);
+    }
+    // Rebias the exponent from 127 to 15 and round the 13 dropped mantissa bits to nearest even
+    const uint32_t odd = (magnitude >> 13) & 1;
+    return sign | static_cast<uint16_t>((magnitude - 0x38000000 + 0xFFF + odd) >> 13);
+}
+
+inline float fp16_to_float(uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else if (exponent == 0)
+    {
+        // Zero or subnormal: mantissa * 2^-24, exact in a float
+        float value = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        std::memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Round to the nearest bf16, ties to even; NaN stays NaN
+inline uint16_t float_to_bf16(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7FFFFFFF) > 0x7F800000)
+    {
+        return static_cast<uint16_t>((bits >> 16) | 0x40);
+    }
+    return static_cast<uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+inline float bf16_to_float(uint16_t half)
+{
+    const uint32_t bits = static_cast<uint32_t>(half) << 16;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Bytes of one stored value at the given precision
+inline size_t precision_bytes(feature_precision precision)
+{
+    return precision == feature_precision::fp32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+#endif // __HALF_FLOAT_HPP
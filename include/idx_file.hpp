@@ -0,0 +1,77 @@
+#ifndef __IDX_FILE_HPP
+#define __IDX_FILE_HPP
+
+#include "buffer.hpp" // For span
+#include "mapped_file.hpp"
+#include "gzip_reader.hpp"
+#include <fstream>
+#include <memory> // For std::unique_ptr
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Read-only view of an IDX file (the MNIST container format). The file is memory-mapped and the
+// header is validated once; records are then served straight from the mapped pages without copying.
+// A gzip-compressed file (.gz) is recognized by its magic bytes and inflated into memory instead.
+class idx_file
+{
+    std::string path;
+    std::unique_ptr<mapped_file> file;  // Uncompressed file
+    aligned_buffer<uint8_t> inflated;   // Decompressed contents of a compressed file
+
+    std::vector<uint32_t> dimensions;
+    const uint8_t* payload;         // First byte after the header
+    size_t record_size;             // Product of all dimensions but the first
+
+public:
+    // Magic numbers: two zero bytes, data type 0x08 (unsigned byte), number of dimensions
+    static constexpr uint32_t IMAGE_MAGIC = 0x00000803;
+    static constexpr uint32_t LABEL_MAGIC = 0x00000801;
+
+    // Map the file at path and check it against expected_magic; exits on any mismatch
+    idx_file(const std::string& path, uint32_t expected_magic);
+
+    idx_file(const idx_file&) = delete;
+    idx_file& operator=(const idx_file&) = delete;
+
+    const std::string& get_path() const { return path; }
+    const std::vector<uint32_t>& get_dimensions() const { return dimensions; }
+    size_t get_count() const { return dimensions[0]; }
+    size_t get_record_size() const { return record_size; }
+    bool is_compressed() const { return file == nullptr; }
+
+    // Payload of all records, get_count() x get_record_size() bytes
+    const uint8_t* data() const { return payload; }
+    span<const uint8_t> record(size_t i) const { return {payload + i * record_size, record_size}; }
+};
+
+// Sequential reader of an IDX file in batches of records, for files too large to map or hold in memory. The
+// header is validated like idx_file's; records are then read with buffered I/O into the caller's storage,
+// or inflated on the fly from a gzip-compressed file.
+class idx_stream
+{
+    std::string path;
+    std::ifstream file;
+    std::unique_ptr<gzip_reader> compressed; // Set for a compressed file, which is read through it instead
+    std::vector<uint32_t> dimensions;
+    size_t header_size = 0;
+    size_t record_size = 0;
+    size_t position = 0; // Records read so far
+
+public:
+    // Open the file at path and check it against expected_magic; exits on any mismatch
+    idx_stream(const std::string& path, uint32_t expected_magic);
+
+    const std::string& get_path() const { return path; }
+    const std::vector<uint32_t>& get_dimensions() const { return dimensions; }
+    size_t get_count() const { return dimensions[0]; }
+    size_t get_record_size() const { return record_size; }
+
+    // Read up to count records into out, which must hold count x get_record_size() bytes; returns the
+    // number of records read, 0 at the end of the file. Exits on a read error.
+    size_t read(uint8_t* out, size_t count);
+    // Continue from the first record again
+    void rewind();
+};
+
+#endif
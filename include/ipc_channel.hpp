@@ -0,0 +1,81 @@
+#ifndef __IPC_CHANNEL_HPP
+#define __IPC_CHANNEL_HPP
+
+#include <memory> // For std::unique_ptr and std::shared_ptr
+#include <string>
+#include <cstddef>
+
+// Byte streams between local processes, independent of the transport. An address picks it:
+// "unix:PATH" and "tcp:PORT" / "tcp:HOST:PORT" are sockets (socket_stream.hpp), "shm:NAME" a POSIX
+// shared memory segment holding one ring buffer per direction. Shared memory skips the kernel copy and
+// the system calls per message but connects exactly one client per listener.
+class ipc_channel
+{
+public:
+    virtual ~ipc_channel() = default;
+
+    // Send or receive exactly bytes bytes; false once the peer has closed or on any error
+    virtual bool send_all(const void* data, size_t bytes) = 0;
+    virtual bool receive_all(void* data, size_t bytes) = 0;
+
+    // Stop both directions, waking a thread blocked in receive_all
+    virtual void shutdown() = 0;
+};
+
+class ipc_listener
+{
+public:
+    virtual ~ipc_listener() = default;
+
+    // Wait up to timeout_ms for a client; nullptr on timeout
+    virtual std::unique_ptr<ipc_channel> accept(int timeout_ms) = 0;
+};
+
+// Listen on address; exits if it is malformed or taken
+std::unique_ptr<ipc_listener> listen_ipc(const std::string& address);
+
+// Connect to a listening address; nullptr with a message on std::cerr if that fails
+std::unique_ptr<ipc_channel> connect_ipc(const std::string& address);
+
+// Shared memory transport. The listener creates the segment; the one client that attaches gets the
+// other end, after which the name is removed. Waiting spins briefly, then yields and sleeps, so an idle
+// channel costs no CPU. A peer that dies without closing its end leaves the other waiting.
+// POSIX only; on Windows creating or attaching a segment fails.
+class shared_memory_channel : public ipc_channel
+{
+public:
+    struct mapping; // The mapped segment, shared by both ends within a process
+
+    shared_memory_channel(std::shared_ptr<mapping> segment, bool creator);
+    ~shared_memory_channel() override;
+
+    bool send_all(const void* data, size_t bytes) override;
+    bool receive_all(void* data, size_t bytes) override;
+    void shutdown() override;
+
+private:
+    std::shared_ptr<mapping> segment;
+    int outgoing; // Ring written by this end; the other one is read
+};
+
+class shared_memory_listener : public ipc_listener
+{
+    std::shared_ptr<shared_memory_channel::mapping> segment;
+    std::string name;
+    bool accepted = false;
+
+public:
+    // Bytes of each ring buffer
+    static constexpr size_t DEFAULT_CAPACITY = size_t(1) << 20;
+
+    // Create the segment NAME ("/name" in the POSIX namespace); exits if it exists or cannot be created
+    explicit shared_memory_listener(const std::string& name, size_t capacity = DEFAULT_CAPACITY);
+    ~shared_memory_listener() override;
+
+    std::unique_ptr<ipc_channel> accept(int timeout_ms) override;
+};
+
+// Attach to the segment created by a shared_memory_listener; nullptr with a message if that fails
+std::unique_ptr<ipc_channel> connect_shared_memory(const std::string& name);
+
+#endif // __IPC_CHANNEL_HPP
@@ -0,0 +1,92 @@
+#ifndef __LATENCY_HISTOGRAM_HPP
+#define __LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Log-bucketed histogram of durations in nanoseconds, for latency percentiles without keeping every
+// sample. Values below 64 are counted exactly; above that every power of two is split into 32 buckets,
+// so a reported percentile is within about 3% of the true value. Not synchronized.
+class latency_histogram
+{
+    static constexpr int SUB_BUCKETS = 32;
+    static constexpr int EXACT = 2 * SUB_BUCKETS;
+    static constexpr size_t BUCKETS = EXACT + 58 * SUB_BUCKETS;
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS, 0);
+    uint64_t total = 0;
+    uint64_t largest = 0;
+
+    static size_t bucket_of(uint64_t value)
+    {
+        if (value < EXACT)
+        {
+            return static_cast<size_t>(value);
+        }
+        // value >> shift lies in [SUB_BUCKETS, 2 * SUB_BUCKETS)
+        const int shift = 63 - __builtin_clzll(value) - 5;
+        return EXACT + (shift - 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+    }
+
+    // Middle of the range of values counted in bucket
+    static uint64_t value_of(size_t bucket)
+    {
+        if (bucket < static_cast<size_t>(EXACT))
+        {
+            return bucket;
+        }
+        const int shift = static_cast<int>((bucket - EXACT) / SUB_BUCKETS) + 1;
+        const uint64_t low = static_cast<uint64_t>((bucket - EXACT) % SUB_BUCKETS + SUB_BUCKETS) << shift;
+        return low + (uint64_t(1) << shift) / 2;
+    }
+
+public:
+    void record(uint64_t nanoseconds)
+    {
+        ++counts[bucket_of(nanoseconds)];
+        ++total;
+        largest = std::max(largest, nanoseconds);
+    }
+
+    void merge(const latency_histogram& other)
+    {
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            counts[b] += other.counts[b];
+        }
+        total += other.total;
+        largest = std::max(largest, other.largest);
+    }
+
+    void reset()
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = largest = 0;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return largest; }
+
+    // Value at or below which the given fraction (0 to 1) of the samples lie; 0 when empty
+    uint64_t percentile(double fraction) const
+    {
+        if (total == 0)
+        {
+            return 0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b)
+        {
+            seen += counts[b];
+            if (seen >= rank)
+            {
+                return std::min(value_of(b), largest);
+            }
+        }
+        return largest;
+    }
+};
+
+#endif // __LATENCY_HISTOGRAM_HPP
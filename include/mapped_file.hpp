@@ -0,0 +1,31 @@
+#ifndef __MAPPED_FILE_HPP
+#define __MAPPED_FILE_HPP
+
+#include "buffer.hpp" // For aligned_buffer
+#include <string>
+#include <cstdint>
+
+// A whole file mapped into memory, or read into an aligned buffer where memory mapping is unavailable.
+// A writable mapping is private (copy-on-write): writes change this process's view, never the file.
+class mapped_file
+{
+    std::string path;
+    void* mapping;                  // Start of the mapped file, nullptr if the file is empty or not mapped
+    size_t mapping_size;
+    aligned_buffer<uint8_t> buffer; // Fallback storage where memory mapping is unavailable
+
+public:
+    // Map the file at path; exits if it cannot be opened or mapped
+    explicit mapped_file(const std::string& path, bool writable = false);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const std::string& get_path() const { return path; }
+    size_t size() const { return mapping ? mapping_size : buffer.size(); }
+    const uint8_t* data() const { return mapping ? static_cast<const uint8_t*>(mapping) : buffer.data(); }
+    uint8_t* data() { return mapping ? static_cast<uint8_t*>(mapping) : buffer.data(); }
+};
+
+#endif // __MAPPED_FILE_HPP
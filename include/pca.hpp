@@ -0,0 +1,38 @@
+#ifndef __PCA_HPP
+#define __PCA_HPP
+
+#include "dataset.hpp" // For dataset_view and span
+#include <vector>
+
+// Principal component analysis of float rows. The covariance matrix is accumulated in parallel over
+// blocks of rows, the leading eigenvectors are found by subspace iteration, and a Jacobi solve of the
+// small projected matrix (Rayleigh-Ritz) separates them into individual components.
+class pca
+{
+    size_t feature_count = 0;
+    size_t component_count = 0;
+    std::vector<float> mean;        // Per feature
+    std::vector<float> components;  // component_count x feature_count, orthonormal rows, by decreasing variance
+    std::vector<double> variances;  // Variance along each component
+    double total_variance = 0.0;    // Sum of the per-feature variances
+
+public:
+    // Rows per block of the covariance accumulation
+    static constexpr size_t COVARIANCE_BLOCK = 64;
+    // Extra directions iterated beyond the requested components, which speeds up convergence
+    static constexpr size_t OVERSAMPLING = 10;
+
+    // Fit the leading component_count components of the normalized rows of view, stored at fp32
+    void fit(const dataset_view& view, size_t component_count, size_t iterations = 50);
+
+    // Project a row of feature_count features onto the components, writing component_count values
+    void project(const float* row, float* out) const;
+
+    size_t get_feature_count() const { return feature_count; }
+    size_t get_component_count() const { return component_count; }
+    const std::vector<double>& get_variances() const { return variances; }
+    // Fraction of the total variance the components retain
+    double explained_variance_ratio() const;
+};
+
+#endif // __PCA_HPP
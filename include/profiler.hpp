@@ -0,0 +1,110 @@
+#ifndef __PROFILER_HPP
+#define __PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Hardware counter values of one thread; all zero when the counters are off or unavailable
+struct counter_values
+{
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t llc_misses = 0; // Last-level cache misses
+};
+
+// Totals of one named phase over every time it was entered, on any thread
+struct phase_report
+{
+    std::string name;
+    uint64_t calls = 0;
+    double seconds = 0.0;
+    counter_values counters;
+};
+
+// Process-wide accumulator behind the PROFILE_PHASE scopes. Each phase is a fixed slot of atomics, so
+// recording a scope costs two clock reads and a few relaxed adds; with counters enabled, each end of a
+// scope also reads the calling thread's perf_event_open group (cycles, instructions, LLC misses).
+// Counters are per thread: a scope sees the work of the thread that opened it, so phases that fan out
+// over OpenMP threads are also opened inside the parallel loop where the counts matter (KNN scans).
+// Scopes nest and every phase reports inclusive time.
+class profiler
+{
+public:
+    static constexpr size_t MAX_PHASES = 64;
+
+    static profiler& instance();
+
+    // Slot of the phase called name, registered on first use
+    size_t register_phase(const char* name);
+    void record(size_t phase, uint64_t nanoseconds, const counter_values& counters);
+
+    // Read hardware counters in every scope. Opens the counters of the calling thread to check that
+    // the kernel allows it and returns false, with the reason in counter_error(), when it does not.
+    bool enable_counters(bool enabled);
+    bool counters_enabled() const { return counters_on.load(std::memory_order_relaxed); }
+    const std::string& counter_error() const { return counter_failure; }
+    // Counters of the calling thread since it first read them; zeros when disabled
+    counter_values read_counters();
+
+    // Write the JSON report to path when the process exits; empty for no report
+    void set_report_path(const std::string& path);
+
+    std::vector<phase_report> snapshot() const;
+    void reset();
+    void write_report(std::ostream& out) const;
+    bool write_report(const std::string& path) const;
+
+    ~profiler();
+
+private:
+    profiler();
+
+    struct phase_slot
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> nanoseconds{0};
+        std::atomic<uint64_t> cycles{0};
+        std::atomic<uint64_t> instructions{0};
+        std::atomic<uint64_t> llc_misses{0};
+    };
+
+    mutable std::mutex lock; // Guards registration and the report path
+    std::vector<std::string> names;
+    phase_slot phases[MAX_PHASES];
+    std::atomic<bool> counters_on{false};
+    std::string counter_failure;
+    std::string report_path;
+};
+
+// Times the enclosing scope into one phase
+class scoped_phase
+{
+    size_t phase;
+    std::chrono::steady_clock::time_point start;
+    counter_values counters_at_start;
+
+public:
+    explicit scoped_phase(size_t phase_id);
+    ~scoped_phase();
+
+    scoped_phase(const scoped_phase&) = delete;
+    scoped_phase& operator=(const scoped_phase&) = delete;
+};
+
+// PROFILE_PHASE("name") times the rest of the enclosing scope; building with -DNO_PROFILING removes it
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifdef NO_PROFILING
+#define PROFILE_PHASE(name) ((void)0)
+#else
+#define PROFILE_PHASE(name)                                                                                  \
+    static const size_t PROFILE_CONCAT(profile_phase_, __LINE__) = profiler::instance().register_phase(name); \
+    scoped_phase PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_phase_, __LINE__))
+#endif
+
+#endif // __PROFILER_HPP
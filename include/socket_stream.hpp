@@ -0,0 +1,52 @@
+#ifndef __SOCKET_STREAM_HPP
+#define __SOCKET_STREAM_HPP
+
+#include "ipc_channel.hpp"
+#include <memory> // For std::unique_ptr
+#include <string>
+#include <cstddef>
+
+// Local stream sockets, the socket transports of ipc_channel. An address is either
+// "unix:PATH", a Unix domain socket, or "tcp:PORT" / "tcp:HOST:PORT", TCP on the loopback interface
+// unless a host is given. Messages are framed by the caller; everything is sent in native byte order,
+// so both ends must run on the same kind of machine. POSIX only; on Windows opening a socket exits.
+
+// A connected socket, closed on destruction
+class socket_stream : public ipc_channel
+{
+    int fd;
+
+public:
+    explicit socket_stream(int descriptor) : fd(descriptor) {}
+    ~socket_stream() override;
+
+    socket_stream(const socket_stream&) = delete;
+    socket_stream& operator=(const socket_stream&) = delete;
+
+    bool send_all(const void* data, size_t bytes) override;
+    bool receive_all(void* data, size_t bytes) override;
+    void shutdown() override;
+};
+
+// A listening socket
+class socket_listener : public ipc_listener
+{
+    int fd;
+    std::string unix_path; // Unlinked on destruction
+
+public:
+    // Bind and listen on address; exits if the address is malformed or taken
+    explicit socket_listener(const std::string& address);
+    ~socket_listener() override;
+
+    socket_listener(const socket_listener&) = delete;
+    socket_listener& operator=(const socket_listener&) = delete;
+
+    // Wait up to timeout_ms for a connection; nullptr on timeout
+    std::unique_ptr<ipc_channel> accept(int timeout_ms) override;
+};
+
+// Connect to a listening address; nullptr with a message on std::cerr if nobody listens there
+std::unique_ptr<socket_stream> connect_socket(const std::string& address);
+
+#endif // __SOCKET_STREAM_HPP
@@ -0,0 +1,46 @@
+#ifndef __STREAM_INGEST_HPP
+#define __STREAM_INGEST_HPP
+
+#include "feature_stats.hpp" // For normalization_method
+#include <string>
+#include <cstdint>
+
+// Bounded-memory preparation of IDX datasets too large for RAM. Two passes stream the files in fixed-size
+// batches: the first accumulates the feature statistics and the class map, the second normalizes each
+// batch and writes it into shard files in the dataset cache format (dataset_cache.hpp), which
+// data_handler::load_cache opens. In the second pass reading the next batch, normalizing the current one
+// and writing the previous one overlap on separate threads, and the only large allocations are a fixed
+// set of batch buffers sized from the memory limit, so memory use does not grow with the dataset.
+struct ingest_options
+{
+    normalization_method method = normalization_method::z_score;
+    size_t memory_limit = size_t(256) << 20; // Bytes the batch buffers and per-shard arrays may take together
+    size_t shard_rows = size_t(1) << 20;     // Samples per shard file
+    uint64_t split_seed = 42;                // Seed of the training / test / validation assignment
+    double training_fraction = 0.75;
+    double test_fraction = 0.20;             // The rest is validation
+};
+
+struct ingest_report
+{
+    size_t samples = 0;
+    size_t shards = 0;
+    size_t batch_rows = 0;           // Samples per batch, chosen from the memory limit
+    size_t buffer_bytes = 0;         // Memory held by the pipeline
+    double statistics_seconds = 0.0; // First pass
+    double shard_seconds = 0.0;      // Second pass
+};
+
+// File of shard i written by stream_ingest under prefix
+std::string shard_path(const std::string& prefix, size_t shard);
+
+// Cache key of shard i, for data_handler::load_cache
+uint64_t shard_key(const std::string& images, const std::string& labels, const ingest_options& options, size_t shard);
+
+// Stream images and labels into shards prefix.0.cache, prefix.1.cache, ... Every sample is assigned to the
+// training, test or validation subset by a seeded hash of its row, so the split is the same for any batch
+// or shard size. Exits if the memory limit cannot hold a single batch.
+ingest_report stream_ingest(const std::string& images, const std::string& labels, const std::string& prefix,
+                            const ingest_options& options = {});
+
+#endif // __STREAM_INGEST_HPP
@@ -0,0 +1,83 @@
+#include "buffer.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm> // For std::min
+#include <cstring> // For std::memset
+#include <new> // For std::bad_alloc
+#ifdef _WIN32
+#include <malloc.h> // For _aligned_malloc
+#endif
+
+namespace
+{
+    std::atomic<size_t> aligned_allocations{0};
+}
+
+void* aligned_allocate(size_t bytes)
+{
+    aligned_allocations.fetch_add(1, std::memory_order_relaxed);
+    constexpr size_t alignment = 64;
+    // aligned_alloc requires the size to be a multiple of the alignment
+    size_t rounded = (bytes + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(rounded, alignment);
+#else
+    void* ptr = std::aligned_alloc(alignment, rounded);
+#endif
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    std::memset(ptr, 0, rounded);
+    return ptr;
+}
+
+void aligned_release(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+size_t aligned_allocation_count()
+{
+    return aligned_allocations.load(std::memory_order_relaxed);
+}
+
+void* arena::allocate_bytes(size_t bytes)
+{
+    constexpr size_t alignment = aligned_buffer<uint8_t>::ALIGNMENT;
+    bytes = (bytes + alignment - 1) / alignment * alignment;
+    if (bytes == 0)
+    {
+        bytes = alignment; // Distinct, valid pointers even for empty requests
+    }
+    if (blocks.empty() || used + bytes > blocks.back().size())
+    {
+        // Requests larger than a block get a block of their own size; the doubling keeps the block
+        // count logarithmic in the total when many small requests arrive
+        size_t block = bytes;
+        if (bytes <= next_block_size)
+        {
+            block = next_block_size;
+            next_block_size = std::min(next_block_size * 2, MAX_BLOCK_SIZE);
+        }
+        blocks.emplace_back(block);
+        used = 0;
+    }
+    void* ptr = blocks.back().data() + used;
+    used += bytes;
+    allocated += bytes;
+    return ptr;
+}
+
+void arena::reset()
+{
+    blocks.clear();
+    used = 0;
+    next_block_size = first_block_size;
+    allocated = 0;
+}
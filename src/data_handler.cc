@@ -1,363 +1,483 @@
-#include "data_handler.hpp"
-#include "data.hpp" 
-#include <algorithm>
-#include <random>
-#include <iostream>
-#include <stdexcept>
-#include <thread>
-#include <omp.h> // For OpenMP
-#include <iomanip> // For std::fixed and std::setprecision
-
-
-// Constructor
-data_handler::data_handler()
-    : data_array(std::make_unique<std::vector<std::unique_ptr<data>>>()),
-      training_data(std::make_unique<std::vector<std::unique_ptr<data>>>()),
-      test_data(std::make_unique<std::vector<std::unique_ptr<data>>>()),
-      validation_data(std::make_unique<std::vector<std::unique_ptr<data>>>())
-{
-    // Vectors are initialized as empty; no further action needed
-}
-
-// Destructor
-data_handler::~data_handler()
-{
-    // No manual deletion needed as smart pointers handle memory management
-}
-
-// Helper function to read big-endian uint32_t
-uint32_t data_handler::read_uint32(std::ifstream& file)
-{
-    uint32_t result = 0;
-    unsigned char bytes[4];
-    file.read(reinterpret_cast<char*>(bytes), 4);
-    if (!file)
-    {
-        std::cerr << "Error reading uint32 from file." << std::endl;
-        exit(1);
-    }
-    result = (static_cast<uint32_t>(bytes[0]) << 24) |
-             (static_cast<uint32_t>(bytes[1]) << 16) |
-             (static_cast<uint32_t>(bytes[2]) << 8) |
-             (static_cast<uint32_t>(bytes[3]));
-    return result;
-}
-
-// Load data from file
-void data_handler::read_feature_vector(const std::string& path)
-{
-    std::ifstream file(path, std::ios::binary);
-    if (!file)
-    {
-        std::cerr << "Could not open image file: " << path << std::endl;
-        exit(1);
-    }
-
-    uint32_t magic_number = read_uint32(file);
-    uint32_t num_images = read_uint32(file);
-    uint32_t num_rows = read_uint32(file);
-    uint32_t num_cols = read_uint32(file);
-
-    size_t image_size = num_rows * num_cols;
-
-    // Read all images into a buffer
-    std::vector<uint8_t> images(num_images * image_size);
-    file.read(reinterpret_cast<char*>(images.data()), images.size());
-
-    if (!file)
-    {
-        std::cerr << "Error reading image data from file." << std::endl;
-        exit(1);
-    }
-
-    // Resize temp_image_data
-    temp_image_data.resize(num_images);
-
-    // Fill temp_image_data
-    for (size_t i = 0; i < num_images; ++i)
-    {
-        temp_image_data[i].assign(images.begin() + i * image_size, images.begin() + (i + 1) * image_size);
-    }
-
-    std::cout << "Successfully read and stored " << temp_image_data.size() << " feature vectors." << std::endl;
-}
-
-// Read labels from file
-void data_handler::read_feature_labels(const std::string& path)
-{
-    std::ifstream file(path, std::ios::binary);
-    if (!file)
-    {
-        std::cerr << "Could not open label file: " << path << std::endl;
-        exit(1);
-    }
-
-    uint32_t magic_number = read_uint32(file);
-    uint32_t num_labels = read_uint32(file);
-
-    // Read all labels into temp_label_data
-    temp_label_data.resize(num_labels);
-    file.read(reinterpret_cast<char*>(temp_label_data.data()), num_labels);
-
-    if (!file)
-    {
-        std::cerr << "Error reading label data from file." << std::endl;
-        exit(1);
-    }
-
-    std::cout << "Successfully read and stored labels." << std::endl;
-}
-
-// Combine images and labels into data_array
-void data_handler::combine_data()
-{
-    if (temp_image_data.size() != temp_label_data.size())
-    {
-        std::cerr << "Mismatch between number of images and labels." << std::endl;
-        exit(1);
-    }
-
-    data_array->reserve(temp_image_data.size());
-
-    for (size_t i = 0; i < temp_image_data.size(); ++i)
-    {
-        auto d = std::make_unique<data>();
-        d->set_feature_vector(temp_image_data[i]);
-        d->set_label(temp_label_data[i]);
-        data_array->emplace_back(std::move(d));
-    }
-
-    // Clear temporary data
-    temp_image_data.clear();
-    temp_label_data.clear();
-}
-
-// Split data into training, test, and validation sets according to the percentages
-void data_handler::split_data()
-{
-    size_t total_size = data_array->size();
-    size_t train_size = static_cast<size_t>(total_size * TRAIN_SET_PERCENT);
-    size_t test_size = static_cast<size_t>(total_size * TEST_SET_PERCENT);
-    size_t valid_size = total_size - train_size - test_size;
-
-    // Initialize random number generator
-    std::random_device rd;
-    std::mt19937 g(rd());
-
-    // Shuffle the data_array
-    std::shuffle(data_array->begin(), data_array->end(), g);
-
-    // Split the data by moving unique_ptrs to respective vectors
-    // Training Data
-    for (size_t i = 0; i < train_size; ++i)
-    {
-        training_data->emplace_back(std::move((*data_array)[i]));
-    }
-
-    // Test Data
-    for (size_t i = train_size; i < train_size + test_size; ++i)
-    {
-        test_data->emplace_back(std::move((*data_array)[i]));
-    }
-
-    // Validation Data
-    for (size_t i = train_size + test_size; i < total_size; ++i)
-    {
-        validation_data->emplace_back(std::move((*data_array)[i]));
-    }
-
-    // Clear the original data_array as ownership has been moved
-    data_array->clear();
-
-    std::cout << "Training Data Size: " << training_data->size() << "." << std::endl;
-    std::cout << "Test Data Size: " << test_data->size() << "." << std::endl;
-    std::cout << "Validation Data Size: " << validation_data->size() << "." << std::endl;
-}
-
-void data_handler::count_classes()
-{
-    // Loop over each data point and build the class mapping
-    for (const auto& data_ptr : *data_array)
-    {
-        uint8_t label = data_ptr->get_label();
-        auto result = classFromInt.try_emplace(label, classFromInt.size());
-        data_ptr->set_enumerated_label(result.first->second);
-    }
-
-    // Set the total number of unique classes
-    class_counts = static_cast<int>(classFromInt.size());
-
-    // Update each data point with the class vector
-    for (const auto& data_ptr : *data_array)
-    {
-        data_ptr->set_class_vector(class_counts);
-    }
-
-    std::cout << "Successfully Extracted " << class_counts << " Unique Classes." << std::endl;
-}
-
-
-void data_handler::normalize()
-{
-    size_t n = data_array->size();
-    if(n == 0) {
-        std::cerr << "No data to normalize." << std::endl;
-        return;
-    }
-
-    // Initialize mean and M2 vectors using float for efficiency
-    std::vector<float> mean(feature_vector_size, 0.0f);
-    std::vector<float> M2(feature_vector_size, 0.0f);
-
-    // Compute mean and M2 using Welford's algorithm in a single pass
-    // Parallelize the outer loop
-    #pragma omp parallel for
-    for(long long idx = 0; idx < static_cast<long long>(n); ++idx)
-    {
-        const auto& data_ptr = (*data_array)[idx];
-        const auto& feature_vector = data_ptr->get_feature_vector();
-        for(size_t i = 0; i < feature_vector_size; ++i)
-        {
-            float x = static_cast<float>(feature_vector[i]);
-            float delta = x - mean[i];
-            #pragma omp atomic
-            mean[i] += delta / static_cast<float>(n);
-            float delta2 = x - mean[i];
-            #pragma omp atomic
-            M2[i] += delta * delta2;
-        }
-    }
-
-    // Compute standard deviation
-    std::vector<float> std_dev(feature_vector_size, 0.0f);
-    #pragma omp parallel for
-    for(size_t i = 0; i < feature_vector_size; ++i)
-    {
-        if(n < 2)
-            std_dev[i] = 0.0f;
-        else
-            std_dev[i] = std::sqrt(M2[i] / static_cast<float>(n - 1));
-    }
-
-    // Handle zero standard deviation to avoid division by zero
-    #pragma omp parallel for
-    for(size_t i = 0; i < feature_vector_size; ++i)
-    {
-        if(std_dev[i] == 0.0f)
-        {
-            std_dev[i] = 1.0f; // Alternatively, assign a small epsilon value
-            #pragma omp critical
-            {
-                std::cerr << "Feature " << i << " has zero standard deviation. Adjusted to 1.0 to avoid division by zero." << std::endl;
-            }
-        }
-    }
-
-    // Normalize the feature vectors
-    #pragma omp parallel for
-    for(long long idx = 0; idx < static_cast<long long>(n); ++idx)
-    {
-        auto& data_ptr = (*data_array)[idx];
-        auto normalized_feature_vector = std::make_unique<std::vector<float>>(feature_vector_size, 0.0f);
-        const auto& feature_vector = data_ptr->get_feature_vector();
-        for(size_t j = 0; j < feature_vector_size; ++j)
-        {
-            normalized_feature_vector->at(j) = (static_cast<float>(feature_vector[j]) - mean[j]) / std_dev[j];
-        }
-        data_ptr->set_normalized_feature_vector(std::move(normalized_feature_vector));
-    }
-
-    std::cout << "Data normalization completed successfully." << std::endl;
-}
-
-
-void data_handler::print()
-{
-    // Lambda function to print a dataset
-    auto print_dataset = [](const std::string& dataset_name, const std::vector<std::unique_ptr<data>>& dataset) {
-        std::cout << dataset_name << " Data:\n";
-        std::cout << std::fixed << std::setprecision(3); // Set floating-point precision
-        for(const auto& data_ptr : dataset)
-        {
-            const auto& normalized_features = data_ptr->get_normalized_feature_vector();
-            for(const auto& value : normalized_features)
-            {
-                std::cout << value << ",";
-            }
-            std::cout << " -> " << static_cast<int>(data_ptr->get_label()) << "\n";
-        }
-        std::cout << std::defaultfloat << "\n"; // Reset to default formatting and add a newline for readability
-    };
-
-    // Print each dataset using the lambda
-    print_dataset("Training", *training_data);
-    print_dataset("Test", *test_data);
-    print_dataset("Validation", *validation_data);
-}
-
-// Getters (Accessors)
-std::vector<std::unique_ptr<data>>* data_handler::get_training_data()
-{
-    return training_data.get();
-}
-
-std::vector<std::unique_ptr<data>>* data_handler::get_test_data()
-{
-    return test_data.get();
-}
-
-std::vector<std::unique_ptr<data>>* data_handler::get_validation_data()
-{
-    return validation_data.get();
-}
-
-int data_handler::get_class_counts()
-{
-    return class_counts;
-}
-
-int data_handler::get_data_array_size()
-{
-    return static_cast<int>(data_array->size());
-}
-
-int data_handler::get_training_data_size()
-{
-    return static_cast<int>(training_data->size());
-}
-
-int data_handler::get_test_data_size()
-{
-    return static_cast<int>(test_data->size());
-}
-
-int data_handler::get_validation_size()
-{
-    return static_cast<int>(validation_data->size());
-}
-
-// Updated main function using smart pointers
-int main()
-{
-    // Use unique_ptr to manage data_handler
-    auto dh = std::make_unique<data_handler>();
-
-    // Read images and labels in parallel
-    std::future<void> future_images = std::async(std::launch::async, &data_handler::read_feature_vector, dh.get(), "./data/train-images.idx3-ubyte");
-    std::future<void> future_labels = std::async(std::launch::async, &data_handler::read_feature_labels, dh.get(), "./data/train-labels.idx1-ubyte");
-
-    // Wait for both to finish
-    future_images.get();
-    future_labels.get();
-
-    // Combine data
-    dh->combine_data();
-
-    dh->count_classes();
-
-    dh->split_data();
-
-    // No need to manually delete dh; it will be automatically cleaned up
-
-    return 0;
-}
+#include "data_handler.hpp"
+#include "dataset_cache.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <omp.h> // For OpenMP
+#include <iomanip> // For std::fixed and std::setprecision
+#include <sstream> // For std::ostringstream
+#include <numeric> // For std::iota
+#include <cmath>
+#include <chrono>  // For timing cache loads
+#include <cstring> // For std::memcpy
+
+
+// Constructor
+data_handler::data_handler()
+    : data_array(std::make_unique<dataset>()),
+      class_counts(0),
+      feature_vector_size(0)
+{
+    // Dataset and views are initialized as empty; no further action needed
+    split_settings.training_fraction = TRAIN_SET_PERCENT;
+    split_settings.test_fraction = TEST_SET_PERCENT;
+}
+
+// Destructor
+data_handler::~data_handler()
+{
+    // No manual deletion needed as smart pointers handle memory management
+}
+
+// Map the image file; the header is validated against the IDX image format
+void data_handler::read_feature_vector(const std::string& path)
+{
+    PROFILE_PHASE("read_images");
+    temp_image_data = std::make_shared<idx_file>(path, idx_file::IMAGE_MAGIC);
+
+    const auto& dims = temp_image_data->get_dimensions();
+    if (dims.size() != 3)
+    {
+        std::cerr << "Expected 3 image dimensions in " << path << ", found " << dims.size() << "." << std::endl;
+        exit(1);
+    }
+
+    std::cout << "Successfully " << (temp_image_data->is_compressed() ? "decompressed " : "mapped ") << temp_image_data->get_count() << " feature vectors of "
+              << dims[1] << "x" << dims[2] << " pixels." << std::endl;
+}
+
+// Map the label file; the header is validated against the IDX label format
+void data_handler::read_feature_labels(const std::string& path)
+{
+    PROFILE_PHASE("read_labels");
+    temp_label_data = std::make_shared<idx_file>(path, idx_file::LABEL_MAGIC);
+
+    std::cout << "Successfully " << (temp_label_data->is_compressed() ? "decompressed " : "mapped ") << temp_label_data->get_count() << " labels." << std::endl;
+}
+
+// Combine images and labels into data_array
+void data_handler::combine_data()
+{
+    PROFILE_PHASE("combine_data");
+    if (!temp_image_data || !temp_label_data)
+    {
+        std::cerr << "Images and labels must be read before combining." << std::endl;
+        exit(1);
+    }
+
+    // The dataset serves pixels and labels straight from the mapped files; nothing is copied
+    data_array->attach(std::move(temp_image_data), std::move(temp_label_data));
+    feature_vector_size = static_cast<int>(data_array->get_feature_count());
+}
+
+// Split data into training, test, and validation sets; only row indices are shuffled, the samples never move
+void data_handler::split_data()
+{
+    PROFILE_PHASE("split_data");
+    apply_split(holdout_split(*data_array, split_settings));
+}
+
+void data_handler::apply_split(split_indices split)
+{
+    training_data = dataset_view(data_array.get(), std::move(split.training));
+    test_data = dataset_view(data_array.get(), std::move(split.test));
+    validation_data = dataset_view(data_array.get(), std::move(split.validation));
+
+    std::cout << "Training Data Size: " << training_data.size() << "." << std::endl;
+    std::cout << "Test Data Size: " << test_data.size() << "." << std::endl;
+    std::cout << "Validation Data Size: " << validation_data.size() << "." << std::endl;
+}
+
+void data_handler::set_split_options(const split_options& options)
+{
+    split_settings = options;
+}
+
+const split_options& data_handler::get_split_options() const
+{
+    return split_settings;
+}
+
+void data_handler::count_classes()
+{
+    PROFILE_PHASE("count_classes");
+    // Loop over each data point and build the class mapping
+    for (size_t i = 0; i < data_array->size(); ++i)
+    {
+        uint8_t label = data_array->get_label(i);
+        auto result = classFromInt.try_emplace(label, classFromInt.size());
+        data_array->set_enumerated_label(i, result.first->second);
+    }
+
+    // Set the total number of unique classes
+    class_counts = static_cast<int>(classFromInt.size());
+    data_array->set_class_count(classFromInt.size());
+
+    std::cout << "Successfully Extracted " << class_counts << " Unique Classes." << std::endl;
+}
+
+
+void data_handler::normalize(normalization_method method)
+{
+    PROFILE_PHASE("normalize");
+    size_t n = data_array->size();
+    if(n == 0) {
+        std::cerr << "No data to normalize." << std::endl;
+        return;
+    }
+
+    // Per-feature statistics in one parallel pass over the raw matrix
+    const size_t feature_count = data_array->get_feature_count();
+    statistics = compute_feature_stats({data_array->raw_row(0).data(), n * feature_count}, feature_count);
+
+    // Both scalings are (x - offset) * scale; precompute them per feature
+    std::vector<float> offset, scale;
+    statistics.scaling(method, offset, scale);
+
+    // Normalize the feature vectors into the dataset's normalized matrix, at the chosen precision
+    data_array->allocate_normalized(precision);
+    const float* off = offset.data();
+    const float* sc = scale.data();
+    const bool bf16 = precision == feature_precision::bf16;
+    #pragma omp parallel for schedule(static)
+    for(long long idx = 0; idx < static_cast<long long>(n); ++idx)
+    {
+        const uint8_t* feature_vector = data_array->raw_row(idx).data();
+        if(precision == feature_precision::fp32)
+        {
+            float* normalized_feature_vector = data_array->normalized_row(idx).data();
+            #pragma omp simd
+            for(size_t j = 0; j < feature_count; ++j)
+            {
+                normalized_feature_vector[j] = (static_cast<float>(feature_vector[j]) - off[j]) * sc[j];
+            }
+        }
+        else
+        {
+            uint16_t* half_feature_vector = data_array->half_row(idx).data();
+            for(size_t j = 0; j < feature_count; ++j)
+            {
+                const float value = (static_cast<float>(feature_vector[j]) - off[j]) * sc[j];
+                half_feature_vector[j] = bf16 ? float_to_bf16(value) : float_to_fp16(value);
+            }
+        }
+    }
+
+    std::cout << "Data normalization completed successfully." << std::endl;
+}
+
+void data_handler::set_feature_precision(feature_precision p)
+{
+    precision = p;
+    data_array->set_normalized_precision(p);
+}
+
+void data_handler::reduce_dimensions(size_t components)
+{
+    PROFILE_PHASE("reduce_dimensions");
+    size_t n = data_array->size();
+    if(n == 0 || !data_array->is_normalized()) {
+        std::cerr << "Normalize the data before reducing its dimensions." << std::endl;
+        exit(1);
+    }
+
+    // The fit and the projection read float rows
+    data_array->set_normalized_precision(feature_precision::fp32);
+
+    // Fit on the training rows only, so test and validation stay unseen
+    if(!training_data.empty())
+    {
+        projection.fit(training_data, components);
+    }
+    else
+    {
+        std::vector<uint32_t> rows(n);
+        std::iota(rows.begin(), rows.end(), 0);
+        projection.fit(dataset_view(data_array.get(), std::move(rows)), components);
+    }
+
+    // Project every row into a new contiguous matrix; the views keep pointing at the same rows
+    const size_t width = projection.get_component_count();
+    aligned_buffer<float> projected(n * width);
+    #pragma omp parallel for schedule(static)
+    for(long long idx = 0; idx < static_cast<long long>(n); ++idx)
+    {
+        projection.project(data_array->normalized_row(idx).data(), projected.data() + idx * width);
+    }
+    data_array->replace_normalized(projected, width);
+    data_array->set_normalized_precision(precision);
+
+    const std::ios_base::fmtflags flags = std::cout.flags();
+    const std::streamsize precision = std::cout.precision();
+    std::cout << "Reduced " << data_array->get_feature_count() << " features to " << width << " principal components ("
+              << std::fixed << std::setprecision(1) << 100.0 * projection.explained_variance_ratio()
+              << "% of the variance retained)." << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+
+void data_handler::print()
+{
+    // Lambda function to print a dataset
+    auto print_dataset = [](const std::string& dataset_name, const dataset_view& view) {
+        std::cout << dataset_name << " Data:\n";
+        std::cout << std::fixed << std::setprecision(3); // Set floating-point precision
+        std::vector<float> row(view.get_normalized_feature_count());
+        for(size_t i = 0; i < view.size(); ++i)
+        {
+            view.widen_normalized_row(i, row.data());
+            for(const auto& value : row)
+            {
+                std::cout << value << ",";
+            }
+            std::cout << " -> " << static_cast<int>(view.get_label(i)) << "\n";
+        }
+        std::cout << std::defaultfloat << "\n"; // Reset to default formatting and add a newline for readability
+    };
+
+    // Print each dataset using the lambda
+    print_dataset("Training", training_data);
+    print_dataset("Test", test_data);
+    print_dataset("Validation", validation_data);
+}
+
+bool data_handler::load_or_prepare(const std::string& images, const std::string& labels, const std::string& cache_path,
+                                   normalization_method method)
+{
+    // Everything that changes the prepared dataset goes into the key
+    std::ostringstream parameters;
+    parameters << (method == normalization_method::z_score ? "z_score" : "min_max") << " "
+               << split_settings.training_fraction << " " << split_settings.test_fraction << " "
+               << split_settings.seed << " " << (split_settings.stratified ? "stratified" : "shuffled");
+    // The normalized rows are cached at their precision; fp32 keeps the key of caches written before precisions existed
+    if(precision != feature_precision::fp32)
+    {
+        parameters << (precision == feature_precision::fp16 ? " fp16" : " bf16");
+    }
+    const uint64_t key = cache_key({images, labels}, parameters.str());
+
+    auto start = std::chrono::steady_clock::now();
+    if(!cache_path.empty() && load_cache(cache_path, key))
+    {
+        std::cout << "Loaded " << data_array->size() << " prepared samples from " << cache_path << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms." << std::endl;
+        return true;
+    }
+
+    read_feature_vector(images);
+    read_feature_labels(labels);
+    combine_data();
+    count_classes();
+    normalize(method);
+    split_data();
+    if(!cache_path.empty() && save_cache(cache_path, key))
+    {
+        std::cout << "Wrote dataset cache " << cache_path << "." << std::endl;
+    }
+    return false;
+}
+
+bool data_handler::save_cache(const std::string& path, uint64_t key) const
+{
+    PROFILE_PHASE("save_cache");
+    const size_t n = data_array->size();
+    if(n == 0 || !data_array->is_normalized())
+    {
+        std::cerr << "Only a normalized dataset can be cached." << std::endl;
+        return false;
+    }
+    const size_t feature_count = data_array->get_feature_count();
+    const size_t width = data_array->get_normalized_feature_count();
+
+    std::vector<uint8_t> labels(n);
+    std::vector<int32_t> enumerated(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        labels[i] = data_array->get_label(i);
+        enumerated[i] = data_array->get_enumerated_label(i);
+    }
+    const std::vector<uint8_t> class_labels = get_class_labels();
+    std::vector<uint32_t> split;
+    for(const dataset_view* view : {&training_data, &test_data, &validation_data})
+    {
+        split.insert(split.end(), view->get_indices().begin(), view->get_indices().end());
+    }
+
+    cache_header header = {};
+    header.key = key;
+    header.sample_count = n;
+    header.feature_count = feature_count;
+    header.normalized_feature_count = width;
+    header.class_count = class_labels.size();
+    header.stats_count = statistics.count;
+    header.training_count = training_data.size();
+    header.test_count = test_data.size();
+    header.validation_count = validation_data.size();
+
+    const cache_section_data sections[CACHE_SECTION_COUNT] = {
+        {data_array->raw_row(0).data(), n * feature_count},
+        {labels.data(), n},
+        {enumerated.data(), n * sizeof(int32_t)},
+        {class_labels.data(), class_labels.size()},
+        {statistics.mean.data(), statistics.mean.size() * sizeof(double)},
+        {statistics.m2.data(), statistics.m2.size() * sizeof(double)},
+        {statistics.minimum.data(), statistics.minimum.size()},
+        {statistics.maximum.data(), statistics.maximum.size()},
+        {data_array->get_normalized_precision() == feature_precision::fp32 ? static_cast<const void*>(data_array->normalized_row(0).data())
+                                                                            : data_array->half_row(0).data(),
+         n * width * precision_bytes(data_array->get_normalized_precision())},
+        {split.data(), split.size() * sizeof(uint32_t)},
+    };
+    return write_cache(path, header, sections);
+}
+
+bool data_handler::load_cache(const std::string& path, uint64_t key)
+{
+    PROFILE_PHASE("load_cache");
+    std::shared_ptr<mapped_file> file = open_cache(path, key);
+    if(!file)
+    {
+        return false;
+    }
+    cache_header header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    // The checksums prove the file is intact; the sizes must still agree with the dimensions it claims
+    const size_t n = header.sample_count;
+    const size_t feature_count = header.feature_count;
+    const size_t width = header.normalized_feature_count;
+    const size_t classes = header.class_count;
+    const size_t expected[CACHE_SECTION_COUNT] = {
+        n * feature_count, n, n * sizeof(int32_t), classes,
+        feature_count * sizeof(double), feature_count * sizeof(double), feature_count, feature_count,
+        n * width * precision_bytes(precision), n * sizeof(uint32_t),
+    };
+    const size_t limit = file->size();
+    bool consistent = n > 0 && n <= limit && feature_count <= limit && width <= limit && classes <= limit &&
+                      header.training_count + header.test_count + header.validation_count == n;
+    for(uint32_t s = 0; s < CACHE_SECTION_COUNT; ++s)
+    {
+        consistent = consistent && header.sections[s].bytes == expected[s];
+    }
+    uint8_t* base = file->data();
+    auto section = [&](cache_section s) { return base + header.sections[s].offset; };
+    std::vector<int32_t> enumerated(n);
+    std::vector<uint32_t> split(n);
+    if(consistent)
+    {
+        std::memcpy(enumerated.data(), section(CACHE_ENUMERATED_LABELS), n * sizeof(int32_t));
+        std::memcpy(split.data(), section(CACHE_SPLIT_INDICES), n * sizeof(uint32_t));
+        for(size_t i = 0; i < n; ++i)
+        {
+            consistent = consistent && enumerated[i] >= 0 && static_cast<size_t>(enumerated[i]) < classes && split[i] < n;
+        }
+    }
+    if(!consistent)
+    {
+        std::cerr << "Dataset cache sections do not match its dimensions: " << path << std::endl;
+        return false;
+    }
+
+    // Both matrices are served from the mapping; only the small arrays are copied out
+    data_array->attach_cache(file, n, feature_count, width, section(CACHE_RAW_FEATURES), section(CACHE_LABELS),
+                             section(CACHE_NORMALIZED_FEATURES), precision);
+    for(size_t i = 0; i < n; ++i)
+    {
+        data_array->set_enumerated_label(i, enumerated[i]);
+    }
+    feature_vector_size = static_cast<int>(feature_count);
+
+    classFromInt.clear();
+    const uint8_t* class_labels = section(CACHE_CLASS_LABELS);
+    for(size_t c = 0; c < classes; ++c)
+    {
+        classFromInt[class_labels[c]] = static_cast<int>(c);
+    }
+    class_counts = static_cast<int>(classes);
+    data_array->set_class_count(classes);
+
+    statistics.reset(feature_count);
+    statistics.count = header.stats_count;
+    std::memcpy(statistics.mean.data(), section(CACHE_STATS_MEAN), feature_count * sizeof(double));
+    std::memcpy(statistics.m2.data(), section(CACHE_STATS_M2), feature_count * sizeof(double));
+    std::memcpy(statistics.minimum.data(), section(CACHE_STATS_MINIMUM), feature_count);
+    std::memcpy(statistics.maximum.data(), section(CACHE_STATS_MAXIMUM), feature_count);
+
+    const uint32_t* rows = split.data();
+    training_data = dataset_view(data_array.get(), std::vector<uint32_t>(rows, rows + header.training_count));
+    rows += header.training_count;
+    test_data = dataset_view(data_array.get(), std::vector<uint32_t>(rows, rows + header.test_count));
+    rows += header.test_count;
+    validation_data = dataset_view(data_array.get(), std::vector<uint32_t>(rows, rows + header.validation_count));
+    return true;
+}
+
+// Getters (Accessors)
+const dataset& data_handler::get_data_array() const
+{
+    return *data_array;
+}
+
+std::vector<uint8_t> data_handler::get_class_labels() const
+{
+    std::vector<uint8_t> class_labels(classFromInt.size());
+    for(const auto& entry : classFromInt)
+    {
+        class_labels[entry.second] = entry.first;
+    }
+    return class_labels;
+}
+
+const feature_stats& data_handler::get_feature_stats() const
+{
+    return statistics;
+}
+
+const pca& data_handler::get_pca() const
+{
+    return projection;
+}
+
+const dataset_view& data_handler::get_training_data() const
+{
+    return training_data;
+}
+
+const dataset_view& data_handler::get_test_data() const
+{
+    return test_data;
+}
+
+const dataset_view& data_handler::get_validation_data() const
+{
+    return validation_data;
+}
+
+int data_handler::get_class_counts()
+{
+    return class_counts;
+}
+
+int data_handler::get_data_array_size()
+{
+    return static_cast<int>(data_array->size());
+}
+
+int data_handler::get_training_data_size()
+{
+    return static_cast<int>(training_data.size());
+}
+
+int data_handler::get_test_data_size()
+{
+    return static_cast<int>(test_data.size());
+}
+
+int data_handler::get_validation_size()
+{
+    return static_cast<int>(validation_data.size());
+}
@@ -0,0 +1,207 @@
+#include "dataset.hpp"
+#include "idx_file.hpp"
+#include "mapped_file.hpp"
+#include <algorithm> // For std::fill
+#include <iostream>
+#include <cstring> // For std::memcpy
+
+void dataset::attach(std::shared_ptr<const idx_file> images, std::shared_ptr<const idx_file> sample_labels)
+{
+    if (images->get_count() != sample_labels->get_count() || sample_labels->get_record_size() != 1)
+    {
+        std::cerr << "Mismatch between number of images and labels." << std::endl;
+        exit(1);
+    }
+
+    sample_count = images->get_count();
+    feature_count = images->get_record_size();
+    raw_features = images->data();
+    labels = sample_labels->data();
+    image_file = std::move(images);
+    label_file = std::move(sample_labels);
+    cache_file.reset();
+    storage.reset();
+    enumerated_labels = storage.allocate<int>(sample_count);
+    normalized_features = nullptr;
+    normalized_precision = feature_precision::fp32;
+    normalized_capacity = 0;
+    normalized_feature_count = 0;
+    class_vectors = nullptr;
+    class_count = 0;
+    class_capacity = 0;
+}
+
+void dataset::attach_cache(std::shared_ptr<mapped_file> file, size_t count, size_t features, size_t normalized_width,
+                           const uint8_t* raw, const uint8_t* sample_labels, void* normalized, feature_precision precision)
+{
+    sample_count = count;
+    feature_count = features;
+    normalized_feature_count = normalized_width;
+    raw_features = raw;
+    labels = sample_labels;
+    normalized_features = normalized;
+    normalized_precision = precision;
+    image_file.reset();
+    label_file.reset();
+    cache_file = std::move(file);
+    storage.reset();
+    enumerated_labels = storage.allocate<int>(sample_count);
+    normalized_capacity = 0;
+    class_vectors = nullptr;
+    class_count = 0;
+    class_capacity = 0;
+}
+
+void dataset::allocate_normalized(feature_precision precision)
+{
+    normalized_feature_count = feature_count;
+    normalized_precision = precision;
+    // Normalizing again (e.g. after PCA) reuses the matrix in the arena, as replace_normalized does
+    const size_t bytes = sample_count * feature_count * precision_bytes(precision);
+    if (bytes > normalized_capacity)
+    {
+        normalized_capacity = bytes;
+        normalized_features = storage.allocate_bytes(bytes);
+    }
+}
+
+namespace
+{
+    uint16_t narrow(float value, feature_precision precision)
+    {
+        return precision == feature_precision::bf16 ? float_to_bf16(value) : float_to_fp16(value);
+    }
+
+    float widen(uint16_t value, feature_precision precision)
+    {
+        return precision == feature_precision::bf16 ? bf16_to_float(value) : fp16_to_float(value);
+    }
+}
+
+void dataset::set_normalized_precision(feature_precision precision)
+{
+    if (!is_normalized() || precision == normalized_precision)
+    {
+        return;
+    }
+
+    const feature_precision from = normalized_precision;
+    const long long values = static_cast<long long>(sample_count * normalized_feature_count);
+    const size_t bytes = values * precision_bytes(precision);
+    // A mapped cache matrix is never written, and widening needs twice the bytes of a half matrix
+    const bool in_place = bytes <= normalized_capacity;
+    void* target = in_place ? normalized_features : storage.allocate_bytes(bytes);
+    const float* floats = static_cast<const float*>(normalized_features);
+    const uint16_t* halves = static_cast<const uint16_t*>(normalized_features);
+    float* wide = static_cast<float*>(target);
+    uint16_t* narrow_values = static_cast<uint16_t*>(target);
+
+    if (in_place && from == feature_precision::fp32)
+    {
+        // Value v moves from byte 4v to byte 2v: front to back, every float is read before it is overwritten
+        for (long long v = 0; v < values; ++v)
+        {
+            narrow_values[v] = narrow(floats[v], precision);
+        }
+    }
+    else if (in_place && precision == feature_precision::fp32)
+    {
+        // Value v moves from byte 2v to byte 4v: back to front, for the same reason
+        for (long long v = values - 1; v >= 0; --v)
+        {
+            wide[v] = widen(halves[v], from);
+        }
+    }
+    else
+    {
+        // Out of place, or between fp16 and bf16 where every value keeps its bytes
+        #pragma omp parallel for schedule(static)
+        for (long long v = 0; v < values; ++v)
+        {
+            if (precision == feature_precision::fp32)
+            {
+                wide[v] = widen(halves[v], from);
+            }
+            else
+            {
+                narrow_values[v] = narrow(from == feature_precision::fp32 ? floats[v] : widen(halves[v], from), precision);
+            }
+        }
+    }
+
+    if (!in_place)
+    {
+        normalized_capacity = bytes;
+        normalized_features = target;
+    }
+    normalized_precision = precision;
+}
+
+void dataset::widen_normalized_row(size_t i, float* out) const
+{
+    if (normalized_precision == feature_precision::fp32)
+    {
+        std::memcpy(out, normalized_row(i).data(), normalized_feature_count * sizeof(float));
+        return;
+    }
+    const span<const uint16_t> row = half_row(i);
+    for (size_t f = 0; f < row.size(); ++f)
+    {
+        out[f] = widen(row[f], normalized_precision);
+    }
+}
+
+void dataset::replace_normalized(const aligned_buffer<float>& features, size_t width)
+{
+    if (features.size() != sample_count * width)
+    {
+        std::cerr << "Replacement features do not match the number of samples." << std::endl;
+        exit(1);
+    }
+    // A mapped cache matrix is never written; its replacement goes to the arena
+    const size_t bytes = features.size() * sizeof(float);
+    if (bytes > normalized_capacity)
+    {
+        normalized_capacity = bytes;
+        normalized_features = storage.allocate_bytes(bytes);
+    }
+    std::memcpy(normalized_features, features.data(), bytes);
+    normalized_feature_count = width;
+    normalized_precision = feature_precision::fp32;
+}
+
+void dataset::set_class_count(size_t classes)
+{
+    // Counting the classes again reuses the table, as allocate_normalized does the matrix
+    if (classes * classes > class_capacity)
+    {
+        class_capacity = classes * classes;
+        class_vectors = storage.allocate<int>(class_capacity);
+    }
+    std::fill(class_vectors, class_vectors + classes * classes, 0);
+    for (size_t c = 0; c < classes; ++c)
+    {
+        class_vectors[c * classes + c] = 1;
+    }
+    class_count = classes;
+}
+
+void dataset::clear()
+{
+    sample_count = 0;
+    feature_count = 0;
+    normalized_feature_count = 0;
+    image_file.reset();
+    label_file.reset();
+    cache_file.reset();
+    raw_features = nullptr;
+    labels = nullptr;
+    storage.reset();
+    normalized_features = nullptr;
+    normalized_precision = feature_precision::fp32;
+    normalized_capacity = 0;
+    enumerated_labels = nullptr;
+    class_vectors = nullptr;
+    class_count = 0;
+    class_capacity = 0;
+}
@@ -0,0 +1,263 @@
+#include "dataset_cache.hpp"
+#include <algorithm>  // For std::min
+#include <cstddef>    // For offsetof
+#include <cstring>    // For std::memcpy
+#include <filesystem> // For file sizes, modification times and rename
+#include <fstream>
+#include <iostream>
+#include <omp.h>      // For OpenMP
+
+namespace
+{
+    constexpr uint64_t PRIME = 0x9E3779B97F4A7C15ULL;
+
+    // splitmix64 finalizer
+    uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t rotate_left(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    // Four independent lanes of 8-byte words keep several multiplies in flight
+    uint64_t hash_chunk(const uint8_t* bytes, size_t size)
+    {
+        uint64_t lanes[4] = {PRIME, PRIME + 1, PRIME + 2, PRIME + 3};
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            for (int l = 0; l < 4; ++l)
+            {
+                uint64_t word;
+                std::memcpy(&word, bytes + i + 8 * l, sizeof(word));
+                lanes[l] = rotate_left(lanes[l] ^ word, 31) * PRIME;
+            }
+        }
+        uint64_t hash = mix(size);
+        for (uint64_t lane : lanes)
+        {
+            hash = mix(hash ^ lane);
+        }
+        for (; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * PRIME;
+        }
+        return mix(hash);
+    }
+
+    size_t align_up(size_t offset)
+    {
+        return (offset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+    }
+
+    // Fold the chunk hashes of a byte range of the given length
+    uint64_t combine_chunks(const std::vector<uint64_t>& chunks, size_t bytes)
+    {
+        uint64_t hash = mix(bytes ^ PRIME);
+        for (uint64_t chunk : chunks)
+        {
+            hash = mix(hash ^ chunk);
+        }
+        return hash;
+    }
+}
+
+uint64_t checksum(const void* data, size_t bytes)
+{
+    const uint8_t* begin = static_cast<const uint8_t*>(data);
+    const size_t chunk_count = (bytes + CHECKSUM_CHUNK - 1) / CHECKSUM_CHUNK;
+    std::vector<uint64_t> chunks(chunk_count);
+    #pragma omp parallel for schedule(static) if(chunk_count > 1)
+    for (long long c = 0; c < static_cast<long long>(chunk_count); ++c)
+    {
+        const size_t offset = c * CHECKSUM_CHUNK;
+        chunks[c] = hash_chunk(begin + offset, std::min(CHECKSUM_CHUNK, bytes - offset));
+    }
+
+    return combine_chunks(chunks, bytes);
+}
+
+void checksum_stream::update(const void* data, size_t bytes)
+{
+    const uint8_t* next = static_cast<const uint8_t*>(data);
+    total += bytes;
+    while (bytes > 0)
+    {
+        if (pending.empty() && bytes >= CHECKSUM_CHUNK)
+        {
+            // Whole chunks are hashed in place, in parallel
+            const size_t count = bytes / CHECKSUM_CHUNK;
+            const size_t first = chunks.size();
+            chunks.resize(first + count);
+            #pragma omp parallel for schedule(static) if(count > 1)
+            for (long long c = 0; c < static_cast<long long>(count); ++c)
+            {
+                chunks[first + c] = hash_chunk(next + c * CHECKSUM_CHUNK, CHECKSUM_CHUNK);
+            }
+            next += count * CHECKSUM_CHUNK;
+            bytes -= count * CHECKSUM_CHUNK;
+            continue;
+        }
+        const size_t take = std::min(bytes, CHECKSUM_CHUNK - pending.size());
+        pending.insert(pending.end(), next, next + take);
+        next += take;
+        bytes -= take;
+        if (pending.size() == CHECKSUM_CHUNK)
+        {
+            chunks.push_back(hash_chunk(pending.data(), pending.size()));
+            pending.clear();
+        }
+    }
+}
+
+uint64_t checksum_stream::finish() const
+{
+    if (pending.empty())
+    {
+        return combine_chunks(chunks, total);
+    }
+    std::vector<uint64_t> all = chunks;
+    all.push_back(hash_chunk(pending.data(), pending.size()));
+    return combine_chunks(all, total);
+}
+
+uint64_t cache_key(const std::vector<std::string>& sources, const std::string& parameters)
+{
+    // A missing source contributes its path only, so the key still differs from any real build
+    std::string description;
+    for (const std::string& source : sources)
+    {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(source, error);
+        const auto modified = std::filesystem::last_write_time(source, error);
+        description += source + '\n';
+        if (!error)
+        {
+            description += std::to_string(size) + '\n' + std::to_string(modified.time_since_epoch().count()) + '\n';
+        }
+    }
+    description += parameters;
+    return checksum(description.data(), description.size());
+}
+
+void layout_cache(cache_header& header, const size_t (&section_bytes)[CACHE_SECTION_COUNT])
+{
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    size_t offset = sizeof(cache_header);
+    for (uint32_t s = 0; s < CACHE_SECTION_COUNT; ++s)
+    {
+        offset = align_up(offset);
+        header.sections[s] = {offset, section_bytes[s]};
+        offset += section_bytes[s];
+    }
+}
+
+void seal_cache(cache_header& header, const uint64_t (&section_checksums)[CACHE_SECTION_COUNT])
+{
+    header.payload_checksum = checksum(section_checksums, sizeof(section_checksums));
+    header.header_checksum = checksum(&header, offsetof(cache_header, header_checksum));
+}
+
+bool write_cache(const std::string& path, cache_header header, const cache_section_data (&sections)[CACHE_SECTION_COUNT])
+{
+    size_t bytes[CACHE_SECTION_COUNT];
+    uint64_t sums[CACHE_SECTION_COUNT];
+    for (uint32_t s = 0; s < CACHE_SECTION_COUNT; ++s)
+    {
+        bytes[s] = sections[s].bytes;
+        sums[s] = checksum(sections[s].data, sections[s].bytes);
+    }
+    layout_cache(header, bytes);
+    seal_cache(header, sums);
+
+    // Write next to the destination and rename, so a reader never sees a half-written cache
+    const std::string temporary = path + ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Could not create dataset cache: " << temporary << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[CACHE_ALIGNMENT] = {};
+    size_t written = sizeof(header);
+    for (uint32_t s = 0; s < CACHE_SECTION_COUNT; ++s)
+    {
+        file.write(padding, header.sections[s].offset - written);
+        file.write(static_cast<const char*>(sections[s].data), sections[s].bytes);
+        written = header.sections[s].offset + sections[s].bytes;
+    }
+    file.close();
+
+    std::error_code error;
+    if (file.fail() || (std::filesystem::rename(temporary, path, error), error))
+    {
+        std::cerr << "Could not write dataset cache: " << path << std::endl;
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<mapped_file> open_cache(const std::string& path, uint64_t key)
+{
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error))
+    {
+        std::cout << "No dataset cache at " << path << "." << std::endl;
+        return nullptr;
+    }
+
+    auto file = std::make_shared<mapped_file>(path, true);
+    cache_header header;
+    if (file->size() < sizeof(header))
+    {
+        std::cerr << "Dataset cache is truncated: " << path << std::endl;
+        return nullptr;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION)
+    {
+        std::cout << "Dataset cache " << path << " has an unknown format or version." << std::endl;
+        return nullptr;
+    }
+    if (header.header_checksum != checksum(&header, offsetof(cache_header, header_checksum)))
+    {
+        std::cerr << "Dataset cache header is damaged: " << path << std::endl;
+        return nullptr;
+    }
+    if (header.key != key)
+    {
+        std::cout << "Dataset cache " << path << " is out of date." << std::endl;
+        return nullptr;
+    }
+
+    for (const cache_section_entry& section : header.sections)
+    {
+        if (section.offset % CACHE_ALIGNMENT != 0 || section.offset > file->size() || section.bytes > file->size() - section.offset)
+        {
+            std::cerr << "Dataset cache section lies outside the file: " << path << std::endl;
+            return nullptr;
+        }
+    }
+    const uint8_t* base = file->data();
+    uint64_t sums[CACHE_SECTION_COUNT];
+    for (uint32_t s = 0; s < CACHE_SECTION_COUNT; ++s)
+    {
+        sums[s] = checksum(base + header.sections[s].offset, header.sections[s].bytes);
+    }
+    if (header.payload_checksum != checksum(sums, sizeof(sums)))
+    {
+        std::cerr << "Dataset cache checksum mismatch: " << path << std::endl;
+        return nullptr;
+    }
+    return file;
+}
@@ -0,0 +1,165 @@
+#include "dataset_split.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility> // For std::swap
+
+namespace
+{
+    // splitmix64; the standard distributions are implementation-defined, so the shuffle draws its own numbers
+    struct split_rng
+    {
+        uint64_t state;
+
+        uint64_t next()
+        {
+            uint64_t x = (state += 0x9E3779B97F4A7C15ULL);
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            return x ^ (x >> 31);
+        }
+
+        // Uniform in [0, n) for n below 2^32, by multiply-shift instead of a biased modulo
+        uint32_t below(uint32_t n) { return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+    };
+
+    // All rows, grouped by label when stratified (in label order) and shuffled within each group;
+    // groups receives the start of every group in order, followed by the row count
+    std::vector<uint32_t> shuffled_groups(const dataset& data, bool stratified, uint64_t seed, std::vector<size_t>& groups)
+    {
+        const size_t n = data.size();
+        size_t start[257] = {};
+        if (stratified)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                ++start[data.get_label(i) + 1];
+            }
+        }
+        else
+        {
+            start[1] = n;
+        }
+        for (size_t label = 1; label <= 256; ++label)
+        {
+            start[label] += start[label - 1];
+        }
+
+        // Counting sort by label keeps the rows of each group ascending before the shuffle
+        std::vector<uint32_t> order(n);
+        size_t next[256];
+        std::copy(start, start + 256, next);
+        for (size_t i = 0; i < n; ++i)
+        {
+            order[next[stratified ? data.get_label(i) : 0]++] = static_cast<uint32_t>(i);
+        }
+
+        split_rng rng{seed};
+        groups.clear();
+        for (size_t label = 0; label < 256; ++label)
+        {
+            if (start[label + 1] == start[label])
+            {
+                continue;
+            }
+            groups.push_back(start[label]);
+            // Fisher-Yates within the group
+            for (size_t i = start[label + 1] - 1; i > start[label]; --i)
+            {
+                size_t j = start[label] + rng.below(static_cast<uint32_t>(i - start[label] + 1));
+                std::swap(order[i], order[j]);
+            }
+        }
+        groups.push_back(n);
+        return order;
+    }
+
+    // Rows tagged 0, 1 and 2 as training, test and validation, each in ascending order
+    split_indices collect(const std::vector<uint8_t>& subset_of)
+    {
+        size_t counts[3] = {};
+        for (uint8_t subset : subset_of)
+        {
+            ++counts[subset];
+        }
+        split_indices split;
+        std::vector<uint32_t>* subsets[3] = {&split.training, &split.test, &split.validation};
+        for (int s = 0; s < 3; ++s)
+        {
+            subsets[s]->reserve(counts[s]);
+        }
+        for (size_t i = 0; i < subset_of.size(); ++i)
+        {
+            subsets[subset_of[i]]->push_back(static_cast<uint32_t>(i));
+        }
+        return split;
+    }
+}
+
+split_indices holdout_split(const dataset& data, const split_options& options)
+{
+    if (options.training_fraction < 0.0 || options.test_fraction < 0.0 || options.training_fraction + options.test_fraction > 1.0)
+    {
+        std::cerr << "Split fractions must be non-negative and add up to at most 1." << std::endl;
+        exit(1);
+    }
+
+    std::vector<size_t> groups;
+    const std::vector<uint32_t> order = shuffled_groups(data, options.stratified, options.seed, groups);
+
+    // The shuffled rows of each group are cut at the rounded fractions of the group's size
+    std::vector<uint8_t> subset_of(data.size());
+    for (size_t g = 0; g + 1 < groups.size(); ++g)
+    {
+        const size_t size = groups[g + 1] - groups[g];
+        const size_t training_end = std::min(size, static_cast<size_t>(std::llround(size * options.training_fraction)));
+        const size_t test_end = std::min(size, static_cast<size_t>(std::llround(size * (options.training_fraction + options.test_fraction))));
+        for (size_t p = 0; p < size; ++p)
+        {
+            subset_of[order[groups[g] + p]] = p < training_end ? 0 : p < test_end ? 1 : 2;
+        }
+    }
+    return collect(subset_of);
+}
+
+kfold_splitter::kfold_splitter(const dataset& data, size_t fold_count, uint64_t seed, bool stratified)
+    : folds(fold_count)
+{
+    if (fold_count < 2 || fold_count > data.size())
+    {
+        std::cerr << "Cannot make " << fold_count << " folds of " << data.size() << " samples." << std::endl;
+        exit(1);
+    }
+
+    // Dealing the label-grouped order round-robin spreads every label evenly over the folds
+    std::vector<size_t> groups;
+    const std::vector<uint32_t> order = shuffled_groups(data, stratified, seed, groups);
+    fold_of.resize(data.size());
+    for (size_t p = 0; p < order.size(); ++p)
+    {
+        fold_of[order[p]] = static_cast<uint32_t>(p % folds);
+    }
+}
+
+split_indices kfold_splitter::fold(size_t f) const
+{
+    std::vector<uint8_t> subset_of(fold_of.size());
+    for (size_t i = 0; i < fold_of.size(); ++i)
+    {
+        subset_of[i] = fold_of[i] == f ? 1 : 0;
+    }
+    return collect(subset_of);
+}
+
+repeated_holdout::repeated_holdout(const dataset& data, const split_options& base, size_t repetitions)
+    : source(&data), options(base), repeats(repetitions)
+{
+}
+
+split_indices repeated_holdout::split(size_t repetition) const
+{
+    split_options repeated = options;
+    split_rng derive{options.seed + 0x9E3779B97F4A7C15ULL * repetition};
+    repeated.seed = derive.next();
+    return holdout_split(*source, repeated);
+}
@@ -0,0 +1,148 @@
+#include "feature_stats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <omp.h> // For OpenMP
+
+void feature_stats::reset(size_t feature_count)
+{
+    count = 0;
+    mean.assign(feature_count, 0.0);
+    m2.assign(feature_count, 0.0);
+    minimum.assign(feature_count, UINT8_MAX);
+    maximum.assign(feature_count, 0);
+}
+
+void feature_stats::merge(const feature_stats& other)
+{
+    if (other.count == 0)
+    {
+        return;
+    }
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    const double n_a = static_cast<double>(count);
+    const double n_b = static_cast<double>(other.count);
+    const double n = n_a + n_b;
+    for (size_t j = 0; j < mean.size(); ++j)
+    {
+        double delta = other.mean[j] - mean[j];
+        mean[j] += delta * (n_b / n);
+        m2[j] += other.m2[j] + delta * delta * (n_a * n_b / n);
+        minimum[j] = std::min(minimum[j], other.minimum[j]);
+        maximum[j] = std::max(maximum[j], other.maximum[j]);
+    }
+    count += other.count;
+}
+
+double feature_stats::variance(size_t feature) const
+{
+    return count < 2 ? 0.0 : m2[feature] / static_cast<double>(count - 1);
+}
+
+double feature_stats::std_dev(size_t feature) const
+{
+    return std::sqrt(variance(feature));
+}
+
+void feature_stats::scaling(normalization_method method, std::vector<float>& offset, std::vector<float>& scale) const
+{
+    const size_t feature_count = get_feature_count();
+    offset.resize(feature_count);
+    scale.resize(feature_count);
+    for (size_t i = 0; i < feature_count; ++i)
+    {
+        double spread;
+        if (method == normalization_method::z_score)
+        {
+            offset[i] = static_cast<float>(mean[i]);
+            spread = std_dev(i);
+        }
+        else
+        {
+            offset[i] = static_cast<float>(minimum[i]);
+            spread = static_cast<double>(maximum[i]) - minimum[i];
+        }
+
+        // Handle zero spread to avoid division by zero
+        if (spread == 0.0)
+        {
+            spread = 1.0;
+            std::cerr << "Feature " << i << " has zero " << (method == normalization_method::z_score ? "standard deviation" : "range")
+                      << ". Adjusted to 1.0 to avoid division by zero." << std::endl;
+        }
+        scale[i] = static_cast<float>(1.0 / spread);
+    }
+}
+
+feature_stats compute_feature_stats(span<const uint8_t> rows, size_t feature_count)
+{
+    feature_stats total;
+    total.reset(feature_count);
+    accumulate_feature_stats(total, rows, feature_count);
+    return total;
+}
+
+void accumulate_feature_stats(feature_stats& total, span<const uint8_t> rows, size_t feature_count)
+{
+    const size_t row_count = feature_count ? rows.size() / feature_count : 0;
+    const size_t chunk_count = (row_count + FEATURE_STATS_CHUNK - 1) / FEATURE_STATS_CHUNK;
+
+    // Exact integer sums, minimum and maximum of every chunk, chunk-major in four flat arrays so
+    // the pass allocates the same few buffers however many rows it covers
+    std::vector<uint32_t> sums(chunk_count * feature_count);
+    std::vector<uint32_t> sum_squares(chunk_count * feature_count);
+    std::vector<uint8_t> minimums(chunk_count * feature_count, UINT8_MAX);
+    std::vector<uint8_t> maximums(chunk_count * feature_count, 0);
+
+    // Each chunk is written by exactly one thread; the loops below run across features and vectorize
+    #pragma omp parallel for schedule(static)
+    for (long long c = 0; c < static_cast<long long>(chunk_count); ++c)
+    {
+        const size_t begin = c * FEATURE_STATS_CHUNK;
+        const size_t end = std::min(begin + FEATURE_STATS_CHUNK, row_count);
+        uint32_t* s = sums.data() + c * feature_count;
+        uint32_t* q = sum_squares.data() + c * feature_count;
+        uint8_t* lo = minimums.data() + c * feature_count;
+        uint8_t* hi = maximums.data() + c * feature_count;
+        for (size_t r = begin; r < end; ++r)
+        {
+            const uint8_t* x = rows.data() + r * feature_count;
+            #pragma omp simd
+            for (size_t j = 0; j < feature_count; ++j)
+            {
+                uint32_t v = x[j];
+                s[j] += v;
+                q[j] += v * v;
+                lo[j] = std::min(lo[j], x[j]);
+                hi[j] = std::max(hi[j], x[j]);
+            }
+        }
+    }
+
+    // Exact sums give each chunk's mean and M2 directly; merge in chunk order so the rounding is
+    // the same for any number of threads
+    feature_stats chunk;
+    chunk.reset(feature_count);
+    for (size_t c = 0; c < chunk_count; ++c)
+    {
+        const size_t begin = c * FEATURE_STATS_CHUNK;
+        chunk.count = std::min(begin + FEATURE_STATS_CHUNK, row_count) - begin;
+        const double n = static_cast<double>(chunk.count);
+        const uint32_t* s = sums.data() + c * feature_count;
+        const uint32_t* q = sum_squares.data() + c * feature_count;
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            double chunk_sum = static_cast<double>(s[j]);
+            chunk.mean[j] = chunk_sum / n;
+            chunk.m2[j] = std::max(0.0, static_cast<double>(q[j]) - chunk_sum * chunk_sum / n);
+        }
+        std::copy_n(minimums.data() + c * feature_count, feature_count, chunk.minimum.data());
+        std::copy_n(maximums.data() + c * feature_count, feature_count, chunk.maximum.data());
+        total.merge(chunk);
+    }
+}
@@ -0,0 +1,152 @@
+#include "gzip_reader.hpp"
+#include <algorithm>
+#include <cstring> // For std::memcpy
+#include <fstream>
+#include <iostream>
+#include <zlib.h>
+
+gzip_reader::gzip_reader(const std::string& file_path)
+    : path(file_path)
+{
+    if (!std::ifstream(path, std::ios::binary))
+    {
+        std::cerr << "Could not open gzip file: " << path << std::endl;
+        exit(1);
+    }
+    producer = std::thread(&gzip_reader::produce, this);
+}
+
+gzip_reader::~gzip_reader()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    changed.notify_all();
+    producer.join();
+}
+
+bool gzip_reader::is_gzip(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    unsigned char magic[2] = {0, 0};
+    file.read(reinterpret_cast<char*>(magic), 2);
+    return file && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+void gzip_reader::produce()
+{
+    std::ifstream file(path, std::ios::binary);
+    z_stream stream = {};
+    // 16 + MAX_WBITS: expect a gzip header and trailer
+    bool ok = inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK;
+    std::vector<uint8_t> input(BLOCK_SIZE);
+    std::vector<uint8_t> block(BLOCK_SIZE);
+    size_t filled = 0;
+    bool member_open = false; // Inside a gzip member that has not reached its trailer
+    std::string failure = ok ? "" : "Could not initialize zlib";
+
+    // Queue a block, waiting while the queue is full; false if the consumer is gone
+    auto push = [&](std::vector<uint8_t>& full) {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&] { return stopping || queue.size() < QUEUE_DEPTH; });
+        if (stopping)
+        {
+            return false;
+        }
+        queue.push_back(std::move(full));
+        guard.unlock();
+        changed.notify_all();
+        return true;
+    };
+
+    while (ok)
+    {
+        if (stream.avail_in == 0)
+        {
+            file.read(reinterpret_cast<char*>(input.data()), static_cast<std::streamsize>(input.size()));
+            stream.next_in = input.data();
+            stream.avail_in = static_cast<uInt>(file.gcount());
+            if (stream.avail_in == 0)
+            {
+                if (member_open)
+                {
+                    failure = "Unexpected end of gzip data";
+                }
+                break;
+            }
+        }
+
+        stream.next_out = block.data() + filled;
+        stream.avail_out = static_cast<uInt>(block.size() - filled);
+        int status = inflate(&stream, Z_NO_FLUSH);
+        filled = block.size() - stream.avail_out;
+        member_open = true;
+        if (status == Z_STREAM_END)
+        {
+            // Another member may follow
+            member_open = false;
+            inflateReset(&stream);
+        }
+        else if (status != Z_OK && status != Z_BUF_ERROR)
+        {
+            failure = stream.msg ? stream.msg : "Invalid gzip data";
+            break;
+        }
+
+        if (filled == block.size())
+        {
+            if (!push(block))
+            {
+                break;
+            }
+            block.assign(BLOCK_SIZE, 0);
+            filled = 0;
+        }
+    }
+    inflateEnd(&stream);
+
+    if (failure.empty() && filled > 0)
+    {
+        block.resize(filled);
+        push(block);
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        error = failure;
+        finished = true;
+    }
+    changed.notify_all();
+}
+
+size_t gzip_reader::read(uint8_t* out, size_t bytes)
+{
+    size_t copied = 0;
+    while (copied < bytes)
+    {
+        if (current_offset == current.size())
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return !queue.empty() || finished; });
+            if (queue.empty())
+            {
+                if (!error.empty())
+                {
+                    std::cerr << error << " in gzip file: " << path << std::endl;
+                    exit(1);
+                }
+                break;
+            }
+            current = std::move(queue.front());
+            queue.pop_front();
+            current_offset = 0;
+            guard.unlock();
+            changed.notify_all();
+        }
+        const size_t take = std::min(bytes - copied, current.size() - current_offset);
+        std::memcpy(out + copied, current.data() + current_offset, take);
+        copied += take;
+        current_offset += take;
+    }
+    return copied;
+}
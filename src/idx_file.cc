@@ -0,0 +1,189 @@
+#include "idx_file.hpp"
+#include <algorithm>  // For std::min
+#include <filesystem> // For the size of streamed files
+#include <iostream>
+
+namespace
+{
+    // Read a big-endian uint32_t
+    uint32_t read_uint32(const uint8_t* bytes)
+    {
+        return (static_cast<uint32_t>(bytes[0]) << 24) |
+               (static_cast<uint32_t>(bytes[1]) << 16) |
+               (static_cast<uint32_t>(bytes[2]) << 8) |
+               (static_cast<uint32_t>(bytes[3]));
+    }
+
+    // Validate an IDX header against expected_magic and the size of the whole file; only the first
+    // available bytes of the file are at bytes. Returns the header size.
+    size_t parse_header(const std::string& path, const uint8_t* bytes, size_t available, size_t file_size,
+                        uint32_t expected_magic, std::vector<uint32_t>& dimensions, size_t& record_size)
+    {
+        if (available < 4)
+        {
+            std::cerr << "IDX file is too short: " << path << std::endl;
+            exit(1);
+        }
+
+        uint32_t magic_number = read_uint32(bytes);
+        if (magic_number != expected_magic)
+        {
+            std::cerr << "Unexpected magic number 0x" << std::hex << magic_number << " (expected 0x" << expected_magic
+                      << std::dec << ") in IDX file: " << path << std::endl;
+            exit(1);
+        }
+
+        size_t dimension_count = magic_number & 0xFF;
+        size_t header_size = 4 + 4 * dimension_count;
+        if (dimension_count == 0 || available < header_size)
+        {
+            std::cerr << "Truncated IDX header in file: " << path << std::endl;
+            exit(1);
+        }
+
+        dimensions.resize(dimension_count);
+        record_size = 1;
+        for (size_t i = 0; i < dimension_count; ++i)
+        {
+            dimensions[i] = read_uint32(bytes + 4 + 4 * i);
+            if (i > 0)
+            {
+                if (dimensions[i] == 0)
+                {
+                    std::cerr << "IDX dimension " << i << " is zero in file: " << path << std::endl;
+                    exit(1);
+                }
+                record_size *= dimensions[i];
+            }
+        }
+
+        // The payload must hold exactly count x record_size bytes
+        size_t payload_size = static_cast<size_t>(dimensions[0]) * record_size;
+        if (file_size - header_size != payload_size)
+        {
+            std::cerr << "IDX file size does not match its dimensions (" << file_size - header_size << " payload bytes, expected "
+                      << payload_size << "): " << path << std::endl;
+            exit(1);
+        }
+
+        return header_size;
+    }
+
+    // Decompress the magic number and dimensions at the start of a gzip-compressed IDX file into header;
+    // returns the bytes read. payload_size is the payload the dimensions describe, 0 for a short header.
+    size_t read_compressed_header(gzip_reader& reader, uint8_t (&header)[4 + 4 * 255], size_t& payload_size)
+    {
+        size_t available = reader.read(header, 4);
+        const size_t dimension_count = available == 4 ? header[3] : 0;
+        available += reader.read(header + 4, 4 * dimension_count);
+        payload_size = 0;
+        if (dimension_count > 0 && available == 4 + 4 * dimension_count)
+        {
+            payload_size = read_uint32(header + 4);
+            for (size_t i = 1; i < dimension_count; ++i)
+            {
+                payload_size *= read_uint32(header + 4 + 4 * i);
+            }
+        }
+        return available;
+    }
+}
+
+idx_file::idx_file(const std::string& file_path, uint32_t expected_magic)
+    : path(file_path),
+      payload(nullptr),
+      record_size(0)
+{
+    if (!gzip_reader::is_gzip(path))
+    {
+        file = std::make_unique<mapped_file>(path);
+        payload = file->data() + parse_header(path, file->data(), file->size(), file->size(), expected_magic, dimensions, record_size);
+        return;
+    }
+
+    // The header gives the decompressed size; the payload is then copied out block by block while the
+    // reader's thread inflates the following blocks
+    gzip_reader reader(path);
+    uint8_t header[4 + 4 * 255];
+    size_t payload_size;
+    const size_t header_size = read_compressed_header(reader, header, payload_size);
+    // Validate before allocating; the payload size is checked again once the data has arrived. Deflate
+    // expands by at most 1032:1, which bounds what a damaged header can make us allocate.
+    parse_header(path, header, header_size, header_size + payload_size, expected_magic, dimensions, record_size);
+    std::error_code error;
+    const size_t compressed_size = std::filesystem::file_size(path, error);
+    if (error || payload_size / 1032 > compressed_size)
+    {
+        std::cerr << "IDX header claims more data than the compressed file can hold: " << path << std::endl;
+        exit(1);
+    }
+
+    inflated.resize(header_size + payload_size);
+    std::copy(header, header + header_size, inflated.data());
+    size_t total = header_size + reader.read(inflated.data() + header_size, payload_size);
+    uint8_t extra;
+    total += reader.read(&extra, 1);
+    payload = inflated.data() + parse_header(path, inflated.data(), header_size, total, expected_magic, dimensions, record_size);
+}
+
+idx_stream::idx_stream(const std::string& file_path, uint32_t expected_magic)
+    : path(file_path)
+{
+    if (gzip_reader::is_gzip(path))
+    {
+        // The decompressed size is unknown up front; a short payload is caught by read()
+        compressed = std::make_unique<gzip_reader>(path);
+        uint8_t header[4 + 4 * 255];
+        size_t payload_size;
+        const size_t available = read_compressed_header(*compressed, header, payload_size);
+        header_size = parse_header(path, header, available, available + payload_size, expected_magic, dimensions, record_size);
+        return;
+    }
+
+    std::error_code error;
+    const size_t file_size = std::filesystem::file_size(path, error);
+    file.open(path, std::ios::binary);
+    if (!file || error)
+    {
+        std::cerr << "Could not open IDX file: " << path << std::endl;
+        exit(1);
+    }
+
+    // The largest possible header: magic number and 255 dimensions
+    uint8_t header[4 + 4 * 255];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    const size_t available = static_cast<size_t>(file.gcount());
+    header_size = parse_header(path, header, available, file_size, expected_magic, dimensions, record_size);
+    rewind();
+}
+
+size_t idx_stream::read(uint8_t* out, size_t count)
+{
+    count = std::min(count, get_count() - position);
+    const size_t bytes = count * record_size;
+    if (compressed ? compressed->read(out, bytes) != bytes
+                   : !file.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(bytes)))
+    {
+        std::cerr << "Error reading IDX file: " << path << std::endl;
+        exit(1);
+    }
+    position += count;
+    return count;
+}
+
+void idx_stream::rewind()
+{
+    if (compressed)
+    {
+        // Start decompressing from the beginning again and skip the header
+        compressed = std::make_unique<gzip_reader>(path);
+        std::vector<uint8_t> header(header_size);
+        compressed->read(header.data(), header_size);
+    }
+    else
+    {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(header_size));
+    }
+    position = 0;
+}
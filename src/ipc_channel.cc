@@ -0,0 +1,314 @@
+#include "ipc_channel.hpp"
+#include "socket_stream.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new> // For placement new
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>    // For O_* constants
+#include <sys/mman.h> // For shm_open and mmap
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<ipc_listener> listen_ipc(const std::string& address)
+{
+    if (address.compare(0, 4, "shm:") == 0)
+    {
+        return std::make_unique<shared_memory_listener>(address.substr(4));
+    }
+    return std::make_unique<socket_listener>(address);
+}
+
+std::unique_ptr<ipc_channel> connect_ipc(const std::string& address)
+{
+    if (address.compare(0, 4, "shm:") == 0)
+    {
+        return connect_shared_memory(address.substr(4));
+    }
+    return connect_socket(address);
+}
+
+namespace
+{
+    constexpr uint32_t SEGMENT_MAGIC = 0x4D485349; // "ISHM"
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory rings need lock-free atomics");
+
+    // Counters of one direction. They only grow; the ring position is the counter modulo the capacity.
+    // Each sits on its own cache line so the two processes do not contend for one.
+    struct ring_state
+    {
+        alignas(64) std::atomic<uint64_t> written;
+        alignas(64) std::atomic<uint64_t> read;
+        alignas(64) std::atomic<uint32_t> closed;
+    };
+
+    // Start of the segment, followed by the data of ring 0 (creator to client) and ring 1
+    struct segment_header
+    {
+        uint32_t magic;
+        uint32_t reserved;
+        uint64_t capacity;              // Bytes per ring
+        std::atomic<uint32_t> attached; // Set by the client
+        ring_state rings[2];
+    };
+
+    // Spin, then yield, then sleep; an idle peer costs a wakeup every 50 us at most
+    class backoff
+    {
+        unsigned attempts = 0;
+
+    public:
+        void wait()
+        {
+            ++attempts;
+            if (attempts < 64)
+            {
+                return;
+            }
+            if (attempts < 256)
+            {
+                std::this_thread::yield();
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    };
+}
+
+struct shared_memory_channel::mapping
+{
+    void* base = nullptr;
+    size_t bytes = 0;
+
+    segment_header* header() const { return static_cast<segment_header*>(base); }
+    uint8_t* ring_data(int ring) const
+    {
+        return static_cast<uint8_t*>(base) + sizeof(segment_header) + ring * header()->capacity;
+    }
+
+    ~mapping()
+    {
+#ifndef _WIN32
+        if (base)
+        {
+            munmap(base, bytes);
+        }
+#endif
+    }
+};
+
+shared_memory_channel::shared_memory_channel(std::shared_ptr<mapping> mapped, bool creator)
+    : segment(std::move(mapped)), outgoing(creator ? 0 : 1)
+{
+}
+
+shared_memory_channel::~shared_memory_channel()
+{
+    shutdown();
+}
+
+bool shared_memory_channel::send_all(const void* data, size_t bytes)
+{
+    ring_state& ring = segment->header()->rings[outgoing];
+    const uint64_t capacity = segment->header()->capacity;
+    uint8_t* buffer = segment->ring_data(outgoing);
+    const uint8_t* next = static_cast<const uint8_t*>(data);
+    uint64_t written = ring.written.load(std::memory_order_relaxed);
+    backoff waiting;
+    while (bytes > 0)
+    {
+        if (ring.closed.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        const uint64_t free = capacity - (written - ring.read.load(std::memory_order_acquire));
+        if (free == 0)
+        {
+            waiting.wait();
+            continue;
+        }
+        // Up to the free space, without wrapping around the end of the buffer
+        const uint64_t position = written % capacity;
+        const size_t chunk = static_cast<size_t>(std::min<uint64_t>({bytes, free, capacity - position}));
+        std::memcpy(buffer + position, next, chunk);
+        written += chunk;
+        ring.written.store(written, std::memory_order_release);
+        next += chunk;
+        bytes -= chunk;
+        waiting = backoff();
+    }
+    return true;
+}
+
+bool shared_memory_channel::receive_all(void* data, size_t bytes)
+{
+    ring_state& ring = segment->header()->rings[1 - outgoing];
+    const uint64_t capacity = segment->header()->capacity;
+    const uint8_t* buffer = segment->ring_data(1 - outgoing);
+    uint8_t* next = static_cast<uint8_t*>(data);
+    uint64_t read = ring.read.load(std::memory_order_relaxed);
+    backoff waiting;
+    while (bytes > 0)
+    {
+        const uint64_t available = ring.written.load(std::memory_order_acquire) - read;
+        if (available == 0)
+        {
+            // Whatever the peer wrote before closing is still delivered
+            if (ring.closed.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            waiting.wait();
+            continue;
+        }
+        const uint64_t position = read % capacity;
+        const size_t chunk = static_cast<size_t>(std::min<uint64_t>({bytes, available, capacity - position}));
+        std::memcpy(next, buffer + position, chunk);
+        read += chunk;
+        ring.read.store(read, std::memory_order_release);
+        next += chunk;
+        bytes -= chunk;
+        waiting = backoff();
+    }
+    return true;
+}
+
+void shared_memory_channel::shutdown()
+{
+    for (ring_state& ring : segment->header()->rings)
+    {
+        ring.closed.store(1, std::memory_order_release);
+    }
+}
+
+#ifdef _WIN32
+
+shared_memory_listener::shared_memory_listener(const std::string& segment_name, size_t)
+    : name(segment_name)
+{
+    std::cerr << "Cannot create shared memory " << name << ": not supported on Windows." << std::endl;
+    exit(1);
+}
+
+shared_memory_listener::~shared_memory_listener() {}
+std::unique_ptr<ipc_channel> shared_memory_listener::accept(int) { return nullptr; }
+
+std::unique_ptr<ipc_channel> connect_shared_memory(const std::string& name)
+{
+    std::cerr << "Cannot attach to shared memory " << name << ": not supported on Windows." << std::endl;
+    return nullptr;
+}
+
+#else
+
+shared_memory_listener::shared_memory_listener(const std::string& segment_name, size_t capacity)
+    : segment(std::make_shared<shared_memory_channel::mapping>()), name(segment_name)
+{
+    const size_t bytes = sizeof(segment_header) + 2 * capacity;
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(bytes)) != 0)
+    {
+        std::cerr << "Cannot create shared memory " << name << ": " << std::strerror(errno) << "." << std::endl;
+        exit(1);
+    }
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        std::cerr << "Cannot map shared memory " << name << ": " << std::strerror(errno) << "." << std::endl;
+        exit(1);
+    }
+    segment->base = base;
+    segment->bytes = bytes;
+
+    // The new segment is zero-filled; the atomics only need constructing
+    segment_header* header = new (base) segment_header();
+    header->capacity = capacity;
+    for (ring_state& ring : header->rings)
+    {
+        ring.written.store(0);
+        ring.read.store(0);
+        ring.closed.store(0);
+    }
+    header->attached.store(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SEGMENT_MAGIC;
+}
+
+shared_memory_listener::~shared_memory_listener()
+{
+    if (!accepted)
+    {
+        shm_unlink(name.c_str());
+    }
+}
+
+std::unique_ptr<ipc_channel> shared_memory_listener::accept(int timeout_ms)
+{
+    if (accepted)
+    {
+        // A segment connects one client; later calls only wait out the timeout
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max(timeout_ms, 0)));
+        return nullptr;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+    backoff waiting;
+    while (!segment->header()->attached.load(std::memory_order_acquire))
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            return nullptr;
+        }
+        waiting.wait();
+    }
+    // Both ends are mapped, so the name is no longer needed
+    shm_unlink(name.c_str());
+    accepted = true;
+    return std::make_unique<shared_memory_channel>(segment, true);
+}
+
+std::unique_ptr<ipc_channel> connect_shared_memory(const std::string& name)
+{
+    const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(segment_header))
+    {
+        std::cerr << "Cannot attach to shared memory " << name << ": " << std::strerror(errno) << "." << std::endl;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return nullptr;
+    }
+    auto segment = std::make_shared<shared_memory_channel::mapping>();
+    segment->bytes = static_cast<size_t>(status.st_size);
+    segment->base = mmap(nullptr, segment->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment->base == MAP_FAILED)
+    {
+        segment->base = nullptr;
+        std::cerr << "Cannot map shared memory " << name << ": " << std::strerror(errno) << "." << std::endl;
+        return nullptr;
+    }
+
+    segment_header* header = segment->header();
+    uint32_t unattached = 0;
+    if (header->magic != SEGMENT_MAGIC || sizeof(segment_header) + 2 * header->capacity != segment->bytes ||
+        !header->attached.compare_exchange_strong(unattached, 1, std::memory_order_acq_rel))
+    {
+        std::cerr << "Shared memory " << name << " is not a free channel." << std::endl;
+        return nullptr;
+    }
+    return std::make_unique<shared_memory_channel>(segment, false);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#include "data_handler.hpp"
+#include "profiler.hpp"
+#include <iostream>
+#include <memory>
+
+// Updated main function using smart pointers
+int main()
+{
+    // Time every phase and write the totals as JSON when the program exits; hardware counters are
+    // added where the kernel allows perf_event_open
+    profiler& phases = profiler::instance();
+    phases.set_report_path("./profile.json");
+    if (!phases.enable_counters(true))
+    {
+        std::cout << "Profiling without hardware counters: " << phases.counter_error() << "." << std::endl;
+    }
+
+    // Use unique_ptr to manage data_handler
+    auto dh = std::make_unique<data_handler>();
+
+    // Read, combine, count classes, normalize and split; later runs load all of it from the cache
+    dh->load_or_prepare("./data/train-images.idx3-ubyte", "./data/train-labels.idx1-ubyte", "./data/train.cache");
+
+    // No need to manually delete dh; it will be automatically cleaned up
+
+    return 0;
+}
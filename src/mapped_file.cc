@@ -0,0 +1,73 @@
+#include "mapped_file.hpp"
+#include <iostream>
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>    // For open
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
+#include <unistd.h>   // For close
+#endif
+
+mapped_file::mapped_file(const std::string& file_path, bool writable)
+    : path(file_path),
+      mapping(nullptr),
+      mapping_size(0)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Could not open file: " << path << std::endl;
+        exit(1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        std::cerr << "Could not stat file: " << path << std::endl;
+        exit(1);
+    }
+
+    mapping_size = static_cast<size_t>(st.st_size);
+    if (mapping_size > 0)
+    {
+        mapping = mmap(nullptr, mapping_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Could not map file: " << path << std::endl;
+            exit(1);
+        }
+        // The whole file is consumed front to back; start paging it in now
+        madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+        madvise(mapping, mapping_size, MADV_WILLNEED);
+    }
+    close(fd);
+#else
+    (void)writable; // The buffer is always writable
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        std::cerr << "Could not open file: " << path << std::endl;
+        exit(1);
+    }
+    buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+    if (!file)
+    {
+        std::cerr << "Error reading file: " << path << std::endl;
+        exit(1);
+    }
+#endif
+}
+
+mapped_file::~mapped_file()
+{
+#ifndef _WIN32
+    if (mapping)
+    {
+        munmap(mapping, mapping_size);
+    }
+#endif
+}
@@ -0,0 +1,338 @@
+#include "pca.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric> // For std::iota
+#include <random>
+#include <omp.h>   // For OpenMP
+
+namespace
+{
+    // Eigen-decomposition of the symmetric n x n row-major matrix a by cyclic Jacobi rotations. On return the
+    // diagonal of a holds the eigenvalues and the columns of vectors the matching eigenvectors.
+    void jacobi_eigen(std::vector<double>& a, size_t n, std::vector<double>& vectors)
+    {
+        vectors.assign(n * n, 0.0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            vectors[i * n + i] = 1.0;
+        }
+
+        for (int sweep = 0; sweep < 100; ++sweep)
+        {
+            double off_diagonal = 0.0, diagonal = 0.0;
+            for (size_t p = 0; p < n; ++p)
+            {
+                diagonal += a[p * n + p] * a[p * n + p];
+                for (size_t q = p + 1; q < n; ++q)
+                {
+                    off_diagonal += a[p * n + q] * a[p * n + q];
+                }
+            }
+            if (off_diagonal <= 1e-24 * diagonal)
+            {
+                break;
+            }
+
+            for (size_t p = 0; p < n; ++p)
+            {
+                for (size_t q = p + 1; q < n; ++q)
+                {
+                    const double apq = a[p * n + q];
+                    if (apq == 0.0)
+                    {
+                        continue;
+                    }
+                    // Rotation angle that zeroes a[p][q]
+                    const double theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+                    const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                    const double c = 1.0 / std::sqrt(t * t + 1.0);
+                    const double s = t * c;
+                    for (size_t k = 0; k < n; ++k)
+                    {
+                        const double akp = a[k * n + p], akq = a[k * n + q];
+                        a[k * n + p] = c * akp - s * akq;
+                        a[k * n + q] = s * akp + c * akq;
+                    }
+                    for (size_t k = 0; k < n; ++k)
+                    {
+                        const double apk = a[p * n + k], aqk = a[q * n + k];
+                        a[p * n + k] = c * apk - s * aqk;
+                        a[q * n + k] = s * apk + c * aqk;
+                    }
+                    for (size_t k = 0; k < n; ++k)
+                    {
+                        const double vkp = vectors[k * n + p], vkq = vectors[k * n + q];
+                        vectors[k * n + p] = c * vkp - s * vkq;
+                        vectors[k * n + q] = s * vkp + c * vkq;
+                    }
+                }
+            }
+        }
+    }
+
+    // Modified Gram-Schmidt on count vectors of length n stored one after another. A vector that
+    // collapses onto the others is replaced by a random one and orthogonalized again.
+    void orthonormalize(std::vector<double>& basis, size_t count, size_t n, std::mt19937& rng)
+    {
+        std::normal_distribution<double> normal;
+        for (size_t k = 0; k < count; ++k)
+        {
+            double* v = basis.data() + k * n;
+            for (int attempt = 0; attempt < 3; ++attempt)
+            {
+                for (size_t j = 0; j < k; ++j)
+                {
+                    const double* u = basis.data() + j * n;
+                    double dot = 0.0;
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        dot += u[i] * v[i];
+                    }
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        v[i] -= dot * u[i];
+                    }
+                }
+                double norm = 0.0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    norm += v[i] * v[i];
+                }
+                norm = std::sqrt(norm);
+                if (norm > 1e-12)
+                {
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        v[i] /= norm;
+                    }
+                    break;
+                }
+                for (size_t i = 0; i < n; ++i)
+                {
+                    v[i] = normal(rng);
+                }
+            }
+        }
+    }
+
+    // out[k] = matrix * basis[k] for count basis vectors; matrix is n x n row-major
+    void multiply(const std::vector<double>& matrix, const std::vector<double>& basis, size_t count, size_t n, std::vector<double>& out)
+    {
+        out.resize(count * n);
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < static_cast<long long>(n); ++i)
+        {
+            const double* row = matrix.data() + i * n;
+            for (size_t k = 0; k < count; ++k)
+            {
+                const double* v = basis.data() + k * n;
+                double dot = 0.0;
+                #pragma omp simd reduction(+:dot)
+                for (size_t j = 0; j < n; ++j)
+                {
+                    dot += row[j] * v[j];
+                }
+                out[k * n + i] = dot;
+            }
+        }
+    }
+}
+
+void pca::fit(const dataset_view& view, size_t components_wanted, size_t iterations)
+{
+    const size_t n = view.size();
+    const size_t f = view.get_normalized_feature_count();
+    if (n < 2 || f == 0)
+    {
+        std::cerr << "PCA needs at least two normalized samples." << std::endl;
+        exit(1);
+    }
+    if (view.get_normalized_precision() != feature_precision::fp32)
+    {
+        std::cerr << "PCA needs normalized rows stored at fp32." << std::endl;
+        exit(1);
+    }
+    feature_count = f;
+    component_count = std::max<size_t>(1, std::min(components_wanted, f));
+
+    // Mean of every feature
+    std::vector<double> sums(f, 0.0);
+    #pragma omp parallel
+    {
+        std::vector<double> local(f, 0.0);
+        #pragma omp for schedule(static)
+        for (long long r = 0; r < static_cast<long long>(n); ++r)
+        {
+            auto row = view.normalized_row(r);
+            for (size_t j = 0; j < f; ++j)
+            {
+                local[j] += row[j];
+            }
+        }
+        #pragma omp critical
+        for (size_t j = 0; j < f; ++j)
+        {
+            sums[j] += local[j];
+        }
+    }
+    mean.resize(f);
+    for (size_t j = 0; j < f; ++j)
+    {
+        mean[j] = static_cast<float>(sums[j] / static_cast<double>(n));
+    }
+
+    // Covariance: each thread takes whole blocks of rows, centers them into a feature-major tile and adds
+    // the tile's outer products to its own upper triangle; float dot products over a block, double totals
+    const size_t block_count = (n + COVARIANCE_BLOCK - 1) / COVARIANCE_BLOCK;
+    std::vector<double> covariance(f * f, 0.0);
+    #pragma omp parallel
+    {
+        std::vector<double> local(f * f, 0.0);
+        aligned_buffer<float> tile(f * COVARIANCE_BLOCK);
+        #pragma omp for schedule(static)
+        for (long long b = 0; b < static_cast<long long>(block_count); ++b)
+        {
+            const size_t begin = b * COVARIANCE_BLOCK;
+            const size_t rows = std::min(COVARIANCE_BLOCK, n - begin);
+            for (size_t r = 0; r < COVARIANCE_BLOCK; ++r)
+            {
+                if (r < rows)
+                {
+                    auto row = view.normalized_row(begin + r);
+                    for (size_t j = 0; j < f; ++j)
+                    {
+                        tile[j * COVARIANCE_BLOCK + r] = row[j] - mean[j];
+                    }
+                }
+                else
+                {
+                    for (size_t j = 0; j < f; ++j)
+                    {
+                        tile[j * COVARIANCE_BLOCK + r] = 0.0f;
+                    }
+                }
+            }
+            for (size_t i = 0; i < f; ++i)
+            {
+                const float* xi = tile.data() + i * COVARIANCE_BLOCK;
+                for (size_t j = i; j < f; ++j)
+                {
+                    const float* xj = tile.data() + j * COVARIANCE_BLOCK;
+                    float dot = 0.0f;
+                    #pragma omp simd reduction(+:dot)
+                    for (size_t r = 0; r < COVARIANCE_BLOCK; ++r)
+                    {
+                        dot += xi[r] * xj[r];
+                    }
+                    local[i * f + j] += dot;
+                }
+            }
+        }
+        #pragma omp critical
+        for (size_t i = 0; i < f; ++i)
+        {
+            for (size_t j = i; j < f; ++j)
+            {
+                covariance[i * f + j] += local[i * f + j];
+            }
+        }
+    }
+    total_variance = 0.0;
+    for (size_t i = 0; i < f; ++i)
+    {
+        for (size_t j = i; j < f; ++j)
+        {
+            covariance[i * f + j] /= static_cast<double>(n - 1);
+            covariance[j * f + i] = covariance[i * f + j];
+        }
+        total_variance += covariance[i * f + i];
+    }
+
+    // Subspace iteration: repeatedly multiply a random orthonormal basis by the covariance and
+    // re-orthonormalize; it converges to the span of the leading eigenvectors
+    const size_t q = std::min(f, component_count + OVERSAMPLING);
+    std::mt19937 rng(42);
+    std::normal_distribution<double> normal;
+    std::vector<double> basis(q * f), product;
+    for (double& value : basis)
+    {
+        value = normal(rng);
+    }
+    orthonormalize(basis, q, f, rng);
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        multiply(covariance, basis, q, f, product);
+        basis.swap(product);
+        orthonormalize(basis, q, f, rng);
+    }
+
+    // Rayleigh-Ritz: eigen-decompose the covariance restricted to the basis
+    multiply(covariance, basis, q, f, product);
+    std::vector<double> projected(q * q), rotation;
+    for (size_t a = 0; a < q; ++a)
+    {
+        for (size_t b = 0; b < q; ++b)
+        {
+            double dot = 0.0;
+            for (size_t i = 0; i < f; ++i)
+            {
+                dot += basis[a * f + i] * product[b * f + i];
+            }
+            projected[a * q + b] = dot;
+        }
+    }
+    jacobi_eigen(projected, q, rotation);
+
+    std::vector<size_t> order(q);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return projected[a * q + a] > projected[b * q + b]; });
+
+    components.assign(component_count * f, 0.0f);
+    variances.resize(component_count);
+    for (size_t c = 0; c < component_count; ++c)
+    {
+        const size_t e = order[c];
+        variances[c] = projected[e * q + e];
+        for (size_t i = 0; i < f; ++i)
+        {
+            double value = 0.0;
+            for (size_t b = 0; b < q; ++b)
+            {
+                value += rotation[b * q + e] * basis[b * f + i];
+            }
+            components[c * f + i] = static_cast<float>(value);
+        }
+    }
+}
+
+void pca::project(const float* row, float* out) const
+{
+    thread_local std::vector<float> centered;
+    centered.resize(feature_count);
+    for (size_t j = 0; j < feature_count; ++j)
+    {
+        centered[j] = row[j] - mean[j];
+    }
+    for (size_t c = 0; c < component_count; ++c)
+    {
+        const float* component = components.data() + c * feature_count;
+        float dot = 0.0f;
+        #pragma omp simd reduction(+:dot)
+        for (size_t j = 0; j < feature_count; ++j)
+        {
+            dot += centered[j] * component[j];
+        }
+        out[c] = dot;
+    }
+}
+
+double pca::explained_variance_ratio() const
+{
+    double kept = 0.0;
+    for (double variance : variances)
+    {
+        kept += variance;
+    }
+    return total_variance > 0.0 ? kept / total_variance : 0.0;
+}
@@ -0,0 +1,320 @@
+#include "profiler.hpp"
+#include <cerrno>
+#include <cstring> // For std::strerror
+#include <fstream>
+#include <iomanip> // For std::setprecision
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+    // cycles, instructions and LLC misses, in the order of counter_values
+    constexpr uint64_t EVENTS[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+
+    // The counter group of one thread, opened on its first read and closed when the thread exits
+    struct thread_counters
+    {
+        bool opened = false;
+        int fds[3] = {-1, -1, -1}; // fds[0] leads the group; -1 for events the CPU does not count
+        int position[3] = {-1, -1, -1}; // Index of each event in the group read
+        int members = 0;
+        std::string error;
+
+        ~thread_counters()
+        {
+            for (int fd : fds)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+        }
+
+        bool open()
+        {
+            opened = true;
+            for (int e = 0; e < 3; ++e)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = EVENTS[e];
+                attr.exclude_kernel = 1; // Allowed without privileges up to perf_event_paranoid 2
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, e == 0 ? -1 : fds[0], 0));
+                if (fd < 0 && e == 0)
+                {
+                    error = std::string("perf_event_open failed: ") + std::strerror(errno);
+                    if (errno == ENOENT || errno == EOPNOTSUPP)
+                    {
+                        error += " (no hardware counters, e.g. inside a virtual machine)";
+                    }
+                    else if (errno == EACCES || errno == EPERM)
+                    {
+                        error += " (check kernel.perf_event_paranoid)";
+                    }
+                    return false;
+                }
+                if (fd >= 0)
+                {
+                    fds[e] = fd;
+                    position[e] = members++;
+                }
+            }
+            return true;
+        }
+
+        counter_values read_group()
+        {
+            counter_values values;
+            if (!opened && !open())
+            {
+                return values;
+            }
+            if (fds[0] < 0)
+            {
+                return values;
+            }
+            // nr, time enabled, time running, then one value per member
+            uint64_t buffer[3 + 3] = {};
+            if (read(fds[0], buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + members) * sizeof(uint64_t)))
+            {
+                return values;
+            }
+            // Scale up when the kernel multiplexed the group with other events
+            double scale = buffer[2] > 0 && buffer[2] < buffer[1] ? static_cast<double>(buffer[1]) / buffer[2] : 1.0;
+            auto value = [&](int e) {
+                return position[e] < 0 ? uint64_t(0) : static_cast<uint64_t>(buffer[3 + position[e]] * scale);
+            };
+            values.cycles = value(0);
+            values.instructions = value(1);
+            values.llc_misses = value(2);
+            return values;
+        }
+    };
+
+    thread_local thread_counters this_thread_counters;
+#endif
+
+    // Names are literals in the sources, but escape them anyway so the report is always valid JSON
+    std::string json_string(const std::string& text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+}
+
+profiler& profiler::instance()
+{
+    static profiler single;
+    return single;
+}
+
+profiler::profiler()
+{
+    names.reserve(MAX_PHASES);
+}
+
+profiler::~profiler()
+{
+#ifndef NO_PROFILING
+    if (!report_path.empty() && write_report(report_path))
+    {
+        std::cout << "Wrote profile " << report_path << "." << std::endl;
+    }
+#endif
+}
+
+size_t profiler::register_phase(const char* name)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        if (names[i] == name)
+        {
+            return i;
+        }
+    }
+    if (names.size() == MAX_PHASES)
+    {
+        std::cerr << "More than " << MAX_PHASES << " profiled phases; raise profiler::MAX_PHASES." << std::endl;
+        exit(1);
+    }
+    names.push_back(name);
+    return names.size() - 1;
+}
+
+void profiler::record(size_t phase, uint64_t nanoseconds, const counter_values& counters)
+{
+    phase_slot& slot = phases[phase];
+    slot.calls.fetch_add(1, std::memory_order_relaxed);
+    slot.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    if (counters_enabled())
+    {
+        slot.cycles.fetch_add(counters.cycles, std::memory_order_relaxed);
+        slot.instructions.fetch_add(counters.instructions, std::memory_order_relaxed);
+        slot.llc_misses.fetch_add(counters.llc_misses, std::memory_order_relaxed);
+    }
+}
+
+bool profiler::enable_counters(bool enabled)
+{
+    if (!enabled)
+    {
+        counters_on.store(false, std::memory_order_relaxed);
+        return true;
+    }
+#ifdef __linux__
+    if (!this_thread_counters.opened)
+    {
+        this_thread_counters.open();
+    }
+    if (this_thread_counters.fds[0] < 0)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counter_failure = this_thread_counters.error;
+        return false;
+    }
+    counters_on.store(true, std::memory_order_relaxed);
+    return true;
+#else
+    std::lock_guard<std::mutex> guard(lock);
+    counter_failure = "Hardware counters need perf_event_open, which only Linux provides";
+    return false;
+#endif
+}
+
+counter_values profiler::read_counters()
+{
+#ifdef __linux__
+    if (counters_enabled())
+    {
+        return this_thread_counters.read_group();
+    }
+#endif
+    return {};
+}
+
+void profiler::set_report_path(const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    report_path = path;
+}
+
+std::vector<phase_report> profiler::snapshot() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<phase_report> reports(names.size());
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        reports[i].name = names[i];
+        reports[i].calls = phases[i].calls.load(std::memory_order_relaxed);
+        reports[i].seconds = phases[i].nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        reports[i].counters.cycles = phases[i].cycles.load(std::memory_order_relaxed);
+        reports[i].counters.instructions = phases[i].instructions.load(std::memory_order_relaxed);
+        reports[i].counters.llc_misses = phases[i].llc_misses.load(std::memory_order_relaxed);
+    }
+    return reports;
+}
+
+void profiler::reset()
+{
+    for (phase_slot& slot : phases)
+    {
+        slot.calls = 0;
+        slot.nanoseconds = 0;
+        slot.cycles = 0;
+        slot.instructions = 0;
+        slot.llc_misses = 0;
+    }
+}
+
+void profiler::write_report(std::ostream& out) const
+{
+    const bool counters = counters_enabled();
+    std::string failure;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        failure = counter_failure;
+    }
+
+    std::streamsize precision = out.precision();
+    out << "{\n  \"counters\": " << (counters ? "true" : "false") << ",\n";
+    if (!counters && !failure.empty())
+    {
+        out << "  \"counter_error\": " << json_string(failure) << ",\n";
+    }
+    out << "  \"phases\": [";
+    std::vector<phase_report> reports = snapshot();
+    bool first = true;
+    for (const phase_report& phase : reports)
+    {
+        // Phases registered but never entered (e.g. the cache path on a cold start) are left out
+        if (phase.calls == 0)
+        {
+            continue;
+        }
+        out << (first ? "\n" : ",\n") << "    {\"name\": " << json_string(phase.name) << ", \"calls\": " << phase.calls
+            << ", \"seconds\": " << std::setprecision(9) << phase.seconds;
+        if (counters)
+        {
+            out << ", \"cycles\": " << phase.counters.cycles << ", \"instructions\": " << phase.counters.instructions
+                << ", \"llc_misses\": " << phase.counters.llc_misses << ", \"ipc\": " << std::setprecision(4)
+                << (phase.counters.cycles ? static_cast<double>(phase.counters.instructions) / phase.counters.cycles : 0.0);
+        }
+        out << "}";
+        first = false;
+    }
+    out << (first ? "]\n}\n" : "\n  ]\n}\n");
+    out.precision(precision);
+}
+
+bool profiler::write_report(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Could not write profile " << path << "." << std::endl;
+        return false;
+    }
+    write_report(file);
+    return static_cast<bool>(file);
+}
+
+scoped_phase::scoped_phase(size_t phase_id)
+    : phase(phase_id)
+{
+    counters_at_start = profiler::instance().read_counters();
+    start = std::chrono::steady_clock::now();
+}
+
+scoped_phase::~scoped_phase()
+{
+    auto end = std::chrono::steady_clock::now();
+    profiler& p = profiler::instance();
+    counter_values now = p.read_counters();
+    // Multiplexed counts are estimates that may step back slightly; clamp those differences at zero
+    auto difference = [](uint64_t later, uint64_t earlier) { return later > earlier ? later - earlier : 0; };
+    counter_values spent;
+    spent.cycles = difference(now.cycles, counters_at_start.cycles);
+    spent.instructions = difference(now.instructions, counters_at_start.instructions);
+    spent.llc_misses = difference(now.llc_misses, counters_at_start.llc_misses);
+    p.record(phase, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()), spent);
+}
@@ -0,0 +1,237 @@
+#include "socket_stream.hpp"
+#include <iostream>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+socket_stream::~socket_stream() {}
+bool socket_stream::send_all(const void*, size_t) { return false; }
+bool socket_stream::receive_all(void*, size_t) { return false; }
+void socket_stream::shutdown() {}
+
+socket_listener::socket_listener(const std::string& address) : fd(-1)
+{
+    std::cerr << "Cannot listen on " << address << ": sockets are not supported on Windows." << std::endl;
+    exit(1);
+}
+
+socket_listener::~socket_listener() {}
+std::unique_ptr<ipc_channel> socket_listener::accept(int) { return nullptr; }
+
+std::unique_ptr<socket_stream> connect_socket(const std::string& address)
+{
+    std::cerr << "Cannot connect to " << address << ": sockets are not supported on Windows." << std::endl;
+    return nullptr;
+}
+
+#else
+
+namespace
+{
+    // Writes to a closed peer fail with EPIPE instead of raising SIGPIPE
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+
+    // A parsed address, ready for bind or connect
+    struct endpoint
+    {
+        sockaddr_storage address{};
+        socklen_t length = 0;
+        std::string unix_path; // Empty for TCP
+    };
+
+    bool parse_endpoint(const std::string& text, endpoint& out)
+    {
+        if (text.compare(0, 5, "unix:") == 0)
+        {
+            sockaddr_un& address = reinterpret_cast<sockaddr_un&>(out.address);
+            out.unix_path = text.substr(5);
+            if (out.unix_path.empty() || out.unix_path.size() >= sizeof(address.sun_path))
+            {
+                return false;
+            }
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, out.unix_path.c_str(), out.unix_path.size() + 1);
+            out.length = sizeof(sockaddr_un);
+            return true;
+        }
+        if (text.compare(0, 4, "tcp:") == 0)
+        {
+            // tcp:PORT or tcp:HOST:PORT, numeric IPv4 hosts only
+            std::string host = "127.0.0.1";
+            std::string port = text.substr(4);
+            const size_t colon = port.rfind(':');
+            if (colon != std::string::npos)
+            {
+                host = port.substr(0, colon);
+                port = port.substr(colon + 1);
+            }
+            sockaddr_in& address = reinterpret_cast<sockaddr_in&>(out.address);
+            address.sin_family = AF_INET;
+            char* end = nullptr;
+            const unsigned long number = std::strtoul(port.c_str(), &end, 10);
+            if (port.empty() || *end != '\0' || number > 65535 || inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+            {
+                return false;
+            }
+            address.sin_port = htons(static_cast<uint16_t>(number));
+            out.length = sizeof(sockaddr_in);
+            return true;
+        }
+        return false;
+    }
+
+    // Requests and responses are small, so send them without waiting to coalesce them
+    void disable_nagle(int fd)
+    {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+}
+
+socket_stream::~socket_stream()
+{
+    ::close(fd);
+}
+
+bool socket_stream::send_all(const void* data, size_t bytes)
+{
+    const char* next = static_cast<const char*>(data);
+    while (bytes > 0)
+    {
+        const ssize_t sent = ::send(fd, next, bytes, SEND_FLAGS);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        next += sent;
+        bytes -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool socket_stream::receive_all(void* data, size_t bytes)
+{
+    char* next = static_cast<char*>(data);
+    while (bytes > 0)
+    {
+        const ssize_t received = ::recv(fd, next, bytes, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        next += received;
+        bytes -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void socket_stream::shutdown()
+{
+    ::shutdown(fd, SHUT_RDWR);
+}
+
+socket_listener::socket_listener(const std::string& address) : fd(-1)
+{
+    endpoint local;
+    if (!parse_endpoint(address, local))
+    {
+        std::cerr << "Invalid socket address " << address << "; expected unix:PATH, tcp:PORT or tcp:HOST:PORT." << std::endl;
+        exit(1);
+    }
+
+    fd = ::socket(local.address.ss_family, SOCK_STREAM, 0);
+    if (fd >= 0 && local.unix_path.empty())
+    {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    else if (fd >= 0)
+    {
+        // A socket file left behind by a server that did not shut down cleanly
+        ::unlink(local.unix_path.c_str());
+    }
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&local.address), local.length) != 0 || ::listen(fd, SOMAXCONN) != 0)
+    {
+        std::cerr << "Cannot listen on " << address << ": " << std::strerror(errno) << "." << std::endl;
+        exit(1);
+    }
+    unix_path = local.unix_path;
+}
+
+socket_listener::~socket_listener()
+{
+    ::close(fd);
+    if (!unix_path.empty())
+    {
+        ::unlink(unix_path.c_str());
+    }
+}
+
+std::unique_ptr<ipc_channel> socket_listener::accept(int timeout_ms)
+{
+    pollfd waiting{fd, POLLIN, 0};
+    if (::poll(&waiting, 1, timeout_ms) <= 0)
+    {
+        return nullptr;
+    }
+    const int client = ::accept(fd, nullptr, nullptr);
+    if (client < 0)
+    {
+        return nullptr;
+    }
+    if (unix_path.empty())
+    {
+        disable_nagle(client);
+    }
+    return std::make_unique<socket_stream>(client);
+}
+
+std::unique_ptr<socket_stream> connect_socket(const std::string& address)
+{
+    endpoint remote;
+    if (!parse_endpoint(address, remote))
+    {
+        std::cerr << "Invalid socket address " << address << "; expected unix:PATH, tcp:PORT or tcp:HOST:PORT." << std::endl;
+        return nullptr;
+    }
+    const int fd = ::socket(remote.address.ss_family, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&remote.address), remote.length) != 0)
+    {
+        std::cerr << "Cannot connect to " << address << ": " << std::strerror(errno) << "." << std::endl;
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return nullptr;
+    }
+    if (remote.unix_path.empty())
+    {
+        disable_nagle(fd);
+    }
+    return std::make_unique<socket_stream>(fd);
+}
+
+#endif
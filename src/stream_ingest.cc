@@ -0,0 +1,292 @@
+#include "stream_ingest.hpp"
+#include "dataset_cache.hpp"
+#include "idx_file.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem> // For rename
+#include <fstream>
+#include <future>     // For the reader and writer threads
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <omp.h>      // For OpenMP
+
+namespace
+{
+    // Subset of a sample from a hash of its row: 0 training, 1 test, 2 validation
+    int assign_subset(size_t row, const ingest_options& options)
+    {
+        uint64_t x = options.split_seed + 0x9E3779B97F4A7C15ULL * (static_cast<uint64_t>(row) + 1);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        const double u = static_cast<double>(x >> 11) * 0x1.0p-53;
+        return u < options.training_fraction ? 0 : u < options.training_fraction + options.test_fraction ? 1 : 2;
+    }
+
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Pixels and labels of up to batch_rows consecutive samples
+    struct batch
+    {
+        aligned_buffer<uint8_t> pixels;
+        std::vector<uint8_t> labels;
+        size_t rows = 0;
+    };
+
+    // Read the next rows samples from both files into a batch on a separate thread
+    std::future<size_t> read_async(idx_stream& images, idx_stream& labels, batch& into, size_t rows)
+    {
+        return std::async(std::launch::async, [&images, &labels, &into, rows] {
+            into.rows = images.read(into.pixels.data(), rows);
+            if (labels.read(into.labels.data(), into.rows) != into.rows)
+            {
+                std::cerr << "Label file ended before the image file: " << labels.get_path() << std::endl;
+                exit(1);
+            }
+            return into.rows;
+        });
+    }
+
+    template <typename T>
+    void write_at(std::ofstream& out, uint64_t offset, const T* data, size_t count)
+    {
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    }
+}
+
+std::string shard_path(const std::string& prefix, size_t shard)
+{
+    return prefix + "." + std::to_string(shard) + ".cache";
+}
+
+uint64_t shard_key(const std::string& images, const std::string& labels, const ingest_options& options, size_t shard)
+{
+    std::ostringstream parameters;
+    parameters << (options.method == normalization_method::z_score ? "z_score" : "min_max") << " "
+               << options.training_fraction << " " << options.test_fraction << " seed " << options.split_seed
+               << " shard " << shard << " of " << options.shard_rows;
+    return cache_key({images, labels}, parameters.str());
+}
+
+ingest_report stream_ingest(const std::string& images, const std::string& labels, const std::string& prefix,
+                            const ingest_options& options)
+{
+    PROFILE_PHASE("stream_ingest");
+    idx_stream image_stream(images, idx_file::IMAGE_MAGIC);
+    idx_stream label_stream(labels, idx_file::LABEL_MAGIC);
+    const size_t n = image_stream.get_count();
+    const size_t f = image_stream.get_record_size();
+    if (n == 0 || label_stream.get_count() != n || label_stream.get_record_size() != 1)
+    {
+        std::cerr << "Mismatch between number of images and labels." << std::endl;
+        exit(1);
+    }
+
+    // Budget: three raw batches (one being read, one normalized, one written), two normalized batches (one
+    // being filled, one written), the labels, enumerated labels and split of a shard, two checksum chunks
+    const size_t shard_rows = options.shard_rows ? std::min(options.shard_rows, n) : n;
+    const size_t fixed_bytes = 2 * CHECKSUM_CHUNK + shard_rows * (sizeof(uint8_t) + sizeof(int32_t) + sizeof(uint32_t));
+    const size_t row_bytes = 3 * (f + 1) + 2 * f * sizeof(float);
+    if (options.memory_limit < fixed_bytes + row_bytes * FEATURE_STATS_CHUNK)
+    {
+        std::cerr << "A memory limit of " << options.memory_limit << " bytes cannot hold one batch of "
+                  << FEATURE_STATS_CHUNK << " samples; at least " << fixed_bytes + row_bytes * FEATURE_STATS_CHUNK
+                  << " bytes are needed." << std::endl;
+        exit(1);
+    }
+    // Whole statistics chunks per batch keep the statistics identical to a single in-memory pass
+    size_t batch_rows = (options.memory_limit - fixed_bytes) / row_bytes / FEATURE_STATS_CHUNK * FEATURE_STATS_CHUNK;
+    batch_rows = std::min(batch_rows, (n + FEATURE_STATS_CHUNK - 1) / FEATURE_STATS_CHUNK * FEATURE_STATS_CHUNK);
+
+    ingest_report report;
+    report.samples = n;
+    report.shards = (n + shard_rows - 1) / shard_rows;
+    report.batch_rows = batch_rows;
+    report.buffer_bytes = fixed_bytes + row_bytes * batch_rows;
+
+    batch slots[3];
+    for (batch& slot : slots)
+    {
+        slot.pixels.resize(batch_rows * f);
+        slot.labels.resize(batch_rows);
+    }
+
+    // First pass: statistics and classes, enumerated in order of first appearance like count_classes
+    auto start = std::chrono::steady_clock::now();
+    feature_stats statistics;
+    statistics.reset(f);
+    int class_of[256];
+    std::fill(std::begin(class_of), std::end(class_of), -1);
+    std::vector<uint8_t> class_labels;
+    std::future<size_t> reading = read_async(image_stream, label_stream, slots[0], batch_rows);
+    for (size_t i = 0;; ++i)
+    {
+        batch& current = slots[i % 2];
+        if (reading.get() == 0)
+        {
+            break;
+        }
+        reading = read_async(image_stream, label_stream, slots[(i + 1) % 2], batch_rows);
+        accumulate_feature_stats(statistics, {current.pixels.data(), current.rows * f}, f);
+        for (size_t r = 0; r < current.rows; ++r)
+        {
+            const uint8_t label = current.labels[r];
+            if (class_of[label] < 0)
+            {
+                class_of[label] = static_cast<int>(class_labels.size());
+                class_labels.push_back(label);
+            }
+        }
+    }
+    report.statistics_seconds = seconds_since(start);
+
+    std::vector<float> offset, scale;
+    statistics.scaling(options.method, offset, scale);
+    const float* off = offset.data();
+    const float* sc = scale.data();
+
+    // Sections shared by every shard
+    const uint64_t class_sum = checksum(class_labels.data(), class_labels.size());
+    const uint64_t mean_sum = checksum(statistics.mean.data(), f * sizeof(double));
+    const uint64_t m2_sum = checksum(statistics.m2.data(), f * sizeof(double));
+    const uint64_t minimum_sum = checksum(statistics.minimum.data(), f);
+    const uint64_t maximum_sum = checksum(statistics.maximum.data(), f);
+
+    // Second pass: read, normalize and write, overlapped
+    start = std::chrono::steady_clock::now();
+    image_stream.rewind();
+    label_stream.rewind();
+    aligned_buffer<float> normalized[2] = {aligned_buffer<float>(batch_rows * f), aligned_buffer<float>(batch_rows * f)};
+    std::vector<uint8_t> shard_labels(shard_rows);
+    std::vector<int32_t> enumerated(shard_rows);
+    std::vector<uint32_t> split(shard_rows);
+    for (size_t shard = 0; shard < report.shards; ++shard)
+    {
+        const size_t first = shard * shard_rows;
+        const size_t rows = std::min(shard_rows, n - first);
+
+        // The subsets are stored one after another; count them first to place each one
+        size_t subset_counts[3] = {0, 0, 0};
+        for (size_t r = 0; r < rows; ++r)
+        {
+            ++subset_counts[assign_subset(first + r, options)];
+        }
+        size_t cursors[3] = {0, subset_counts[0], subset_counts[0] + subset_counts[1]};
+
+        cache_header header = {};
+        header.key = shard_key(images, labels, options, shard);
+        header.sample_count = rows;
+        header.feature_count = f;
+        header.normalized_feature_count = f;
+        header.class_count = class_labels.size();
+        header.stats_count = statistics.count;
+        header.training_count = subset_counts[0];
+        header.test_count = subset_counts[1];
+        header.validation_count = subset_counts[2];
+        const size_t bytes[CACHE_SECTION_COUNT] = {
+            rows * f, rows, rows * sizeof(int32_t), class_labels.size(),
+            f * sizeof(double), f * sizeof(double), f, f,
+            rows * f * sizeof(float), rows * sizeof(uint32_t),
+        };
+        layout_cache(header, bytes);
+
+        const std::string path = shard_path(prefix, shard);
+        const std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "Could not create shard: " << temporary << std::endl;
+            exit(1);
+        }
+
+        // Batch i lives in slots[i % 3] and normalized[i % 2]. The write of batch i - 1 may still run while
+        // batch i is normalized; the write of batch i - 2 has finished, which frees the slot batch i + 1 is
+        // read into and the normalized buffer of batch i.
+        checksum_stream raw_sum, normalized_sum;
+        std::future<void> writing;
+        reading = read_async(image_stream, label_stream, slots[0], std::min(batch_rows, rows));
+        for (size_t i = 0, done = 0; done < rows; ++i)
+        {
+            batch& current = slots[i % 3];
+            const size_t count = reading.get();
+            if (count == 0)
+            {
+                std::cerr << "Image file ended early: " << images << std::endl;
+                exit(1);
+            }
+            if (done + count < rows)
+            {
+                reading = read_async(image_stream, label_stream, slots[(i + 1) % 3], std::min(batch_rows, rows - done - count));
+            }
+
+            float* target = normalized[i % 2].data();
+            const uint8_t* pixels = current.pixels.data();
+            #pragma omp parallel for schedule(static)
+            for (long long r = 0; r < static_cast<long long>(count); ++r)
+            {
+                const uint8_t* feature_vector = pixels + r * f;
+                float* normalized_feature_vector = target + r * f;
+                #pragma omp simd
+                for (size_t j = 0; j < f; ++j)
+                {
+                    normalized_feature_vector[j] = (static_cast<float>(feature_vector[j]) - off[j]) * sc[j];
+                }
+            }
+            for (size_t r = 0; r < count; ++r)
+            {
+                shard_labels[done + r] = current.labels[r];
+                enumerated[done + r] = class_of[current.labels[r]];
+                split[cursors[assign_subset(first + done + r, options)]++] = static_cast<uint32_t>(done + r);
+            }
+
+            if (writing.valid())
+            {
+                writing.get();
+            }
+            writing = std::async(std::launch::async, [&, done, count, pixels, target] {
+                write_at(out, header.sections[CACHE_RAW_FEATURES].offset + done * f, pixels, count * f);
+                raw_sum.update(pixels, count * f);
+                write_at(out, header.sections[CACHE_NORMALIZED_FEATURES].offset + done * f * sizeof(float), target, count * f);
+                normalized_sum.update(target, count * f * sizeof(float));
+            });
+            done += count;
+        }
+        writing.get();
+
+        // The small sections, then the header
+        write_at(out, header.sections[CACHE_LABELS].offset, shard_labels.data(), rows);
+        write_at(out, header.sections[CACHE_ENUMERATED_LABELS].offset, enumerated.data(), rows);
+        write_at(out, header.sections[CACHE_CLASS_LABELS].offset, class_labels.data(), class_labels.size());
+        write_at(out, header.sections[CACHE_STATS_MEAN].offset, statistics.mean.data(), f);
+        write_at(out, header.sections[CACHE_STATS_M2].offset, statistics.m2.data(), f);
+        write_at(out, header.sections[CACHE_STATS_MINIMUM].offset, statistics.minimum.data(), f);
+        write_at(out, header.sections[CACHE_STATS_MAXIMUM].offset, statistics.maximum.data(), f);
+        write_at(out, header.sections[CACHE_SPLIT_INDICES].offset, split.data(), rows);
+        const uint64_t sums[CACHE_SECTION_COUNT] = {
+            raw_sum.finish(), checksum(shard_labels.data(), rows), checksum(enumerated.data(), rows * sizeof(int32_t)),
+            class_sum, mean_sum, m2_sum, minimum_sum, maximum_sum,
+            normalized_sum.finish(), checksum(split.data(), rows * sizeof(uint32_t)),
+        };
+        seal_cache(header, sums);
+        write_at(out, 0, &header, 1);
+        out.close();
+
+        std::error_code error;
+        if (out.fail() || (std::filesystem::rename(temporary, path, error), error))
+        {
+            std::cerr << "Could not write shard: " << path << std::endl;
+            exit(1);
+        }
+    }
+    report.shard_seconds = seconds_since(start);
+
+    std::cout << "Streamed " << n << " samples into " << report.shards << " shard(s) in batches of " << batch_rows
+              << " samples (" << report.buffer_bytes / (1 << 20) << " MiB of buffers)." << std::endl;
+    return report;
+}
@@ -0,0 +1,182 @@
+// Load generator for knn_server: replays the images of an IDX file from several connections, each keeping
+// up to depth requests in flight, and reports the client-side latency percentiles, the throughput and the
+// accuracy of the answers against the label file. With --shutdown 1 the server is stopped afterwards.
+// Usage: knn_load_generator [--address unix:PATH|tcp:PORT] [--connections C] [--requests N] [--depth D]
+//                           [--images PATH] [--labels PATH] [--shutdown 0|1]
+#include "../include/idx_file.hpp"
+#include "../include/latency_histogram.hpp"
+#include "../include/ipc_channel.hpp"
+#include "../K-NN/include/inference_server.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using load_clock = std::chrono::steady_clock;
+
+    struct connection_result
+    {
+        latency_histogram latency;
+        size_t answered = 0;
+        size_t correct = 0;
+        size_t errors = 0; // Bad requests, unknown ids or a lost connection
+    };
+
+    // Send the requests first, first + step, ... below end over one connection, at most depth at a time
+    void drive_connection(const std::string& address, const idx_file& images, const idx_file& labels,
+                          size_t first, size_t step, size_t end, size_t depth, connection_result& result)
+    {
+        std::unique_ptr<ipc_channel> stream = connect_ipc(address);
+        if (!stream)
+        {
+            result.errors = (end - first + step - 1) / step;
+            return;
+        }
+
+        const size_t features = images.get_record_size();
+        std::vector<load_clock::time_point> sent_at(end);
+        std::mutex lock;
+        std::condition_variable slot_freed;
+        size_t in_flight = 0;
+        bool failed = false;
+
+        std::thread sender([&] {
+            std::vector<uint8_t> message(sizeof(request_header) + features);
+            for (size_t id = first; id < end; id += step)
+            {
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    slot_freed.wait(guard, [&] { return in_flight < depth || failed; });
+                    if (failed)
+                    {
+                        return;
+                    }
+                    ++in_flight;
+                    sent_at[id] = load_clock::now();
+                }
+                const request_header header{INFERENCE_REQUEST_MAGIC, static_cast<uint32_t>(id),
+                                            static_cast<uint32_t>(request_type::raw_features), static_cast<uint32_t>(features)};
+                std::memcpy(message.data(), &header, sizeof(header));
+                std::memcpy(message.data() + sizeof(header), images.record(id % images.get_count()).data(), features);
+                if (!stream->send_all(message.data(), message.size()))
+                {
+                    return;
+                }
+            }
+        });
+
+        const size_t expected = (end - first + step - 1) / step;
+        inference_response reply;
+        while (result.answered + result.errors < expected && stream->receive_all(&reply, sizeof(reply)))
+        {
+            const load_clock::time_point now = load_clock::now();
+            if (reply.magic != INFERENCE_RESPONSE_MAGIC || reply.id >= end || reply.status != static_cast<uint32_t>(response_status::ok))
+            {
+                ++result.errors;
+            }
+            else
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                result.latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - sent_at[reply.id]).count()));
+                ++result.answered;
+                result.correct += reply.label == labels.record(reply.id % labels.get_count())[0];
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                --in_flight;
+            }
+            slot_freed.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            failed = true;
+        }
+        slot_freed.notify_one();
+        stream->shutdown();
+        sender.join();
+        result.errors = expected - result.answered;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string address = server_options().address;
+    size_t connections = 4;
+    size_t requests = 10000;
+    size_t depth = 1;
+    bool shutdown = false;
+    std::string images_path = "./data/train-images.idx3-ubyte";
+    std::string labels_path = "./data/train-labels.idx1-ubyte";
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string flag = argv[i];
+        const std::string value = argv[i + 1];
+        if (flag == "--address") address = value;
+        else if (flag == "--connections") connections = std::stoul(value);
+        else if (flag == "--requests") requests = std::stoul(value);
+        else if (flag == "--depth") depth = std::stoul(value);
+        else if (flag == "--images") images_path = value;
+        else if (flag == "--labels") labels_path = value;
+        else if (flag == "--shutdown") shutdown = value != "0";
+        else
+        {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+    connections = std::max<size_t>(connections, 1);
+    depth = std::max<size_t>(depth, 1);
+
+    const idx_file images(images_path, idx_file::IMAGE_MAGIC);
+    const idx_file labels(labels_path, idx_file::LABEL_MAGIC);
+
+    // Connection c sends requests c, c + connections, ...
+    std::vector<connection_result> results(connections);
+    std::vector<std::thread> drivers;
+    const load_clock::time_point start = load_clock::now();
+    for (size_t c = 0; c < connections; ++c)
+    {
+        drivers.emplace_back(drive_connection, std::cref(address), std::cref(images), std::cref(labels), c, connections,
+                             requests, depth, std::ref(results[c]));
+    }
+    for (std::thread& driver : drivers)
+    {
+        driver.join();
+    }
+    const double seconds = std::chrono::duration<double>(load_clock::now() - start).count();
+
+    connection_result total;
+    for (const connection_result& result : results)
+    {
+        total.latency.merge(result.latency);
+        total.answered += result.answered;
+        total.correct += result.correct;
+        total.errors += result.errors;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << total.answered << " answers from " << connections << " connections at depth " << depth << " in "
+              << seconds << " s: " << total.answered / seconds << " req/s\n";
+    std::cout << "latency p50 " << total.latency.percentile(0.50) / 1e3 << " us, p90 " << total.latency.percentile(0.90) / 1e3
+              << " us, p99 " << total.latency.percentile(0.99) / 1e3 << " us, max " << total.latency.max() / 1e3 << " us\n";
+    std::cout << std::setprecision(4) << "accuracy " << (total.answered ? static_cast<double>(total.correct) / total.answered : 0.0)
+              << ", errors " << total.errors << std::endl;
+
+    if (shutdown)
+    {
+        std::unique_ptr<ipc_channel> stream = connect_ipc(address);
+        const request_header header{INFERENCE_REQUEST_MAGIC, 0, static_cast<uint32_t>(request_type::shutdown), 0};
+        if (stream)
+        {
+            stream->send_all(&header, sizeof(header));
+        }
+    }
+    return total.errors == 0 ? 0 : 1;
+}
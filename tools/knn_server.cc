@@ -0,0 +1,112 @@
+// Local KNN inference server: prepares the dataset once (from the cache when it is current), trains on
+// the training split and answers predictions over a Unix domain socket or loopback TCP in micro-batches.
+// Stops on SIGINT/SIGTERM or a shutdown request and prints the latency percentiles and throughput.
+// With --reduce the training rows are first reduced to prototypes (prototype_reduction.hpp), so every
+// query scans a fraction of them; with --precision fp16 or bf16 the normalized rows are stored (and cached)
+// at half width, which halves the dataset's memory and the bytes every scan reads.
+// Usage: knn_server [--address unix:PATH|tcp:PORT] [--k K] [--max-batch N] [--max-delay-us U]
+//                   [--threads T] [--report-seconds S] [--images PATH] [--labels PATH] [--cache PATH]
+//                   [--reduce edited|condensed|edited_condensed|kmeans] [--prototypes-per-class N]
+//                   [--precision fp32|fp16|bf16]
+#include "../include/data_handler.hpp"
+#include "../K-NN/include/inference_server.hpp"
+#include "../K-NN/include/knn.hpp"
+#include "../K-NN/include/prototype_reduction.hpp"
+#include <csignal>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    inference_server* running_server = nullptr;
+
+    void request_stop(int)
+    {
+        if (running_server)
+        {
+            running_server->stop();
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    server_options options;
+    int k = 3;
+    int threads = 0;
+    std::string images = "./data/train-images.idx3-ubyte";
+    std::string labels = "./data/train-labels.idx1-ubyte";
+    std::string cache = "./data/train.cache";
+    std::string reduce;
+    std::string precision = "fp32";
+    reduction_options reduction;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string flag = argv[i];
+        const std::string value = argv[i + 1];
+        if (flag == "--address") options.address = value;
+        else if (flag == "--k") k = std::stoi(value);
+        else if (flag == "--max-batch") options.max_batch = std::stoul(value);
+        else if (flag == "--max-delay-us") options.max_delay = std::chrono::microseconds(std::stol(value));
+        else if (flag == "--threads") threads = std::stoi(value);
+        else if (flag == "--report-seconds") options.report_seconds = std::stod(value);
+        else if (flag == "--images") images = value;
+        else if (flag == "--labels") labels = value;
+        else if (flag == "--cache") cache = value;
+        else if (flag == "--reduce") reduce = value;
+        else if (flag == "--prototypes-per-class") reduction.prototypes_per_class = std::stoul(value);
+        else if (flag == "--precision") precision = value;
+        else
+        {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    feature_precision storage;
+    if (precision == "fp32") storage = feature_precision::fp32;
+    else if (precision == "fp16") storage = feature_precision::fp16;
+    else if (precision == "bf16") storage = feature_precision::bf16;
+    else
+    {
+        std::cerr << "Unknown precision " << precision << std::endl;
+        return 1;
+    }
+
+    // The model is loaded once; every request reuses it
+    data_handler dh;
+    // The reduction reads fp32 rows, so with it the rows are narrowed afterwards; otherwise they are
+    // normalized (or mapped from the cache) at the chosen precision directly
+    if (reduce.empty())
+    {
+        dh.set_feature_precision(storage);
+    }
+    dh.load_or_prepare(images, labels, cache, options.normalization);
+    dataset_view training = dh.get_training_data();
+    if (!reduce.empty())
+    {
+        if (reduce == "edited") reduction.method = reduction_method::edited;
+        else if (reduce == "condensed") reduction.method = reduction_method::condensed;
+        else if (reduce == "edited_condensed") reduction.method = reduction_method::edited_condensed;
+        else if (reduce == "kmeans") reduction.method = reduction_method::kmeans;
+        else
+        {
+            std::cerr << "Unknown reduction " << reduce << std::endl;
+            return 1;
+        }
+        reduction.threads = threads;
+        training = reduce_training_set(training, reduction);
+        dh.set_feature_precision(storage);
+    }
+    KNN knn(k);
+    knn.set_thread_count(threads);
+    knn.set_training_data(training);
+
+    inference_server server(knn, dh, options);
+    running_server = &server;
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+    server.run();
+    running_server = nullptr;
+    return 0;
+}
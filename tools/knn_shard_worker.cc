@@ -0,0 +1,17 @@
+// Shard worker for sharded_knn: set shard_options::worker_command to this program. It loads its slice of
+// the training rows from the prepared dataset cache and answers the coordinator until it disconnects.
+// Usage (filled in by the coordinator): knn_shard_worker --address A --images I --labels L --cache C
+//                                       --shard S --shards N --metric M --threads T
+#include "../K-NN/include/sharded_knn.hpp"
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    shard_worker_options options;
+    if (!parse_shard_worker_arguments(argc, argv, 1, options))
+    {
+        std::cerr << "Invalid shard worker arguments." << std::endl;
+        return 1;
+    }
+    return run_shard_worker(options);
+}